@@ -50,6 +50,9 @@ static struct ble_handles_t
     .advertising = BLE_GAP_ADV_SET_HANDLE_NOT_SET,
 };
 
+// Notifications handed to the SoftDevice which haven't yet been sent
+static volatile uint8_t notifications_in_flight = 0;
+
 static struct advertising_data_t
 {
     uint8_t length;
@@ -162,6 +165,8 @@ void SD_EVT_IRQHandler(void)
         case BLE_GAP_EVT_DISCONNECTED:
         {
             ble_handles.connection = BLE_CONN_HANDLE_INVALID;
+            notifications_in_flight = 0;
+            lua_rpc_disconnect_interrupt();
 
             check_error(sd_ble_gap_adv_start(ble_handles.advertising, 1));
 
@@ -217,10 +222,23 @@ void SD_EVT_IRQHandler(void)
             if (ble_evt->evt.gatts_evt.params.write.handle ==
                 ble_handles.repl_rx_write.value_handle)
             {
-                // Handle raw data
+                // Handle raw data, unless it calls a registered function
                 if (ble_evt->evt.gatts_evt.params.write.data[0] == 0x01)
                 {
-                    lua_bluetooth_data_interrupt(
+                    if (!lua_rpc_interrupt(
+                            ble_evt->evt.gatts_evt.params.write.data + 1,
+                            ble_evt->evt.gatts_evt.params.write.len - 1))
+                    {
+                        lua_bluetooth_data_interrupt(
+                            ble_evt->evt.gatts_evt.params.write.data + 1,
+                            ble_evt->evt.gatts_evt.params.write.len - 1);
+                    }
+                }
+
+                // Streams of length prefixed function calls
+                else if (ble_evt->evt.gatts_evt.params.write.data[0] == 0x02)
+                {
+                    lua_rpc_stream_interrupt(
                         ble_evt->evt.gatts_evt.params.write.data + 1,
                         ble_evt->evt.gatts_evt.params.write.len - 1);
                 }
@@ -343,12 +361,23 @@ void SD_EVT_IRQHandler(void)
         case BLE_GAP_EVT_CONN_PARAM_UPDATE:
         case BLE_GAP_EVT_PHY_UPDATE:
         case BLE_GAP_EVT_DATA_LENGTH_UPDATE:
-        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
         {
             // Unused events
             break;
         }
 
+        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+        {
+            uint8_t count = ble_evt->evt.gatts_evt.params.hvn_tx_complete.count;
+            notifications_in_flight -= count < notifications_in_flight
+                                           ? count
+                                           : notifications_in_flight;
+
+            // Queue up the next audio packet as soon as there's space
+            lua_microphone_stream_interrupt();
+            break;
+        }
+
         default:
         {
             LOG("Unhandled BLE event: %u", ble_evt->header.evt_id);
@@ -590,6 +619,11 @@ bool bluetooth_is_connected(void)
     return ble_handles.connection == BLE_CONN_HANDLE_INVALID ? false : true;
 }
 
+bool bluetooth_is_sending(void)
+{
+    return notifications_in_flight > 0;
+}
+
 bool bluetooth_send_data(const uint8_t *data, size_t length)
 {
     if (ble_handles.connection == BLE_CONN_HANDLE_INVALID)
@@ -604,6 +638,12 @@ bool bluetooth_send_data(const uint8_t *data, size_t length)
     hvx_params.p_len = (uint16_t *)&length;
     hvx_params.type = BLE_GATT_HVX_NOTIFICATION;
 
+    // Counted first, as it may be sent before sd_ble_gatts_hvx() returns. Data
+    // is also sent from the SoftDevice event handler
+    NRFX_CRITICAL_SECTION_ENTER();
+    notifications_in_flight++;
+    NRFX_CRITICAL_SECTION_EXIT();
+
     uint32_t status = sd_ble_gatts_hvx(ble_handles.connection, &hvx_params);
 
     if (status == NRF_SUCCESS)
@@ -611,5 +651,9 @@ bool bluetooth_send_data(const uint8_t *data, size_t length)
         return false;
     }
 
+    NRFX_CRITICAL_SECTION_ENTER();
+    notifications_in_flight--;
+    NRFX_CRITICAL_SECTION_EXIT();
+
     return true;
 }
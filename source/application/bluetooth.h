@@ -39,4 +39,7 @@ void bluetooth_unpair(void);
 
 bool bluetooth_is_connected(void);
 
+// True while notifications are still queued in the SoftDevice
+bool bluetooth_is_sending(void);
+
 bool bluetooth_send_data(const uint8_t *data, size_t length);
\ No newline at end of file
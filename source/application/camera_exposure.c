@@ -0,0 +1,154 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Works out how much the exposure must change for the metered brightness to
+ * reach the target, using the luma histogram and zones measured by the FPGA.
+ *
+ * The zones are linear in exposure, so the correction is simply the ratio of
+ * the target to the metered brightness, and a single step is normally enough.
+ * Only once pixels start to clip does the metered brightness fall short of the
+ * true scene brightness. The fraction of pixels in the top histogram bin is
+ * then used to step down further than the ratio alone would suggest.
+ *
+ * Very dark frames carry little information, so each step is limited.
+ */
+
+#include <stddef.h>
+#include "camera_exposure.h"
+
+#define CLIPPED_THRESHOLD 0.02
+#define CLIPPED_STEP_DOWN 1.0
+#define MAXIMUM_CORRECTION 64.0
+#define MINIMUM_BRIGHTNESS (0.5 / 255.0)
+
+// Zones 5, 6, 9 and 10 form the center of the 4x4 grid
+static const uint8_t center_zones[] = {5, 6, 9, 10};
+
+void camera_exposure_unpack_statistics(camera_exposure_statistics_t *statistics,
+                                       const uint8_t data[CAMERA_EXPOSURE_STATISTICS_BYTES])
+{
+    for (int i = 0; i < CAMERA_EXPOSURE_HISTOGRAM_BINS; i++)
+    {
+        statistics->histogram[i] = data[2 * i] | (data[2 * i + 1] << 8);
+    }
+
+    data += 2 * CAMERA_EXPOSURE_HISTOGRAM_BINS;
+
+    for (int i = 0; i < CAMERA_EXPOSURE_ZONES; i++)
+    {
+        statistics->zones[i] = data[2 * i] | (data[2 * i + 1] << 8);
+    }
+}
+
+double camera_exposure_correction(const camera_exposure_statistics_t *statistics,
+                                  camera_exposure_metering_t metering,
+                                  double target,
+                                  camera_exposure_measurement_t *measurement)
+{
+    // Histogram bins are counted in units of 8 pixels
+    uint32_t pixels = 0;
+
+    for (int i = 0; i < CAMERA_EXPOSURE_HISTOGRAM_BINS; i++)
+    {
+        pixels += statistics->histogram[i];
+    }
+
+    pixels *= 8;
+
+    if (pixels < CAMERA_EXPOSURE_ZONES)
+    {
+        *measurement = (camera_exposure_measurement_t){.correction = 1.0};
+        return 1.0;
+    }
+
+    // Zone sums are of 8 bit luma values, in units of 256
+    double zone_pixels = (double)pixels / CAMERA_EXPOSURE_ZONES;
+
+    measurement->average = 0.0;
+
+    for (int i = 0; i < CAMERA_EXPOSURE_ZONES; i++)
+    {
+        measurement->zones[i] = statistics->zones[i] * 256.0 / zone_pixels / 255.0;
+        measurement->average += measurement->zones[i] / CAMERA_EXPOSURE_ZONES;
+    }
+
+    measurement->spot = 0.0;
+
+    for (size_t i = 0; i < sizeof(center_zones); i++)
+    {
+        measurement->spot += measurement->zones[center_zones[i]] /
+                             sizeof(center_zones);
+    }
+
+    measurement->center_weighted = (2.0 * measurement->spot +
+                                    measurement->average) /
+                                   3.0;
+
+    switch (metering)
+    {
+    case CAMERA_EXPOSURE_SPOT:
+        measurement->metered = measurement->spot;
+        break;
+
+    case CAMERA_EXPOSURE_CENTER_WEIGHTED:
+        measurement->metered = measurement->center_weighted;
+        break;
+
+    default:
+        measurement->metered = measurement->average;
+        break;
+    }
+
+    measurement->clipped = statistics->histogram[CAMERA_EXPOSURE_HISTOGRAM_BINS - 1] *
+                           8.0 / pixels;
+
+    double metered = measurement->metered;
+
+    if (metered < MINIMUM_BRIGHTNESS)
+    {
+        metered = MINIMUM_BRIGHTNESS;
+    }
+
+    double correction = target / metered;
+
+    // Clipped pixels hide how much brighter the scene really is
+    if (correction < 1.0 && measurement->clipped > CLIPPED_THRESHOLD)
+    {
+        correction /= 1.0 + CLIPPED_STEP_DOWN * measurement->clipped;
+    }
+
+    if (correction > MAXIMUM_CORRECTION)
+    {
+        correction = MAXIMUM_CORRECTION;
+    }
+
+    if (correction < 1.0 / MAXIMUM_CORRECTION)
+    {
+        correction = 1.0 / MAXIMUM_CORRECTION;
+    }
+
+    measurement->correction = correction;
+    return correction;
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define CAMERA_EXPOSURE_HISTOGRAM_BINS 64
+#define CAMERA_EXPOSURE_ZONES 16
+#define CAMERA_EXPOSURE_STATISTICS_BYTES \
+    (2 * (CAMERA_EXPOSURE_HISTOGRAM_BINS + CAMERA_EXPOSURE_ZONES))
+
+typedef enum camera_exposure_metering_t
+{
+    CAMERA_EXPOSURE_SPOT,
+    CAMERA_EXPOSURE_CENTER_WEIGHTED,
+    CAMERA_EXPOSURE_AVERAGE
+} camera_exposure_metering_t;
+
+typedef struct camera_exposure_statistics_t
+{
+    uint16_t histogram[CAMERA_EXPOSURE_HISTOGRAM_BINS];
+    uint16_t zones[CAMERA_EXPOSURE_ZONES];
+} camera_exposure_statistics_t;
+
+typedef struct camera_exposure_measurement_t
+{
+    double zones[CAMERA_EXPOSURE_ZONES];
+    double spot;
+    double average;
+    double center_weighted;
+    double metered;
+    double clipped;
+    double correction;
+} camera_exposure_measurement_t;
+
+void camera_exposure_unpack_statistics(camera_exposure_statistics_t *statistics,
+                                       const uint8_t data[CAMERA_EXPOSURE_STATISTICS_BYTES]);
+
+double camera_exposure_correction(const camera_exposure_statistics_t *statistics,
+                                  camera_exposure_metering_t metering,
+                                  double target,
+                                  camera_exposure_measurement_t *measurement);
@@ -0,0 +1,158 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Picks the JPEG quality level of the next frame so that its compressed size
+ * stays within a byte budget.
+ *
+ * Each frame's size is converted into a scene complexity, i.e. the number of
+ * bytes the frame would have taken per 64x64 pixels at quality level 6. The
+ * next frame's size at any quality level is then predicted from the running
+ * complexity estimate, and the highest level predicted to fit is chosen.
+ *
+ * Complexity rises quickly, and falls slowly, so that a busier scene doesn't
+ * overshoot the budget for more than a frame. A large change in the metered
+ * brightness is taken as a new scene, and the estimate is replaced outright.
+ */
+
+#include <stdlib.h>
+#include "camera_rate_control.h"
+
+// Relative compressed size of each quality level, where 1024 = level 6
+static const uint16_t relative_size[CAMERA_RATE_CONTROL_QUALITY_LEVELS] = {
+    460, 540, 615, 690, 760, 820, 1024, 1180};
+
+#define COMPLEXITY_BLOCK_PIXELS 4096
+#define COMPLEXITY_FRACTION_BITS 4
+#define SCENE_CHANGE_BRIGHTNESS 24
+
+// Moving up a level needs 1/8th of the budget spare to avoid oscillating
+#define STEP_UP_HEADROOM_SHIFT 3
+
+static uint8_t brightness_from_metering(const uint8_t metering[6])
+{
+    // Average of the matrix red, green and blue values
+    return (uint8_t)(((uint16_t)metering[3] +
+                      (uint16_t)metering[4] +
+                      (uint16_t)metering[5]) /
+                     3);
+}
+
+static uint64_t predicted_bytes(const camera_rate_control_t *rate_control,
+                                uint32_t pixels,
+                                uint8_t quality_level)
+{
+    return ((uint64_t)rate_control->complexity *
+            relative_size[quality_level] *
+            pixels) >>
+           (10 + 12 + COMPLEXITY_FRACTION_BITS);
+}
+
+void camera_rate_control_reset(camera_rate_control_t *rate_control,
+                               uint32_t target_bytes,
+                               uint8_t max_quality_level)
+{
+    if (max_quality_level >= CAMERA_RATE_CONTROL_QUALITY_LEVELS)
+    {
+        max_quality_level = CAMERA_RATE_CONTROL_QUALITY_LEVELS - 1;
+    }
+
+    rate_control->target_bytes = target_bytes;
+    rate_control->max_quality_level = max_quality_level;
+    rate_control->quality_level = max_quality_level;
+    rate_control->has_estimate = false;
+    rate_control->complexity = 0;
+    rate_control->brightness = 0;
+}
+
+uint8_t camera_rate_control_next_quality_level(camera_rate_control_t *rate_control,
+                                               uint32_t pixels)
+{
+    // Without any previous frames, start from the middle and work outwards
+    if (!rate_control->has_estimate)
+    {
+        rate_control->quality_level = rate_control->max_quality_level / 2;
+        return rate_control->quality_level;
+    }
+
+    uint8_t quality_level = 0;
+
+    for (int level = rate_control->max_quality_level; level > 0; level--)
+    {
+        uint64_t budget = rate_control->target_bytes;
+
+        if (level > rate_control->quality_level)
+        {
+            budget -= budget >> STEP_UP_HEADROOM_SHIFT;
+        }
+
+        if (predicted_bytes(rate_control, pixels, level) <= budget)
+        {
+            quality_level = level;
+            break;
+        }
+    }
+
+    rate_control->quality_level = quality_level;
+    return quality_level;
+}
+
+void camera_rate_control_update(camera_rate_control_t *rate_control,
+                                uint32_t pixels,
+                                uint8_t quality_level,
+                                uint32_t compressed_bytes,
+                                const uint8_t metering[6])
+{
+    if (pixels == 0 ||
+        quality_level >= CAMERA_RATE_CONTROL_QUALITY_LEVELS)
+    {
+        return;
+    }
+
+    uint32_t complexity = (uint32_t)((((uint64_t)compressed_bytes
+                                       << (10 + 12 + COMPLEXITY_FRACTION_BITS)) /
+                                      relative_size[quality_level]) /
+                                     pixels);
+
+    uint8_t brightness = brightness_from_metering(metering);
+
+    if (!rate_control->has_estimate ||
+        abs((int)brightness - (int)rate_control->brightness) > SCENE_CHANGE_BRIGHTNESS)
+    {
+        rate_control->complexity = complexity;
+    }
+
+    else if (complexity > rate_control->complexity)
+    {
+        rate_control->complexity = (rate_control->complexity + complexity + 1) / 2;
+    }
+
+    else
+    {
+        rate_control->complexity = (3 * rate_control->complexity + complexity) / 4;
+    }
+
+    rate_control->brightness = brightness;
+    rate_control->has_estimate = true;
+}
@@ -0,0 +1,53 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CAMERA_RATE_CONTROL_QUALITY_LEVELS 8
+
+typedef struct camera_rate_control_t
+{
+    uint32_t target_bytes;
+    uint8_t max_quality_level;
+    uint8_t quality_level;
+    bool has_estimate;
+    uint32_t complexity;
+    uint8_t brightness;
+} camera_rate_control_t;
+
+void camera_rate_control_reset(camera_rate_control_t *rate_control,
+                               uint32_t target_bytes,
+                               uint8_t max_quality_level);
+
+uint8_t camera_rate_control_next_quality_level(camera_rate_control_t *rate_control,
+                                               uint32_t pixels);
+
+void camera_rate_control_update(camera_rate_control_t *rate_control,
+                                uint32_t pixels,
+                                uint8_t quality_level,
+                                uint32_t compressed_bytes,
+                                const uint8_t metering[6]);
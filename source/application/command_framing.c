@@ -0,0 +1,242 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "command_framing.h"
+#include <string.h>
+
+static size_t queue_space(const command_framing_t *framing)
+{
+    // One byte is kept free so that a full queue isn't mistaken as empty
+    return (framing->tail + COMMAND_FRAMING_QUEUE_SIZE - framing->head - 1) %
+           COMMAND_FRAMING_QUEUE_SIZE;
+}
+
+static void queue_write(command_framing_t *framing,
+                        size_t index,
+                        const uint8_t *data,
+                        size_t length)
+{
+    size_t first_span = COMMAND_FRAMING_QUEUE_SIZE - index;
+
+    if (first_span > length)
+    {
+        first_span = length;
+    }
+
+    memcpy(framing->queue + index, data, first_span);
+    memcpy(framing->queue, data + first_span, length - first_span);
+}
+
+static void queue_read(const command_framing_t *framing,
+                       size_t index,
+                       uint8_t *data,
+                       size_t length)
+{
+    size_t first_span = COMMAND_FRAMING_QUEUE_SIZE - index;
+
+    if (first_span > length)
+    {
+        first_span = length;
+    }
+
+    memcpy(data, framing->queue + index, first_span);
+    memcpy(data + first_span, framing->queue, length - first_span);
+}
+
+void command_framing_reset(command_framing_t *framing)
+{
+    framing->head = 0;
+    framing->tail = 0;
+    framing->dropped = 0;
+    command_framing_abandon(framing);
+}
+
+void command_framing_abandon(command_framing_t *framing)
+{
+    framing->length = 0;
+    framing->received = 0;
+    framing->prefix_pending = false;
+    framing->receiving = false;
+}
+
+bool command_framing_push(command_framing_t *framing,
+                          const uint8_t *command,
+                          size_t length,
+                          uint8_t flags)
+{
+    if (length == 0)
+    {
+        return true;
+    }
+
+    uint8_t header[3] = {(uint8_t)(length & 0xFF),
+                         (uint8_t)(length >> 8),
+                         flags};
+
+    if (length > COMMAND_FRAMING_MAX_LENGTH ||
+        queue_space(framing) < length + sizeof(header))
+    {
+        framing->dropped++;
+        return false;
+    }
+
+    size_t head = framing->head;
+    queue_write(framing, head, header, sizeof(header));
+    head = (head + sizeof(header)) % COMMAND_FRAMING_QUEUE_SIZE;
+    queue_write(framing, head, command, length);
+
+    // Only visible to the reader once it's all there
+    framing->head = (head + length) % COMMAND_FRAMING_QUEUE_SIZE;
+
+    return true;
+}
+
+void command_framing_receive(command_framing_t *framing,
+                             const uint8_t *data,
+                             size_t length)
+{
+    while (length > 0)
+    {
+        if (!framing->receiving)
+        {
+            uint8_t byte = *data++;
+            length--;
+
+            if (framing->prefix_pending)
+            {
+                framing->length = (size_t)(framing->prefix & 0x7F) << 8 | byte;
+                framing->prefix_pending = false;
+            }
+
+            else if (byte & 0x80)
+            {
+                framing->prefix = byte;
+                framing->prefix_pending = true;
+                continue;
+            }
+
+            else
+            {
+                framing->length = byte;
+            }
+
+            framing->received = 0;
+            framing->receiving = framing->length > 0;
+
+            // Too long to keep, but still skipped over to find the next one
+            if (framing->length > COMMAND_FRAMING_MAX_LENGTH)
+            {
+                framing->dropped++;
+            }
+
+            continue;
+        }
+
+        size_t chunk = framing->length - framing->received;
+
+        if (chunk > length)
+        {
+            chunk = length;
+        }
+
+        if (framing->length <= COMMAND_FRAMING_MAX_LENGTH)
+        {
+            memcpy(framing->command + framing->received, data, chunk);
+        }
+
+        framing->received += chunk;
+        data += chunk;
+        length -= chunk;
+
+        if (framing->received == framing->length)
+        {
+            if (framing->length <= COMMAND_FRAMING_MAX_LENGTH)
+            {
+                command_framing_push(framing,
+                                     framing->command,
+                                     framing->length,
+                                     0);
+            }
+
+            framing->receiving = false;
+        }
+    }
+}
+
+size_t command_framing_read(command_framing_t *framing,
+                            uint8_t *command,
+                            uint8_t *flags)
+{
+    size_t tail = framing->tail;
+
+    if (tail == framing->head)
+    {
+        return 0;
+    }
+
+    uint8_t header[3];
+    queue_read(framing, tail, header, sizeof(header));
+    tail = (tail + sizeof(header)) % COMMAND_FRAMING_QUEUE_SIZE;
+
+    size_t length = (size_t)header[1] << 8 | header[0];
+
+    if (flags != NULL)
+    {
+        *flags = header[2];
+    }
+
+    queue_read(framing, tail, command, length);
+
+    framing->tail = (tail + length) % COMMAND_FRAMING_QUEUE_SIZE;
+
+    return length;
+}
+
+size_t command_framing_encode(const uint8_t *command,
+                              size_t length,
+                              uint8_t *output)
+{
+    if (length > 0x7FFF)
+    {
+        return 0;
+    }
+
+    size_t prefix_bytes = 1;
+
+    if (length < 0x80)
+    {
+        output[0] = (uint8_t)length;
+    }
+
+    else
+    {
+        output[0] = 0x80 | (uint8_t)(length >> 8);
+        output[1] = (uint8_t)(length & 0xFF);
+        prefix_bytes = 2;
+    }
+
+    memcpy(output + prefix_bytes, command, length);
+
+    return prefix_bytes + length;
+}
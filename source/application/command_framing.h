@@ -0,0 +1,85 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lengths below 128 take one byte. Longer ones set the top bit of the first
+// byte, which holds the upper seven bits, and follow with the lower eight
+#define COMMAND_FRAMING_MAX_PREFIX_BYTES 2
+
+#define COMMAND_FRAMING_MAX_LENGTH 512
+#define COMMAND_FRAMING_QUEUE_SIZE 2048
+
+typedef struct command_framing_t
+{
+    // Each complete command is queued after a two byte length and its flags
+    uint8_t queue[COMMAND_FRAMING_QUEUE_SIZE];
+    volatile size_t head;
+    volatile size_t tail;
+
+    // The command being received, which may span many writes
+    uint8_t command[COMMAND_FRAMING_MAX_LENGTH];
+    size_t length;
+    size_t received;
+    uint8_t prefix;
+    bool prefix_pending;
+    bool receiving;
+
+    uint32_t dropped;
+} command_framing_t;
+
+void command_framing_reset(command_framing_t *framing);
+
+// Forgets any partly received command, such as after a disconnect
+void command_framing_abandon(command_framing_t *framing);
+
+// Queues a single complete command, along with flags which are read back with
+// it. Returns false if there's no space
+bool command_framing_push(command_framing_t *framing,
+                          const uint8_t *command,
+                          size_t length,
+                          uint8_t flags);
+
+// Splits a stream of length prefixed commands, which may continue over any
+// number of calls, and queues each one once it's complete, with no flags
+void command_framing_receive(command_framing_t *framing,
+                             const uint8_t *data,
+                             size_t length);
+
+// Copies the next command into a buffer of COMMAND_FRAMING_MAX_LENGTH, and
+// returns its length, or 0 if there are none. Commands are never empty. Its
+// flags are also returned, unless flags is NULL
+size_t command_framing_read(command_framing_t *framing,
+                            uint8_t *command,
+                            uint8_t *flags);
+
+// Writes the length prefix and command, and returns the number of bytes, or 0
+// if the command is too long
+size_t command_framing_encode(const uint8_t *command,
+                              size_t length,
+                              uint8_t *output);
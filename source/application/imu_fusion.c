@@ -0,0 +1,164 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Fuses the accelerometer and magnetometer into a steady orientation. There is
+ * no gyroscope, so a complementary filter low passes both vectors with the
+ * same time constant, and the angles are only worked out when read.
+ *
+ * Filtering the vectors rather than the angles avoids wrapping problems around
+ * north, and keeps the two consistent so that tilt compensation holds while
+ * moving. Samples where the acceleration differs from gravity, such as while
+ * walking, are trusted less.
+ *
+ * Axes are as worn: x to the right, y forwards and z upwards. Pitch and roll
+ * are the tilt of gravity towards y and x. Heading is the angle of the forward
+ * axis, projected onto the horizontal plane, clockwise from magnetic north.
+ */
+
+#include <math.h>
+#include "imu_fusion.h"
+
+#define RADIANS_TO_DEGREES 57.2957795f
+
+// Gravity is ignored once its magnitude is this fraction away from normal
+#define ACCELERATION_REJECTION 0.3f
+
+// The normal magnitude of gravity follows much slower than the filter
+#define GRAVITY_MAGNITUDE_SLOWDOWN 20.0f
+
+// Change in field direction, in radians, above which the filter speeds up
+#define TURNING_THRESHOLD 0.04f
+
+static float magnitude(const float vector[3])
+{
+    return sqrtf(vector[0] * vector[0] +
+                 vector[1] * vector[1] +
+                 vector[2] * vector[2]);
+}
+
+static void cross(const float a[3], const float b[3], float result[3])
+{
+    result[0] = a[1] * b[2] - a[2] * b[1];
+    result[1] = a[2] * b[0] - a[0] * b[2];
+    result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+void imu_fusion_reset(imu_fusion_t *fusion, float time_constant)
+{
+    fusion->time_constant = time_constant;
+    fusion->initialised = false;
+    fusion->heading = 0.0f;
+}
+
+void imu_fusion_update(imu_fusion_t *fusion,
+                       const float accelerometer[3],
+                       const float magnetometer[3],
+                       float interval)
+{
+    float acceleration = magnitude(accelerometer);
+
+    if (!fusion->initialised)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            fusion->gravity[i] = accelerometer[i];
+            fusion->field[i] = magnetometer[i];
+        }
+
+        fusion->gravity_magnitude = acceleration;
+        fusion->initialised = true;
+        return;
+    }
+
+    // Follow turns faster than the noise would otherwise allow. Only the field
+    // is used to detect them, as it isn't disturbed by acceleration
+    float field_magnitude = magnitude(fusion->field);
+    float measured_magnitude = magnitude(magnetometer);
+    float turning = 0.0f;
+
+    if (field_magnitude > 0.0f && measured_magnitude > 0.0f)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            float difference = magnetometer[i] / measured_magnitude -
+                               fusion->field[i] / field_magnitude;
+            turning += difference * difference;
+        }
+
+        turning /= TURNING_THRESHOLD * TURNING_THRESHOLD;
+    }
+
+    float time_constant = fusion->time_constant / (1.0f + turning);
+    float weight = interval / (time_constant + interval);
+
+    // Trust gravity less the more the device is accelerating
+    float deviation = fabsf(acceleration / fusion->gravity_magnitude - 1.0f);
+    float gravity_weight = deviation < ACCELERATION_REJECTION
+                               ? weight * (1.0f - deviation / ACCELERATION_REJECTION)
+                               : 0.0f;
+
+    for (int i = 0; i < 3; i++)
+    {
+        fusion->gravity[i] += gravity_weight *
+                              (accelerometer[i] - fusion->gravity[i]);
+
+        fusion->field[i] += weight * (magnetometer[i] - fusion->field[i]);
+    }
+
+    fusion->gravity_magnitude += weight / GRAVITY_MAGNITUDE_SLOWDOWN *
+                                 (acceleration - fusion->gravity_magnitude);
+}
+
+imu_fusion_orientation_t imu_fusion_orientation(imu_fusion_t *fusion)
+{
+    const float *gravity = fusion->gravity;
+
+    imu_fusion_orientation_t orientation = {
+        .pitch = atan2f(gravity[1], gravity[2]) * RADIANS_TO_DEGREES,
+        .roll = atan2f(gravity[0], gravity[2]) * RADIANS_TO_DEGREES,
+        .heading = fusion->heading,
+    };
+
+    // East is perpendicular to both down and the field, and north to both
+    float down[3] = {-gravity[0], -gravity[1], -gravity[2]};
+    float east[3];
+    float north[3];
+
+    cross(down, fusion->field, east);
+    cross(east, down, north);
+
+    // The forward axis is y, so only the y components are needed
+    if (magnitude(east) > 0.0f)
+    {
+        float heading = atan2f(east[1] * magnitude(down),
+                               north[1]) *
+                        RADIANS_TO_DEGREES;
+
+        fusion->heading = heading < 0.0f ? heading + 360.0f : heading;
+        orientation.heading = fusion->heading;
+    }
+
+    return orientation;
+}
@@ -0,0 +1,57 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+typedef struct imu_fusion_t
+{
+    float time_constant;
+    bool initialised;
+
+    // Filtered gravity and magnetic field, in the worn orientation axes
+    float gravity[3];
+    float field[3];
+    float gravity_magnitude;
+
+    // Held when the field is parallel to gravity, and so has no direction
+    float heading;
+} imu_fusion_t;
+
+typedef struct imu_fusion_orientation_t
+{
+    float pitch;
+    float roll;
+    float heading;
+} imu_fusion_orientation_t;
+
+void imu_fusion_reset(imu_fusion_t *fusion, float time_constant);
+
+void imu_fusion_update(imu_fusion_t *fusion,
+                       const float accelerometer[3],
+                       const float magnetometer[3],
+                       float interval);
+
+imu_fusion_orientation_t imu_fusion_orientation(imu_fusion_t *fusion);
@@ -106,6 +106,8 @@ static void lua_bluetooth_receive_callback_handler(lua_State *L, lua_Debug *ar)
     {
         luaL_error(L, "%s", lua_tostring(L, -1));
     }
+
+    lua_system_resume_pending();
 }
 
 void lua_bluetooth_data_interrupt(uint8_t *data, size_t length)
@@ -25,22 +25,24 @@
 #include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include "bluetooth.h"
+#include "camera_exposure.h"
+#include "camera_jpeg_header.h"
+#include "camera_rate_control.h"
 #include "error_logging.h"
+#include "frame_lua_libraries.h"
 #include "i2c.h"
 #include "lauxlib.h"
 #include "lua.h"
+#include "nrf_soc.h"
 #include "nrfx_systick.h"
 #include "spi.h"
 #include "nrfx_log.h"
+#include "watchdog.h"
 
-static bool camera_is_asleep = false;
+#define CAMERA_SENSOR_WINDOW 720
 
-typedef enum camera_metering_mode
-{
-    SPOT,
-    CENTER_WEIGHTED,
-    AVERAGE
-} camera_metering_mode_t;
+static bool camera_is_asleep = false;
 
 static struct camera_auto_last_values
 {
@@ -59,8 +61,10 @@ static struct camera_auto_last_values
 
 static struct camera_capture_settings
 {
-    uint16_t resolution;
+    uint16_t width;
+    uint16_t height;
     uint8_t quality_factor;
+    bool grayscale;
 } capture_settings;
 
 static size_t header_bytes_sent_out;
@@ -68,141 +72,197 @@ static size_t data_bytes_remaining;
 static size_t data_bytes_sent_out;
 static size_t footer_bytes_sent_out;
 
-static int lua_camera_capture(lua_State *L)
+static struct camera_continuous_capture
 {
-    if (camera_is_asleep)
+    bool enabled;
+    bool frame_loaded;
+    uint16_t frame_number;
+    bool frame_dropped;
+} continuous_capture = {0};
+
+static struct camera_rate_control_state
+{
+    bool enabled;
+    bool frame_pending;
+    uint8_t quality_level;
+    camera_rate_control_t controller;
+} rate_control = {0};
+
+static void release_continuous_capture_frame(void)
+{
+    if (continuous_capture.enabled && continuous_capture.frame_loaded)
     {
-        luaL_error(L, "camera is asleep");
+        spi_write(FPGA, 0x36, NULL, 0);
+        continuous_capture.frame_loaded = false;
     }
+}
 
-    uint16_t resolution = 512;
+static void generate_jpeg_header(uint8_t *header)
+{
+    camera_jpeg_header(header,
+                       capture_settings.width,
+                       capture_settings.height,
+                       capture_settings.quality_factor,
+                       capture_settings.grayscale);
+}
 
-    if (lua_getfield(L, 1, "resolution") != LUA_TNIL)
-    {
-        resolution = luaL_checkinteger(L, -1);
+static size_t jpeg_header_length(void)
+{
+    return camera_jpeg_header_length(capture_settings.grayscale);
+}
 
-        if (resolution < 100 || resolution > 720 || resolution % 2 != 0)
+static uint8_t quality_level_from_string(lua_State *L,
+                                         const char *string,
+                                         uint16_t resolution)
+{
+    if (strcmp(string, "VERY_HIGH") == 0)
+    {
+        if (resolution <= 256)
         {
-            luaL_error(L, "resolution value must be a multiple of 2 between 100 and 720");
+            return 7;
+        }
+        else if (resolution <= 512)
+        {
+            return 6;
+        }
+        else
+        {
+            return 5;
         }
     }
-
-    int16_t pan = 0;
-
-    if (lua_getfield(L, 1, "pan") != LUA_TNIL)
+    else if (strcmp(string, "HIGH") == 0)
     {
-        pan = luaL_checkinteger(L, -1) * 2;
-
-        if (pan < -280 || pan > 280)
+        if (resolution <= 256)
         {
-            luaL_error(L, "pan value must be value between -140 and 140");
+            return 6;
+        }
+        else if (resolution <= 512)
+        {
+            return 5;
+        }
+        else
+        {
+            return 4;
         }
     }
-
-    uint8_t quality_level = 6;
-
-    if (lua_getfield(L, 1, "quality") != LUA_TNIL)
+    else if (strcmp(string, "MEDIUM") == 0)
     {
-        const char *string = luaL_checkstring(L, -1);
-
-        if (strcmp(string, "VERY_HIGH") == 0)
+        if (resolution <= 256)
         {
-            if (resolution <= 256)
-            {
-                quality_level = 7;
-            }
-            else if (resolution <= 512)
-            {
-                quality_level = 6;
-            }
-            else
-            {
-                quality_level = 5;
-            }
+            return 5;
         }
-        else if (strcmp(string, "HIGH") == 0)
+        else if (resolution <= 512)
         {
-            if (resolution <= 256)
-            {
-                quality_level = 6;
-            }
-            else if (resolution <= 512)
-            {
-                quality_level = 5;
-            }
-            else
-            {
-                quality_level = 4;
-            }
+            return 4;
         }
-        else if (strcmp(string, "MEDIUM") == 0)
+        else
         {
-            if (resolution <= 256)
-            {
-                quality_level = 5;
-            }
-            else if (resolution <= 512)
-            {
-                quality_level = 4;
-            }
-            else
-            {
-                quality_level = 3;
-            }
+            return 3;
         }
-        else if (strcmp(string, "LOW") == 0)
+    }
+    else if (strcmp(string, "LOW") == 0)
+    {
+        if (resolution <= 256)
         {
-            if (resolution <= 256)
-            {
-                quality_level = 4;
-            }
-            else if (resolution <= 512)
-            {
-                quality_level = 3;
-            }
-            else
-            {
-                quality_level = 2;
-            }
+            return 4;
         }
-        else if (strcmp(string, "VERY_LOW") == 0)
+        else if (resolution <= 512)
         {
-            if (resolution <= 256)
-            {
-                quality_level = 3;
-            }
-            else if (resolution <= 512)
-            {
-                quality_level = 2;
-            }
-            else
-            {
-                quality_level = 1;
-            }
+            return 3;
         }
         else
         {
-            luaL_error(L, "quality must be either VERY_HIGH, HIGH, MEDIUM, LOW or VERY_LOW");
+            return 2;
         }
     }
+    else if (strcmp(string, "VERY_LOW") == 0)
+    {
+        if (resolution <= 256)
+        {
+            return 3;
+        }
+        else if (resolution <= 512)
+        {
+            return 2;
+        }
+        else
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        luaL_error(L, "quality must be either VERY_HIGH, HIGH, MEDIUM, LOW or VERY_LOW");
+    }
 
-    header_bytes_sent_out = 0;
-    data_bytes_remaining = 0;
-    data_bytes_sent_out = 0;
-    footer_bytes_sent_out = 0;
+    return 6;
+}
+
+static void apply_binning(uint8_t binning)
+{
+    uint8_t binning_register = binning == 4 ? 2 : binning == 2 ? 1 : 0;
+    spi_write(FPGA, 0x38, &binning_register, sizeof(binning_register));
+}
+
+static void apply_resolution(uint16_t resolution, uint8_t binning)
+{
+    capture_settings.width = resolution;
+    capture_settings.height = resolution;
+
+    apply_binning(binning);
 
-    // Apply resolution
-    capture_settings.resolution = resolution;
     uint8_t resolution_bytes[2] = {(uint8_t)(resolution >> 8), (uint8_t)(resolution & 0xFF)};
     spi_write(FPGA, 0x23, resolution_bytes, sizeof(resolution_bytes));
+}
 
-    // Apply pan
-    // Normalize pan to center of sensor with correct offset for 720 native resolution
-    pan += (1280 / 2) - (720 / 2);
-    check_error(i2c_write(CAMERA, 0x3810, 0xFF, pan >> 8).fail);
-    check_error(i2c_write(CAMERA, 0x3811, 0xFF, pan).fail);
+static void apply_region_of_interest(uint16_t x,
+                                     uint16_t y,
+                                     uint16_t width,
+                                     uint16_t height,
+                                     uint8_t binning)
+{
+    capture_settings.width = width / binning;
+    capture_settings.height = height / binning;
+
+    // The crop includes a border for the debayer, and is in sensor pixels
+    uint16_t crop_width = (capture_settings.width + 2) * binning;
+    uint16_t crop_height = (capture_settings.height + 2) * binning;
+
+    uint16_t x_start = x + 1 < binning ? 0 : x + 1 - binning;
+    uint16_t y_start = y + 1 < binning ? 0 : y + 1 - binning;
 
-    // Apply quality
+    if (x_start + crop_width > CAMERA_SENSOR_WINDOW + 2)
+    {
+        x_start = CAMERA_SENSOR_WINDOW + 2 - crop_width;
+    }
+
+    if (y_start + crop_height > CAMERA_SENSOR_WINDOW + 2)
+    {
+        y_start = CAMERA_SENSOR_WINDOW + 2 - crop_height;
+    }
+
+    apply_binning(binning);
+
+    uint8_t roi_bytes[8] = {(uint8_t)(x_start >> 8),
+                            (uint8_t)(x_start & 0xFF),
+                            (uint8_t)(y_start >> 8),
+                            (uint8_t)(y_start & 0xFF),
+                            (uint8_t)(capture_settings.width >> 8),
+                            (uint8_t)(capture_settings.width & 0xFF),
+                            (uint8_t)(capture_settings.height >> 8),
+                            (uint8_t)(capture_settings.height & 0xFF)};
+    spi_write(FPGA, 0x37, roi_bytes, sizeof(roi_bytes));
+}
+
+static void apply_grayscale(bool grayscale)
+{
+    capture_settings.grayscale = grayscale;
+    uint8_t grayscale_register = grayscale ? 1 : 0;
+    spi_write(FPGA, 0x39, &grayscale_register, sizeof(grayscale_register));
+}
+
+static void apply_quality_level(uint8_t quality_level)
+{
     // These should match the indexed tables in quant_tables.sv
     switch (quality_level)
     {
@@ -233,9 +293,277 @@ static int lua_camera_capture(lua_State *L)
     }
 
     spi_write(FPGA, 0x26, &quality_level, sizeof(quality_level));
+}
+
+static uint32_t target_size_from_lua(lua_State *L, int index)
+{
+    lua_Integer target_size = luaL_checkinteger(L, index);
+
+    if (target_size < 1024 || target_size > 65535)
+    {
+        luaL_error(L, "target_size must be between 1024 and 65535 bytes");
+    }
+
+    return (uint32_t)target_size;
+}
+
+static void configure_rate_control(uint32_t target_size,
+                                   uint8_t max_quality_level)
+{
+    // Previous estimates stay valid as long as the budget is unchanged
+    if (!rate_control.enabled ||
+        rate_control.controller.target_bytes != target_size ||
+        rate_control.controller.max_quality_level != max_quality_level)
+    {
+        camera_rate_control_reset(&rate_control.controller,
+                                  target_size,
+                                  max_quality_level);
+    }
+
+    rate_control.enabled = true;
+    rate_control.frame_pending = false;
+}
+
+static void rate_control_record_frame(size_t compressed_bytes)
+{
+    uint8_t metering_data[6];
+    spi_read(FPGA, 0x25, metering_data, sizeof(metering_data));
+
+    camera_rate_control_update(&rate_control.controller,
+                               (uint32_t)capture_settings.width * capture_settings.height,
+                               rate_control.quality_level,
+                               compressed_bytes,
+                               metering_data);
+}
+
+static int lua_camera_capture(lua_State *L)
+{
+    if (camera_is_asleep)
+    {
+        luaL_error(L, "camera is asleep");
+    }
+
+    uint8_t binning = 1;
+
+    if (lua_getfield(L, 1, "binning") != LUA_TNIL)
+    {
+        lua_Integer value = luaL_checkinteger(L, -1);
+
+        if (value != 1 && value != 2 && value != 4)
+        {
+            luaL_error(L, "binning must be 1, 2 or 4");
+        }
+
+        binning = (uint8_t)value;
+    }
+
+    uint16_t resolution = 512;
+    bool resolution_set = false;
+
+    if (lua_getfield(L, 1, "resolution") != LUA_TNIL)
+    {
+        resolution = luaL_checkinteger(L, -1);
+        resolution_set = true;
+
+        if (resolution < 100 || resolution > 720 || resolution % 2 != 0)
+        {
+            luaL_error(L, "resolution value must be a multiple of 2 between 100 and 720");
+        }
+
+        if (binning > 1 && resolution * binning >= CAMERA_SENSOR_WINDOW)
+        {
+            luaL_error(L, "resolution multiplied by binning must be less than 720");
+        }
+    }
+
+    // Binning alone keeps the default field of view at a lower resolution
+    else
+    {
+        resolution /= binning;
+    }
+
+    // A region of interest is given as { x, y, width, height } in sensor pixels
+    bool roi = false;
+    uint16_t roi_values[4];
+
+    if (lua_getfield(L, 1, "roi") != LUA_TNIL)
+    {
+        luaL_checktype(L, -1, LUA_TTABLE);
+
+        if (resolution_set)
+        {
+            luaL_error(L, "resolution can't be used with roi");
+        }
+
+        if (luaL_len(L, -1) != 4)
+        {
+            luaL_error(L, "roi must be a table of { x, y, width, height }");
+        }
+
+        for (int i = 0; i < 4; i++)
+        {
+            lua_rawgeti(L, -1, i + 1);
+            lua_Integer value = luaL_checkinteger(L, -1);
+            lua_pop(L, 1);
+
+            if (value < 0 || value > CAMERA_SENSOR_WINDOW)
+            {
+                luaL_error(L, "roi values must be between 0 and 720");
+            }
+
+            roi_values[i] = (uint16_t)value;
+        }
+
+        if (roi_values[0] + roi_values[2] > CAMERA_SENSOR_WINDOW ||
+            roi_values[1] + roi_values[3] > CAMERA_SENSOR_WINDOW)
+        {
+            luaL_error(L, "roi must be within the 720x720 sensor area");
+        }
+
+        if (roi_values[2] % (2 * binning) != 0 ||
+            roi_values[3] % (2 * binning) != 0)
+        {
+            luaL_error(L, "roi width and height must be multiples of 2 times binning");
+        }
+
+        // The debayer needs a border of one binned pixel around the image
+        if (roi_values[2] + 2 * binning > CAMERA_SENSOR_WINDOW + 2 ||
+            roi_values[3] + 2 * binning > CAMERA_SENSOR_WINDOW + 2)
+        {
+            luaL_error(L, "roi width and height must be at most 722 - 2 * binning");
+        }
+
+        if (roi_values[2] / binning < 16 || roi_values[3] / binning < 16)
+        {
+            luaL_error(L, "roi must be at least 16x16 pixels after binning");
+        }
+
+        roi = true;
+
+        // Quality levels are picked on the longest side of the image
+        resolution = roi_values[2] > roi_values[3] ? roi_values[2] : roi_values[3];
+        resolution /= binning;
+    }
+
+    int16_t pan = 0;
+
+    if (lua_getfield(L, 1, "pan") != LUA_TNIL)
+    {
+        pan = luaL_checkinteger(L, -1) * 2;
+
+        if (pan < -280 || pan > 280)
+        {
+            luaL_error(L, "pan value must be value between -140 and 140");
+        }
+    }
+
+    uint8_t quality_level = 6;
+    bool quality_set = false;
+
+    if (lua_getfield(L, 1, "quality") != LUA_TNIL)
+    {
+        quality_level = quality_level_from_string(L,
+                                                  luaL_checkstring(L, -1),
+                                                  resolution);
+        quality_set = true;
+    }
+
+    uint32_t target_size = 0;
+
+    if (lua_getfield(L, 1, "target_size") != LUA_TNIL)
+    {
+        target_size = target_size_from_lua(L, -1);
+    }
+
+    bool continuous = false;
+
+    if (lua_getfield(L, 1, "continuous") != LUA_TNIL)
+    {
+        luaL_checktype(L, -1, LUA_TBOOLEAN);
+        continuous = lua_toboolean(L, -1);
+    }
+
+    bool grayscale = false;
+
+    if (lua_getfield(L, 1, "grayscale") != LUA_TNIL)
+    {
+        luaL_checktype(L, -1, LUA_TBOOLEAN);
+        grayscale = lua_toboolean(L, -1);
+    }
+
+    if (continuous && target_size != 0)
+    {
+        luaL_error(L, "target_size can't be used with continuous capture");
+    }
+
+    // With a target size, quality is the highest level the controller may use
+    if (target_size != 0)
+    {
+        configure_rate_control(target_size,
+                               quality_set ? quality_level : 7);
+
+        quality_level = camera_rate_control_next_quality_level(
+            &rate_control.controller,
+            roi ? (uint32_t)(roi_values[2] / binning) * (roi_values[3] / binning)
+                : (uint32_t)resolution * resolution);
+
+        rate_control.quality_level = quality_level;
+    }
+
+    else
+    {
+        rate_control.enabled = false;
+    }
+
+    // Settings can't change while an image is being compressed
+    if (continuous_capture.enabled)
+    {
+        spi_write(FPGA, 0x33, (uint8_t *)"\x00", 1);
+        continuous_capture.enabled = false;
+        continuous_capture.frame_loaded = false;
+    }
+
+    header_bytes_sent_out = 0;
+    data_bytes_remaining = 0;
+    data_bytes_sent_out = 0;
+    footer_bytes_sent_out = 0;
+
+    // Apply resolution or region of interest
+    if (roi)
+    {
+        apply_region_of_interest(roi_values[0],
+                                 roi_values[1],
+                                 roi_values[2],
+                                 roi_values[3],
+                                 binning);
+    }
+
+    else
+    {
+        apply_resolution(resolution, binning);
+    }
+
+    // Apply pan
+    // Normalize pan to center of sensor with correct offset for 720 native resolution
+    pan += (1280 / 2) - (720 / 2);
+    check_error(i2c_write(CAMERA, 0x3810, 0xFF, pan >> 8).fail);
+    check_error(i2c_write(CAMERA, 0x3811, 0xFF, pan).fail);
+
+    // Apply quality and color
+    apply_quality_level(quality_level);
+    apply_grayscale(grayscale);
+
+    // Continuously capture into alternating halves of the image buffer
+    if (continuous)
+    {
+        spi_write(FPGA, 0x33, (uint8_t *)"\x01", 1);
+        continuous_capture.enabled = true;
+        return 0;
+    }
 
     // Start capture
     spi_write(FPGA, 0x20, NULL, 0);
+    rate_control.frame_pending = rate_control.enabled;
 
     return 0;
 }
@@ -249,6 +577,39 @@ static int lua_camera_image_ready(lua_State *L)
 
     uint8_t data[2];
 
+    if (continuous_capture.enabled)
+    {
+        if (!continuous_capture.frame_loaded)
+        {
+            spi_read(FPGA, 0x30, (uint8_t *)data, sizeof(data));
+
+            if (data[0] == 0)
+            {
+                lua_pushboolean(L, false);
+                return 1;
+            }
+
+            spi_read(FPGA, 0x31, (uint8_t *)data, sizeof(data));
+            data_bytes_remaining = (size_t)data[1] << 8 | (size_t)data[0];
+
+            spi_read(FPGA, 0x34, (uint8_t *)data, sizeof(data));
+            continuous_capture.frame_number = (uint16_t)data[1] << 8 | data[0];
+
+            spi_read(FPGA, 0x35, (uint8_t *)data, 1);
+            continuous_capture.frame_dropped = data[0] != 0;
+
+            header_bytes_sent_out = 0;
+            data_bytes_sent_out = 0;
+            footer_bytes_sent_out = 0;
+            continuous_capture.frame_loaded = true;
+        }
+
+        lua_pushboolean(L, true);
+        lua_pushinteger(L, continuous_capture.frame_number);
+        lua_pushboolean(L, continuous_capture.frame_dropped);
+        return 3;
+    }
+
     spi_read(FPGA, 0x30, (uint8_t *)data, sizeof(data));
 
     if (data[0] != 0)
@@ -257,6 +618,12 @@ static int lua_camera_image_ready(lua_State *L)
 
         data_bytes_remaining = (size_t)data[1] << 8 | (size_t)data[0];
 
+        if (rate_control.frame_pending)
+        {
+            rate_control_record_frame(data_bytes_remaining);
+            rate_control.frame_pending = false;
+        }
+
         lua_pushboolean(L, true);
         return 1;
     }
@@ -283,143 +650,17 @@ static int lua_camera_read(lua_State *L)
         luaL_error(L, "bytes requested is too large");
     }
 
-    uint8_t header[] = {
-        0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46,
-        0x49, 0x46, 0x00, 0x01, 0x02, 0x00, 0x00, 0x64,
-        0x00, 0x64, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43,
-        0x00, 0x10, 0x0b, 0x0c, 0x0e, 0x0c, 0x0a, 0x10,
-        0x0e, 0x0d, 0x0e, 0x12, 0x11, 0x10, 0x13, 0x18,
-        0x28, 0x1a, 0x18, 0x16, 0x16, 0x18, 0x31, 0x23,
-        0x25, 0x1d, 0x28, 0x3a, 0x33, 0x3d, 0x3c, 0x39,
-        0x33, 0x38, 0x37, 0x40, 0x48, 0x5c, 0x4e, 0x40,
-        0x44, 0x57, 0x45, 0x37, 0x38, 0x50, 0x6d, 0x51,
-        0x57, 0x5f, 0x62, 0x67, 0x68, 0x67, 0x3e, 0x4d,
-        0x71, 0x79, 0x70, 0x64, 0x78, 0x5c, 0x65, 0x67,
-        0x63, 0xff, 0xdb, 0x00, 0x43, 0x01, 0x11, 0x12,
-        0x12, 0x18, 0x15, 0x18, 0x2f, 0x1a, 0x1a, 0x2f,
-        0x63, 0x42, 0x38, 0x42, 0x63, 0x63, 0x63, 0x63,
-        0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
-        0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
-        0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
-        0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
-        0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
-        0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0xff, 0xc0,
-        0x00, 0x11, 0x08, 0x00, 0x00, 0x00, 0x00, 0x03,
-        0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11,
-        0x01, 0xff, 0xc4, 0x00, 0x1f, 0x00, 0x00, 0x01,
-        0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
-        0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09,
-        0x0a, 0x0b, 0xff, 0xc4, 0x00, 0x1f, 0x01, 0x00,
-        0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
-        0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-        0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
-        0x09, 0x0a, 0x0b, 0xff, 0xc4, 0x00, 0xb5, 0x10,
-        0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03,
-        0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7d,
-        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
-        0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
-        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
-        0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
-        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16,
-        0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
-        0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
-        0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
-        0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
-        0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
-        0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
-        0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
-        0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98,
-        0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
-        0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
-        0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
-        0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4,
-        0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
-        0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
-        0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
-        0xf9, 0xfa, 0xff, 0xc4, 0x00, 0xb5, 0x11, 0x00,
-        0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07,
-        0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77, 0x00,
-        0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31,
-        0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13,
-        0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1,
-        0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15,
-        0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1,
-        0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27,
-        0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39,
-        0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
-        0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
-        0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
-        0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
-        0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88,
-        0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
-        0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6,
-        0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5,
-        0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4,
-        0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3,
-        0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe2,
-        0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
-        0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9,
-        0xfa, 0xff, 0xda, 0x00, 0x0c, 0x03, 0x01, 0x00,
-        0x02, 0x11, 0x03, 0x11, 0x00, 0x3f, 0x00};
+    uint8_t header[CAMERA_JPEG_HEADER_MAX_LENGTH];
+    size_t header_length = jpeg_header_length();
 
     // Append JPEG header data
-    if (header_bytes_sent_out < sizeof(header))
+    if (header_bytes_sent_out < header_length)
     {
-        // Generate header data
-        float scale;
-
-        if (capture_settings.quality_factor < 50)
-        {
-            scale = 5000 / capture_settings.quality_factor;
-        }
-        else
-        {
-            scale = 200 - 2 * capture_settings.quality_factor;
-        }
-
-        for (int i = 25; i <= 88; i++)
-        {
-            float t = (scale * header[i] + 50) / 100;
-
-            if (t < 1)
-            {
-                t = 1;
-            }
-
-            else if (t > 255)
-            {
-                t = 255;
-            }
-
-            header[i] = (uint8_t)t;
-        }
-
-        for (int i = 94; i <= 157; i++)
-        {
-            float t = (scale * header[i] + 50) / 100;
-
-            if (t < 1)
-            {
-                t = 1;
-            }
-
-            else if (t > 255)
-            {
-                t = 255;
-            }
-
-            header[i] = (uint8_t)t;
-        }
-
-        header[163] = (capture_settings.resolution >> 8) & 0xff;
-        header[164] = capture_settings.resolution & 0xff;
-        header[165] = (capture_settings.resolution >> 8) & 0xff;
-        header[166] = capture_settings.resolution & 0xff;
+        generate_jpeg_header(header);
 
         size_t length =
-            sizeof(header) - header_bytes_sent_out < bytes_requested
-                ? sizeof(header) - header_bytes_sent_out
+            header_length - header_bytes_sent_out < bytes_requested
+                ? header_length - header_bytes_sent_out
                 : bytes_requested;
 
         memcpy(payload, header + header_bytes_sent_out, length);
@@ -465,6 +706,12 @@ static int lua_camera_read(lua_State *L)
                 footer_bytes_sent_out++;
                 remaining--;
             }
+
+            // The next image can be compressed into this half of the buffer
+            if (footer_bytes_sent_out == 2)
+            {
+                release_continuous_capture_frame();
+            }
         }
     }
 
@@ -535,140 +782,593 @@ static int lua_camera_read_raw(lua_State *L)
             footer_bytes_sent_out++;
             remaining--;
         }
+
+        // The next image can be compressed into this half of the buffer
+        if (footer_bytes_sent_out == 2)
+        {
+            release_continuous_capture_frame();
+        }
+    }
+
+    // Return nil if nothing was written to payload
+    if (remaining == bytes_requested)
+    {
+        lua_pushnil(L);
+    }
+
+    // Otherwise return payload
+    else
+    {
+        lua_pushlstring(L, (char *)payload, bytes_requested - remaining);
+    }
+
+    free(payload);
+    return 1;
+}
+
+#define VIDEO_FRAME_START 0x10
+#define VIDEO_FRAME_DATA 0x11
+
+static struct camera_video_packet
+{
+    uint8_t data[BLE_PREFERRED_MAX_MTU];
+    size_t length;
+} video_packet;
+
+static void auto_loop_handler(lua_State *L, lua_Debug *ar);
+
+static bool video_interrupted(lua_State *L)
+{
+    // Keep the auto exposure loop running while streaming
+    if (lua_gethook(L) == auto_loop_handler)
+    {
+        auto_loop_handler(L, NULL);
+    }
+
+    // A break signal or Lua callback is waiting to run
+    if (lua_gethook(L) != reload_watchdog)
+    {
+        return true;
+    }
+
+    reload_watchdog(L, NULL);
+
+    return !bluetooth_is_connected();
+}
+
+static void video_wait_for_event(void)
+{
+    // Clear exceptions and sleep
+    __set_FPSCR(__get_FPSCR() & ~(0x0000009F));
+    (void)__get_FPSCR();
+
+    NVIC_ClearPendingIRQ(FPU_IRQn);
+
+    check_error(sd_app_evt_wait());
+}
+
+static bool video_send_packet(lua_State *L)
+{
+    while (bluetooth_send_data(video_packet.data, video_packet.length))
+    {
+        if (video_interrupted(L))
+        {
+            return false;
+        }
+
+        video_wait_for_event();
+    }
+
+    video_packet.data[1] = VIDEO_FRAME_DATA;
+    video_packet.length = 2;
+
+    return true;
+}
+
+static bool video_send_bytes(lua_State *L,
+                             const uint8_t *data,
+                             size_t length,
+                             bool from_fpga)
+{
+    while (length > 0)
+    {
+        size_t space = ble_negotiated_mtu - video_packet.length;
+        size_t chunk = length < space ? length : space;
+
+        if (from_fpga)
+        {
+            spi_read(FPGA, 0x22, video_packet.data + video_packet.length, chunk);
+        }
+        else
+        {
+            memcpy(video_packet.data + video_packet.length, data, chunk);
+            data += chunk;
+        }
+
+        video_packet.length += chunk;
+        length -= chunk;
+
+        if (video_packet.length == ble_negotiated_mtu)
+        {
+            if (!video_send_packet(L))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static int lua_camera_video(lua_State *L)
+{
+    if (camera_is_asleep)
+    {
+        luaL_error(L, "camera is asleep");
+    }
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+
+    lua_Number fps = 5;
+
+    if (lua_getfield(L, 1, "fps") != LUA_TNIL)
+    {
+        fps = luaL_checknumber(L, -1);
+
+        if (fps < 0.1 || fps > 30)
+        {
+            luaL_error(L, "fps must be between 0.1 and 30");
+        }
+    }
+    lua_pop(L, 1);
+
+    uint16_t resolution = 256;
+
+    if (lua_getfield(L, 1, "resolution") != LUA_TNIL)
+    {
+        resolution = luaL_checkinteger(L, -1);
+
+        if (resolution < 100 || resolution > 720 || resolution % 2 != 0)
+        {
+            luaL_error(L, "resolution value must be a multiple of 2 between 100 and 720");
+        }
+    }
+    lua_pop(L, 1);
+
+    uint8_t max_quality_level = quality_level_from_string(L, "MEDIUM", resolution);
+
+    if (lua_getfield(L, 1, "quality") != LUA_TNIL)
+    {
+        max_quality_level = quality_level_from_string(L,
+                                                      luaL_checkstring(L, -1),
+                                                      resolution);
+    }
+    lua_pop(L, 1);
+
+    bool adaptive = true;
+
+    if (lua_getfield(L, 1, "adaptive") != LUA_TNIL)
+    {
+        luaL_checktype(L, -1, LUA_TBOOLEAN);
+        adaptive = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1);
+
+    uint32_t target_size = 0;
+
+    if (lua_getfield(L, 1, "target_size") != LUA_TNIL)
+    {
+        target_size = target_size_from_lua(L, -1);
+    }
+    lua_pop(L, 1);
+
+    bool grayscale = false;
+
+    if (lua_getfield(L, 1, "grayscale") != LUA_TNIL)
+    {
+        luaL_checktype(L, -1, LUA_TBOOLEAN);
+        grayscale = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1);
+
+    lua_Integer total_frames = 0;
+
+    if (lua_getfield(L, 1, "frames") != LUA_TNIL)
+    {
+        total_frames = luaL_checkinteger(L, -1);
+
+        if (total_frames < 0)
+        {
+            luaL_error(L, "frames must be 0 or greater");
+        }
     }
+    lua_pop(L, 1);
 
-    // Return nil if nothing was written to payload
-    if (remaining == bytes_requested)
+    if (continuous_capture.enabled)
     {
-        lua_pushnil(L);
+        spi_write(FPGA, 0x33, (uint8_t *)"\x00", 1);
+        continuous_capture.enabled = false;
+        continuous_capture.frame_loaded = false;
     }
 
-    // Otherwise return payload
-    else
+    apply_resolution(resolution, 1);
+    apply_grayscale(grayscale);
+
+    // A size budget replaces stepping the quality on the frame timing
+    if (target_size != 0)
     {
-        lua_pushlstring(L, (char *)payload, bytes_requested - remaining);
+        configure_rate_control(target_size, max_quality_level);
+        adaptive = false;
     }
 
-    free(payload);
-    return 1;
-}
-
-static int lua_camera_auto(lua_State *L)
-{
-    if (camera_is_asleep)
+    else
     {
-        return 0;
+        rate_control.enabled = false;
     }
 
-    // Default auto exposure settings
-    camera_metering_mode_t metering = CENTER_WEIGHTED;
-    double target_exposure = 0.1;
-    double exposure_speed = 0.45;
-    double shutter_limit = 16383.0;
-    double analog_gain_limit = 16.0;
-    double rgb_gain_limit = 287.0;
+    uint8_t quality_level = max_quality_level;
+    uint32_t frame_period_ms = (uint32_t)(1000 / fps);
+    uint64_t next_frame_time = time_utc_ms();
+    uint16_t sequence_number = 0;
+    uint8_t frames_on_time = 0;
+    lua_Integer frames_sent = 0;
 
-    // Default white balance settings
-    double white_balance_speed = 0.5;
-    double brightness_constant = 4166400.0;
-    double white_balance_min_activation = 50;
-    double white_balance_max_activation = 200;
+    video_packet.data[0] = 0x01;
 
-    // Allow user to over-ride these if desired
-    if (lua_istable(L, 1))
+    // Stream until the requested number of frames, a break or disconnect
+    while (total_frames == 0 || frames_sent < total_frames)
     {
-        if (lua_getfield(L, 1, "metering") != LUA_TNIL)
+        // Wake up in time for the next frame
+        uint64_t now = time_utc_ms();
+
+        if (now < next_frame_time)
         {
-            if (strcmp(luaL_checkstring(L, -1), "SPOT") == 0)
-            {
-                metering = SPOT;
-            }
+            time_set_alarm(TIME_ALARM_CAMERA_VIDEO,
+                           time_monotonic_us() + (next_frame_time - now) * 1000,
+                           NULL);
+        }
 
-            else if (strcmp(luaL_checkstring(L, -1), "CENTER_WEIGHTED") == 0)
+        while (time_utc_ms() < next_frame_time)
+        {
+            if (video_interrupted(L))
             {
-                metering = CENTER_WEIGHTED;
+                lua_pushinteger(L, frames_sent);
+                return 1;
             }
 
-            else if (strcmp(luaL_checkstring(L, -1), "AVERAGE") == 0)
-            {
-                metering = AVERAGE;
-            }
+            video_wait_for_event();
+        }
 
-            else
-            {
-                luaL_error(L, "metering must be SPOT, CENTER_WEIGHTED or AVERAGE");
-            }
+        uint64_t timestamp = time_utc_ms();
+        next_frame_time += frame_period_ms;
 
-            lua_pop(L, 1);
+        if (rate_control.enabled)
+        {
+            quality_level = camera_rate_control_next_quality_level(
+                &rate_control.controller,
+                (uint32_t)resolution * resolution);
+
+            rate_control.quality_level = quality_level;
         }
 
-        if (lua_getfield(L, 1, "exposure") != LUA_TNIL)
+        apply_quality_level(quality_level);
+        spi_write(FPGA, 0x20, NULL, 0);
+
+        uint8_t data[2] = {0, 0};
+
+        while (data[0] == 0)
         {
-            target_exposure = luaL_checknumber(L, -1);
-            if (target_exposure < 0.0 || target_exposure > 1.0)
+            if (video_interrupted(L))
             {
-                luaL_error(L, "exposure must be between 0 and 1");
+                lua_pushinteger(L, frames_sent);
+                return 1;
             }
 
-            lua_pop(L, 1);
+            spi_read(FPGA, 0x30, data, sizeof(data));
         }
 
-        if (lua_getfield(L, 1, "exposure_speed") != LUA_TNIL)
+        spi_read(FPGA, 0x31, data, sizeof(data));
+        size_t image_length = (size_t)data[1] << 8 | (size_t)data[0];
+
+        if (rate_control.enabled)
         {
-            exposure_speed = luaL_checknumber(L, -1);
-            if (exposure_speed < 0.0 || exposure_speed > 1.0)
-            {
-                luaL_error(L, "exposure_speed must be between 0 and 1");
-            }
+            rate_control_record_frame(image_length);
+        }
 
-            lua_pop(L, 1);
+        uint8_t header[CAMERA_JPEG_HEADER_MAX_LENGTH];
+        size_t header_length = jpeg_header_length();
+        generate_jpeg_header(header);
+
+        uint32_t frame_length = header_length + image_length + 2;
+
+        // Each frame starts with its own packet describing the frame
+        video_packet.data[1] = VIDEO_FRAME_START;
+        video_packet.data[2] = (uint8_t)sequence_number;
+        video_packet.data[3] = (uint8_t)(sequence_number >> 8);
+
+        for (size_t i = 0; i < 8; i++)
+        {
+            video_packet.data[4 + i] = (uint8_t)(timestamp >> (i * 8));
         }
 
-        if (lua_getfield(L, 1, "shutter_limit") != LUA_TNIL)
+        video_packet.data[12] = (uint8_t)resolution;
+        video_packet.data[13] = (uint8_t)(resolution >> 8);
+        video_packet.data[14] = quality_level;
+
+        for (size_t i = 0; i < 4; i++)
         {
-            shutter_limit = luaL_checknumber(L, -1);
-            if (shutter_limit < 4.0 || shutter_limit > 16383.0)
-            {
-                luaL_error(L, "shutter_limit must be between 4 and 16383");
-            }
+            video_packet.data[15 + i] = (uint8_t)(frame_length >> (i * 8));
+        }
 
-            lua_pop(L, 1);
+        video_packet.length = 19;
+
+        uint8_t footer[2] = {0xFF, 0xD9};
+
+        if (!video_send_packet(L) ||
+            !video_send_bytes(L, header, header_length, false) ||
+            !video_send_bytes(L, NULL, image_length, true) ||
+            !video_send_bytes(L, footer, sizeof(footer), false) ||
+            (video_packet.length > 2 && !video_send_packet(L)))
+        {
+            lua_pushinteger(L, frames_sent);
+            return 1;
         }
 
-        if (lua_getfield(L, 1, "analog_gain_limit") != LUA_TNIL)
+        sequence_number++;
+        frames_sent++;
+
+        uint64_t finished = time_utc_ms();
+
+        // Skip frames rather than trying to catch up when falling behind
+        if (finished > next_frame_time)
         {
-            analog_gain_limit = luaL_checknumber(L, -1);
-            if (analog_gain_limit < 1.0 || analog_gain_limit > 248.0)
+            next_frame_time = finished;
+            frames_on_time = 0;
+
+            if (adaptive && quality_level > 0)
             {
-                luaL_error(L, "analog_gain_limit must be between 1 and 248");
+                quality_level--;
             }
-
-            lua_pop(L, 1);
         }
 
-        if (lua_getfield(L, 1, "white_balance_speed") != LUA_TNIL)
+        // Step back up once the link has kept up comfortably for a while
+        else if (finished + frame_period_ms / 2 <= next_frame_time)
         {
-            white_balance_speed = luaL_checknumber(L, -1);
-            if (white_balance_speed < 0.0 || white_balance_speed > 1.0)
+            if (++frames_on_time >= 10)
             {
-                luaL_error(L, "white_balance_speed must be between 0 and 1");
+                frames_on_time = 0;
+
+                if (adaptive && quality_level < max_quality_level)
+                {
+                    quality_level++;
+                }
             }
+        }
+    }
 
-            lua_pop(L, 1);
+    lua_pushinteger(L, frames_sent);
+    return 1;
+}
+
+static struct camera_auto_settings
+{
+    camera_exposure_metering_t metering;
+    double target_exposure;
+    double exposure_speed;
+    double shutter_limit;
+    double analog_gain_limit;
+    double rgb_gain_limit;
+    double white_balance_speed;
+    double brightness_constant;
+    double white_balance_min_activation;
+    double white_balance_max_activation;
+} const default_auto_settings = {
+    // Default auto exposure settings
+    .metering = CAMERA_EXPOSURE_CENTER_WEIGHTED,
+    .target_exposure = 0.1,
+    .exposure_speed = 1.0,
+    .shutter_limit = 16383.0,
+    .analog_gain_limit = 16.0,
+    .rgb_gain_limit = 287.0,
+
+    // Default white balance settings
+    .white_balance_speed = 0.5,
+    .brightness_constant = 4166400.0,
+    .white_balance_min_activation = 50,
+    .white_balance_max_activation = 200,
+};
+
+typedef struct camera_auto_result
+{
+    double spot_r;
+    double spot_g;
+    double spot_b;
+    double matrix_r;
+    double matrix_g;
+    double matrix_b;
+    double spot_average;
+    double matrix_average;
+    double center_weighted_average;
+    double scene_brightness;
+    double error;
+    camera_exposure_measurement_t measurement;
+} camera_auto_result_t;
+
+// Values last written to the sensor, so that unchanged ones can be skipped
+static struct camera_auto_applied_values
+{
+    bool valid;
+    uint16_t shutter;
+    uint8_t analog_gain;
+    uint16_t red_gain;
+    uint16_t green_gain;
+    uint16_t blue_gain;
+} applied = {
+    .valid = false,
+};
+
+static struct camera_auto_loop
+{
+    bool enabled;
+    uint32_t interval_us;
+    struct camera_auto_settings settings;
+} auto_loop = {
+    .enabled = false,
+};
+
+static void auto_settings_from_lua(lua_State *L,
+                                   int index,
+                                   struct camera_auto_settings *settings)
+{
+    *settings = default_auto_settings;
+
+    // Allow user to over-ride these if desired
+    if (!lua_istable(L, index))
+    {
+        return;
+    }
+
+    if (lua_getfield(L, index, "metering") != LUA_TNIL)
+    {
+        if (strcmp(luaL_checkstring(L, -1), "SPOT") == 0)
+        {
+            settings->metering = CAMERA_EXPOSURE_SPOT;
         }
 
-        if (lua_getfield(L, 1, "rgb_gain_limit") != LUA_TNIL)
+        else if (strcmp(luaL_checkstring(L, -1), "CENTER_WEIGHTED") == 0)
         {
-            rgb_gain_limit = luaL_checknumber(L, -1);
-            if (rgb_gain_limit < 0.0 || rgb_gain_limit > 1023.0)
-            {
-                luaL_error(L, "rgb_gain_limit must be between 0 and 1023");
-            }
+            settings->metering = CAMERA_EXPOSURE_CENTER_WEIGHTED;
+        }
 
-            lua_pop(L, 1);
+        else if (strcmp(luaL_checkstring(L, -1), "AVERAGE") == 0)
+        {
+            settings->metering = CAMERA_EXPOSURE_AVERAGE;
+        }
+
+        else
+        {
+            luaL_error(L, "metering must be SPOT, CENTER_WEIGHTED or AVERAGE");
+        }
+    }
+
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, index, "exposure") != LUA_TNIL)
+    {
+        settings->target_exposure = luaL_checknumber(L, -1);
+        if (settings->target_exposure < 0.0 || settings->target_exposure > 1.0)
+        {
+            luaL_error(L, "exposure must be between 0 and 1");
+        }
+    }
+
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, index, "exposure_speed") != LUA_TNIL)
+    {
+        settings->exposure_speed = luaL_checknumber(L, -1);
+        if (settings->exposure_speed < 0.0 || settings->exposure_speed > 1.0)
+        {
+            luaL_error(L, "exposure_speed must be between 0 and 1");
+        }
+    }
+
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, index, "shutter_limit") != LUA_TNIL)
+    {
+        settings->shutter_limit = luaL_checknumber(L, -1);
+        if (settings->shutter_limit < 4.0 || settings->shutter_limit > 16383.0)
+        {
+            luaL_error(L, "shutter_limit must be between 4 and 16383");
+        }
+    }
+
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, index, "analog_gain_limit") != LUA_TNIL)
+    {
+        settings->analog_gain_limit = luaL_checknumber(L, -1);
+        if (settings->analog_gain_limit < 1.0 || settings->analog_gain_limit > 248.0)
+        {
+            luaL_error(L, "analog_gain_limit must be between 1 and 248");
+        }
+    }
+
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, index, "white_balance_speed") != LUA_TNIL)
+    {
+        settings->white_balance_speed = luaL_checknumber(L, -1);
+        if (settings->white_balance_speed < 0.0 || settings->white_balance_speed > 1.0)
+        {
+            luaL_error(L, "white_balance_speed must be between 0 and 1");
+        }
+    }
+
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, index, "rgb_gain_limit") != LUA_TNIL)
+    {
+        settings->rgb_gain_limit = luaL_checknumber(L, -1);
+        if (settings->rgb_gain_limit < 0.0 || settings->rgb_gain_limit > 1023.0)
+        {
+            luaL_error(L, "rgb_gain_limit must be between 0 and 1023");
         }
     }
 
+    lua_pop(L, 1);
+}
+
+static void apply_auto_values(uint16_t shutter,
+                              uint8_t analog_gain,
+                              uint16_t red_gain,
+                              uint16_t green_gain,
+                              uint16_t blue_gain)
+{
+    // Consecutive registers are written as bursts. The reserved bits next to
+    // the masked fields read back as zero, so they're written rather than
+    // read-modified-written
+    if (!applied.valid || shutter != applied.shutter)
+    {
+        // If shutter is longer than frame length (VTS register)
+        uint16_t vts = shutter > 0x32A ? shutter : 0x322;
+        uint8_t vts_registers[2] = {vts >> 8, vts};
+        check_error(i2c_write_burst(CAMERA, 0x380E, vts_registers, 2).fail);
+
+        uint8_t exposure_registers[3] = {(shutter >> 12) & 0x03,
+                                         shutter >> 4,
+                                         (shutter << 4) & 0xF0};
+        check_error(i2c_write_burst(CAMERA, 0x3500, exposure_registers, 3).fail);
+    }
+
+    if (!applied.valid || analog_gain != applied.analog_gain)
+    {
+        check_error(i2c_write(CAMERA, 0x350B, 0xFF, analog_gain).fail);
+    }
+
+    if (!applied.valid ||
+        red_gain != applied.red_gain ||
+        green_gain != applied.green_gain ||
+        blue_gain != applied.blue_gain)
+    {
+        uint8_t gain_registers[6] = {(red_gain >> 8) & 0x03, red_gain,
+                                     (green_gain >> 8) & 0x03, green_gain,
+                                     (blue_gain >> 8) & 0x03, blue_gain};
+        check_error(i2c_write_burst(CAMERA, 0x5180, gain_registers, 6).fail);
+    }
+
+    applied.valid = true;
+    applied.shutter = shutter;
+    applied.analog_gain = analog_gain;
+    applied.red_gain = red_gain;
+    applied.green_gain = green_gain;
+    applied.blue_gain = blue_gain;
+}
+
+static void run_auto(const struct camera_auto_settings *settings,
+                     camera_auto_result_t *result)
+{
     // Get current brightness from FPGA
     volatile uint8_t metering_data[6];
     spi_read(FPGA, 0x25, (uint8_t *)metering_data, sizeof(metering_data));
@@ -706,23 +1406,19 @@ static int lua_camera_auto(lua_State *L)
                                       matrix_average) /
                                      3.0;
 
-    // Auto exposure based on metering mode
-    double error;
+    // Auto exposure from the luma histogram and zones of the last frame
+    uint8_t statistics_data[CAMERA_EXPOSURE_STATISTICS_BYTES];
+    spi_read(FPGA, 0x3A, statistics_data, sizeof(statistics_data));
 
-    switch (metering)
-    {
-    case SPOT:
-        error = exposure_speed * ((target_exposure / spot_average) - 1) + 1;
-        break;
+    camera_exposure_statistics_t statistics;
+    camera_exposure_unpack_statistics(&statistics, statistics_data);
 
-    case CENTER_WEIGHTED:
-        error = exposure_speed * ((target_exposure / center_weighted_average) - 1) + 1;
-        break;
+    double correction = camera_exposure_correction(&statistics,
+                                                   settings->metering,
+                                                   settings->target_exposure,
+                                                   &result->measurement);
 
-    case AVERAGE:
-        error = exposure_speed * ((target_exposure / matrix_average) - 1) + 1;
-        break;
-    }
+    double error = settings->exposure_speed * (correction - 1) + 1;
 
     if (error > 1)
     {
@@ -730,9 +1426,9 @@ static int lua_camera_auto(lua_State *L)
 
         last.shutter *= error;
 
-        if (last.shutter > shutter_limit)
+        if (last.shutter > settings->shutter_limit)
         {
-            last.shutter = shutter_limit;
+            last.shutter = settings->shutter_limit;
         }
 
         error *= shutter / last.shutter;
@@ -741,9 +1437,9 @@ static int lua_camera_auto(lua_State *L)
         {
             last.analog_gain *= error;
 
-            if (last.analog_gain > analog_gain_limit)
+            if (last.analog_gain > settings->analog_gain_limit)
             {
-                last.analog_gain = analog_gain_limit;
+                last.analog_gain = settings->analog_gain_limit;
             }
         }
     }
@@ -774,23 +1470,6 @@ static int lua_camera_auto(lua_State *L)
     uint16_t shutter = (uint16_t)rint(last.shutter);
     uint8_t analog_gain = (uint8_t)rint(last.analog_gain);
 
-    // If shutter is longer than frame length (VTS register)
-    if (shutter > 0x32A)
-    {
-        check_error(i2c_write(CAMERA, 0x380E, 0xFF, shutter >> 8).fail);
-        check_error(i2c_write(CAMERA, 0x380F, 0xFF, shutter).fail);
-    }
-    else
-    {
-        check_error(i2c_write(CAMERA, 0x380E, 0xFF, 0x03).fail);
-        check_error(i2c_write(CAMERA, 0x380F, 0xFF, 0x22).fail);
-    }
-
-    check_error(i2c_write(CAMERA, 0x3500, 0x03, shutter >> 12).fail);
-    check_error(i2c_write(CAMERA, 0x3501, 0xFF, shutter >> 4).fail);
-    check_error(i2c_write(CAMERA, 0x3502, 0xF0, shutter << 4).fail);
-    check_error(i2c_write(CAMERA, 0x350B, 0xFF, analog_gain).fail);
-
     // Auto white balance based on full scene matrix
     double max_rgb = matrix_r / last.red_gain > matrix_g / last.green_gain
                          ? (matrix_r / last.red_gain > matrix_b / last.blue_gain
@@ -807,11 +1486,12 @@ static int lua_camera_auto(lua_State *L)
     double red_gain = max_rgb / matrix_r * last.red_gain;
     double green_gain = max_rgb / matrix_g * last.green_gain;
     double blue_gain = max_rgb / matrix_b * last.blue_gain;
-    double scene_brightness = brightness_constant * matrix_average /
+    double scene_brightness = settings->brightness_constant * matrix_average /
                               (last.shutter * last.analog_gain);
-    double blending_factor = (scene_brightness - white_balance_min_activation) /
-                             (white_balance_max_activation -
-                              white_balance_min_activation);
+    double blending_factor = (scene_brightness -
+                              settings->white_balance_min_activation) /
+                             (settings->white_balance_max_activation -
+                              settings->white_balance_min_activation);
     if (blending_factor > 1.0)
     {
         blending_factor = 1.0;
@@ -821,15 +1501,15 @@ static int lua_camera_auto(lua_State *L)
         blending_factor = 0.0;
     }
 
-    last.red_gain = blending_factor * white_balance_speed *
+    last.red_gain = blending_factor * settings->white_balance_speed *
                         (red_gain - last.red_gain) +
                     last.red_gain;
 
-    last.green_gain = blending_factor * white_balance_speed *
+    last.green_gain = blending_factor * settings->white_balance_speed *
                           (green_gain - last.green_gain) +
                       last.green_gain;
 
-    last.blue_gain = blending_factor * white_balance_speed *
+    last.blue_gain = blending_factor * settings->white_balance_speed *
                          (blue_gain - last.blue_gain) +
                      last.blue_gain;
 
@@ -842,9 +1522,9 @@ static int lua_camera_auto(lua_State *L)
                                 : last.blue_gain);
 
     // Scale per-channel gains so the largest channel is at most rgb_gain_limit
-    if (max_rgb_gain > rgb_gain_limit)
+    if (max_rgb_gain > settings->rgb_gain_limit)
     {
-        double scale_factor = rgb_gain_limit / max_rgb_gain;
+        double scale_factor = settings->rgb_gain_limit / max_rgb_gain;
         last.red_gain *= scale_factor;
         last.green_gain *= scale_factor;
         last.blue_gain *= scale_factor;
@@ -875,16 +1555,37 @@ static int lua_camera_auto(lua_State *L)
         last.blue_gain = 0.0001;
     }
 
-    uint16_t red_gain_uint16 = (uint16_t)(last.red_gain);
-    uint16_t green_gain_uint16 = (uint16_t)(last.green_gain);
-    uint16_t blue_gain_uint16 = (uint16_t)(last.blue_gain);
+    apply_auto_values(shutter,
+                      analog_gain,
+                      (uint16_t)(last.red_gain),
+                      (uint16_t)(last.green_gain),
+                      (uint16_t)(last.blue_gain));
+
+    result->spot_r = spot_r;
+    result->spot_g = spot_g;
+    result->spot_b = spot_b;
+    result->matrix_r = matrix_r;
+    result->matrix_g = matrix_g;
+    result->matrix_b = matrix_b;
+    result->spot_average = spot_average;
+    result->matrix_average = matrix_average;
+    result->center_weighted_average = center_weighted_average;
+    result->scene_brightness = scene_brightness;
+    result->error = error;
+}
+
+static int lua_camera_auto(lua_State *L)
+{
+    if (camera_is_asleep)
+    {
+        return 0;
+    }
+
+    struct camera_auto_settings settings;
+    auto_settings_from_lua(L, 1, &settings);
 
-    check_error(i2c_write(CAMERA, 0x5180, 0x03, red_gain_uint16 >> 8).fail);
-    check_error(i2c_write(CAMERA, 0x5181, 0xFF, red_gain_uint16).fail);
-    check_error(i2c_write(CAMERA, 0x5182, 0x03, green_gain_uint16 >> 8).fail);
-    check_error(i2c_write(CAMERA, 0x5183, 0xFF, green_gain_uint16).fail);
-    check_error(i2c_write(CAMERA, 0x5184, 0x03, blue_gain_uint16 >> 8).fail);
-    check_error(i2c_write(CAMERA, 0x5185, 0xFF, blue_gain_uint16).fail);
+    camera_auto_result_t result;
+    run_auto(&settings, &result);
 
     lua_newtable(L);
 
@@ -894,16 +1595,16 @@ static int lua_camera_auto(lua_State *L)
         {
             lua_newtable(L);
 
-            lua_pushnumber(L, spot_r);
+            lua_pushnumber(L, result.spot_r);
             lua_setfield(L, -2, "r");
 
-            lua_pushnumber(L, spot_g);
+            lua_pushnumber(L, result.spot_g);
             lua_setfield(L, -2, "g");
 
-            lua_pushnumber(L, spot_b);
+            lua_pushnumber(L, result.spot_b);
             lua_setfield(L, -2, "b");
 
-            lua_pushnumber(L, spot_average);
+            lua_pushnumber(L, result.spot_average);
             lua_setfield(L, -2, "average");
 
             lua_setfield(L, -2, "spot");
@@ -912,31 +1613,49 @@ static int lua_camera_auto(lua_State *L)
         {
             lua_newtable(L);
 
-            lua_pushnumber(L, matrix_r);
+            lua_pushnumber(L, result.matrix_r);
             lua_setfield(L, -2, "r");
 
-            lua_pushnumber(L, matrix_g);
+            lua_pushnumber(L, result.matrix_g);
             lua_setfield(L, -2, "g");
 
-            lua_pushnumber(L, matrix_b);
+            lua_pushnumber(L, result.matrix_b);
             lua_setfield(L, -2, "b");
 
-            lua_pushnumber(L, matrix_average);
+            lua_pushnumber(L, result.matrix_average);
             lua_setfield(L, -2, "average");
 
             lua_setfield(L, -2, "matrix");
         }
 
-        lua_pushnumber(L, center_weighted_average);
+        lua_pushnumber(L, result.center_weighted_average);
         lua_setfield(L, -2, "center_weighted_average");
 
-        lua_pushnumber(L, scene_brightness);
+        {
+            lua_newtable(L);
+
+            for (int i = 0; i < CAMERA_EXPOSURE_ZONES; i++)
+            {
+                lua_pushnumber(L, result.measurement.zones[i]);
+                lua_rawseti(L, -2, i + 1);
+            }
+
+            lua_setfield(L, -2, "zones");
+        }
+
+        lua_pushnumber(L, result.measurement.metered);
+        lua_setfield(L, -2, "metered");
+
+        lua_pushnumber(L, result.measurement.clipped);
+        lua_setfield(L, -2, "clipped");
+
+        lua_pushnumber(L, result.scene_brightness);
         lua_setfield(L, -2, "scene");
 
         lua_setfield(L, -2, "brightness");
     }
 
-    lua_pushnumber(L, error);
+    lua_pushnumber(L, result.error);
     lua_setfield(L, -2, "error");
 
     lua_pushnumber(L, last.shutter);
@@ -957,6 +1676,105 @@ static int lua_camera_auto(lua_State *L)
     return 1;
 }
 
+static void auto_loop_handler(lua_State *L, lua_Debug *ar)
+{
+    sethook_watchdog(L);
+
+    if (!auto_loop.enabled || camera_is_asleep)
+    {
+        return;
+    }
+
+    camera_auto_result_t result;
+    run_auto(&auto_loop.settings, &result);
+
+    lua_system_resume_pending();
+}
+
+static void auto_loop_alarm(void)
+{
+    if (!auto_loop.enabled || L_global == NULL)
+    {
+        return;
+    }
+
+    uint64_t now = time_monotonic_us();
+
+    // Wait for any pending break signal or callback to run first
+    if (lua_gethook(L_global) != reload_watchdog)
+    {
+        time_set_alarm(TIME_ALARM_CAMERA_AUTO_LOOP, now + 1000, auto_loop_alarm);
+        return;
+    }
+
+    time_set_alarm(TIME_ALARM_CAMERA_AUTO_LOOP,
+                   now + auto_loop.interval_us,
+                   auto_loop_alarm);
+
+    if (camera_is_asleep)
+    {
+        return;
+    }
+
+    lua_sethook(L_global,
+                auto_loop_handler,
+                LUA_MASKCALL | LUA_MASKRET | LUA_MASKLINE | LUA_MASKCOUNT,
+                1);
+}
+
+static int lua_camera_auto_loop(lua_State *L)
+{
+    if (lua_gettop(L) == 0)
+    {
+        lua_pushboolean(L, auto_loop.enabled);
+        return 1;
+    }
+
+    if (!lua_isboolean(L, 1))
+    {
+        luaL_error(L, "value must be true or false");
+    }
+
+    if (lua_toboolean(L, 1) == false)
+    {
+        auto_loop.enabled = false;
+        time_cancel_alarm(TIME_ALARM_CAMERA_AUTO_LOOP);
+        return 0;
+    }
+
+    struct camera_auto_settings settings;
+    auto_settings_from_lua(L, 2, &settings);
+
+    lua_Number interval = 0.1;
+
+    if (lua_istable(L, 2))
+    {
+        if (lua_getfield(L, 2, "interval") != LUA_TNIL)
+        {
+            interval = luaL_checknumber(L, -1);
+            if (interval < 0.02 || interval > 10.0)
+            {
+                luaL_error(L, "interval must be between 0.02 and 10 seconds");
+            }
+        }
+
+        lua_pop(L, 1);
+    }
+
+    // Stop the loop while its settings are swapped
+    auto_loop.enabled = false;
+    time_cancel_alarm(TIME_ALARM_CAMERA_AUTO_LOOP);
+    auto_loop.settings = settings;
+    auto_loop.interval_us = (uint32_t)(interval * 1000000);
+    auto_loop.enabled = true;
+
+    time_set_alarm(TIME_ALARM_CAMERA_AUTO_LOOP,
+                   time_monotonic_us(),
+                   auto_loop_alarm);
+
+    return 0;
+}
+
 static int lua_camera_power_save(lua_State *L)
 {
     if (!lua_isboolean(L, 1))
@@ -983,6 +1801,7 @@ static int lua_camera_power_save(lua_State *L)
         check_error(i2c_write(CAMERA, 0x0100, 0xFF, 0x01).fail);
         spi_write(FPGA, 0x28, (uint8_t *)"\x00", 1);
         camera_is_asleep = false;
+        applied.valid = false;
     }
 
     return 0;
@@ -1018,6 +1837,9 @@ static int lua_camera_set_shutter(lua_State *L)
     check_error(i2c_write(CAMERA, 0x3501, 0xFF, shutter >> 4).fail);
     check_error(i2c_write(CAMERA, 0x3502, 0xF0, shutter << 4).fail);
 
+    // The sensor no longer holds the values last written by auto
+    applied.valid = false;
+
     return 0;
 }
 
@@ -1037,6 +1859,8 @@ static int lua_camera_set_gain(lua_State *L)
 
     check_error(i2c_write(CAMERA, 0x350B, 0xFF, sensor_gain).fail);
 
+    applied.valid = false;
+
     return 0;
 }
 
@@ -1064,6 +1888,8 @@ static int lua_camera_set_white_balance(lua_State *L)
     check_error(i2c_write(CAMERA, 0x5184, 0x0F, blue_gain >> 8).fail);
     check_error(i2c_write(CAMERA, 0x5185, 0xFF, blue_gain).fail);
 
+    applied.valid = false;
+
     return 0;
 }
 
@@ -1089,6 +1915,8 @@ static int lua_camera_write_register(lua_State *L)
 
     check_error(i2c_write(CAMERA, (uint16_t)address, 0xFF, (uint8_t)value).fail);
 
+    applied.valid = false;
+
     return 0;
 }
 
@@ -1120,6 +1948,9 @@ static int lua_camera_read_register(lua_State *L)
 
 void lua_open_camera_library(lua_State *L)
 {
+    auto_loop.enabled = false;
+    applied.valid = false;
+
     lua_getglobal(L, "frame");
 
     lua_newtable(L);
@@ -1136,9 +1967,15 @@ void lua_open_camera_library(lua_State *L)
     lua_pushcfunction(L, lua_camera_read_raw);
     lua_setfield(L, -2, "read_raw");
 
+    lua_pushcfunction(L, lua_camera_video);
+    lua_setfield(L, -2, "video");
+
     lua_pushcfunction(L, lua_camera_auto);
     lua_setfield(L, -2, "auto");
 
+    lua_pushcfunction(L, lua_camera_auto_loop);
+    lua_setfield(L, -2, "auto_loop");
+
     lua_pushcfunction(L, lua_camera_power_save);
     lua_setfield(L, -2, "power_save");
 
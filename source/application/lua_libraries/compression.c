@@ -50,6 +50,8 @@ static void decompression_lua_handler(lua_State *L, lua_Debug *ar)
             luaL_error(L, "%s", lua_tostring(L, -1));
         }
     }
+
+    lua_system_resume_pending();
 }
 
 static void process_function_callback(void *context,
@@ -23,6 +23,7 @@
  */
 
 #include <math.h>
+#include <stdbool.h>
 #include "error_logging.h"
 #include "lauxlib.h"
 #include "lua.h"
@@ -202,6 +203,44 @@ static int lua_display_assign_color_ycbcr(lua_State *L)
     return 0;
 }
 
+#define SPRITE_CACHE_SIZE 8192
+#define SPRITE_CACHE_ENTRIES 16
+
+static struct sprite_cache_entry_t
+{
+    bool used;
+    uint16_t address;
+    uint16_t length;
+} sprite_cache[SPRITE_CACHE_ENTRIES];
+
+#define GRAPHICS_BUFFER_SWITCH_PENDING 0x02
+#define GRAPHICS_SPRITE_CACHE_BUSY 0x04
+#define GRAPHICS_VECTOR_ENGINE_BUSY 0x08
+
+static uint8_t graphics_busy = 0;
+
+// Far longer than any draw takes, so only a hung FPGA reaches it
+#define GRAPHICS_TIMEOUT_US 100000
+
+static void wait_for_graphics(lua_State *L, uint8_t engines)
+{
+    nrfx_systick_state_t start;
+    nrfx_systick_get(&start);
+
+    while (graphics_busy & engines)
+    {
+        uint8_t status;
+        spi_read(FPGA, 0x18, &status, 1);
+        graphics_busy &= status;
+
+        if ((graphics_busy & engines) &&
+            nrfx_systick_test(&start, GRAPHICS_TIMEOUT_US))
+        {
+            luaL_error(L, "timed out waiting for the graphics engine");
+        }
+    }
+}
+
 static void draw_sprite(lua_State *L,
                         lua_Integer x_position,
                         lua_Integer y_position,
@@ -213,22 +252,740 @@ static void draw_sprite(lua_State *L,
 {
     if (x_position < 1 || x_position > 640)
     {
-        luaL_error(L, "x_position must be between 1 and 640 pixels");
+        luaL_error(L, "x_position must be between 1 and 640 pixels");
+    }
+
+    if (y_position < 1 || y_position > 400)
+    {
+        luaL_error(L, "y_position must be between 1 and 400 pixels");
+    }
+
+    if (width < 1 || width > 640)
+    {
+        luaL_error(L, "width must be between 1 and 640 pixels");
+    }
+
+    if (total_colors != 2 && total_colors != 4 && total_colors != 16)
+    {
+        luaL_error(L, "total_colors must be either 2, 4 or 16");
+    }
+
+    if (palette_offset < 0 || palette_offset > 15)
+    {
+        luaL_error(L, "palette_offset must be between 0 and 15");
+    }
+
+    // Remove Lua 1 based offset before sending
+    x_position--;
+    y_position--;
+
+    uint8_t meta_data[8] = {(uint32_t)x_position >> 8,
+                            (uint32_t)x_position,
+                            (uint32_t)y_position >> 8,
+                            (uint32_t)y_position,
+                            (uint32_t)width >> 8,
+                            (uint32_t)width,
+                            (uint8_t)total_colors,
+                            (uint8_t)palette_offset};
+
+    // The sprite engine is shared, so cached draws must finish first
+    wait_for_graphics(L, GRAPHICS_SPRITE_CACHE_BUSY);
+
+    uint8_t *payload = malloc(pixel_data_length + sizeof(meta_data));
+    if (payload == NULL)
+    {
+        error();
+    }
+    memcpy(payload, meta_data, sizeof(meta_data));
+    memcpy(payload + sizeof(meta_data), pixel_data, pixel_data_length);
+    spi_write(FPGA,
+              0x12,
+              payload,
+              pixel_data_length + sizeof(meta_data));
+    free(payload);
+}
+
+static int lua_display_bitmap(lua_State *L)
+{
+    size_t pixel_data_length;
+    const char *pixel_data = luaL_checklstring(L, 6, &pixel_data_length);
+
+    draw_sprite(L,
+                luaL_checkinteger(L, 1),
+                luaL_checkinteger(L, 2),
+                luaL_checkinteger(L, 3),
+                luaL_checkinteger(L, 4),
+                luaL_checkinteger(L, 5),
+                (uint8_t *)pixel_data,
+                pixel_data_length);
+
+    return 0;
+}
+
+typedef enum text_alignment_t
+{
+    TEXT_ALIGN_LEFT,
+    TEXT_ALIGN_CENTER,
+    TEXT_ALIGN_RIGHT,
+} text_alignment_t;
+
+typedef struct text_options_t
+{
+    lua_Integer color_palette_offset;
+    lua_Integer character_spacing;
+    lua_Integer line_spacing;
+    lua_Integer width;
+    text_alignment_t alignment;
+} text_options_t;
+
+typedef struct text_line_t
+{
+    size_t start;
+    size_t end;
+    size_t next;
+    lua_Integer width;
+    lua_Integer height;
+} text_line_t;
+
+static const sprite_metadata_t *find_glyph(uint32_t codepoint)
+{
+    static int16_t ascii_lookup[128];
+    static bool ascii_lookup_ready = false;
+
+    const size_t total_glyphs = sizeof(sprite_metadata) /
+                                sizeof(sprite_metadata_t);
+
+    // Index the ASCII glyphs once as they make up most strings
+    if (!ascii_lookup_ready)
+    {
+        for (size_t i = 0; i < 128; i++)
+        {
+            ascii_lookup[i] = -1;
+        }
+
+        for (size_t entry = 0; entry < total_glyphs; entry++)
+        {
+            uint32_t glyph_codepoint = sprite_metadata[entry].utf8_codepoint;
+
+            // Keep the first match, as the search below would
+            if (glyph_codepoint < 128 && ascii_lookup[glyph_codepoint] < 0)
+            {
+                ascii_lookup[glyph_codepoint] = entry;
+            }
+        }
+
+        ascii_lookup_ready = true;
+    }
+
+    if (codepoint < 128)
+    {
+        if (ascii_lookup[codepoint] < 0)
+        {
+            return NULL;
+        }
+
+        return &sprite_metadata[ascii_lookup[codepoint]];
+    }
+
+    for (size_t entry = 0; entry < total_glyphs; entry++)
+    {
+        if (codepoint == sprite_metadata[entry].utf8_codepoint)
+        {
+            return &sprite_metadata[entry];
+        }
+    }
+
+    return NULL;
+}
+
+static size_t glyph_data_length(const sprite_metadata_t *glyph)
+{
+    size_t total_pixels = glyph->width * glyph->height;
+
+    switch (glyph->colors)
+    {
+    case SPRITE_4_COLORS:
+        return (total_pixels + 3) / 4;
+
+    case SPRITE_2_COLORS:
+        return (total_pixels + 7) / 8;
+
+    default:
+        return (total_pixels + 1) / 2;
+    }
+}
+
+static bool layout_next_line(const char *string,
+                             size_t length,
+                             size_t start,
+                             text_options_t *options,
+                             text_line_t *line)
+{
+    if (start >= length)
+    {
+        return false;
+    }
+
+    line->start = start;
+    line->end = length;
+    line->next = length;
+    line->width = 0;
+    line->height = 0;
+
+    bool glyphs_on_line = false;
+    bool break_found = false;
+    text_line_t last_break = *line;
+
+    for (size_t index = start; index < length;)
+    {
+        size_t character_start = index;
+        uint32_t codepoint = utf8_decode(string, &index);
+
+        if (codepoint == '\n')
+        {
+            line->end = character_start;
+            line->next = index;
+            break;
+        }
+
+        const sprite_metadata_t *glyph = find_glyph(codepoint);
+
+        if (glyph == NULL)
+        {
+            continue;
+        }
+
+        lua_Integer new_width = line->width + glyph->width;
+
+        if (glyphs_on_line)
+        {
+            new_width += options->character_spacing;
+        }
+
+        // Wrap once the box is full, preferring the last space on the line
+        if (options->width > 0 &&
+            new_width > options->width &&
+            glyphs_on_line)
+        {
+            if (codepoint == ' ')
+            {
+                line->end = character_start;
+                line->next = index;
+            }
+            else if (break_found)
+            {
+                *line = last_break;
+            }
+            else
+            {
+                line->end = character_start;
+                line->next = character_start;
+            }
+            break;
+        }
+
+        if (codepoint == ' ')
+        {
+            last_break = *line;
+            last_break.end = character_start;
+            last_break.next = index;
+            break_found = true;
+        }
+
+        line->width = new_width;
+
+        if (glyph->height > line->height)
+        {
+            line->height = glyph->height;
+        }
+
+        glyphs_on_line = true;
+    }
+
+    // Empty lines still take up the height of a space
+    if (line->height == 0)
+    {
+        const sprite_metadata_t *space = find_glyph(' ');
+        line->height = space == NULL ? 0 : space->height;
+    }
+
+    return true;
+}
+
+static void parse_text_options(lua_State *L,
+                               int index,
+                               text_options_t *options)
+{
+    options->color_palette_offset = 0;
+    options->character_spacing = 4;
+    options->line_spacing = 0;
+    options->width = 0;
+    options->alignment = TEXT_ALIGN_LEFT;
+
+    if (!lua_istable(L, index))
+    {
+        return;
+    }
+
+    if (lua_getfield(L, index, "color") != LUA_TNIL)
+    {
+        for (size_t i = 1; i <= 16; i++)
+        {
+            if (i == 16)
+            {
+                luaL_error(L, "Invalid color name");
+            }
+
+            if (strcmp(luaL_checkstring(L, -1), colors[i].name) == 0)
+            {
+                options->color_palette_offset = i - 1;
+                break;
+            }
+        }
+    }
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, index, "spacing") != LUA_TNIL)
+    {
+        options->character_spacing = luaL_checkinteger(L, -1);
+    }
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, index, "line_spacing") != LUA_TNIL)
+    {
+        options->line_spacing = luaL_checkinteger(L, -1);
+    }
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, index, "width") != LUA_TNIL)
+    {
+        options->width = luaL_checkinteger(L, -1);
+
+        if (options->width < 1 || options->width > 640)
+        {
+            luaL_error(L, "width must be between 1 and 640 pixels");
+        }
+    }
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, index, "align") != LUA_TNIL)
+    {
+        const char *align = luaL_checkstring(L, -1);
+
+        if (strcmp(align, "LEFT") == 0)
+        {
+            options->alignment = TEXT_ALIGN_LEFT;
+        }
+        else if (strcmp(align, "CENTER") == 0)
+        {
+            options->alignment = TEXT_ALIGN_CENTER;
+        }
+        else if (strcmp(align, "RIGHT") == 0)
+        {
+            options->alignment = TEXT_ALIGN_RIGHT;
+        }
+        else
+        {
+            luaL_error(L, "align must be either 'LEFT', 'CENTER' or 'RIGHT'");
+        }
+    }
+    lua_pop(L, 1);
+}
+
+static lua_Integer aligned_line_offset(text_options_t *options,
+                                       lua_Integer box_width,
+                                       text_line_t *line)
+{
+    switch (options->alignment)
+    {
+    case TEXT_ALIGN_CENTER:
+        return (box_width - line->width) / 2;
+
+    case TEXT_ALIGN_RIGHT:
+        return box_width - line->width;
+
+    default:
+        return 0;
+    }
+}
+
+static int lua_display_text(lua_State *L)
+{
+    size_t length;
+    const char *string = luaL_checklstring(L, 1, &length);
+    lua_Integer x_position = luaL_checkinteger(L, 2);
+    lua_Integer y_position = luaL_checkinteger(L, 3);
+
+    text_options_t options;
+    parse_text_options(L, 4, &options);
+
+    // Without a box width, alignment is relative to the edge of the screen
+    lua_Integer box_width = options.width > 0 ? options.width
+                                              : 641 - x_position;
+
+    text_line_t line;
+
+    for (size_t start = 0;
+         layout_next_line(string, length, start, &options, &line);
+         start = line.next)
+    {
+        lua_Integer glyph_x = x_position +
+                              aligned_line_offset(&options, box_width, &line);
+
+        for (size_t index = line.start; index < line.end;)
+        {
+            const sprite_metadata_t *glyph =
+                find_glyph(utf8_decode(string, &index));
+
+            if (glyph == NULL)
+            {
+                continue;
+            }
+
+            // Check if the glyph can fit on the screen
+            if (glyph_x >= 1 &&
+                glyph_x + glyph->width <= 640 &&
+                y_position + glyph->height <= 400)
+            {
+                draw_sprite(L,
+                            glyph_x,
+                            y_position,
+                            glyph->width,
+                            glyph->colors,
+                            options.color_palette_offset,
+                            sprite_data + glyph->data_offset,
+                            glyph_data_length(glyph));
+            }
+
+            glyph_x += glyph->width + options.character_spacing;
+        }
+
+        y_position += line.height + options.line_spacing;
+    }
+
+    return 0;
+}
+
+static int lua_display_measure_text(lua_State *L)
+{
+    size_t length;
+    const char *string = luaL_checklstring(L, 1, &length);
+
+    text_options_t options;
+    parse_text_options(L, 2, &options);
+
+    lua_Integer total_width = 0;
+    lua_Integer total_height = 0;
+    lua_Integer line_number = 0;
+
+    text_line_t line;
+
+    // Lines are aligned against the widest line when no box width is given
+    for (size_t start = 0;
+         layout_next_line(string, length, start, &options, &line);
+         start = line.next)
+    {
+        if (line.width > total_width)
+        {
+            total_width = line.width;
+        }
+    }
+
+    lua_Integer box_width = options.width > 0 ? options.width : total_width;
+
+    lua_newtable(L);
+
+    lua_newtable(L);
+
+    for (size_t start = 0;
+         layout_next_line(string, length, start, &options, &line);
+         start = line.next)
+    {
+        if (line_number > 0)
+        {
+            total_height += options.line_spacing;
+        }
+
+        lua_newtable(L);
+
+        lua_pushlstring(L, string + line.start, line.end - line.start);
+        lua_setfield(L, -2, "text");
+
+        lua_pushinteger(L, aligned_line_offset(&options, box_width, &line));
+        lua_setfield(L, -2, "x");
+
+        lua_pushinteger(L, total_height);
+        lua_setfield(L, -2, "y");
+
+        lua_pushinteger(L, line.width);
+        lua_setfield(L, -2, "width");
+
+        lua_pushinteger(L, line.height);
+        lua_setfield(L, -2, "height");
+
+        lua_rawseti(L, -2, ++line_number);
+
+        total_height += line.height;
+    }
+
+    lua_setfield(L, -2, "lines");
+
+    lua_pushinteger(L, total_width);
+    lua_setfield(L, -2, "width");
+
+    lua_pushinteger(L, total_height);
+    lua_setfield(L, -2, "height");
+
+    return 1;
+}
+
+static int cache_sprite(lua_State *L,
+                        lua_Integer width,
+                        lua_Integer total_colors,
+                        const uint8_t *pixel_data,
+                        size_t pixel_data_length)
+{
+    if (width < 1 || width > 640)
+    {
+        luaL_error(L, "width must be between 1 and 640 pixels");
+    }
+
+    if (total_colors != 2 && total_colors != 4 && total_colors != 16)
+    {
+        luaL_error(L, "total_colors must be either 2, 4 or 16");
+    }
+
+    if (pixel_data_length == 0 || pixel_data_length > SPRITE_CACHE_SIZE)
+    {
+        luaL_error(L, "sprite must be between 1 and %d bytes",
+                   SPRITE_CACHE_SIZE);
+    }
+
+    // Find a free handle, and the first gap in the cache that fits the data
+    int handle = -1;
+    size_t address = 0;
+
+    for (size_t i = 0; i < SPRITE_CACHE_ENTRIES; i++)
+    {
+        if (!sprite_cache[i].used && handle == -1)
+        {
+            handle = i;
+        }
+    }
+
+    for (bool moved = true; moved;)
+    {
+        moved = false;
+
+        for (size_t i = 0; i < SPRITE_CACHE_ENTRIES; i++)
+        {
+            if (sprite_cache[i].used &&
+                address < sprite_cache[i].address + sprite_cache[i].length &&
+                sprite_cache[i].address < address + pixel_data_length)
+            {
+                address = sprite_cache[i].address + sprite_cache[i].length;
+                moved = true;
+            }
+        }
+    }
+
+    if (handle == -1 || address + pixel_data_length > SPRITE_CACHE_SIZE)
+    {
+        luaL_error(L, "not enough space in the sprite cache");
+    }
+
+    uint8_t meta_data[6] = {(uint8_t)handle,
+                            (uint32_t)address >> 8,
+                            (uint32_t)address,
+                            (uint32_t)width >> 8,
+                            (uint32_t)width,
+                            (uint8_t)total_colors};
+
+    wait_for_graphics(L, GRAPHICS_SPRITE_CACHE_BUSY);
+
+    uint8_t *payload = malloc(pixel_data_length + sizeof(meta_data));
+    if (payload == NULL)
+    {
+        error();
+    }
+    memcpy(payload, meta_data, sizeof(meta_data));
+    memcpy(payload + sizeof(meta_data), pixel_data, pixel_data_length);
+    spi_write(FPGA,
+              0x15,
+              payload,
+              pixel_data_length + sizeof(meta_data));
+    free(payload);
+
+    sprite_cache[handle].used = true;
+    sprite_cache[handle].address = address;
+    sprite_cache[handle].length = pixel_data_length;
+
+    // Lua handles start from 1
+    return handle + 1;
+}
+
+static int check_sprite_cache_handle(lua_State *L, int index)
+{
+    lua_Integer handle = luaL_checkinteger(L, index);
+
+    if (handle < 1 ||
+        handle > SPRITE_CACHE_ENTRIES ||
+        !sprite_cache[handle - 1].used)
+    {
+        luaL_error(L, "invalid sprite cache handle");
+    }
+
+    return handle - 1;
+}
+
+static int lua_display_cache_bitmap(lua_State *L)
+{
+    size_t pixel_data_length;
+    const char *pixel_data = luaL_checklstring(L, 3, &pixel_data_length);
+
+    lua_pushinteger(L, cache_sprite(L,
+                                    luaL_checkinteger(L, 1),
+                                    luaL_checkinteger(L, 2),
+                                    (uint8_t *)pixel_data,
+                                    pixel_data_length));
+
+    return 1;
+}
+
+static int lua_display_cache_text(lua_State *L)
+{
+    size_t length;
+    const char *string = luaL_checklstring(L, 1, &length);
+
+    text_options_t options;
+    parse_text_options(L, 2, &options);
+
+    // Size the bitmap to fit the whole layout
+    lua_Integer box_width = options.width;
+    lua_Integer box_height = 0;
+
+    text_line_t line;
+
+    for (size_t start = 0;
+         layout_next_line(string, length, start, &options, &line);
+         start = line.next)
+    {
+        if (options.width == 0 && line.width > box_width)
+        {
+            box_width = line.width;
+        }
+
+        if (start > 0)
+        {
+            box_height += options.line_spacing;
+        }
+
+        box_height += line.height;
+    }
+
+    if (box_width < 1 || box_width > 640 || box_height < 1)
+    {
+        luaL_error(L, "text must be between 1 and 640 pixels wide");
     }
 
-    if (y_position < 1 || y_position > 400)
+    size_t bitmap_length = (box_width * box_height + 7) / 8;
+
+    if (bitmap_length > SPRITE_CACHE_SIZE)
     {
-        luaL_error(L, "y_position must be between 1 and 400 pixels");
+        luaL_error(L, "text is too large to cache");
     }
 
-    if (width < 1 || width > 640)
+    // Held on the Lua stack so it's collected if caching raises an error
+    uint8_t *bitmap = lua_newuserdatauv(L, bitmap_length, 0);
+    memset(bitmap, 0, bitmap_length);
+
+    // Copy each 2 color glyph into a single 2 color bitmap
+    lua_Integer line_y = 0;
+
+    for (size_t start = 0;
+         layout_next_line(string, length, start, &options, &line);
+         start = line.next)
     {
-        luaL_error(L, "width must be between 1 and 640 pixels");
+        lua_Integer glyph_x = aligned_line_offset(&options, box_width, &line);
+
+        for (size_t index = line.start; index < line.end;)
+        {
+            const sprite_metadata_t *glyph =
+                find_glyph(utf8_decode(string, &index));
+
+            if (glyph == NULL)
+            {
+                continue;
+            }
+
+            if (glyph->colors == SPRITE_2_COLORS)
+            {
+                const uint8_t *glyph_data = sprite_data + glyph->data_offset;
+
+                for (size_t y = 0; y < glyph->height; y++)
+                {
+                    for (size_t x = 0; x < glyph->width; x++)
+                    {
+                        size_t source_bit = y * glyph->width + x;
+
+                        if (!(glyph_data[source_bit / 8] &
+                              (0x80 >> (source_bit % 8))))
+                        {
+                            continue;
+                        }
+
+                        lua_Integer bitmap_x = glyph_x + x;
+
+                        if (bitmap_x < 0 || bitmap_x >= box_width)
+                        {
+                            continue;
+                        }
+
+                        size_t bit = (line_y + y) * box_width + bitmap_x;
+                        bitmap[bit / 8] |= 0x80 >> (bit % 8);
+                    }
+                }
+            }
+
+            glyph_x += glyph->width + options.character_spacing;
+        }
+
+        line_y += line.height + options.line_spacing;
     }
 
-    if (total_colors != 2 && total_colors != 4 && total_colors != 16)
+    lua_pushinteger(L, cache_sprite(L, box_width, 2, bitmap, bitmap_length));
+
+    return 1;
+}
+
+static int lua_display_draw_cached(lua_State *L)
+{
+    int handle = check_sprite_cache_handle(L, 1);
+    lua_Integer x_position = luaL_checkinteger(L, 2);
+    lua_Integer y_position = luaL_checkinteger(L, 3);
+    lua_Integer palette_offset = 0;
+
+    if (lua_istable(L, 4))
     {
-        luaL_error(L, "total_colors must be either 2, 4 or 16");
+        text_options_t options;
+        parse_text_options(L, 4, &options);
+        palette_offset = options.color_palette_offset;
+
+        if (lua_getfield(L, 4, "palette_offset") != LUA_TNIL)
+        {
+            palette_offset = luaL_checkinteger(L, -1);
+        }
+        lua_pop(L, 1);
+    }
+
+    if (x_position < 1 || x_position > 640)
+    {
+        luaL_error(L, "x_position must be between 1 and 640 pixels");
+    }
+
+    if (y_position < 1 || y_position > 400)
+    {
+        luaL_error(L, "y_position must be between 1 and 400 pixels");
     }
 
     if (palette_offset < 0 || palette_offset > 15)
@@ -240,140 +997,451 @@ static void draw_sprite(lua_State *L,
     x_position--;
     y_position--;
 
-    uint8_t meta_data[8] = {(uint32_t)x_position >> 8,
-                            (uint32_t)x_position,
-                            (uint32_t)y_position >> 8,
-                            (uint32_t)y_position,
-                            (uint32_t)width >> 8,
-                            (uint32_t)width,
-                            (uint8_t)total_colors,
-                            (uint8_t)palette_offset};
+    uint8_t command[6] = {(uint32_t)x_position >> 8,
+                          (uint32_t)x_position,
+                          (uint32_t)y_position >> 8,
+                          (uint32_t)y_position,
+                          (uint8_t)handle,
+                          (uint8_t)palette_offset};
 
-    uint8_t *payload = malloc(pixel_data_length + sizeof(meta_data));
-    if (payload == NULL)
-    {
-        error();
-    }
-    memcpy(payload, meta_data, sizeof(meta_data));
-    memcpy(payload + sizeof(meta_data), pixel_data, pixel_data_length);
-    spi_write(FPGA,
-              0x12,
-              payload,
-              pixel_data_length + sizeof(meta_data));
-    free(payload);
+    wait_for_graphics(L, GRAPHICS_SPRITE_CACHE_BUSY);
+    spi_write(FPGA, 0x16, command, sizeof(command));
+    graphics_busy |= GRAPHICS_SPRITE_CACHE_BUSY;
+
+    return 0;
 }
 
-static int lua_display_bitmap(lua_State *L)
+static int lua_display_free_cached(lua_State *L)
 {
-    size_t pixel_data_length;
-    const char *pixel_data = luaL_checklstring(L, 6, &pixel_data_length);
+    int handle = check_sprite_cache_handle(L, 1);
 
-    draw_sprite(L,
-                luaL_checkinteger(L, 1),
-                luaL_checkinteger(L, 2),
-                luaL_checkinteger(L, 3),
-                luaL_checkinteger(L, 4),
-                luaL_checkinteger(L, 5),
-                (uint8_t *)pixel_data,
-                pixel_data_length);
+    wait_for_graphics(L, GRAPHICS_SPRITE_CACHE_BUSY);
+    sprite_cache[handle].used = false;
 
     return 0;
 }
 
-static int lua_display_text(lua_State *L)
+typedef enum vector_shape_t
 {
-    const char *string = luaL_checkstring(L, 1);
-    lua_Integer x_position = luaL_checkinteger(L, 2);
-    lua_Integer y_position = luaL_checkinteger(L, 3);
-    lua_Integer color_palette_offset = 0;
-    lua_Integer character_spacing = 4;
-    // TODO justification options
+    VECTOR_LINE = 0,
+    VECTOR_FILLED_RECTANGLE = 1,
+} vector_shape_t;
+
+static void draw_vector(lua_State *L,
+                        vector_shape_t shape,
+                        lua_Integer x_start,
+                        lua_Integer y_start,
+                        lua_Integer x_end,
+                        lua_Integer y_end,
+                        lua_Integer color)
+{
+    // Remove Lua 1 based offset before sending
+    x_start--;
+    y_start--;
+    x_end--;
+    y_end--;
+
+    uint8_t command[10] = {(uint8_t)shape,
+                           (uint32_t)x_start >> 8,
+                           (uint32_t)x_start,
+                           (uint32_t)y_start >> 8,
+                           (uint32_t)y_start,
+                           (uint32_t)x_end >> 8,
+                           (uint32_t)x_end,
+                           (uint32_t)y_end >> 8,
+                           (uint32_t)y_end,
+                           (uint8_t)color};
+
+    wait_for_graphics(L, GRAPHICS_VECTOR_ENGINE_BUSY);
+    spi_write(FPGA, 0x13, command, sizeof(command));
+    graphics_busy |= GRAPHICS_VECTOR_ENGINE_BUSY;
+}
 
-    if (lua_istable(L, 4))
+static lua_Integer check_vector_coordinate(lua_State *L,
+                                           int index,
+                                           lua_Integer max)
+{
+    lua_Integer value = luaL_checkinteger(L, index);
+
+    if (value < 1 || value > max)
+    {
+        luaL_error(L, "coordinates must be within the 640x400 display");
+    }
+
+    return value;
+}
+
+static lua_Integer parse_vector_color(lua_State *L, int index, bool *fill)
+{
+    lua_Integer color = 1;
+    *fill = false;
+
+    if (!lua_istable(L, index))
     {
-        if (lua_getfield(L, 4, "color") != LUA_TNIL)
+        return color;
+    }
+
+    if (lua_getfield(L, index, "color") != LUA_TNIL)
+    {
+        for (size_t i = 0; i <= 16; i++)
         {
-            for (size_t i = 1; i <= 16; i++)
+            if (i == 16)
             {
-                if (i == 16)
-                {
-                    luaL_error(L, "Invalid color name");
-                }
-
-                if (strcmp(luaL_checkstring(L, -1), colors[i].name) == 0)
-                {
-                    color_palette_offset = i - 1;
-                    break;
-                }
+                luaL_error(L, "Invalid color name");
             }
 
-            lua_pop(L, 1);
+            if (strcmp(luaL_checkstring(L, -1), colors[i].name) == 0)
+            {
+                color = i;
+                break;
+            }
         }
+    }
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, index, "fill") != LUA_TNIL)
+    {
+        *fill = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1);
 
-        if (lua_getfield(L, 4, "spacing") != LUA_TNIL)
+    return color;
+}
+
+static int lua_display_line(lua_State *L)
+{
+    lua_Integer x_start = check_vector_coordinate(L, 1, 640);
+    lua_Integer y_start = check_vector_coordinate(L, 2, 400);
+    lua_Integer x_end = check_vector_coordinate(L, 3, 640);
+    lua_Integer y_end = check_vector_coordinate(L, 4, 400);
+
+    bool fill;
+    lua_Integer color = parse_vector_color(L, 5, &fill);
+
+    draw_vector(L, VECTOR_LINE, x_start, y_start, x_end, y_end, color);
+
+    return 0;
+}
+
+static int lua_display_rect(lua_State *L)
+{
+    lua_Integer x_position = check_vector_coordinate(L, 1, 640);
+    lua_Integer y_position = check_vector_coordinate(L, 2, 400);
+    lua_Integer width = luaL_checkinteger(L, 3);
+    lua_Integer height = luaL_checkinteger(L, 4);
+
+    if (width < 1 || x_position + width - 1 > 640)
+    {
+        luaL_error(L, "width must be between 1 and %d pixels",
+                   641 - x_position);
+    }
+
+    if (height < 1 || y_position + height - 1 > 400)
+    {
+        luaL_error(L, "height must be between 1 and %d pixels",
+                   401 - y_position);
+    }
+
+    bool fill;
+    lua_Integer color = parse_vector_color(L, 5, &fill);
+
+    lua_Integer right = x_position + width - 1;
+    lua_Integer bottom = y_position + height - 1;
+
+    if (fill)
+    {
+        draw_vector(L, VECTOR_FILLED_RECTANGLE,
+                    x_position, y_position, right, bottom, color);
+        return 0;
+    }
+
+    // Outlines are drawn as four one pixel wide filled rectangles
+    draw_vector(L, VECTOR_FILLED_RECTANGLE,
+                x_position, y_position, right, y_position, color);
+    draw_vector(L, VECTOR_FILLED_RECTANGLE,
+                x_position, bottom, right, bottom, color);
+    draw_vector(L, VECTOR_FILLED_RECTANGLE,
+                x_position, y_position, x_position, bottom, color);
+    draw_vector(L, VECTOR_FILLED_RECTANGLE,
+                right, y_position, right, bottom, color);
+
+    return 0;
+}
+
+static int lua_display_polygon(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+
+    lua_Integer total_points = luaL_len(L, 1) / 2;
+
+    if (total_points < 2 || luaL_len(L, 1) % 2 != 0)
+    {
+        luaL_error(L, "points must be a list of at least two x, y pairs");
+    }
+
+    bool fill;
+    lua_Integer color = parse_vector_color(L, 2, &fill);
+
+    // Userdata is garbage collected even if a coordinate check fails
+    int16_t *points = lua_newuserdatauv(L,
+                                        total_points * 2 * sizeof(int16_t),
+                                        0);
+    int16_t *crossings = lua_newuserdatauv(L,
+                                           total_points * sizeof(int16_t),
+                                           0);
+
+    lua_Integer top = 400;
+    lua_Integer bottom = 1;
+
+    for (lua_Integer i = 0; i < total_points * 2; i++)
+    {
+        lua_geti(L, 1, i + 1);
+        points[i] = check_vector_coordinate(L, -1, i % 2 ? 400 : 640);
+        lua_pop(L, 1);
+
+        if (i % 2)
         {
-            character_spacing = luaL_checkinteger(L, -1);
-            lua_pop(L, 1);
+            top = points[i] < top ? points[i] : top;
+            bottom = points[i] > bottom ? points[i] : bottom;
         }
     }
 
-    for (size_t index = 0; index < strlen(string);)
+    if (!fill)
     {
-        uint32_t codepoint = utf8_decode(string, &index);
+        for (lua_Integer i = 0; i < total_points; i++)
+        {
+            lua_Integer next = (i + 1) % total_points;
+
+            draw_vector(L, VECTOR_LINE,
+                        points[i * 2],
+                        points[i * 2 + 1],
+                        points[next * 2],
+                        points[next * 2 + 1],
+                        color);
+        }
+    }
 
-        if (codepoint != 0)
+    else
+    {
+        // Fill each row between pairs of edge crossings
+        for (lua_Integer y = top; y <= bottom; y++)
         {
-            // Search for the codepoint in the font table
-            for (size_t entry = 0;
-                 entry < sizeof(sprite_metadata) / sizeof(sprite_metadata_t);
-                 entry++)
-            {
-                if (codepoint == sprite_metadata[entry].utf8_codepoint)
-                {
-                    // Check if the glyph can fit on the screen
-                    if (x_position + sprite_metadata[entry].width <= 640 &&
-                        y_position + sprite_metadata[entry].height <= 400)
-                    {
-                        size_t data_offset = sprite_metadata[entry].data_offset;
+            size_t total_crossings = 0;
 
-                        size_t data_length = sprite_metadata[entry].width *
-                                             sprite_metadata[entry].height;
+            for (lua_Integer i = 0; i < total_points; i++)
+            {
+                lua_Integer next = (i + 1) % total_points;
+                lua_Integer x0 = points[i * 2];
+                lua_Integer y0 = points[i * 2 + 1];
+                lua_Integer x1 = points[next * 2];
+                lua_Integer y1 = points[next * 2 + 1];
 
-                        switch (sprite_metadata[entry].colors)
-                        {
-                        case SPRITE_16_COLORS:
-                            break;
-                        case SPRITE_4_COLORS:
-                            data_length = (size_t)ceil(data_length / 2.0);
-                            break;
-                        case SPRITE_2_COLORS:
-                            data_length = (size_t)ceil(data_length / 8.0);
-                            break;
-                        }
+                if ((y0 <= y && y1 > y) || (y1 <= y && y0 > y))
+                {
+                    int16_t x = x0 + (y - y0) * (x1 - x0) / (y1 - y0);
 
-                        draw_sprite(L,
-                                    x_position,
-                                    y_position,
-                                    sprite_metadata[entry].width,
-                                    sprite_metadata[entry].colors,
-                                    color_palette_offset,
-                                    sprite_data + data_offset,
-                                    data_length);
-
-                        x_position += sprite_metadata[entry].width;
-                        x_position += character_spacing;
+                    // Insertion sort, as there are only a few crossings
+                    size_t j = total_crossings++;
+                    for (; j > 0 && crossings[j - 1] > x; j--)
+                    {
+                        crossings[j] = crossings[j - 1];
                     }
+                    crossings[j] = x;
                 }
             }
+
+            for (size_t i = 0; i + 1 < total_crossings; i += 2)
+            {
+                draw_vector(L, VECTOR_FILLED_RECTANGLE,
+                            crossings[i], y, crossings[i + 1], y, color);
+            }
         }
     }
 
     return 0;
 }
 
+typedef enum clear_mode_t
+{
+    CLEAR_WHOLE_BUFFER = 0,
+    CLEAR_REGION = 1,
+    CLEAR_NOTHING = 2,
+} clear_mode_t;
+
+typedef struct display_region_t
+{
+    bool dirty;
+    lua_Integer left;
+    lua_Integer top;
+    lua_Integer right;
+    lua_Integer bottom;
+} display_region_t;
+
+static struct retained_mode_t
+{
+    bool enabled;
+    bool first_frame;
+
+    // Regions marked while drawing this frame and the one before it. Each
+    // frame was drawn into a different buffer
+    display_region_t marked;
+    display_region_t previous;
+} retained_mode = {0};
+
+static struct clear_settings_t
+{
+    clear_mode_t mode;
+    uint8_t region[8];
+} clear_settings = {.mode = CLEAR_WHOLE_BUFFER};
+
+static void grow_region(display_region_t *region,
+                        lua_Integer left,
+                        lua_Integer top,
+                        lua_Integer right,
+                        lua_Integer bottom)
+{
+    if (!region->dirty)
+    {
+        region->left = left;
+        region->top = top;
+        region->right = right;
+        region->bottom = bottom;
+        region->dirty = true;
+        return;
+    }
+
+    region->left = left < region->left ? left : region->left;
+    region->top = top < region->top ? top : region->top;
+    region->right = right > region->right ? right : region->right;
+    region->bottom = bottom > region->bottom ? bottom : region->bottom;
+}
+
+static void set_clear_settings(lua_State *L,
+                               clear_mode_t mode,
+                               const display_region_t *clear)
+{
+    uint8_t region[8] = {0};
+
+    if (mode == CLEAR_REGION)
+    {
+        // Remove Lua 1 based offset before sending
+        region[0] = (uint32_t)(clear->left - 1) >> 8;
+        region[1] = (uint32_t)(clear->left - 1);
+        region[2] = (uint32_t)(clear->top - 1) >> 8;
+        region[3] = (uint32_t)(clear->top - 1);
+        region[4] = (uint32_t)(clear->right - 1) >> 8;
+        region[5] = (uint32_t)(clear->right - 1);
+        region[6] = (uint32_t)(clear->bottom - 1) >> 8;
+        region[7] = (uint32_t)(clear->bottom - 1);
+    }
+
+    if (mode == clear_settings.mode &&
+        memcmp(region, clear_settings.region, sizeof(region)) == 0)
+    {
+        return;
+    }
+
+    // The settings are taken when the buffers switch, so let any pending
+    // switch complete before changing them
+    wait_for_graphics(L, GRAPHICS_BUFFER_SWITCH_PENDING);
+
+    if (mode == CLEAR_REGION)
+    {
+        spi_write(FPGA, 0x17, region, sizeof(region));
+    }
+
+    uint8_t mode_value = (uint8_t)mode;
+    spi_write(FPGA, 0x19, &mode_value, 1);
+
+    clear_settings.mode = mode;
+    memcpy(clear_settings.region, region, sizeof(region));
+}
+
 static int lua_display_show(lua_State *L)
 {
+    wait_for_graphics(L,
+                      GRAPHICS_SPRITE_CACHE_BUSY |
+                      GRAPHICS_VECTOR_ENGINE_BUSY);
+
+    // The buffer which comes back after the first switch must still be
+    // cleared entirely, as it holds whatever was drawn before retaining
+    if (!retained_mode.enabled || retained_mode.first_frame)
+    {
+        set_clear_settings(L, CLEAR_WHOLE_BUFFER, NULL);
+        retained_mode.first_frame = false;
+    }
+
+    else
+    {
+        // The buffer which comes back was last drawn two frames ago, so
+        // whatever either frame changed must be cleared for it to be redrawn
+        display_region_t clear = retained_mode.marked;
+
+        if (retained_mode.previous.dirty)
+        {
+            grow_region(&clear,
+                        retained_mode.previous.left,
+                        retained_mode.previous.top,
+                        retained_mode.previous.right,
+                        retained_mode.previous.bottom);
+        }
+
+        set_clear_settings(L,
+                           clear.dirty ? CLEAR_REGION : CLEAR_NOTHING,
+                           &clear);
+    }
+
+    retained_mode.previous = retained_mode.marked;
+    retained_mode.marked.dirty = false;
+
     spi_write(FPGA, 0x14, NULL, 0);
+    graphics_busy |= GRAPHICS_BUFFER_SWITCH_PENDING;
+
+    return 0;
+}
+
+static int lua_display_retain(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TBOOLEAN);
+
+    retained_mode.enabled = lua_toboolean(L, 1);
+    retained_mode.first_frame = true;
+    retained_mode.marked.dirty = false;
+    retained_mode.previous.dirty = false;
+
+    return 0;
+}
+
+static int lua_display_mark_dirty(lua_State *L)
+{
+    if (!retained_mode.enabled)
+    {
+        luaL_error(L, "retained mode must be enabled first");
+    }
+
+    lua_Integer x_position = check_vector_coordinate(L, 1, 640);
+    lua_Integer y_position = check_vector_coordinate(L, 2, 400);
+    lua_Integer width = luaL_checkinteger(L, 3);
+    lua_Integer height = luaL_checkinteger(L, 4);
+
+    if (width < 1 || x_position + width - 1 > 640)
+    {
+        luaL_error(L, "width must be between 1 and %d pixels",
+                   641 - x_position);
+    }
+
+    if (height < 1 || y_position + height - 1 > 400)
+    {
+        luaL_error(L, "height must be between 1 and %d pixels",
+                   401 - y_position);
+    }
+
+    lua_Integer right = x_position + width - 1;
+    lua_Integer bottom = y_position + height - 1;
+
+    // Only a single region can be cleared, so it grows to cover them all
+    grow_region(&retained_mode.marked, x_position, y_position, right, bottom);
+
     return 0;
 }
 
@@ -460,9 +1528,39 @@ void lua_open_display_library(lua_State *L)
     lua_pushcfunction(L, lua_display_text);
     lua_setfield(L, -2, "text");
 
+    lua_pushcfunction(L, lua_display_measure_text);
+    lua_setfield(L, -2, "measure_text");
+
+    lua_pushcfunction(L, lua_display_line);
+    lua_setfield(L, -2, "line");
+
+    lua_pushcfunction(L, lua_display_rect);
+    lua_setfield(L, -2, "rect");
+
+    lua_pushcfunction(L, lua_display_polygon);
+    lua_setfield(L, -2, "polygon");
+
+    lua_pushcfunction(L, lua_display_cache_bitmap);
+    lua_setfield(L, -2, "cache_bitmap");
+
+    lua_pushcfunction(L, lua_display_cache_text);
+    lua_setfield(L, -2, "cache_text");
+
+    lua_pushcfunction(L, lua_display_draw_cached);
+    lua_setfield(L, -2, "draw_cached");
+
+    lua_pushcfunction(L, lua_display_free_cached);
+    lua_setfield(L, -2, "free_cached");
+
     lua_pushcfunction(L, lua_display_show);
     lua_setfield(L, -2, "show");
 
+    lua_pushcfunction(L, lua_display_retain);
+    lua_setfield(L, -2, "retain");
+
+    lua_pushcfunction(L, lua_display_mark_dirty);
+    lua_setfield(L, -2, "mark_dirty");
+
     lua_pushcfunction(L, lua_display_power_save);
     lua_setfield(L, -2, "power_save");
 
@@ -25,11 +25,52 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "lua.h"
 
 extern lua_State *L_global;
 
 void lua_bluetooth_data_interrupt(uint8_t *data, size_t length);
+void lua_microphone_stream_interrupt(void);
+
+// Returns false if the data isn't a call to a registered function
+bool lua_rpc_interrupt(const uint8_t *data, size_t length);
+void lua_rpc_stream_interrupt(const uint8_t *data, size_t length);
+void lua_rpc_disconnect_interrupt(void);
+void lua_rpc_resume_pending(void);
+void lua_imu_resume_pending(void);
+
+// Each alarm uses one of the RTC's compare channels
+typedef enum time_alarm_t
+{
+    TIME_ALARM_SLEEP,
+    TIME_ALARM_CAMERA_AUTO_LOOP,
+    TIME_ALARM_CAMERA_VIDEO,
+    TIME_ALARM_COUNT,
+} time_alarm_t;
+
+uint64_t time_monotonic_us(void);
+uint64_t time_utc_us(void);
+uint64_t time_utc_ms(void);
+
+// Calls the handler from the RTC interrupt once the monotonic time is reached.
+// Setting an alarm again replaces it
+void time_set_alarm(time_alarm_t alarm,
+                    uint64_t monotonic_us,
+                    void (*handler)(void));
+void time_cancel_alarm(time_alarm_t alarm);
+
+// Runs any callback or break signal that an interrupt has left waiting
+void lua_system_run_pending(lua_State *L);
+
+// Only one hook can be pending, so callbacks which arrive while another is
+// waiting are held back. Each callback sets their hook again once it's run
+void lua_system_resume_pending(void);
+
+// Sleeps until an interrupt or the deadline, or only an interrupt if the
+// deadline is 0. Any callback or break signal that arrives is run, so this
+// must be called from within Lua
+void lua_system_wait(lua_State *L, uint64_t deadline_us);
 
 void lua_open_bluetooth_library(lua_State *L);
 void lua_open_camera_library(lua_State *L);
@@ -38,7 +79,9 @@ void lua_open_display_library(lua_State *L);
 void lua_open_imu_library(lua_State *L);
 void lua_open_led_library(lua_State *L);
 void lua_open_microphone_library(lua_State *L);
+void lua_open_rpc_library(lua_State *L);
 void lua_open_system_library(lua_State *L);
+void lua_open_task_library(lua_State *L);
 void lua_open_time_library(lua_State *L);
 void lua_open_version_library(lua_State *L);
 
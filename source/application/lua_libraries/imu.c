@@ -22,10 +22,10 @@
  * PERFORMANCE OF THIS SOFTWARE.
  */
 
-#include <math.h>
 #include "error_logging.h"
 #include "frame_lua_libraries.h"
 #include "i2c.h"
+#include "imu_fusion.h"
 #include "lauxlib.h"
 #include "lua.h"
 #include "main.h"
@@ -34,8 +34,6 @@
 #include "pinout.h"
 #include "watchdog.h"
 
-#define PI 3.14159265
-
 typedef struct imu_values_y
 {
     struct accelerometer_t
@@ -52,6 +50,43 @@ typedef struct imu_values_y
     } magnetometer;
 } imu_values_t;
 
+typedef struct imu_sample_t
+{
+    uint64_t timestamp_us;
+    imu_values_t values;
+} imu_sample_t;
+
+#define SAMPLE_BUFFER_LENGTH 256
+#define SAMPLE_RATE 256
+
+// Accelerometer status register flags
+#define STATUS_TAP_FLAGS 0x3F
+#define STATUS_SAMPLE_ACQUIRED 0x80
+
+static struct sampling
+{
+    volatile bool enabled;
+    bool compass;
+    uint16_t decimation;
+    uint16_t interrupt_count;
+
+    // Set when an interrupt arrives while the bus is busy
+    volatile bool pending;
+    volatile uint64_t pending_timestamp_us;
+    volatile uint64_t pending_monotonic_us;
+
+    imu_values_t latest;
+    imu_fusion_t fusion;
+
+    // Written from the interrupt at head, and read by Lua from tail
+    volatile uint16_t head;
+    volatile uint16_t tail;
+    volatile uint32_t dropped;
+    imu_sample_t buffer[SAMPLE_BUFFER_LENGTH];
+} sampling = {
+    .enabled = false,
+};
+
 static int lua_imu_callback_function = 0;
 
 static void lua_imu_tap_callback_handler(lua_State *L, lua_Debug *ar)
@@ -70,11 +105,11 @@ static void lua_imu_tap_callback_handler(lua_State *L, lua_Debug *ar)
             luaL_error(L, "%s", lua_tostring(L, -1));
         }
     }
+
+    lua_system_resume_pending();
 }
 
-void imu_tap_interrupt_handler(nrfx_gpiote_pin_t unused_gptiote_pin,
-                               nrfx_gpiote_trigger_t unused_gptiote_trigger,
-                               void *unused_gptiote_context_pointer)
+static void set_tap_hook(void)
 {
     lua_sethook(L_global,
                 lua_imu_tap_callback_handler,
@@ -82,6 +117,199 @@ void imu_tap_interrupt_handler(nrfx_gpiote_pin_t unused_gptiote_pin,
                 1);
 }
 
+static bool read_accelerometer(imu_values_t *values)
+{
+    uint8_t accel[6];
+
+    if (i2c_read_burst(ACCELEROMETER, 0x0D, accel, sizeof(accel)).fail)
+    {
+        return false;
+    }
+
+    // Combine bytes and swap the axis to match the worn orientation
+    values->accelerometer.x = (int16_t)(accel[3] << 8 | accel[2]);
+    values->accelerometer.y = (int16_t)(accel[5] << 8 | accel[4]);
+    values->accelerometer.z = (int16_t)(accel[1] << 8 | accel[0]);
+
+    return true;
+}
+
+static bool read_magnetometer(imu_values_t *values)
+{
+    // Read magnetometer (14 bit signed integers) as a single burst
+    uint8_t mag[6];
+
+    if (i2c_read_burst(MAGNETOMETER, 0x10, mag, sizeof(mag)).fail)
+    {
+        return false;
+    }
+
+    // Combine bytes and swap the axis to match the worn orientation
+    values->magnetometer.x = (int16_t)(mag[3] << 8 | mag[2]);
+    values->magnetometer.y = (int16_t)(mag[5] << 8 | mag[4]);
+    values->magnetometer.z = (int16_t)(mag[1] << 8 | mag[0]);
+
+    return true;
+}
+
+static void update_fusion(imu_fusion_t *fusion,
+                          const imu_values_t *values,
+                          float interval)
+{
+    float accelerometer[3] = {values->accelerometer.x,
+                              values->accelerometer.y,
+                              values->accelerometer.z};
+
+    float magnetometer[3] = {values->magnetometer.x,
+                             values->magnetometer.y,
+                             values->magnetometer.z};
+
+    imu_fusion_update(fusion, accelerometer, magnetometer, interval);
+}
+
+static void take_sample(uint64_t timestamp_us)
+{
+    // Reading the status also clears the interrupt
+    i2c_response_t status = i2c_read(ACCELEROMETER, 0x03, 0xFF);
+
+    if (status.fail)
+    {
+        sampling.dropped++;
+        return;
+    }
+
+    if (status.value & STATUS_TAP_FLAGS)
+    {
+        set_tap_hook();
+    }
+
+    if (!(status.value & STATUS_SAMPLE_ACQUIRED))
+    {
+        return;
+    }
+
+    // The accelerometer always runs at one rate, so lower rates skip samples
+    if (++sampling.interrupt_count < sampling.decimation)
+    {
+        return;
+    }
+
+    sampling.interrupt_count = 0;
+
+    if (!read_accelerometer(&sampling.latest))
+    {
+        sampling.dropped++;
+        return;
+    }
+
+    // Use the last forced conversion, and start the next one
+    if (sampling.compass && i2c_read(MAGNETOMETER, 0x18, 0x40).value)
+    {
+        if (read_magnetometer(&sampling.latest))
+        {
+            i2c_write(MAGNETOMETER, 0x1D, 0x40, 0x40);
+        }
+    }
+
+    if (sampling.compass)
+    {
+        update_fusion(&sampling.fusion,
+                      &sampling.latest,
+                      (float)sampling.decimation / SAMPLE_RATE);
+    }
+
+    uint16_t next_head = (sampling.head + 1) % SAMPLE_BUFFER_LENGTH;
+
+    if (next_head == sampling.tail)
+    {
+        sampling.dropped++;
+        return;
+    }
+
+    sampling.buffer[sampling.head].timestamp_us = timestamp_us;
+    sampling.buffer[sampling.head].values = sampling.latest;
+    sampling.head = next_head;
+}
+
+static void take_pending_sample(void)
+{
+    // Stops the interrupt from sampling in between these transfers
+    NRFX_IRQ_DISABLE(GPIOTE_IRQn);
+
+    if (sampling.enabled && sampling.pending)
+    {
+        // The interrupt stays high until the sample is read, so any samples
+        // the accelerometer took since then are lost
+        uint64_t late_us = time_monotonic_us() - sampling.pending_monotonic_us;
+        sampling.dropped += (uint32_t)(late_us * SAMPLE_RATE / 1000000 /
+                                       sampling.decimation);
+
+        sampling.pending = false;
+        take_sample(sampling.pending_timestamp_us);
+    }
+
+    NRFX_IRQ_ENABLE(GPIOTE_IRQn);
+}
+
+static void lua_imu_sample_handler(lua_State *L, lua_Debug *ar)
+{
+    sethook_watchdog(L);
+
+    take_pending_sample();
+
+    lua_system_resume_pending();
+}
+
+static void set_sample_hook(void)
+{
+    // Leave any break signal or other callback to run first
+    if (lua_gethook(L_global) != reload_watchdog)
+    {
+        return;
+    }
+
+    lua_sethook(L_global,
+                lua_imu_sample_handler,
+                LUA_MASKCALL | LUA_MASKRET | LUA_MASKLINE | LUA_MASKCOUNT,
+                1);
+}
+
+void lua_imu_resume_pending(void)
+{
+    // No more interrupts arrive while a sample is pending, so it's set again
+    // once the other callbacks have run
+    if (sampling.enabled && sampling.pending)
+    {
+        set_sample_hook();
+    }
+}
+
+void imu_interrupt_handler(nrfx_gpiote_pin_t unused_gptiote_pin,
+                           nrfx_gpiote_trigger_t unused_gptiote_trigger,
+                           void *unused_gptiote_context_pointer)
+{
+    if (!sampling.enabled)
+    {
+        set_tap_hook();
+        return;
+    }
+
+    uint64_t timestamp_us = time_utc_us();
+
+    if (!i2c_busy())
+    {
+        take_sample(timestamp_us);
+        return;
+    }
+
+    // Otherwise sample once Lua next runs, or on the next read
+    sampling.pending_timestamp_us = timestamp_us;
+    sampling.pending_monotonic_us = time_monotonic_us();
+    sampling.pending = true;
+
+    set_sample_hook();
+}
+
 static int lua_imu_tap_callback(lua_State *L)
 {
     if (lua_isnil(L, 1))
@@ -105,6 +333,19 @@ static imu_values_t get_imu_data(void)
 {
     imu_values_t values;
 
+    // While sampling, the latest values are already known
+    if (sampling.enabled)
+    {
+        take_pending_sample();
+
+        values = sampling.latest;
+
+        if (sampling.compass)
+        {
+            return values;
+        }
+    }
+
     // Set PC to wake up magnetometer, and set FORCE to start a conversion
     check_error(i2c_write(MAGNETOMETER, 0x1B, 0x80, 0x80).fail);
     check_error(i2c_write(MAGNETOMETER, 0x1D, 0x40, 0x40).fail);
@@ -125,101 +366,271 @@ static imu_values_t get_imu_data(void)
         nrfx_systick_delay_ms(1);
     }
 
-    // Read magnetometer (14 bit signed integers)
-    int16_t x_mag_lsb = i2c_read(MAGNETOMETER, 0x10, 0xFF).value;
-    int16_t x_mag_msb = i2c_read(MAGNETOMETER, 0x11, 0xFF).value;
-    int16_t y_mag_lsb = i2c_read(MAGNETOMETER, 0x12, 0xFF).value;
-    int16_t y_mag_msb = i2c_read(MAGNETOMETER, 0x13, 0xFF).value;
-    int16_t z_mag_lsb = i2c_read(MAGNETOMETER, 0x14, 0xFF).value;
-    int16_t z_mag_msb = i2c_read(MAGNETOMETER, 0x15, 0xFF).value;
-
-    // Combine bytes and swap the axis to match the worn orientation
-    values.magnetometer.x = y_mag_msb << 8 | y_mag_lsb;
-    values.magnetometer.y = z_mag_msb << 8 | z_mag_lsb;
-    values.magnetometer.z = x_mag_msb << 8 | x_mag_lsb;
+    check_error(!read_magnetometer(&values));
 
     // Clear PC to put magnetometer back to sleep
     check_error(i2c_write(MAGNETOMETER, 0x1B, 0x80, 0x00).fail);
 
-    // Accelerometer data is always available, so just read it
-    int16_t x_accel_lsb = i2c_read(ACCELEROMETER, 0x0D, 0xFF).value;
-    int16_t x_accel_msb = i2c_read(ACCELEROMETER, 0x0E, 0xFF).value;
-    int16_t y_accel_lsb = i2c_read(ACCELEROMETER, 0x0F, 0xFF).value;
-    int16_t y_accel_msb = i2c_read(ACCELEROMETER, 0x10, 0xFF).value;
-    int16_t z_accel_lsb = i2c_read(ACCELEROMETER, 0x11, 0xFF).value;
-    int16_t z_accel_msb = i2c_read(ACCELEROMETER, 0x12, 0xFF).value;
+    if (sampling.enabled)
+    {
+        return values;
+    }
 
-    // Combine bytes and swap the axis to match the worn orientation
-    values.accelerometer.x = y_accel_msb << 8 | y_accel_lsb;
-    values.accelerometer.y = z_accel_msb << 8 | z_accel_lsb;
-    values.accelerometer.z = x_accel_msb << 8 | x_accel_lsb;
+    // Accelerometer data is always available, so just read it
+    check_error(!read_accelerometer(&values));
 
     return values;
 }
 
 static int lua_imu_direction(lua_State *L)
 {
-    imu_values_t values = get_imu_data();
+    imu_fusion_orientation_t orientation;
 
-    double roll = atan2((double)values.accelerometer.x,
-                        (double)values.accelerometer.z);
+    // While sampling with the compass, the filtered orientation is ready
+    if (sampling.enabled && sampling.compass)
+    {
+        take_pending_sample();
 
-    double pitch = atan2((double)values.accelerometer.y,
-                         (double)values.accelerometer.z);
+        NRFX_IRQ_DISABLE(GPIOTE_IRQn);
+        orientation = imu_fusion_orientation(&sampling.fusion);
+        NRFX_IRQ_ENABLE(GPIOTE_IRQn);
+    }
 
-    double heading = 0.0; // TODO
+    // Otherwise use a single unfiltered sample
+    else
+    {
+        imu_values_t values = get_imu_data();
+
+        imu_fusion_t fusion;
+        imu_fusion_reset(&fusion, 0.0f);
+        update_fusion(&fusion, &values, 0.0f);
+
+        orientation = imu_fusion_orientation(&fusion);
+    }
 
     lua_newtable(L);
 
-    lua_pushnumber(L, pitch * (180.0 / PI));
+    lua_pushnumber(L, orientation.pitch);
     lua_setfield(L, -2, "pitch");
 
-    lua_pushnumber(L, roll * (180.0 / PI));
+    lua_pushnumber(L, orientation.roll);
     lua_setfield(L, -2, "roll");
 
-    lua_pushnumber(L, heading);
+    lua_pushnumber(L, orientation.heading);
     lua_setfield(L, -2, "heading");
 
     return 1;
 }
 
-static int lua_imu_raw(lua_State *L)
+static void push_imu_values(lua_State *L, const imu_values_t *values)
 {
-    imu_values_t values = get_imu_data();
-
     lua_newtable(L);
 
     lua_newtable(L);
 
-    lua_pushnumber(L, values.magnetometer.x);
+    lua_pushnumber(L, values->magnetometer.x);
     lua_setfield(L, -2, "x");
 
-    lua_pushnumber(L, values.magnetometer.y);
+    lua_pushnumber(L, values->magnetometer.y);
     lua_setfield(L, -2, "y");
 
-    lua_pushnumber(L, values.magnetometer.z);
+    lua_pushnumber(L, values->magnetometer.z);
     lua_setfield(L, -2, "z");
 
     lua_setfield(L, -2, "compass");
 
     lua_newtable(L);
 
-    lua_pushnumber(L, values.accelerometer.x);
+    lua_pushnumber(L, values->accelerometer.x);
     lua_setfield(L, -2, "x");
 
-    lua_pushnumber(L, values.accelerometer.y);
+    lua_pushnumber(L, values->accelerometer.y);
     lua_setfield(L, -2, "y");
 
-    lua_pushnumber(L, values.accelerometer.z);
+    lua_pushnumber(L, values->accelerometer.z);
     lua_setfield(L, -2, "z");
 
     lua_setfield(L, -2, "accelerometer");
+}
+
+static int lua_imu_raw(lua_State *L)
+{
+    imu_values_t values = get_imu_data();
+
+    push_imu_values(L, &values);
 
     return 1;
 }
 
+static void set_sample_interrupt(bool enable)
+{
+    // Accelerometer must be in standby while changing settings
+    check_error(i2c_write(ACCELEROMETER, 0x07, 0xFF, 0xC0).fail);
+
+    // Tap interrupt on -Y axis, and optionally on each new sample
+    check_error(i2c_write(ACCELEROMETER, 0x06, 0xFF, enable ? 0x88 : 0x08).fail);
+
+    check_error(i2c_write(ACCELEROMETER, 0x07, 0xFF, 0xC1).fail);
+
+    // Clear any interrupt already latched, so the next one raises the pin
+    check_error(i2c_read(ACCELEROMETER, 0x03, 0xFF).fail);
+}
+
+static int lua_imu_start(lua_State *L)
+{
+    if (sampling.enabled)
+    {
+        luaL_error(L, "already started");
+    }
+
+    lua_Integer rate = 64;
+    bool compass = true;
+    lua_Number smoothing = 0.2;
+
+    if (lua_istable(L, 1))
+    {
+        if (lua_getfield(L, 1, "rate") != LUA_TNIL)
+        {
+            rate = luaL_checkinteger(L, -1);
+        }
+        lua_pop(L, 1);
+
+        if (lua_getfield(L, 1, "compass") != LUA_TNIL)
+        {
+            luaL_checktype(L, -1, LUA_TBOOLEAN);
+            compass = lua_toboolean(L, -1);
+        }
+        lua_pop(L, 1);
+
+        if (lua_getfield(L, 1, "smoothing") != LUA_TNIL)
+        {
+            smoothing = luaL_checknumber(L, -1);
+        }
+        lua_pop(L, 1);
+    }
+
+    if (rate < 1 || rate > SAMPLE_RATE || (rate & (rate - 1)) != 0)
+    {
+        luaL_error(L, "rate must be 1, 2, 4, 8, 16, 32, 64, 128 or 256");
+    }
+
+    if (smoothing < 0 || smoothing > 10)
+    {
+        luaL_error(L, "smoothing must be between 0 and 10 seconds");
+    }
+
+    sampling.compass = compass;
+    sampling.decimation = SAMPLE_RATE / rate;
+    sampling.interrupt_count = sampling.decimation - 1;
+    sampling.pending = false;
+    sampling.head = 0;
+    sampling.tail = 0;
+    sampling.dropped = 0;
+
+    // Samples start from the current values
+    sampling.latest = get_imu_data();
+
+    imu_fusion_reset(&sampling.fusion, (float)smoothing);
+    update_fusion(&sampling.fusion, &sampling.latest, 0.0f);
+
+    // Keep the magnetometer awake, and start the first conversion
+    if (compass)
+    {
+        check_error(i2c_write(MAGNETOMETER, 0x1B, 0x80, 0x80).fail);
+        check_error(i2c_write(MAGNETOMETER, 0x1D, 0x40, 0x40).fail);
+    }
+
+    sampling.enabled = true;
+
+    set_sample_interrupt(true);
+
+    return 0;
+}
+
+static int lua_imu_stop(lua_State *L)
+{
+    if (!sampling.enabled)
+    {
+        return 0;
+    }
+
+    NRFX_IRQ_DISABLE(GPIOTE_IRQn);
+    sampling.enabled = false;
+    sampling.pending = false;
+    NRFX_IRQ_ENABLE(GPIOTE_IRQn);
+
+    set_sample_interrupt(false);
+
+    if (sampling.compass)
+    {
+        check_error(i2c_write(MAGNETOMETER, 0x1B, 0x80, 0x00).fail);
+    }
+
+    return 0;
+}
+
+static int lua_imu_read_batch(lua_State *L)
+{
+    if (!sampling.enabled)
+    {
+        luaL_error(L, "sampling not started");
+    }
+
+    lua_Integer max_samples = luaL_optinteger(L, 1, SAMPLE_BUFFER_LENGTH);
+
+    if (max_samples < 1)
+    {
+        luaL_error(L, "maximum samples must be 1 or more");
+    }
+
+    take_pending_sample();
+
+    uint16_t head = sampling.head;
+    uint16_t available = (head - sampling.tail + SAMPLE_BUFFER_LENGTH) %
+                         SAMPLE_BUFFER_LENGTH;
+
+    if (available > max_samples)
+    {
+        available = max_samples;
+    }
+
+    lua_createtable(L, available, 0);
+
+    for (uint16_t i = 0; i < available; i++)
+    {
+        imu_sample_t *sample = &sampling.buffer[sampling.tail];
+
+        push_imu_values(L, &sample->values);
+
+        lua_pushnumber(L, (lua_Number)sample->timestamp_us / 1000000);
+        lua_setfield(L, -2, "timestamp");
+
+        lua_rawseti(L, -2, i + 1);
+
+        // Only now can the interrupt reuse the slot
+        sampling.tail = (sampling.tail + 1) % SAMPLE_BUFFER_LENGTH;
+    }
+
+    // Also return how many were lost since the last read
+    NRFX_IRQ_DISABLE(GPIOTE_IRQn);
+    lua_Integer dropped = sampling.dropped;
+    sampling.dropped = 0;
+    NRFX_IRQ_ENABLE(GPIOTE_IRQn);
+
+    lua_pushinteger(L, dropped);
+
+    return 2;
+}
+
 void lua_open_imu_library(lua_State *L)
 {
+    // Sampling doesn't carry over when Lua restarts
+    if (sampling.enabled)
+    {
+        sampling.enabled = false;
+        set_sample_interrupt(false);
+    }
+
     // NOTE: IMU must be repowered after changing these settings
 
     // Enable tap interrupt on -Y axis
@@ -254,7 +665,7 @@ void lua_open_imu_library(lua_State *L)
     };
 
     nrfx_gpiote_handler_config_t handler_config = {
-        .handler = imu_tap_interrupt_handler,
+        .handler = imu_interrupt_handler,
         .p_context = NULL,
     };
 
@@ -279,6 +690,15 @@ void lua_open_imu_library(lua_State *L)
     lua_pushcfunction(L, lua_imu_raw);
     lua_setfield(L, -2, "raw");
 
+    lua_pushcfunction(L, lua_imu_start);
+    lua_setfield(L, -2, "start");
+
+    lua_pushcfunction(L, lua_imu_stop);
+    lua_setfield(L, -2, "stop");
+
+    lua_pushcfunction(L, lua_imu_read_batch);
+    lua_setfield(L, -2, "read_batch");
+
     lua_setfield(L, -2, "imu");
 
     lua_pop(L, 1);
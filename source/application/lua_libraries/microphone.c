@@ -24,46 +24,423 @@
 
 #include <math.h>
 #include <stdint.h>
+#include "bluetooth.h"
 #include "error_logging.h"
+#include "frame_lua_libraries.h"
 #include "lauxlib.h"
 #include "lua.h"
+#include "microphone_adpcm.h"
+#include "microphone_decimator.h"
+#include "microphone_vad.h"
 #include "nrfx_config.h"
 #include "nrfx_log.h"
 #include "nrfx_pdm.h"
 #include "pinout.h"
+#include "watchdog.h"
 
 #define PDM_BUFFER_SIZE 128
 static int16_t pdm_buffers[2][PDM_BUFFER_SIZE];
 static bool sampling_active = false;
 static lua_Integer sample_rate = 8000;
 static lua_Integer bit_depth = 8;
+static bool dither = false;
+static uint32_t dither_state = 1;
+static microphone_decimator_t decimator;
 
+static enum codec
+{
+    CODEC_PCM,
+    CODEC_ADPCM,
+} codec = CODEC_PCM;
+
+static const char *const codec_names[] = {"pcm", "adpcm", NULL};
+
+static microphone_adpcm_t adpcm;
+
+// The PDM always samples at 16kHz, and is decimated down to the sample rate
+#define PDM_SAMPLE_RATE 16000
+
+// Only the PDM interrupt moves the head, and only the reader moves the tail.
+// When the reader falls behind, new samples are dropped and counted, rather
+// than overwriting ones which may be mid read
 #define FIFO_TOTAL_SIZE 32768
 static struct fifo
 {
     int16_t buffer[FIFO_TOTAL_SIZE];
-    size_t head;
-    size_t tail;
+    volatile size_t head;
+    volatile size_t tail;
+    volatile uint64_t head_time_us;
+    uint32_t overruns;
 } fifo;
 
 #if (FIFO_TOTAL_SIZE % PDM_BUFFER_SIZE)
 #error "chunks don't fit evenly into fifo"
 #endif
 
+static size_t fifo_available(void)
+{
+    return (fifo.head - fifo.tail + FIFO_TOTAL_SIZE) % FIFO_TOTAL_SIZE;
+}
+
+// Copies out samples in at most two spans, either side of the wrap
+static void fifo_read(int16_t *samples, size_t count)
+{
+    size_t first = FIFO_TOTAL_SIZE - fifo.tail;
+    first = count < first ? count : first;
+
+    memcpy(samples, fifo.buffer + fifo.tail, first * sizeof(int16_t));
+    memcpy(samples + first, fifo.buffer, (count - first) * sizeof(int16_t));
+
+    fifo.tail = (fifo.tail + count) % FIFO_TOTAL_SIZE;
+}
+
+static void fifo_read_8_bit(uint8_t *samples, size_t count)
+{
+    while (count > 0)
+    {
+        size_t span = FIFO_TOTAL_SIZE - fifo.tail;
+        span = count < span ? count : span;
+
+        const int16_t *source = fifo.buffer + fifo.tail;
+
+        for (size_t i = 0; i < span; i++)
+        {
+            samples[i] = microphone_decimator_to_8_bit(source[i],
+                                                       dither,
+                                                       &dither_state);
+        }
+
+        samples += span;
+        count -= span;
+        fifo.tail = (fifo.tail + span) % FIFO_TOTAL_SIZE;
+    }
+}
+
+// Returns how many samples are waiting, and when the oldest was captured
+static size_t fifo_snapshot(double *timestamp)
+{
+    NRFX_IRQ_DISABLE(PDM_IRQn);
+    size_t available = fifo_available();
+    uint64_t head_time_us = fifo.head_time_us;
+    NRFX_IRQ_ENABLE(PDM_IRQn);
+
+    double age = available > 0 ? (double)(available - 1) / sample_rate : 0;
+    *timestamp = (double)head_time_us / 1000000 - age;
+
+    return available;
+}
+
+// Streamed packets are the data flag, the stream flag, a sequence number, and
+// then either raw samples or an ADPCM packet
+#define STREAM_DATA 0x12
+#define STREAM_HEADER_BYTES 4
+
+// Older audio is dropped once the link falls this far behind
+#define STREAM_MAX_LATENCY_MS 80
+
+static struct stream
+{
+    bool enabled;
+    volatile bool draining;
+    volatile bool retry;
+    uint16_t sequence;
+    uint8_t packet[BLE_PREFERRED_MAX_MTU];
+    size_t packet_length;
+    uint32_t sent;
+    uint32_t busy;
+    uint32_t dropped;
+} stream;
+
+static size_t stream_packet_samples(void)
+{
+    if (!bluetooth_is_connected() || ble_negotiated_mtu <= STREAM_HEADER_BYTES)
+    {
+        return 0;
+    }
+
+    size_t payload = ble_negotiated_mtu - STREAM_HEADER_BYTES;
+
+    if (codec == CODEC_ADPCM)
+    {
+        return microphone_adpcm_packet_samples(payload);
+    }
+
+    return bit_depth == 16 ? payload / 2 : payload;
+}
+
+static void stream_build_packet(size_t packet_samples)
+{
+    // Big enough for a full ADPCM packet, which is the most samples per byte
+    static int16_t samples[2 * BLE_PREFERRED_MAX_MTU];
+
+    uint8_t *payload = stream.packet + STREAM_HEADER_BYTES;
+    size_t payload_length;
+
+    stream.packet[0] = 0x01;
+    stream.packet[1] = STREAM_DATA;
+    stream.packet[2] = (uint8_t)stream.sequence;
+    stream.packet[3] = (uint8_t)(stream.sequence >> 8);
+
+    if (codec == CODEC_ADPCM)
+    {
+        fifo_read(samples, packet_samples);
+        payload_length = microphone_adpcm_encode_packet(&adpcm,
+                                                        samples,
+                                                        packet_samples,
+                                                        payload);
+    }
+
+    // Samples are already little endian, so go straight into the packet
+    else if (bit_depth == 16)
+    {
+        fifo_read((int16_t *)payload, packet_samples);
+        payload_length = packet_samples * 2;
+    }
+
+    else
+    {
+        fifo_read_8_bit(payload, packet_samples);
+        payload_length = packet_samples;
+    }
+
+    stream.packet_length = STREAM_HEADER_BYTES + payload_length;
+    stream.sequence++;
+}
+
+static void stream_drain(void)
+{
+    size_t packet_samples = stream_packet_samples();
+
+    // Nowhere to send audio yet, so keep only the latest
+    if (packet_samples == 0)
+    {
+        fifo.tail = fifo.head;
+        return;
+    }
+
+    size_t max_backlog = packet_samples +
+                         sample_rate * STREAM_MAX_LATENCY_MS / 1000;
+
+    // Skipped packets still use up a sequence number, so the gap can be seen
+    while (fifo_available() > max_backlog)
+    {
+        fifo.tail = (fifo.tail + packet_samples) % FIFO_TOTAL_SIZE;
+        stream.sequence++;
+        stream.dropped++;
+    }
+
+    while (true)
+    {
+        if (stream.packet_length == 0)
+        {
+            if (fifo_available() < packet_samples)
+            {
+                return;
+            }
+
+            stream_build_packet(packet_samples);
+        }
+
+        if (bluetooth_send_data(stream.packet, stream.packet_length))
+        {
+            stream.busy++;
+            return;
+        }
+
+        stream.packet_length = 0;
+        stream.sent++;
+    }
+}
+
+void lua_microphone_stream_interrupt(void)
+{
+    if (!stream.enabled)
+    {
+        return;
+    }
+
+    // Called from both the PDM and Bluetooth interrupts. Whichever preempts
+    // the other leaves the draining to it, rather than touching the FIFO
+    if (stream.draining)
+    {
+        stream.retry = true;
+        return;
+    }
+
+    do
+    {
+        stream.draining = true;
+        stream.retry = false;
+        stream_drain();
+        stream.draining = false;
+    } while (stream.retry);
+}
+
+static void fifo_write(const int16_t *samples, size_t count)
+{
+    // One slot always stays empty, so that a full FIFO isn't empty
+    if (fifo_available() + count >= FIFO_TOTAL_SIZE)
+    {
+        fifo.overruns += count;
+        return;
+    }
+
+    // Blocks are always the same size, and divide the FIFO, so never wrap
+    memcpy(fifo.buffer + fifo.head, samples, count * sizeof(int16_t));
+
+    fifo.head_time_us = time_utc_us();
+    fifo.head = (fifo.head + count) % FIFO_TOTAL_SIZE;
+}
+
+// Blocks kept from before speech starts, so that its beginning isn't lost
+#define VOICE_PREROLL_BLOCKS 8
+
+static struct voice_activity
+{
+    bool enabled;
+    bool gate;
+    microphone_vad_t detector;
+    int callback_function;
+    volatile bool callback_pending;
+    int16_t preroll[VOICE_PREROLL_BLOCKS][PDM_BUFFER_SIZE];
+    size_t preroll_count;
+    size_t preroll_next;
+    size_t block_size;
+} voice_activity = {
+    .callback_function = 0,
+};
+
+static void lua_microphone_speech_callback_handler(lua_State *L, lua_Debug *ar)
+{
+    sethook_watchdog(L);
+
+    voice_activity.callback_pending = false;
+
+    if (voice_activity.callback_function == 0)
+    {
+        return;
+    }
+
+    // Events in quick succession are merged, leaving only the latest state
+    lua_rawgeti(L, LUA_REGISTRYINDEX, voice_activity.callback_function);
+    lua_pushboolean(L, voice_activity.detector.active);
+
+    if (lua_pcall(L, 1, 0, 0) != LUA_OK)
+    {
+        luaL_error(L, "%s", lua_tostring(L, -1));
+    }
+
+    lua_system_resume_pending();
+}
+
+static void set_speech_callback_hook(void)
+{
+    // Leave any break signal or other callback to run first
+    if (lua_gethook(L_global) != reload_watchdog)
+    {
+        return;
+    }
+
+    lua_sethook(L_global,
+                lua_microphone_speech_callback_handler,
+                LUA_MASKCALL | LUA_MASKRET | LUA_MASKLINE | LUA_MASKCOUNT,
+                1);
+}
+
+static void preroll_push(const int16_t *samples, size_t count)
+{
+    memcpy(voice_activity.preroll[voice_activity.preroll_next],
+           samples,
+           count * sizeof(int16_t));
+
+    voice_activity.preroll_next =
+        (voice_activity.preroll_next + 1) % VOICE_PREROLL_BLOCKS;
+
+    if (voice_activity.preroll_count < VOICE_PREROLL_BLOCKS)
+    {
+        voice_activity.preroll_count++;
+    }
+}
+
+static void preroll_flush(void)
+{
+    size_t oldest = (voice_activity.preroll_next +
+                     VOICE_PREROLL_BLOCKS -
+                     voice_activity.preroll_count) %
+                    VOICE_PREROLL_BLOCKS;
+
+    for (size_t i = 0; i < voice_activity.preroll_count; i++)
+    {
+        fifo_write(voice_activity.preroll[(oldest + i) % VOICE_PREROLL_BLOCKS],
+                   voice_activity.block_size);
+    }
+
+    voice_activity.preroll_count = 0;
+}
+
+static void detect_voice_activity(const int16_t *samples, size_t count)
+{
+    voice_activity.block_size = count;
+
+    microphone_vad_event_t event = microphone_vad_process(
+        &voice_activity.detector,
+        samples,
+        count);
+
+    if (event != MICROPHONE_VAD_NO_CHANGE)
+    {
+        voice_activity.callback_pending = true;
+    }
+
+    if (voice_activity.callback_pending &&
+        voice_activity.callback_function != 0)
+    {
+        set_speech_callback_hook();
+    }
+
+    if (!voice_activity.gate)
+    {
+        fifo_write(samples, count);
+        return;
+    }
+
+    // Only speech goes into the FIFO, led in by the audio just before it
+    if (event == MICROPHONE_VAD_SPEECH_STARTED)
+    {
+        preroll_flush();
+    }
+
+    if (voice_activity.detector.active)
+    {
+        fifo_write(samples, count);
+    }
+    else
+    {
+        preroll_push(samples, count);
+    }
+}
+
 static void pdm_event_handler(nrfx_pdm_evt_t const *p_evt)
 {
     if (p_evt->buffer_released != NULL)
     {
-        memcpy(fifo.buffer + fifo.head,
-               p_evt->buffer_released,
-               PDM_BUFFER_SIZE * sizeof(int16_t));
+        int16_t samples[PDM_BUFFER_SIZE];
 
-        fifo.head += PDM_BUFFER_SIZE;
+        size_t count = microphone_decimator_process(&decimator,
+                                                    p_evt->buffer_released,
+                                                    PDM_BUFFER_SIZE,
+                                                    samples);
 
-        if (fifo.head == FIFO_TOTAL_SIZE)
+        if (voice_activity.enabled)
+        {
+            detect_voice_activity(samples, count);
+        }
+        else
         {
-            fifo.head = 0;
+            fifo_write(samples, count);
         }
+
+        lua_microphone_stream_interrupt();
     }
 
     if (p_evt->buffer_requested)
@@ -79,6 +456,70 @@ static void pdm_event_handler(nrfx_pdm_evt_t const *p_evt)
     }
 }
 
+struct voice_activity_settings
+{
+    bool enabled;
+    bool gate;
+    lua_Number threshold;
+    lua_Number zero_crossings;
+    lua_Number onset;
+    lua_Number hangover;
+};
+
+static lua_Number check_vad_option(lua_State *L,
+                                   const char *name,
+                                   lua_Number default_value,
+                                   lua_Number min,
+                                   lua_Number max)
+{
+    lua_Number value = default_value;
+
+    if (lua_getfield(L, -1, name) != LUA_TNIL)
+    {
+        value = luaL_checknumber(L, -1);
+
+        if (value < min || value > max)
+        {
+            luaL_error(L, "vad %s must be between %f and %f", name, min, max);
+        }
+    }
+
+    lua_pop(L, 1);
+
+    return value;
+}
+
+// Reads either vad=true, or a table of settings, from the top of the stack
+static void parse_voice_activity_settings(lua_State *L,
+                                          struct voice_activity_settings *vad)
+{
+    if (lua_isboolean(L, -1))
+    {
+        vad->enabled = lua_toboolean(L, -1);
+        return;
+    }
+
+    luaL_checktype(L, -1, LUA_TTABLE);
+    vad->enabled = true;
+
+    vad->threshold = check_vad_option(L, "threshold", vad->threshold, 0, 40);
+    vad->zero_crossings = check_vad_option(L,
+                                           "zero_crossings",
+                                           vad->zero_crossings,
+                                           0,
+                                           1);
+    vad->onset = check_vad_option(L, "onset", vad->onset, 0, 1);
+    vad->hangover = check_vad_option(L, "hangover", vad->hangover, 0, 10);
+
+    if (lua_getfield(L, -1, "gate") != LUA_TNIL)
+    {
+        luaL_checktype(L, -1, LUA_TBOOLEAN);
+        vad->gate = lua_toboolean(L, -1);
+    }
+
+    lua_pop(L, 1);
+}
+
 static int lua_microphone_start(lua_State *L)
 {
     if (sampling_active)
@@ -87,7 +528,18 @@ static int lua_microphone_start(lua_State *L)
     }
 
     lua_Integer set_sample_rate = 8000;
-    lua_Integer set_bit_depth = 8;
+    lua_Integer set_bit_depth = 0;
+    bool set_dither = false;
+    enum codec set_codec = CODEC_PCM;
+    bool set_stream = false;
+    struct voice_activity_settings set_vad = {
+        .enabled = false,
+        .gate = true,
+        .threshold = MICROPHONE_VAD_DEFAULT_THRESHOLD_DB,
+        .zero_crossings = MICROPHONE_VAD_DEFAULT_ZERO_CROSSING_LIMIT,
+        .onset = MICROPHONE_VAD_DEFAULT_ONSET_SECONDS,
+        .hangover = MICROPHONE_VAD_DEFAULT_HANGOVER_SECONDS,
+    };
 
     if (lua_istable(L, 1))
     {
@@ -102,11 +554,45 @@ static int lua_microphone_start(lua_State *L)
             set_bit_depth = luaL_checkinteger(L, -1);
             lua_pop(L, 1);
         }
+
+        if (lua_getfield(L, 1, "dither") != LUA_TNIL)
+        {
+            luaL_checktype(L, -1, LUA_TBOOLEAN);
+            set_dither = lua_toboolean(L, -1);
+            lua_pop(L, 1);
+        }
+
+        if (lua_getfield(L, 1, "codec") != LUA_TNIL)
+        {
+            set_codec = luaL_checkoption(L, -1, NULL, codec_names);
+            lua_pop(L, 1);
+        }
+
+        if (lua_getfield(L, 1, "stream") != LUA_TNIL)
+        {
+            luaL_checktype(L, -1, LUA_TBOOLEAN);
+            set_stream = lua_toboolean(L, -1);
+            lua_pop(L, 1);
+        }
+
+        if (lua_getfield(L, 1, "vad") != LUA_TNIL)
+        {
+            parse_voice_activity_settings(L, &set_vad);
+            lua_pop(L, 1);
+        }
+    }
+
+    // ADPCM encodes 16 bit samples, while raw samples are 8 bit by default
+    if (set_bit_depth == 0)
+    {
+        set_bit_depth = set_codec == CODEC_ADPCM ? 16 : 8;
     }
 
-    if (set_sample_rate != 8000 && set_sample_rate != 16000)
+    if (set_sample_rate != 4000 &&
+        set_sample_rate != 8000 &&
+        set_sample_rate != 16000)
     {
-        luaL_error(L, "sample rate must be 8000 or 16000");
+        luaL_error(L, "sample rate must be 4000, 8000 or 16000");
     }
 
     if (set_bit_depth != 16 && set_bit_depth != 8)
@@ -114,10 +600,40 @@ static int lua_microphone_start(lua_State *L)
         luaL_error(L, "bit depth must be 8 or 16");
     }
 
+    if (set_codec == CODEC_ADPCM && set_bit_depth != 16)
+    {
+        luaL_error(L, "adpcm codec requires a bit depth of 16");
+    }
+
     sample_rate = set_sample_rate;
     bit_depth = set_bit_depth;
+    dither = set_dither;
+    codec = set_codec;
+    microphone_adpcm_reset(&adpcm);
+    microphone_decimator_init(&decimator, PDM_SAMPLE_RATE / sample_rate);
     fifo.head = 0;
     fifo.tail = 0;
+    fifo.overruns = 0;
+    stream.sequence = 0;
+    stream.packet_length = 0;
+    stream.sent = 0;
+    stream.busy = 0;
+    stream.dropped = 0;
+    stream.enabled = set_stream;
+
+    microphone_vad_init(&voice_activity.detector,
+                        sample_rate,
+                        (float)set_vad.threshold,
+                        (float)set_vad.zero_crossings,
+                        (float)set_vad.onset,
+                        (float)set_vad.hangover);
+
+    voice_activity.gate = set_vad.gate;
+    voice_activity.preroll_count = 0;
+    voice_activity.preroll_next = 0;
+    voice_activity.callback_pending = false;
+    voice_activity.enabled = set_vad.enabled;
+
     sampling_active = true;
 
     check_error(nrfx_pdm_start());
@@ -129,19 +645,83 @@ static int lua_microphone_stop(lua_State *L)
 {
     check_error(nrfx_pdm_stop());
     sampling_active = false;
+
+    // Anything not yet sent is dropped, as it would arrive late anyway
+    stream.enabled = false;
+
+    voice_activity.enabled = false;
+    voice_activity.detector.active = false;
+
     return 0;
 }
 
-static int lua_microphone_read(lua_State *L)
+static int lua_microphone_speaking(lua_State *L)
 {
-    lua_Integer bytes = luaL_checkinteger(L, 1);
+    lua_pushboolean(L, voice_activity.detector.active);
+    return 1;
+}
 
-    if (bytes % 2 != 0)
+static int lua_microphone_speech_callback(lua_State *L)
+{
+    if (lua_isnil(L, 1))
     {
-        luaL_error(L, "bytes must be a multiple of 2");
+        voice_activity.callback_function = 0;
+        return 0;
     }
 
-    if (fifo.tail == fifo.head)
+    if (lua_isfunction(L, 1))
+    {
+        voice_activity.callback_function = luaL_ref(L, LUA_REGISTRYINDEX);
+        return 0;
+    }
+
+    luaL_error(L, "expected nil or function");
+
+    return 0;
+}
+
+static int lua_microphone_stats(lua_State *L)
+{
+    lua_newtable(L);
+
+    lua_pushinteger(L, stream.sent);
+    lua_setfield(L, -2, "sent");
+
+    lua_pushinteger(L, stream.busy);
+    lua_setfield(L, -2, "busy");
+
+    lua_pushinteger(L, stream.dropped);
+    lua_setfield(L, -2, "dropped");
+
+    lua_pushinteger(L, fifo.overruns);
+    lua_setfield(L, -2, "overruns");
+
+    return 1;
+}
+
+// Returns one packet of ADPCM, which is only sent once it can be filled
+static int lua_microphone_read_adpcm(lua_State *L)
+{
+    lua_Integer bytes = luaL_optinteger(L, 1, ble_negotiated_mtu - 1);
+
+    // Packets larger than the FIFO can hold would never fill
+    lua_Integer max_bytes = MICROPHONE_ADPCM_HEADER_BYTES +
+                            (FIFO_TOTAL_SIZE - PDM_BUFFER_SIZE) / 2;
+
+    if (bytes <= MICROPHONE_ADPCM_HEADER_BYTES || bytes > max_bytes)
+    {
+        luaL_error(L,
+                   "bytes must be between %d and %d for the adpcm codec",
+                   MICROPHONE_ADPCM_HEADER_BYTES + 1,
+                   (int)max_bytes);
+    }
+
+    size_t packet_samples = microphone_adpcm_packet_samples(bytes);
+
+    double timestamp;
+    size_t available = fifo_snapshot(&timestamp);
+
+    if (available < packet_samples)
     {
         if (sampling_active)
         {
@@ -149,52 +729,102 @@ static int lua_microphone_read(lua_State *L)
             return 1;
         }
 
-        lua_pushnil(L);
-        return 1;
+        // Once stopped, what remains goes out in a shorter packet
+        packet_samples = available & ~1;
+
+        if (packet_samples == 0)
+        {
+            fifo.tail = fifo.head;
+            lua_pushnil(L);
+            return 1;
+        }
     }
 
-    char *samples = malloc(bytes);
+    luaL_Buffer buffer;
+    uint8_t *packet = (uint8_t *)luaL_buffinitsize(L, &buffer, bytes);
+
+    // Nothing below raises an error until the samples are freed
+    int16_t *samples = malloc(packet_samples * sizeof(int16_t));
     if (samples == NULL)
     {
         luaL_error(L, "not enough memory");
     }
 
-    size_t i = 0;
-    while (true)
+    fifo_read(samples, packet_samples);
+
+    size_t length = microphone_adpcm_encode_packet(&adpcm,
+                                                   samples,
+                                                   packet_samples,
+                                                   packet);
+
+    free(samples);
+    luaL_pushresultsize(&buffer, length);
+
+    lua_pushnumber(L, timestamp);
+
+    return 2;
+}
+
+static int lua_microphone_read(lua_State *L)
+{
+    if (stream.enabled)
     {
-        if (fifo.tail == fifo.head || i == bytes)
-        {
-            break;
-        }
+        luaL_error(L, "microphone is streaming");
+    }
 
-        int16_t raw_sample = fifo.buffer[fifo.tail++];
-        if (fifo.tail == FIFO_TOTAL_SIZE)
+    if (codec == CODEC_ADPCM)
+    {
+        return lua_microphone_read_adpcm(L);
+    }
+
+    lua_Integer bytes = luaL_checkinteger(L, 1);
+
+    if (bytes < 0)
+    {
+        luaL_error(L, "bytes must be positive");
+    }
+
+    if (bytes % 2 != 0)
+    {
+        luaL_error(L, "bytes must be a multiple of 2");
+    }
+
+    double timestamp;
+    size_t available = fifo_snapshot(&timestamp);
+
+    if (available == 0)
+    {
+        if (sampling_active)
         {
-            fifo.tail = 0;
+            lua_pushstring(L, "");
+            return 1;
         }
 
-        // 8khz simply throws away a sample
-        // TODO 8khz is missing an anti-aliasing filter
+        lua_pushnil(L);
+        return 1;
+    }
 
-        if (sample_rate == 16000 || (sample_rate == 8000 && fifo.tail % 2))
-        {
-            if (bit_depth == 16)
-            {
-                samples[i++] = raw_sample;
-                samples[i++] = raw_sample >> 8;
-            }
+    size_t sample_bytes = bit_depth / 8;
+    size_t count = bytes / sample_bytes;
+    count = available < count ? available : count;
 
-            if (bit_depth == 8)
-            {
-                samples[i++] = raw_sample >> 8;
-            }
-        }
+    // Samples are copied straight into the string, a span at a time
+    luaL_Buffer buffer;
+    char *samples = luaL_buffinitsize(L, &buffer, count * sample_bytes);
+
+    if (bit_depth == 16)
+    {
+        fifo_read((int16_t *)samples, count);
+    }
+    else
+    {
+        fifo_read_8_bit((uint8_t *)samples, count);
     }
 
-    lua_pushlstring(L, samples, i);
-    free(samples);
+    luaL_pushresultsize(&buffer, count * sample_bytes);
+    lua_pushnumber(L, timestamp);
 
-    return 1;
+    return 2;
 }
 
 void lua_open_microphone_library(lua_State *L)
@@ -225,6 +855,15 @@ void lua_open_microphone_library(lua_State *L)
     lua_pushcfunction(L, lua_microphone_read);
     lua_setfield(L, -2, "read");
 
+    lua_pushcfunction(L, lua_microphone_stats);
+    lua_setfield(L, -2, "stats");
+
+    lua_pushcfunction(L, lua_microphone_speaking);
+    lua_setfield(L, -2, "speaking");
+
+    lua_pushcfunction(L, lua_microphone_speech_callback);
+    lua_setfield(L, -2, "speech_callback");
+
     lua_setfield(L, -2, "microphone");
 
     lua_pop(L, 1);
@@ -0,0 +1,426 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Functions registered by name, and then called by their ID over Bluetooth.
+ * Calls skip the Lua compiler entirely, as the function is compiled once when
+ * registered, and its arguments are sent in binary.
+ *
+ * A call is the function ID, followed by each argument:
+ *
+ *   0x00         nil
+ *   0x01, 0x02   false, true
+ *   0x03 .. 0x06 8, 16, 32 or 64 bit signed integer, little endian
+ *   0x07, 0x08   32 or 64 bit float, little endian
+ *   0x09, 0x0A   string, prefixed with a one or two byte little endian length
+ *   0x80 .. 0xFF integer from 0 to 127
+ *
+ * A single call can be sent as a data packet, where the byte after the 0x01
+ * data flag is 0x02. Data packets which don't call a registered function are
+ * passed on to the Bluetooth receive callback as before.
+ *
+ * Otherwise calls are streamed in writes starting with 0x02, each call prefixed
+ * by its length as described in command_framing.h. A write can hold many calls,
+ * and a call can span many writes. Streamed calls to an ID with no function
+ * raise an error. Single calls are only skipped, as they were checked when
+ * they arrived, so only their function can have been removed since.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "bluetooth.h"
+#include "command_framing.h"
+#include "frame_lua_libraries.h"
+#include "lauxlib.h"
+#include "lua.h"
+#include "watchdog.h"
+
+#define RPC_CALL 0x02
+
+#define RPC_NIL 0x00
+#define RPC_FALSE 0x01
+#define RPC_TRUE 0x02
+#define RPC_INT8 0x03
+#define RPC_INT16 0x04
+#define RPC_INT32 0x05
+#define RPC_INT64 0x06
+#define RPC_FLOAT32 0x07
+#define RPC_FLOAT64 0x08
+#define RPC_STRING 0x09
+#define RPC_LONG_STRING 0x0A
+#define RPC_SMALL_INTEGER 0x80
+
+#define RPC_MAX_FUNCTIONS 32
+
+// Queued with calls sent as single data packets. These were checked when they
+// arrived, unlike those from the stream
+#define RPC_FROM_PACKET 0x01
+
+static struct rpc_functions
+{
+    int names;
+    int function[RPC_MAX_FUNCTIONS];
+} rpc_functions;
+
+// Calls which arrive before Lua gets to run them are queued
+static command_framing_t rpc_commands;
+
+static void lua_rpc_call_handler(lua_State *L, lua_Debug *ar);
+
+static uint64_t read_little_endian(const uint8_t *data, size_t bytes)
+{
+    uint64_t value = 0;
+
+    for (size_t i = 0; i < bytes; i++)
+    {
+        value |= (uint64_t)data[i] << (i * 8);
+    }
+
+    return value;
+}
+
+static int push_arguments(lua_State *L, const uint8_t *data, size_t length)
+{
+    static const size_t sizes[] = {
+        [RPC_INT8] = 1,
+        [RPC_INT16] = 2,
+        [RPC_INT32] = 4,
+        [RPC_INT64] = 8,
+        [RPC_FLOAT32] = 4,
+        [RPC_FLOAT64] = 8,
+        [RPC_STRING] = 1,
+        [RPC_LONG_STRING] = 2,
+    };
+
+    int arguments = 0;
+    size_t i = 0;
+
+    while (i < length)
+    {
+        uint8_t type = data[i++];
+
+        luaL_checkstack(L, 1, "too many arguments");
+
+        if (type >= RPC_SMALL_INTEGER)
+        {
+            lua_pushinteger(L, type - RPC_SMALL_INTEGER);
+            arguments++;
+            continue;
+        }
+
+        if (type > RPC_LONG_STRING)
+        {
+            return -1;
+        }
+
+        size_t size = sizes[type];
+
+        if (length - i < size)
+        {
+            return -1;
+        }
+
+        uint64_t value = read_little_endian(data + i, size);
+        i += size;
+
+        switch (type)
+        {
+        case RPC_NIL:
+            lua_pushnil(L);
+            break;
+
+        case RPC_FALSE:
+        case RPC_TRUE:
+            lua_pushboolean(L, type == RPC_TRUE);
+            break;
+
+        case RPC_INT8:
+            lua_pushinteger(L, (int8_t)value);
+            break;
+
+        case RPC_INT16:
+            lua_pushinteger(L, (int16_t)value);
+            break;
+
+        case RPC_INT32:
+            lua_pushinteger(L, (int32_t)value);
+            break;
+
+        case RPC_INT64:
+            lua_pushinteger(L, (lua_Integer)value);
+            break;
+
+        case RPC_FLOAT32:
+        {
+            uint32_t bits = (uint32_t)value;
+            float number;
+            memcpy(&number, &bits, sizeof(number));
+            lua_pushnumber(L, (lua_Number)number);
+            break;
+        }
+
+        case RPC_FLOAT64:
+        {
+            double number;
+            memcpy(&number, &value, sizeof(number));
+            lua_pushnumber(L, (lua_Number)number);
+            break;
+        }
+
+        case RPC_STRING:
+        case RPC_LONG_STRING:
+            if (length - i < value)
+            {
+                return -1;
+            }
+
+            lua_pushlstring(L, (const char *)data + i, (size_t)value);
+            i += (size_t)value;
+            break;
+        }
+
+        arguments++;
+    }
+
+    return arguments;
+}
+
+static void set_rpc_hook(void)
+{
+    // Leave any break signal or other callback to run first. It sets this hook
+    // again once it's done
+    if (L_global == NULL || lua_gethook(L_global) != reload_watchdog)
+    {
+        return;
+    }
+
+    lua_sethook(L_global,
+                lua_rpc_call_handler,
+                LUA_MASKCALL | LUA_MASKRET | LUA_MASKLINE | LUA_MASKCOUNT,
+                1);
+}
+
+static void lua_rpc_call_handler(lua_State *L, lua_Debug *ar)
+{
+    sethook_watchdog(L);
+
+    static uint8_t call[COMMAND_FRAMING_MAX_LENGTH];
+    uint8_t flags;
+    size_t length;
+
+    // Calls are never empty, so there's always an ID
+    while ((length = command_framing_read(&rpc_commands, call, &flags)) > 0)
+    {
+        bool from_packet = flags & RPC_FROM_PACKET;
+        uint8_t id = call[0];
+
+        // Any calls left over run after an error
+        bool calls_left_over = rpc_commands.tail != rpc_commands.head;
+
+        if (id >= RPC_MAX_FUNCTIONS || rpc_functions.function[id] == 0)
+        {
+            // It was registered when it arrived, but has since been removed
+            if (from_packet)
+            {
+                continue;
+            }
+
+            if (calls_left_over)
+            {
+                set_rpc_hook();
+            }
+
+            luaL_error(L, "no function registered as %d", id);
+        }
+
+        lua_rawgeti(L, LUA_REGISTRYINDEX, rpc_functions.function[id]);
+
+        int arguments = push_arguments(L, call + 1, length - 1);
+
+        if (arguments < 0)
+        {
+            if (calls_left_over)
+            {
+                set_rpc_hook();
+            }
+
+            luaL_error(L, "malformed arguments in call to function %d", id);
+        }
+
+        if (lua_pcall(L, arguments, 0, 0) != LUA_OK)
+        {
+            if (rpc_commands.tail != rpc_commands.head)
+            {
+                set_rpc_hook();
+            }
+
+            luaL_error(L, "%s", lua_tostring(L, -1));
+        }
+    }
+
+    lua_system_resume_pending();
+}
+
+bool lua_rpc_interrupt(const uint8_t *data, size_t length)
+{
+    if (length < 2 ||
+        data[0] != RPC_CALL ||
+        data[1] >= RPC_MAX_FUNCTIONS ||
+        rpc_functions.function[data[1]] == 0)
+    {
+        return false;
+    }
+
+    // Dropped, rather than passed on as data, if Lua is too far behind
+    command_framing_push(&rpc_commands, data + 1, length - 1, RPC_FROM_PACKET);
+
+    set_rpc_hook();
+
+    return true;
+}
+
+void lua_rpc_stream_interrupt(const uint8_t *data, size_t length)
+{
+    command_framing_receive(&rpc_commands, data, length);
+
+    if (rpc_commands.tail != rpc_commands.head)
+    {
+        set_rpc_hook();
+    }
+}
+
+void lua_rpc_resume_pending(void)
+{
+    if (rpc_commands.tail != rpc_commands.head)
+    {
+        set_rpc_hook();
+    }
+}
+
+void lua_rpc_disconnect_interrupt(void)
+{
+    command_framing_abandon(&rpc_commands);
+}
+
+static int lua_rpc_register(lua_State *L)
+{
+    luaL_checkstring(L, 1);
+
+    if (!lua_isnil(L, 2) && !lua_isfunction(L, 2))
+    {
+        luaL_error(L, "expected nil or function");
+    }
+
+    lua_settop(L, 2);
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, rpc_functions.names);
+    lua_pushvalue(L, 1);
+    lua_rawget(L, 3);
+
+    lua_Integer id = lua_isinteger(L, 4) ? lua_tointeger(L, 4) : -1;
+    lua_pop(L, 1);
+
+    // Unregistering frees the ID for other functions
+    if (lua_isnil(L, 2))
+    {
+        if (id >= 0)
+        {
+            luaL_unref(L, LUA_REGISTRYINDEX, rpc_functions.function[id]);
+            rpc_functions.function[id] = 0;
+
+            lua_pushvalue(L, 1);
+            lua_pushnil(L);
+            lua_rawset(L, 3);
+        }
+
+        return 0;
+    }
+
+    if (id < 0)
+    {
+        for (id = 0; id < RPC_MAX_FUNCTIONS; id++)
+        {
+            if (rpc_functions.function[id] == 0)
+            {
+                break;
+            }
+        }
+
+        if (id == RPC_MAX_FUNCTIONS)
+        {
+            luaL_error(L, "too many functions");
+        }
+
+        lua_pushvalue(L, 1);
+        lua_pushinteger(L, id);
+        lua_rawset(L, 3);
+    }
+
+    else
+    {
+        luaL_unref(L, LUA_REGISTRYINDEX, rpc_functions.function[id]);
+    }
+
+    lua_pushvalue(L, 2);
+    rpc_functions.function[id] = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    lua_pushinteger(L, id);
+    return 1;
+}
+
+static int lua_rpc_stats(lua_State *L)
+{
+    lua_newtable(L);
+
+    // Calls too long to queue, or which found the queue full
+    lua_pushinteger(L, rpc_commands.dropped);
+    lua_setfield(L, -2, "dropped");
+
+    return 1;
+}
+
+void lua_open_rpc_library(lua_State *L)
+{
+    // Any previous functions belonged to the old Lua state
+    memset(rpc_functions.function, 0, sizeof(rpc_functions.function));
+    command_framing_reset(&rpc_commands);
+
+    lua_newtable(L);
+    rpc_functions.names = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    lua_getglobal(L, "frame");
+
+    lua_newtable(L);
+
+    lua_pushcfunction(L, lua_rpc_register);
+    lua_setfield(L, -2, "register");
+
+    lua_pushcfunction(L, lua_rpc_stats);
+    lua_setfield(L, -2, "stats");
+
+    lua_setfield(L, -2, "rpc");
+
+    lua_pop(L, 1);
+}
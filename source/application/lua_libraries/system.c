@@ -25,6 +25,7 @@
 #include <math.h>
 #include <stdbool.h>
 #include "error_logging.h"
+#include "frame_lua_libraries.h"
 #include "lauxlib.h"
 #include "lua.h"
 #include "main.h"
@@ -33,6 +34,7 @@
 #include "nrfx_saadc.h"
 #include "pinout.h"
 #include "spi.h"
+#include "watchdog.h"
 
 static int lua_update(lua_State *L)
 {
@@ -47,47 +49,50 @@ static int lua_update(lua_State *L)
     return 0;
 }
 
-static int lua_sleep(lua_State *L)
+// The watchdog bites after six seconds, so sleeping wakes up at least this often
+#define WATCHDOG_FEED_INTERVAL_US 1000000
+
+void lua_system_resume_pending(void)
 {
-    if (lua_gettop(L) == 0)
+    // Interrupts set hooks too, so check and set them together
+    NRFX_CRITICAL_SECTION_ENTER();
+    lua_rpc_resume_pending();
+    lua_imu_resume_pending();
+    NRFX_CRITICAL_SECTION_EXIT();
+}
+
+void lua_system_run_pending(lua_State *L)
+{
+    reload_watchdog(L, NULL);
+
+    // Run callbacks, or raise the break signal, as Lua would have
+    lua_Hook hook = lua_gethook(L);
+
+    if (hook != NULL && hook != reload_watchdog)
     {
-        shutdown(true);
-        return 0;
+        hook(L, NULL);
     }
 
-    lua_Number seconds = luaL_checknumber(L, 1);
-    lua_pop(L, 1);
+    lua_system_resume_pending();
+}
 
-    // Get the current time
-    int status = luaL_dostring(L, "return frame.time.utc()");
-    if (status != LUA_OK)
+void lua_system_wait(lua_State *L, uint64_t deadline_us)
+{
+    uint64_t wake_up = time_monotonic_us() + WATCHDOG_FEED_INTERVAL_US;
+
+    if (deadline_us != 0 && deadline_us < wake_up)
     {
-        const char *lua_error = lua_tostring(L, -1);
-        luaL_error(L, "%s", lua_error);
-        lua_pop(L, -1);
+        wake_up = deadline_us;
     }
 
-    // Add the current time to the wait time
-    lua_Number wait_until = lua_tonumber(L, 1) + seconds;
+    // Including anything held back by a callback which raised an error
+    lua_system_resume_pending();
 
-    while (true)
+    // Nothing's waiting to run. Anything which interrupts after this check
+    // still wakes the CPU straight away
+    if (lua_gethook(L) == reload_watchdog)
     {
-        // Keep getting the current time
-        status = luaL_dostring(L, "return frame.time.utc()");
-        if (status != LUA_OK)
-        {
-            const char *lua_error = lua_tostring(L, -1);
-            luaL_error(L, "%s", lua_error);
-            lua_pop(L, -1);
-        }
-
-        lua_Number current_time = lua_tonumber(L, 2);
-        lua_pop(L, 1);
-
-        if (current_time >= wait_until)
-        {
-            break;
-        }
+        time_set_alarm(TIME_ALARM_SLEEP, wake_up, NULL);
 
         // Clear exceptions and sleep
         __set_FPSCR(__get_FPSCR() & ~(0x0000009F));
@@ -98,6 +103,33 @@ static int lua_sleep(lua_State *L)
         check_error(sd_app_evt_wait());
     }
 
+    lua_system_run_pending(L);
+}
+
+static int lua_sleep(lua_State *L)
+{
+    if (lua_gettop(L) == 0)
+    {
+        shutdown(true);
+        return 0;
+    }
+
+    lua_Number seconds = luaL_checknumber(L, 1);
+
+    uint64_t deadline = time_monotonic_us();
+
+    if (seconds > 0)
+    {
+        deadline += (uint64_t)(seconds * 1000000);
+    }
+
+    while (time_monotonic_us() < deadline)
+    {
+        lua_system_wait(L, deadline);
+    }
+
+    time_cancel_alarm(TIME_ALARM_SLEEP);
+
     return 0;
 }
 
@@ -0,0 +1,352 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Cooperative tasks, each running as a Lua coroutine. A task gives way to the
+ * others whenever it waits on one of the functions below, or calls
+ * coroutine.yield(). While every task is waiting, the CPU sleeps until the RTC
+ * alarm of the earliest sleeping task, or until the SoftDevice wakes it.
+ *
+ * Callbacks and the break signal are run between tasks, so a task which never
+ * waits holds up everything else.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "bluetooth.h"
+#include "frame_lua_libraries.h"
+#include "lauxlib.h"
+#include "lua.h"
+#include "watchdog.h"
+
+#define MAX_TASKS 16
+
+// The FPGA can't interrupt, so captures are polled. Each poll that finds no
+// image waits twice as long as the last, so that long captures don't keep
+// waking the CPU
+#define CAMERA_POLL_MIN_INTERVAL_US 1000
+#define CAMERA_POLL_MAX_INTERVAL_US 16000
+
+static struct task
+{
+    lua_State *thread;
+    int reference;
+    int arguments;
+    bool waiting_for_event;
+    uint64_t resume_at;
+} tasks[MAX_TASKS];
+
+static size_t task_count = 0;
+
+static struct task *find_task(lua_State *L)
+{
+    for (size_t i = 0; i < task_count; i++)
+    {
+        if (tasks[i].thread == L)
+        {
+            return &tasks[i];
+        }
+    }
+
+    return NULL;
+}
+
+static struct task *current_task(lua_State *L)
+{
+    struct task *task = find_task(L);
+
+    if (task == NULL)
+    {
+        luaL_error(L, "must be called from within a task");
+    }
+
+    return task;
+}
+
+static void remove_task(lua_State *L, size_t index)
+{
+    luaL_unref(L, LUA_REGISTRYINDEX, tasks[index].reference);
+
+    memmove(&tasks[index],
+            &tasks[index + 1],
+            (task_count - index - 1) * sizeof(struct task));
+
+    task_count--;
+}
+
+static int lua_task_spawn(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+
+    if (task_count == MAX_TASKS)
+    {
+        luaL_error(L, "too many tasks");
+    }
+
+    int arguments = lua_gettop(L) - 1;
+
+    // The function and its arguments are moved onto the new thread
+    lua_State *thread = lua_newthread(L);
+    lua_rotate(L, 1, 1);
+    lua_xmove(L, thread, arguments + 1);
+
+    // Otherwise it inherits whichever hook was set when it was created
+    sethook_watchdog(thread);
+
+    lua_pushvalue(L, 1);
+
+    tasks[task_count] = (struct task){
+        .thread = thread,
+        .reference = luaL_ref(L, LUA_REGISTRYINDEX),
+        .arguments = arguments,
+        .waiting_for_event = false,
+        .resume_at = 0,
+    };
+
+    task_count++;
+
+    return 1;
+}
+
+static int lua_task_sleep(lua_State *L)
+{
+    lua_Number seconds = luaL_checknumber(L, 1);
+
+    struct task *task = current_task(L);
+
+    task->resume_at = time_monotonic_us();
+
+    if (seconds > 0)
+    {
+        task->resume_at += (uint64_t)(seconds * 1000000);
+    }
+
+    return lua_yield(L, 0);
+}
+
+static int camera_ready_continue(lua_State *L, int status, lua_KContext context)
+{
+    // The context holds the last interval once resumed from a yield
+    lua_KContext interval = CAMERA_POLL_MIN_INTERVAL_US;
+
+    if (status == LUA_YIELD)
+    {
+        interval = context * 2 < CAMERA_POLL_MAX_INTERVAL_US
+                       ? context * 2
+                       : CAMERA_POLL_MAX_INTERVAL_US;
+    }
+
+    lua_settop(L, 0);
+
+    lua_getglobal(L, "frame");
+    lua_getfield(L, 1, "camera");
+    lua_getfield(L, 2, "image_ready");
+    lua_call(L, 0, LUA_MULTRET);
+
+    // Returns the same values as image_ready()
+    if (lua_toboolean(L, 3))
+    {
+        return lua_gettop(L) - 2;
+    }
+
+    struct task *task = current_task(L);
+    task->resume_at = time_monotonic_us() + (uint64_t)interval;
+
+    return lua_yieldk(L, 0, interval, camera_ready_continue);
+}
+
+static int lua_task_camera_ready(lua_State *L)
+{
+    current_task(L);
+    return camera_ready_continue(L, LUA_OK, 0);
+}
+
+static int bluetooth_drain_continue(lua_State *L,
+                                    int status,
+                                    lua_KContext context)
+{
+    if (!bluetooth_is_sending())
+    {
+        return 0;
+    }
+
+    // Checked again after each SoftDevice event
+    struct task *task = current_task(L);
+    task->waiting_for_event = true;
+
+    return lua_yieldk(L, 0, context, bluetooth_drain_continue);
+}
+
+static int lua_task_bluetooth_drain(lua_State *L)
+{
+    current_task(L);
+    return bluetooth_drain_continue(L, LUA_OK, 0);
+}
+
+static bool resume_task(lua_State *L, size_t index)
+{
+    struct task *task = &tasks[index];
+    lua_State *thread = task->thread;
+    int arguments = task->arguments;
+
+    // A plain coroutine.yield() resumes again straight away
+    task->arguments = 0;
+    task->waiting_for_event = false;
+    task->resume_at = 0;
+
+    int results;
+    int status = lua_resume(thread, L, arguments, &results);
+
+    if (status == LUA_YIELD)
+    {
+        lua_pop(thread, results);
+        return true;
+    }
+
+    if (status != LUA_OK)
+    {
+        lua_xmove(thread, L, 1);
+        lua_error(L);
+    }
+
+    // Tasks spawned while it ran don't move it, as they're added to the end
+    remove_task(L, index);
+
+    return false;
+}
+
+static int task_scheduler(lua_State *L)
+{
+    while (task_count > 0)
+    {
+        uint64_t now = time_monotonic_us();
+
+        for (size_t i = 0; i < task_count;)
+        {
+            if (tasks[i].waiting_for_event || tasks[i].resume_at <= now)
+            {
+                if (!resume_task(L, i))
+                {
+                    continue;
+                }
+
+                lua_system_run_pending(L);
+            }
+
+            i++;
+        }
+
+        // Sleep until the earliest task is due, if none are already
+        uint64_t wake_up = 0;
+        bool ready = false;
+
+        now = time_monotonic_us();
+
+        for (size_t i = 0; i < task_count; i++)
+        {
+            if (tasks[i].waiting_for_event)
+            {
+                continue;
+            }
+
+            if (tasks[i].resume_at <= now)
+            {
+                ready = true;
+                break;
+            }
+
+            if (wake_up == 0 || tasks[i].resume_at < wake_up)
+            {
+                wake_up = tasks[i].resume_at;
+            }
+        }
+
+        if (ready || task_count == 0)
+        {
+            lua_system_run_pending(L);
+        }
+        else
+        {
+            lua_system_wait(L, wake_up);
+        }
+    }
+
+    return 0;
+}
+
+static int lua_task_run(lua_State *L)
+{
+    if (find_task(L) != NULL)
+    {
+        luaL_error(L, "can't run tasks from within a task");
+    }
+
+    lua_pushcfunction(L, task_scheduler);
+    int status = lua_pcall(L, 0, 0, 0);
+
+    time_cancel_alarm(TIME_ALARM_SLEEP);
+
+    if (status != LUA_OK)
+    {
+        // Abandon the other tasks, such as after a break signal
+        while (task_count > 0)
+        {
+            remove_task(L, task_count - 1);
+        }
+
+        return lua_error(L);
+    }
+
+    return 0;
+}
+
+void lua_open_task_library(lua_State *L)
+{
+    // Any previous tasks belonged to the old Lua state
+    task_count = 0;
+
+    lua_getglobal(L, "frame");
+
+    lua_newtable(L);
+
+    lua_pushcfunction(L, lua_task_spawn);
+    lua_setfield(L, -2, "spawn");
+
+    lua_pushcfunction(L, lua_task_run);
+    lua_setfield(L, -2, "run");
+
+    lua_pushcfunction(L, lua_task_sleep);
+    lua_setfield(L, -2, "sleep");
+
+    lua_pushcfunction(L, lua_task_camera_ready);
+    lua_setfield(L, -2, "camera_ready");
+
+    lua_pushcfunction(L, lua_task_bluetooth_drain);
+    lua_setfield(L, -2, "bluetooth_drain");
+
+    lua_setfield(L, -2, "task");
+
+    lua_pop(L, 1);
+}
@@ -26,32 +26,214 @@
 #include <stdbool.h>
 #include <time.h>
 #include "error_logging.h"
+#include "frame_lua_libraries.h"
 #include "lauxlib.h"
 #include "lua.h"
 #include "nrfx_rtc.h"
 
+/*
+ * The RTC counts at 32768Hz without interrupting, and time is read from its
+ * counter. It only interrupts when the 24 bit counter overflows, every 512
+ * seconds, which counts up the epoch, or when an alarm set on one of its
+ * compare channels is due.
+ *
+ * The interrupt runs at the highest application priority, so that no other
+ * interrupt can read the time between the overflow being cleared and the epoch
+ * being counted up.
+ */
+
 static const nrfx_rtc_t rtc = NRFX_RTC_INSTANCE(1);
 
-static uint64_t utc_time_ms = 0;
+#define RTC_FREQUENCY 32768
+#define RTC_COUNTER_BITS 24
+
+// The RTC can miss a compare value set less than this many ticks ahead
+#define RTC_MIN_COMPARE_TICKS 2
+
+static volatile uint64_t overflow_epochs = 0;
+static int64_t utc_offset_us = 0;
 static int8_t time_zone_offset_hours;
 static uint8_t time_zone_offset_minutes;
 
+static struct time_alarm
+{
+    volatile bool active;
+    uint64_t deadline_ticks;
+    void (*handler)(void);
+} alarms[TIME_ALARM_COUNT];
+
+#if TIME_ALARM_COUNT > 4
+#error "the RTC only has four compare channels"
+#endif
+
+// Alarm handlers set alarms themselves, so only re-enable the interrupt if it
+// was enabled to begin with
+static bool rtc_irq_lock(void)
+{
+    bool enabled = NRFX_IRQ_IS_ENABLED(rtc.irq);
+    NRFX_IRQ_DISABLE(rtc.irq);
+    return enabled;
+}
+
+static void rtc_irq_unlock(bool enabled)
+{
+    if (enabled)
+    {
+        NRFX_IRQ_ENABLE(rtc.irq);
+    }
+}
+
+// Only called with the RTC interrupt disabled, or from within it
+static uint64_t ticks_now_locked(void)
+{
+    uint32_t counter = nrfx_rtc_counter_get(&rtc);
+    uint64_t epochs = overflow_epochs;
+
+    // An overflow that's yet to be counted. Reading again ensures the counter
+    // is from after it, rather than just before
+    if (nrf_rtc_event_check(rtc.p_reg, NRF_RTC_EVENT_OVERFLOW))
+    {
+        counter = nrfx_rtc_counter_get(&rtc);
+        epochs++;
+    }
+
+    return epochs << RTC_COUNTER_BITS | counter;
+}
+
+static uint64_t ticks_now(void)
+{
+    bool enabled = rtc_irq_lock();
+    uint64_t ticks = ticks_now_locked();
+    rtc_irq_unlock(enabled);
+
+    return ticks;
+}
+
+static uint64_t ticks_to_us(uint64_t ticks)
+{
+    // 1000000 / 32768 reduces to 15625 / 512
+    return ticks * 15625 / 512;
+}
+
+static uint64_t us_to_ticks(uint64_t us)
+{
+    // Rounded up, so that alarms are never early
+    return (us * 512 + 15624) / 15625;
+}
+
+uint64_t time_monotonic_us(void)
+{
+    return ticks_to_us(ticks_now());
+}
+
+uint64_t time_utc_us(void)
+{
+    return time_monotonic_us() + utc_offset_us;
+}
+
+uint64_t time_utc_ms(void)
+{
+    return time_utc_us() / 1000;
+}
+
+// Only called with the RTC interrupt disabled, or from within it
+static void arm_alarm(time_alarm_t alarm)
+{
+    uint64_t deadline = alarms[alarm].deadline_ticks;
+    uint64_t target;
+
+    // Only the lower bits of the deadline can be compared, so one further than
+    // an overflow away first matches early, and is then set again. If the
+    // counter passes the target while it's being set, try again further on
+    do
+    {
+        uint64_t now = ticks_now_locked();
+        target = deadline > now + RTC_MIN_COMPARE_TICKS
+                     ? deadline
+                     : now + RTC_MIN_COMPARE_TICKS;
+
+        check_error(nrfx_rtc_cc_set(&rtc,
+                                    alarm,
+                                    (uint32_t)target & NRF_RTC_COUNTER_MAX,
+                                    true));
+
+    } while (ticks_now_locked() + RTC_MIN_COMPARE_TICKS > target);
+}
+
+void time_set_alarm(time_alarm_t alarm,
+                    uint64_t monotonic_us,
+                    void (*handler)(void))
+{
+    bool enabled = rtc_irq_lock();
+
+    alarms[alarm].deadline_ticks = us_to_ticks(monotonic_us);
+    alarms[alarm].handler = handler;
+    alarms[alarm].active = true;
+
+    arm_alarm(alarm);
+
+    rtc_irq_unlock(enabled);
+}
+
+void time_cancel_alarm(time_alarm_t alarm)
+{
+    bool enabled = rtc_irq_lock();
+
+    alarms[alarm].active = false;
+    check_error(nrfx_rtc_cc_disable(&rtc, alarm));
+
+    rtc_irq_unlock(enabled);
+}
+
 static void rtc_event_handler(nrfx_rtc_int_type_t int_type)
 {
-    utc_time_ms++;
+    if (int_type == NRFX_RTC_INT_OVERFLOW)
+    {
+        overflow_epochs++;
+        return;
+    }
+
+    if (int_type > NRFX_RTC_INT_COMPARE3 || int_type >= TIME_ALARM_COUNT)
+    {
+        return;
+    }
+
+    time_alarm_t alarm = (time_alarm_t)int_type;
+
+    if (!alarms[alarm].active)
+    {
+        return;
+    }
+
+    if (ticks_now_locked() < alarms[alarm].deadline_ticks)
+    {
+        arm_alarm(alarm);
+        return;
+    }
+
+    alarms[alarm].active = false;
+
+    // Without a handler, the alarm only wakes the CPU
+    if (alarms[alarm].handler != NULL)
+    {
+        alarms[alarm].handler();
+    }
 }
 
 static int lua_time_utc(lua_State *L)
 {
     if (lua_gettop(L) == 0)
     {
-        lua_pushnumber(L, (lua_Number)utc_time_ms / 1000);
+        lua_pushnumber(L, (lua_Number)time_utc_us() / 1000000);
         return 1;
     }
 
-    NRFX_IRQ_DISABLE(rtc.irq);
-    utc_time_ms = luaL_checkinteger(L, 1) * 1000;
-    NRFX_IRQ_ENABLE(rtc.irq);
+    int64_t utc_us = luaL_checkinteger(L, 1) * 1000000;
+
+    // Interrupts read the offset too, and it can't be written in one access
+    NRFX_CRITICAL_SECTION_ENTER();
+    utc_offset_us = utc_us - (int64_t)time_monotonic_us();
+    NRFX_CRITICAL_SECTION_EXIT();
 
     return 0;
 }
@@ -142,7 +324,7 @@ static int lua_time_date(lua_State *L)
     // Get local time as table
     if (lua_gettop(L) == 0)
     {
-        time_t local_time_now_s = (utc_time_ms / 1000) +
+        time_t local_time_now_s = (time_utc_us() / 1000000) +
                                   (time_zone_offset_minutes * 60) +
                                   (time_zone_offset_hours * 60 * 60);
 
@@ -169,12 +351,12 @@ void lua_open_time_library(lua_State *L)
     {
         nrfx_rtc_config_t config = NRFX_RTC_DEFAULT_CONFIG;
 
-        config.prescaler = NRF_RTC_FREQ_TO_PRESCALER(1000);
-        config.interrupt_priority = 6;
+        config.prescaler = NRF_RTC_FREQ_TO_PRESCALER(RTC_FREQUENCY);
+        config.interrupt_priority = 2;
 
         check_error(nrfx_rtc_init(&rtc, &config, rtc_event_handler));
 
-        nrfx_rtc_tick_enable(&rtc, true);
+        nrfx_rtc_overflow_enable(&rtc, true);
         nrfx_rtc_enable(&rtc);
     }
 
@@ -103,6 +103,12 @@ int show_pairing_screen(bool is_paired, bool is_update)
     return status;
 }
 
+static int lua_repl_idle(lua_State *L)
+{
+    lua_system_wait(L, 0);
+    return 0;
+}
+
 void run_lua(bool is_paired)
 {
     lua_State *L = luaL_newstate();
@@ -140,6 +146,8 @@ void run_lua(bool is_paired)
     lua_open_time_library(L);
     lua_open_led_library(L);
     lua_open_compression_library(L);
+    lua_open_task_library(L);
+    lua_open_rpc_library(L);
 
     lua_open_file_library(L, !is_paired);
 
@@ -197,12 +205,14 @@ void run_lua(bool is_paired)
                 lua_pop(L, -1);
             }
         }
+        // Wait for input, running any callbacks as they come in
         else
         {
-            int status = luaL_dostring(L, "frame.sleep(0.01)");
-            if (status != LUA_OK)
+            lua_pushcfunction(L, lua_repl_idle);
+
+            if (lua_pcall(L, 0, 0, 0) != LUA_OK)
             {
-                lua_pop(L, -1);
+                lua_pop(L, 1);
             }
         }
     }
@@ -108,6 +108,15 @@ void shutdown(bool enable_imu_wakeup)
         check_error(i2c_write(ACCELEROMETER, 0x07, 0xFF, 0x00).fail);
     }
 
+    // Otherwise only wake up on taps, and not on every new sample
+    else
+    {
+        check_error(i2c_write(ACCELEROMETER, 0x07, 0xFF, 0xC0).fail);
+        check_error(i2c_write(ACCELEROMETER, 0x06, 0xFF, 0x08).fail);
+        check_error(i2c_write(ACCELEROMETER, 0x07, 0xFF, 0xC1).fail);
+        check_error(i2c_read(ACCELEROMETER, 0x03, 0xFF).fail);
+    }
+
     nrf_gpio_pin_clear(FPGA_PROGRAM_PIN);
     nrfx_systick_delay_ms(100);
 
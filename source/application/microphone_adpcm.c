@@ -0,0 +1,160 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * IMA ADPCM encoder for microphone audio, which packs each 16 bit sample into
+ * 4 bits. Every packet starts with the encoder state, so that each one can be
+ * decoded on its own, and a lost packet doesn't corrupt those that follow.
+ *
+ * Packet layout:
+ *
+ *   0..1  Predicted sample before the first code, signed and LSB first
+ *   2     Step index before the first code
+ *   3     Reserved, always 0
+ *   4..   Codes, two per byte, with the earlier sample in the low nibble
+ */
+
+#include "microphone_adpcm.h"
+
+static const int8_t index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8};
+
+static const int16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+void microphone_adpcm_reset(microphone_adpcm_t *adpcm)
+{
+    adpcm->predictor = 0;
+    adpcm->step_index = 0;
+}
+
+size_t microphone_adpcm_packet_samples(size_t packet_bytes)
+{
+    if (packet_bytes <= MICROPHONE_ADPCM_HEADER_BYTES)
+    {
+        return 0;
+    }
+
+    return 2 * (packet_bytes - MICROPHONE_ADPCM_HEADER_BYTES);
+}
+
+static uint8_t encode_sample(microphone_adpcm_t *adpcm, int16_t sample)
+{
+    int32_t step = step_table[adpcm->step_index];
+    int32_t difference = sample - adpcm->predictor;
+    uint8_t code = 0;
+
+    if (difference < 0)
+    {
+        code = 8;
+        difference = -difference;
+    }
+
+    // Quantise the difference, and track what the decoder will reconstruct
+    int32_t reconstructed = step >> 3;
+
+    if (difference >= step)
+    {
+        code |= 4;
+        difference -= step;
+        reconstructed += step;
+    }
+
+    step >>= 1;
+
+    if (difference >= step)
+    {
+        code |= 2;
+        difference -= step;
+        reconstructed += step;
+    }
+
+    step >>= 1;
+
+    if (difference >= step)
+    {
+        code |= 1;
+        reconstructed += step;
+    }
+
+    int32_t predictor = adpcm->predictor;
+    predictor += code & 8 ? -reconstructed : reconstructed;
+
+    if (predictor > INT16_MAX)
+    {
+        predictor = INT16_MAX;
+    }
+    else if (predictor < INT16_MIN)
+    {
+        predictor = INT16_MIN;
+    }
+
+    adpcm->predictor = (int16_t)predictor;
+
+    int32_t step_index = adpcm->step_index + index_table[code];
+
+    if (step_index < 0)
+    {
+        step_index = 0;
+    }
+    else if (step_index > 88)
+    {
+        step_index = 88;
+    }
+
+    adpcm->step_index = (uint8_t)step_index;
+
+    return code;
+}
+
+size_t microphone_adpcm_encode_packet(microphone_adpcm_t *adpcm,
+                                      const int16_t *samples,
+                                      size_t sample_count,
+                                      uint8_t *packet)
+{
+    packet[0] = (uint8_t)adpcm->predictor;
+    packet[1] = (uint8_t)((uint16_t)adpcm->predictor >> 8);
+    packet[2] = adpcm->step_index;
+    packet[3] = 0;
+
+    size_t length = MICROPHONE_ADPCM_HEADER_BYTES;
+
+    for (size_t i = 0; i + 1 < sample_count; i += 2)
+    {
+        uint8_t low = encode_sample(adpcm, samples[i]);
+        uint8_t high = encode_sample(adpcm, samples[i + 1]);
+        packet[length++] = (uint8_t)(low | high << 4);
+    }
+
+    return length;
+}
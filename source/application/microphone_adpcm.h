@@ -0,0 +1,48 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Predictor (int16, LSB first), step index and a reserved byte
+#define MICROPHONE_ADPCM_HEADER_BYTES 4
+
+typedef struct microphone_adpcm_t
+{
+    int16_t predictor;
+    uint8_t step_index;
+} microphone_adpcm_t;
+
+void microphone_adpcm_reset(microphone_adpcm_t *adpcm);
+
+// Samples needed to fill a packet of the given size
+size_t microphone_adpcm_packet_samples(size_t packet_bytes);
+
+// Encodes an even number of samples, and returns the size of the packet
+size_t microphone_adpcm_encode_packet(microphone_adpcm_t *adpcm,
+                                      const int16_t *samples,
+                                      size_t sample_count,
+                                      uint8_t *packet);
@@ -0,0 +1,241 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Decimates the 16kHz microphone samples by an integer ratio, with a low pass
+ * FIR filter to stop anything above the new Nyquist frequency from aliasing
+ * into the audio band.
+ *
+ * The filter is a Blackman windowed sinc, designed for the ratio when started,
+ * and applied in Q15. Only the outputs that are kept are computed, which is
+ * the same work as splitting the filter into one phase per input sample of
+ * each output. New input is appended to the history so that every output is a
+ * contiguous dot product. On the Cortex-M4, taps are taken two at a time with
+ * the dual 16 bit multiply accumulate instruction.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "microphone_decimator.h"
+
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#include <arm_acle.h>
+#endif
+
+// Cutoff as a fraction of the output Nyquist frequency
+#define CUTOFF 0.9f
+
+#define PI_F 3.14159265f
+
+void microphone_decimator_init(microphone_decimator_t *decimator,
+                               uint8_t ratio)
+{
+    if (ratio < 1)
+    {
+        ratio = 1;
+    }
+
+    if (ratio > MICROPHONE_DECIMATOR_MAX_RATIO)
+    {
+        ratio = MICROPHONE_DECIMATOR_MAX_RATIO;
+    }
+
+    decimator->ratio = ratio;
+    decimator->taps = ratio * MICROPHONE_DECIMATOR_TAPS_PER_PHASE;
+    decimator->phase = 0;
+
+    memset(decimator->history, 0, sizeof(decimator->history));
+
+    if (ratio == 1)
+    {
+        return;
+    }
+
+    float cutoff = CUTOFF / ratio;
+    float centre = (decimator->taps - 1) / 2.0f;
+    float taps[MICROPHONE_DECIMATOR_MAX_TAPS];
+    float sum = 0.0f;
+
+    for (uint16_t i = 0; i < decimator->taps; i++)
+    {
+        float x = i - centre;
+        float sinc = sinf(PI_F * cutoff * x) / (PI_F * cutoff * x);
+        float phase = 2.0f * PI_F * i / (decimator->taps - 1);
+        float window = 0.42f - 0.5f * cosf(phase) + 0.08f * cosf(2.0f * phase);
+
+        taps[i] = sinc * window;
+        sum += taps[i];
+    }
+
+    // Normalise for unity gain at DC
+    for (uint16_t i = 0; i < decimator->taps; i++)
+    {
+        float coefficient = roundf(taps[i] / sum * 32768.0f);
+
+        decimator->coefficients[decimator->taps - 1 - i] =
+            coefficient > 32767.0f ? 32767 : (int16_t)coefficient;
+    }
+}
+
+static int32_t dot_product(const int16_t *samples,
+                           const int16_t *coefficients,
+                           uint16_t taps)
+{
+    int32_t accumulator = 0;
+
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+    // Taps are always a multiple of four, so unroll by two pairs
+    for (uint16_t i = 0; i < taps; i += 4)
+    {
+        int16x2_t samples_0, samples_1, coefficients_0, coefficients_1;
+        memcpy(&samples_0, samples + i, sizeof(samples_0));
+        memcpy(&samples_1, samples + i + 2, sizeof(samples_1));
+        memcpy(&coefficients_0, coefficients + i, sizeof(coefficients_0));
+        memcpy(&coefficients_1, coefficients + i + 2, sizeof(coefficients_1));
+
+        accumulator = __smlad(samples_0, coefficients_0, accumulator);
+        accumulator = __smlad(samples_1, coefficients_1, accumulator);
+    }
+#else
+    for (uint16_t i = 0; i < taps; i += 4)
+    {
+        accumulator += samples[i] * coefficients[i];
+        accumulator += samples[i + 1] * coefficients[i + 1];
+        accumulator += samples[i + 2] * coefficients[i + 2];
+        accumulator += samples[i + 3] * coefficients[i + 3];
+    }
+#endif
+
+    return accumulator;
+}
+
+static size_t process_block(microphone_decimator_t *decimator,
+                            const int16_t *input,
+                            size_t length,
+                            int16_t *output)
+{
+    uint16_t kept = decimator->taps - 1;
+    size_t total = kept + length;
+    size_t count = 0;
+
+    memcpy(decimator->history + kept, input, length * sizeof(int16_t));
+
+    size_t start = decimator->phase;
+
+    for (; start + decimator->taps <= total; start += decimator->ratio)
+    {
+        int32_t accumulator = dot_product(decimator->history + start,
+                                          decimator->coefficients,
+                                          decimator->taps);
+
+        // Round and saturate from Q30 back to Q15
+        accumulator = (accumulator + (1 << 14)) >> 15;
+
+        if (accumulator > INT16_MAX)
+        {
+            accumulator = INT16_MAX;
+        }
+        else if (accumulator < INT16_MIN)
+        {
+            accumulator = INT16_MIN;
+        }
+
+        output[count++] = (int16_t)accumulator;
+    }
+
+    // Keep the samples needed by the next outputs
+    decimator->phase = start - length;
+    memmove(decimator->history,
+            decimator->history + length,
+            kept * sizeof(int16_t));
+
+    return count;
+}
+
+size_t microphone_decimator_process(microphone_decimator_t *decimator,
+                                    const int16_t *input,
+                                    size_t length,
+                                    int16_t *output)
+{
+    if (decimator->ratio == 1)
+    {
+        memcpy(output, input, length * sizeof(int16_t));
+        return length;
+    }
+
+    size_t count = 0;
+
+    while (length > 0)
+    {
+        size_t block = length < MICROPHONE_DECIMATOR_BLOCK_SIZE
+                           ? length
+                           : MICROPHONE_DECIMATOR_BLOCK_SIZE;
+
+        count += process_block(decimator, input, block, output + count);
+
+        input += block;
+        length -= block;
+    }
+
+    return count;
+}
+
+static uint32_t next_random(uint32_t *state)
+{
+    // Xorshift, which is plenty for dither
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+int8_t microphone_decimator_to_8_bit(int16_t sample,
+                                     bool dither,
+                                     uint32_t *dither_state)
+{
+    int32_t value = sample + 128;
+
+    // Triangular dither of +/-1 output step, from the sum of two uniform values
+    if (dither)
+    {
+        uint32_t random = next_random(dither_state);
+        value += (int32_t)(random & 0xFF) + (int32_t)((random >> 8) & 0xFF) - 255;
+    }
+
+    value >>= 8;
+
+    if (value > INT8_MAX)
+    {
+        return INT8_MAX;
+    }
+
+    if (value < INT8_MIN)
+    {
+        return INT8_MIN;
+    }
+
+    return (int8_t)value;
+}
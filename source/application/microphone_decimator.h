@@ -0,0 +1,66 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MICROPHONE_DECIMATOR_MAX_RATIO 4
+#define MICROPHONE_DECIMATOR_TAPS_PER_PHASE 32
+#define MICROPHONE_DECIMATOR_MAX_TAPS \
+    (MICROPHONE_DECIMATOR_MAX_RATIO * MICROPHONE_DECIMATOR_TAPS_PER_PHASE)
+
+// Input is processed in blocks of up to this many samples
+#define MICROPHONE_DECIMATOR_BLOCK_SIZE 128
+
+typedef struct microphone_decimator_t
+{
+    uint8_t ratio;
+    uint16_t taps;
+
+    // Where the next output's window starts in the history
+    uint16_t phase;
+
+    // Stored in reverse, so that both run forwards in the inner loop
+    int16_t coefficients[MICROPHONE_DECIMATOR_MAX_TAPS];
+
+    int16_t history[MICROPHONE_DECIMATOR_MAX_TAPS - 1 +
+                    MICROPHONE_DECIMATOR_BLOCK_SIZE];
+} microphone_decimator_t;
+
+void microphone_decimator_init(microphone_decimator_t *decimator,
+                               uint8_t ratio);
+
+size_t microphone_decimator_process(microphone_decimator_t *decimator,
+                                    const int16_t *input,
+                                    size_t length,
+                                    int16_t *output);
+
+// Rounds to 8 bits, optionally with triangular dither. The dither state can be
+// any non-zero value to begin with
+int8_t microphone_decimator_to_8_bit(int16_t sample,
+                                     bool dither,
+                                     uint32_t *dither_state);
@@ -0,0 +1,177 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Voice activity detection from the energy and zero crossing rate of each
+ * block of audio.
+ *
+ * A block counts as speech when its energy is some threshold above the noise
+ * floor, and it doesn't change sign so often that it looks like hiss. Blocks
+ * well above the threshold count regardless, so that loud unvoiced sounds
+ * such as "s" aren't cut out. Speech starts once it's lasted the onset time,
+ * which ignores clicks and knocks, and stops once there's been silence for
+ * the hangover time, which bridges the gaps between words.
+ *
+ * The noise floor follows quiet blocks down quickly, and rises at a limited
+ * rate in dB. It also rises during speech, more slowly still, so that a lasting
+ * change in the background noise isn't mistaken for someone talking forever.
+ */
+
+#include <math.h>
+#include "microphone_vad.h"
+
+// Nothing below about -60dBFS counts as speech, however quiet the room is
+#define MIN_ENERGY 1000.0f
+
+// Blocks this far above the threshold are speech, whatever their crossing rate
+#define LOUD_MARGIN 4.0f
+
+// The noise floor falls with this time constant in seconds, and rises no
+// faster than these rates in dB per second
+#define NOISE_FALL_TIME 0.05f
+#define NOISE_RISE_RATE 3.0f
+#define NOISE_RISE_RATE_DURING_SPEECH 0.5f
+
+void microphone_vad_init(microphone_vad_t *vad,
+                         uint32_t sample_rate,
+                         float threshold_db,
+                         float zero_crossing_limit,
+                         float onset_seconds,
+                         float hangover_seconds)
+{
+    vad->sample_rate = sample_rate;
+    vad->threshold = powf(10.0f, threshold_db / 10.0f);
+    vad->zero_crossing_limit = zero_crossing_limit;
+    vad->onset_samples = (uint32_t)(onset_seconds * (float)sample_rate);
+    vad->hangover_samples = (uint32_t)(hangover_seconds * (float)sample_rate);
+
+    vad->noise_energy = MIN_ENERGY;
+    vad->noise_initialised = false;
+    vad->previous_sample = 0;
+
+    vad->speech_samples = 0;
+    vad->silence_samples = 0;
+    vad->active = false;
+}
+
+static void update_noise_floor(microphone_vad_t *vad,
+                               float energy,
+                               size_t count,
+                               bool speech)
+{
+    float seconds = (float)count / (float)vad->sample_rate;
+
+    if (energy < vad->noise_energy)
+    {
+        float alpha = seconds / NOISE_FALL_TIME;
+        alpha = alpha > 1.0f ? 1.0f : alpha;
+        vad->noise_energy += (energy - vad->noise_energy) * alpha;
+        return;
+    }
+
+    // Rising is limited in dB, so loud speech doesn't drag the floor up
+    float rate = speech ? NOISE_RISE_RATE_DURING_SPEECH : NOISE_RISE_RATE;
+    float limit = vad->noise_energy * powf(10.0f, rate * seconds / 10.0f);
+
+    vad->noise_energy = energy < limit ? energy : limit;
+}
+
+microphone_vad_event_t microphone_vad_process(microphone_vad_t *vad,
+                                              const int16_t *samples,
+                                              size_t count)
+{
+    if (count == 0)
+    {
+        return MICROPHONE_VAD_NO_CHANGE;
+    }
+
+    float energy = 0.0f;
+    size_t zero_crossings = 0;
+    int16_t previous = vad->previous_sample;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        float sample = (float)samples[i];
+        energy += sample * sample;
+
+        if ((samples[i] < 0) != (previous < 0))
+        {
+            zero_crossings++;
+        }
+
+        previous = samples[i];
+    }
+
+    vad->previous_sample = previous;
+    energy /= (float)count;
+
+    float zero_crossing_rate = (float)zero_crossings / (float)count;
+
+    if (!vad->noise_initialised)
+    {
+        vad->noise_energy = energy;
+        vad->noise_initialised = true;
+    }
+
+    float noise_floor = vad->noise_energy > MIN_ENERGY ? vad->noise_energy
+                                                       : MIN_ENERGY;
+    float threshold = noise_floor * vad->threshold;
+
+    bool speech = energy > threshold &&
+                  (zero_crossing_rate <= vad->zero_crossing_limit ||
+                   energy > threshold * LOUD_MARGIN);
+
+    update_noise_floor(vad, energy, count, speech);
+
+    if (speech)
+    {
+        vad->speech_samples += count;
+        vad->silence_samples = 0;
+    }
+    else
+    {
+        vad->silence_samples += count;
+
+        // Onset has to be continuous, whereas hangover bridges short gaps
+        if (!vad->active)
+        {
+            vad->speech_samples = 0;
+        }
+    }
+
+    if (!vad->active && vad->speech_samples >= vad->onset_samples && speech)
+    {
+        vad->active = true;
+        return MICROPHONE_VAD_SPEECH_STARTED;
+    }
+
+    if (vad->active && vad->silence_samples >= vad->hangover_samples)
+    {
+        vad->active = false;
+        vad->speech_samples = 0;
+        return MICROPHONE_VAD_SPEECH_STOPPED;
+    }
+
+    return MICROPHONE_VAD_NO_CHANGE;
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Defaults for frame.microphone.start{vad=...}
+#define MICROPHONE_VAD_DEFAULT_THRESHOLD_DB 9.0f
+#define MICROPHONE_VAD_DEFAULT_ZERO_CROSSING_LIMIT 0.35f
+#define MICROPHONE_VAD_DEFAULT_ONSET_SECONDS 0.03f
+#define MICROPHONE_VAD_DEFAULT_HANGOVER_SECONDS 0.3f
+
+typedef enum microphone_vad_event_t
+{
+    MICROPHONE_VAD_NO_CHANGE,
+    MICROPHONE_VAD_SPEECH_STARTED,
+    MICROPHONE_VAD_SPEECH_STOPPED,
+} microphone_vad_event_t;
+
+typedef struct microphone_vad_t
+{
+    uint32_t sample_rate;
+
+    // Energy ratio above the noise floor, and the fraction of samples which
+    // may change sign, for a block to count as speech
+    float threshold;
+    float zero_crossing_limit;
+
+    // How long speech must last before it starts, and silence before it stops
+    uint32_t onset_samples;
+    uint32_t hangover_samples;
+
+    float noise_energy;
+    bool noise_initialised;
+    int16_t previous_sample;
+
+    uint32_t speech_samples;
+    uint32_t silence_samples;
+    bool active;
+} microphone_vad_t;
+
+void microphone_vad_init(microphone_vad_t *vad,
+                         uint32_t sample_rate,
+                         float threshold_db,
+                         float zero_crossing_limit,
+                         float onset_seconds,
+                         float hangover_seconds);
+
+// Blocks are best kept to around 10ms, as each is classified as a whole
+microphone_vad_event_t microphone_vad_process(microphone_vad_t *vad,
+                                              const int16_t *samples,
+                                              size_t count);
@@ -76,9 +76,11 @@ VERILOG_FILES += \
         $(CAMERA_PATH)/image_buffer.sv \
         $(CAMERA_PATH)/spi_registers.sv \
         $(JPEG_PATH)/jenc_cdc.sv \
+        $(CAMERA_PATH)/binning.sv \
         $(CAMERA_PATH)/crop.sv \
         $(CAMERA_PATH)/debayer.sv \
         $(CAMERA_PATH)/metering.sv \
+        $(CAMERA_PATH)/histogram.sv \
         $(CAMERA_PATH)/gamma_correction.sv \
         $(CAMERA_PATH)/camera.sv \
 
@@ -92,7 +94,9 @@ VERILOG_FILES += \
         $(MODULES_PATH)/graphics/display_buffers.sv \
         $(MODULES_PATH)/graphics/display_driver.sv \
         $(MODULES_PATH)/graphics/graphics.sv \
+        $(MODULES_PATH)/graphics/sprite_cache.sv \
         $(MODULES_PATH)/graphics/sprite_engine.sv \
+        $(MODULES_PATH)/graphics/vector_engine.sv \
 
 # inferrable RAM models
 VERILOG_FILES += \
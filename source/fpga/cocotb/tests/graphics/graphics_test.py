@@ -14,6 +14,45 @@ from cocotb.triggers import ClockCycles, RisingEdge, FallingEdge, Timer
 from tb_top import SpiTransactor, clock_n_reset
 
 
+def bresenham(x0, y0, x1, y1):
+    """Reference line rasterizer matching the vector engine"""
+    dx, sx = abs(x1 - x0), 1 if x0 < x1 else -1
+    dy, sy = -abs(y1 - y0), 1 if y0 < y1 else -1
+    err = dx + dy
+    pixels = set()
+    while True:
+        pixels.add((x0, y0))
+        if x0 == x1 and y0 == y1:
+            return pixels
+        e2 = 2 * err
+        if e2 >= dy:
+            err += dy
+            x0 += sx
+        if e2 <= dx:
+            err += dx
+            y0 += sy
+
+
+async def vector_pixel_monitor(dut, pixels):
+    """Collects every pixel accepted from the vector engine"""
+    g = dut.dut.graphics
+    while True:
+        await RisingEdge(g.display_clock_in)
+        if g.vector_engine.pixel_write_enable_out.value and g.vector_engine.pixel_write_ready_in.value:
+            a = int(g.vector_engine.pixel_write_address_out.value)
+            pixels[(a % 640, a // 640)] = int(g.vector_engine.pixel_write_data_out.value)
+
+
+async def draw_vector(t, shape, x0, y0, x1, y1, color):
+    await t.spi_write(0x13, [shape, x0 >> 8, x0 & 0xff, y0 >> 8, y0 & 0xff, x1 >> 8, x1 & 0xff, y1 >> 8, y1 & 0xff, color])
+    for i in range(100):
+        await Timer(10, units='us')
+        read_bytes = await t.spi_read(0x18)
+        if read_bytes[0] & 0x08 == 0:
+            return
+    assert False, "Vector engine still busy"
+
+
 @cocotb.test()
 async def spi_test(dut):
     log_level = os.environ.get('LOG_LEVEL', 'INFO') # NOTSET=0 DEBUG=10 INFO=20 WARN=30 ERROR=40 CRITICAL=50
@@ -83,6 +122,50 @@ async def spi_test(dut):
     await t.spi_command(0x14)
     read_bytes = await t.spi_read(0x18)
 
+    await Timer(25, units='ms')
+
+    #   5. Test sprite cache
+    await t.spi_write(0x15, [
+        0x00,           # Handle
+        0x00, 0x00,     # Cache address
+        0x00, 0x10,     # Width
+        0x02,           # Total colors
+        0xff, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00,
+        0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff,
+    ])
+    for y in [0x32, 0x64, 0x96]:
+        await t.spi_write(0x16, [
+            0x00, 0x96,     # X pos
+            0x00, y,        # Y pos
+            0x00,           # Handle
+            0x01,           # palette offset
+        ])
+        await Timer(100, units='us')
+        read_bytes = await t.spi_read(0x18)
+        assert read_bytes[0] & 0x04 == 0, f"Sprite cache still busy: {[hex(i) for i in read_bytes]}"
+    await t.spi_command(0x14)
+
+    await Timer(25, units='ms')
+
+    #   6. Test vector engine
+    pixels = {}
+    monitor = cocotb.start_soon(vector_pixel_monitor(dut, pixels))
+
+    for x0, y0, x1, y1 in [(10, 10, 30, 17), (30, 40, 12, 60), (100, 100, 100, 120), (50, 5, 50, 5)]:
+        pixels.clear()
+        await draw_vector(t, 0, x0, y0, x1, y1, 3)
+        expected = bresenham(x0, y0, x1, y1)
+        assert set(pixels.keys()) == expected, f"Line {(x0, y0, x1, y1)}: Expected {sorted(expected)}. Received {sorted(pixels.keys())}."
+        assert set(pixels.values()) == {3}, f"Line {(x0, y0, x1, y1)}: Wrong color {set(pixels.values())}."
+
+    pixels.clear()
+    await draw_vector(t, 1, 207, 52, 200, 50, 5)
+    expected = {(x, y) for x in range(200, 208) for y in range(50, 53)}
+    assert set(pixels.keys()) == expected, f"Rectangle: Expected {sorted(expected)}. Received {sorted(pixels.keys())}."
+
+    monitor.kill()
+    await t.spi_command(0x14)
+
     await Timer(25, units='ms')
     #           // Show command
     #           send_opcode('h14);
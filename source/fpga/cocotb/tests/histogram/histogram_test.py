@@ -0,0 +1,128 @@
+#
+# This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+#
+# Authored by: Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+#              Raj Nakarja / Brilliant Labs Limited (raj@brilliant.xyz)
+#
+# CERN Open Hardware Licence Version 2 - Permissive
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+import os
+import numpy as np
+
+import cocotb
+from cocotb.clock import Clock
+from cocotb.triggers import ClockCycles, RisingEdge, Timer
+
+BINS = 64
+ZONES = 16
+
+np.random.seed(0)
+
+
+def reference_statistics(red, green, blue):
+    """Model of the histogram and zone sums, as computed by histogram.sv"""
+    height, width = red.shape
+    luma = (red.astype(int) + 2 * green.astype(int) + blue.astype(int)) >> 4
+
+    histogram = np.bincount((luma >> 2).flatten(), minlength=BINS) >> 3
+
+    zone_width = width >> 2
+    zone_height = height >> 2
+    zone_x = np.minimum(np.arange(width) // max(zone_width, 1), 3)
+    zone_y = np.minimum(np.arange(height) // max(zone_height, 1), 3)
+    zones = np.zeros(ZONES, dtype=int)
+    for y in range(height):
+        for x in range(width):
+            zones[zone_y[y] * 4 + zone_x[x]] += luma[y, x]
+
+    return list(histogram) + list(zones >> 8)
+
+
+async def send_frame(dut, red, green, blue):
+    height, width = red.shape
+    dut.x_size_in.value = width
+    dut.y_size_in.value = height
+
+    await RisingEdge(dut.clock_in)
+    dut.frame_valid_in.value = 1
+    await ClockCycles(dut.clock_in, 10)
+
+    for y in range(height):
+        dut.line_valid_in.value = 1
+        for x in range(width):
+            dut.red_data_in.value = int(red[y, x])
+            dut.green_data_in.value = int(green[y, x])
+            dut.blue_data_in.value = int(blue[y, x])
+            await RisingEdge(dut.clock_in)
+        dut.line_valid_in.value = 0
+
+        # Last line ends together with the frame
+        if y < height - 1:
+            await ClockCycles(dut.clock_in, 5)
+
+    dut.frame_valid_in.value = 0
+
+    # Wait for the copy into the statistics RAM
+    await ClockCycles(dut.clock_in, BINS + ZONES + 20)
+
+
+async def read_statistics(dut):
+    statistics = []
+    for address in range(BINS + ZONES):
+        dut.statistics_address_in.value = address
+        await Timer(1, "ns")
+        statistics.append(int(dut.statistics_data_out.value))
+    return statistics
+
+
+async def check_frame(dut, name, red, green, blue):
+    await send_frame(dut, red, green, blue)
+    expected = reference_statistics(red, green, blue)
+    received = await read_statistics(dut)
+
+    for i, (e, r) in enumerate(zip(expected, received)):
+        label = f"bin {i}" if i < BINS else f"zone {i - BINS}"
+        assert e == r, f"{name}: {label} expected {e}, got {r}"
+
+    dut._log.info(f"{name}: {red.shape[1]}x{red.shape[0]} OK")
+
+
+@cocotb.test()
+async def histogram_test(dut):
+    log_level = os.environ.get("LOG_LEVEL", "INFO")
+    dut._log.setLevel(log_level)
+
+    cocotb.start_soon(Clock(dut.clock_in, 10, units="ns").start())
+
+    dut.reset_n_in.value = 0
+    dut.line_valid_in.value = 0
+    dut.frame_valid_in.value = 0
+    dut.statistics_address_in.value = 0
+    await ClockCycles(dut.clock_in, 5)
+    dut.reset_n_in.value = 1
+    await ClockCycles(dut.clock_in, BINS + ZONES + 5)
+
+    # Every pixel in the same bin, exercising the forwarding path
+    flat = np.full((32, 48), 600)
+    await check_frame(dut, "flat", flat, flat, flat)
+
+    # Alternating bins, so each read follows a write two pixels earlier
+    stripes = np.tile([100, 900], (24, 20))
+    await check_frame(dut, "stripes", stripes, stripes, stripes)
+
+    # Gradient across all bins, with sizes that don't divide into zones
+    gradient = np.tile(np.linspace(0, 1023, 61).astype(int), (37, 1))
+    await check_frame(dut, "gradient", gradient, gradient[::-1], gradient)
+
+    # Random scenes, also checking that bins are cleared between frames
+    for i in range(3):
+        height, width = np.random.randint(16, 64, 2) * 2
+        red, green, blue = np.random.randint(0, 1024, (3, height, width))
+        await check_frame(dut, f"random {i}", red, green, blue)
+
+    # Bright window on a dark background, as seen by auto exposure
+    scene = np.full((40, 40), 40)
+    scene[4:14, 24:36] = 1023
+    await check_frame(dut, "window", scene, scene, scene)
@@ -0,0 +1,101 @@
+#
+# Authored by: Robert Metchev / Raumzeit Technologies (robert@raumzeit.co)
+#
+# CERN Open Hardware Licence Version 2 - Permissive
+#
+# Copyright (C) 2024 Robert Metchev
+#
+import sys, os, time, random, logging
+
+import cocotb
+from cocotb.triggers import ClockCycles, RisingEdge, FallingEdge, Timer
+from cocotb.utils import get_sim_time
+
+from tb_top import SpiTransactor, clock_n_reset
+
+
+class SpriteEngineMonitor:
+    """Counts busy cycles and pixels written by the sprite engine"""
+    def __init__(self, dut):
+        self.g = dut.dut.graphics
+        self.busy_cycles = 0
+        self.pixels = 0
+        self.clock_period = None
+        cocotb.start_soon(self.run())
+
+    def reset(self):
+        self.busy_cycles = 0
+        self.pixels = 0
+
+    async def run(self):
+        se = self.g.sprite_engine
+        await RisingEdge(self.g.display_clock_in)
+        t0 = get_sim_time('ps')
+        await RisingEdge(self.g.display_clock_in)
+        self.clock_period = get_sim_time('ps') - t0
+        while True:
+            await RisingEdge(self.g.display_clock_in)
+            if not se.ready_out.value:
+                self.busy_cycles += 1
+            if se.pixel_write_enable_out.value:
+                self.pixels += bin(int(se.pixel_write_mask_out.value)).count('1')
+
+
+@cocotb.test()
+async def sprite_benchmark_test(dut):
+    log_level = os.environ.get('LOG_LEVEL', 'INFO') # NOTSET=0 DEBUG=10 INFO=20 WARN=30 ERROR=40 CRITICAL=50
+    dut._log.setLevel(log_level)
+
+    # SPI Transactor
+    t = SpiTransactor(dut)
+
+    # Start camera clock
+    cr = cocotb.start_soon(clock_n_reset(dut.camera_pixel_clock, None, f=36.0*10e6))       # 36 MHz clock
+
+    # Hack/Fix for missing "negedge reset" in verilator, works OK in icarus
+    await Timer(10, 'ns')
+    dut.spi_select_in.value = 0
+    await Timer(10, 'ns')
+    dut.spi_select_in.value = 1
+    await Timer(10, 'ns')
+
+    #   0. Wait for reset
+    await Timer(10, units='us')
+
+    #   1. Power up the PLL 0x40/0x41 and wait for lock
+    await t.spi_write(0x40, 0x1)
+    await Timer(20, units='us')
+    read_bytes = await t.spi_read(0x41)
+    assert read_bytes == [1] , f"PLL not locked. Received: {[hex(i) for i in read_bytes]}."
+
+    #   2. Draw one sprite in each color mode, and measure how fast the engine draws it
+    m = SpriteEngineMonitor(dut)
+    await Timer(10, units='us')
+    width = 64
+    total_bytes = 128
+
+    for total_colors in [2, 4, 16]:
+        pixels_per_byte = {2: 8, 4: 4, 16: 2}[total_colors]
+        data = [random.randint(0, 255) for i in range(total_bytes)]
+
+        m.reset()
+        await t.spi_write(0x12, [
+            0x00, 0x40,             # X pos (word aligned)
+            0x00, 0x40,             # Y pos
+            0x00, width,            # Width
+            total_colors,           # Total colors
+            0x00,                   # palette offset
+        ] + data)
+        await Timer(10, units='us')
+
+        pixels = total_bytes * pixels_per_byte
+        assert m.pixels == pixels, f"{total_colors} colors: Expected {pixels} pixels. Received {m.pixels}."
+
+        clock_hz = 1e12 / m.clock_period
+        pixels_per_second = pixels / m.busy_cycles * clock_hz
+        dut._log.info(f"{total_colors} colors: {m.busy_cycles} cycles for {pixels} pixels. "
+                      f"{pixels / m.busy_cycles:.2f} pixels/cycle, {pixels_per_second / 1e6:.1f} Mpixels/s "
+                      f"at {clock_hz / 1e6:.1f} MHz")
+
+    # Finish
+    await Timer(10, units='us')
@@ -0,0 +1,200 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Raj Nakarja / Brilliant Labs Limited (raj@brilliant.xyz)
+ *
+ * CERN Open Hardware Licence Version 2 - Permissive
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ */
+
+/*
+ * Downscales the raw Bayer image by 2x or 4x before debayering, keeping the
+ * Bayer pattern intact so that the debayer doesn't need to know about it.
+ *
+ * Horizontally, pixels of the same color are averaged. For 2x, each group of 4
+ * input pixels, e.g. B Gb B Gb, becomes 2 output pixels. For 4x, each group of
+ * 8 pixels becomes 2. Vertically, the first 2 rows of every 4 (or 8) are kept,
+ * and the rest are skipped.
+ *
+ * The debayer expects each line to arrive as one uninterrupted run of pixels,
+ * so the output of each kept row is collected in one half of a line buffer and
+ * then played out contiguously as soon as the row ends, while the next kept
+ * row fills the other half.
+ *
+ *   factor = 0 : No binning, pixels are passed straight through
+ *   factor = 1 : 2x binning, rows must be a multiple of 4 pixels wide
+ *   factor = 2 : 4x binning, rows must be a multiple of 8 pixels wide
+ */
+
+module binning (
+    input logic clock_in,
+    input logic reset_n_in,
+
+    input logic [1:0] factor_in,
+
+    input logic [9:0] pixel_data_in,
+    input logic line_valid_in,
+    input logic frame_valid_in,
+
+    output logic [9:0] pixel_data_out,
+    output logic line_valid_out,
+    output logic frame_valid_out
+);
+
+logic [1:0] factor;
+
+logic [9:0] x_counter;
+logic [9:0] y_counter;
+logic previous_line_valid;
+
+logic first_of_group;
+logic last_of_group;
+logic row_kept;
+logic row_written;
+
+logic [11:0] accumulator [1:0];
+logic [11:0] sum;
+
+logic write_bank;
+logic [8:0] write_address;
+
+logic playing;
+logic play_bank;
+logic [8:0] play_address;
+logic [8:0] play_length;
+
+logic [9:0] read_data;
+logic read_valid;
+logic [3:0] line_valid_tail;
+
+logic [9:0] line_buffer [0:1023] /* synthesis ram_style = "Block_RAM" */;
+
+always_comb begin
+    if (factor == 1) begin
+        first_of_group = x_counter[1] == 0;
+        last_of_group = x_counter[1] == 1;
+        row_kept = y_counter[1] == 0;
+    end
+
+    else begin
+        first_of_group = x_counter[2:1] == 0;
+        last_of_group = x_counter[2:1] == 3;
+        row_kept = y_counter[2:1] == 0;
+    end
+end
+
+always_comb sum = first_of_group ? pixel_data_in
+                                 : accumulator[x_counter[0]] + pixel_data_in;
+
+// Line buffer
+always_ff @(posedge clock_in) begin
+    if (line_valid_in && row_kept && last_of_group && factor != 0) begin
+        line_buffer[{write_bank, write_address}] <= factor == 1 ? sum[10:1]
+                                                                 : sum[11:2];
+    end
+
+    read_data <= line_buffer[{play_bank, play_address}];
+end
+
+always_ff @(posedge clock_in) begin
+
+    if (reset_n_in == 0) begin
+        factor <= 0;
+        x_counter <= 0;
+        y_counter <= 0;
+        previous_line_valid <= 0;
+        row_written <= 0;
+        write_bank <= 0;
+        write_address <= 0;
+        playing <= 0;
+        play_bank <= 0;
+        play_address <= 0;
+        play_length <= 0;
+        read_valid <= 0;
+        line_valid_tail <= 0;
+        line_valid_out <= 0;
+        frame_valid_out <= 0;
+    end
+
+    else begin
+
+        // Counting
+        if (frame_valid_in == 0) begin
+            factor <= factor_in; // Only changes between frames
+            x_counter <= 0;
+            y_counter <= 0;
+            previous_line_valid <= 0;
+            row_written <= 0;
+            write_address <= 0;
+        end
+
+        else begin
+            previous_line_valid <= line_valid_in;
+
+            if (line_valid_in) begin
+                x_counter <= x_counter + 1;
+
+                if (row_kept && factor != 0) begin
+                    accumulator[x_counter[0]] <= sum;
+
+                    if (last_of_group) begin
+                        write_address <= write_address + 1;
+                        row_written <= 1;
+                    end
+                end
+            end
+
+            else begin
+                x_counter <= 0;
+
+                if (previous_line_valid) begin
+                    y_counter <= y_counter + 1;
+                end
+            end
+        end
+
+        // Play out the row just completed and start filling the other half.
+        // The last row may end together with the frame
+        if (previous_line_valid && !line_valid_in && row_written) begin
+            playing <= 1;
+            play_bank <= write_bank;
+            play_address <= 0;
+            play_length <= write_address;
+            write_bank <= ~write_bank;
+            write_address <= 0;
+            row_written <= 0;
+        end
+
+        // Playing out continues even after the frame ends
+        if (playing) begin
+            play_address <= play_address + 1;
+
+            if (play_address == play_length - 1) begin
+                playing <= 0;
+            end
+        end
+
+        read_valid <= playing;
+
+        // Output
+        if (factor == 0) begin
+            pixel_data_out <= pixel_data_in;
+            line_valid_out <= line_valid_in;
+            frame_valid_out <= frame_valid_in;
+        end
+
+        else begin
+            pixel_data_out <= read_data;
+            line_valid_out <= read_valid;
+            line_valid_tail <= {line_valid_tail[2:0], line_valid_out};
+            frame_valid_out <= frame_valid_in | playing | read_valid |
+                               line_valid_out | (|line_valid_tail);
+        end
+
+    end
+
+end
+
+endmodule
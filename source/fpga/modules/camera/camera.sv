@@ -11,12 +11,14 @@
  */
 
 `ifndef RADIANT
+`include "modules/camera/binning.sv"
 `include "modules/camera/crop.sv"
 `include "modules/camera/debayer.sv"
 `include "modules/camera/gamma_correction.sv"
 `include "modules/camera/image_buffer.sv"
 `include "modules/camera/jpeg/jpeg.sv"
 `include "modules/camera/metering.sv"
+`include "modules/camera/histogram.sv"
 `include "modules/camera/spi_registers.sv"
 `endif
 
@@ -59,23 +61,42 @@ module camera (
 
 logic start_capture_spi_clock_domain;
 logic start_capture_pixel_clock_domain;
+logic release_frame_spi_clock_domain;
+logic release_frame_pixel_clock_domain;
+logic jpeg_start_capture;
 
 logic [9:0] resolution;
+logic roi_enable;
+logic [9:0] roi_x_start;
+logic [9:0] roi_y_start;
+logic [9:0] roi_width;
+logic [9:0] roi_height;
+logic [1:0] binning_factor;
+logic grayscale;
 logic [2:0] compression_factor;
 logic power_save_enable;
 logic gamma_bypass;
+logic continuous_capture;
 
 logic image_buffer_ready;               // Ready bit, high when compression finished
 logic [7:0] image_buffer_data;          // Read out data
 logic [15:0] image_buffer_address;      // Read address
 logic image_buffer_address_valid;       // qualifier
 logic [15:0] final_image_address;       // image address JPEG -> Image buffer
+logic [15:0] ready_image_address;       // final address of the image being read
+logic image_buffer_split;               // Continuous capture into two halves
+logic image_buffer_write_half;
+logic image_buffer_read_half;
+logic [15:0] frame_counter;
+logic frame_dropped;
 logic [7:0] red_center_metering;
 logic [7:0] green_center_metering;
 logic [7:0] blue_center_metering;
 logic [7:0] red_average_metering;
 logic [7:0] green_average_metering;
 logic [7:0] blue_average_metering;
+logic [6:0] statistics_address;
+logic [15:0] statistics_data;
 
 spi_registers spi_registers (
     .clock_in(spi_clock_in),
@@ -93,22 +114,36 @@ spi_registers spi_registers (
 
     .start_capture_out(start_capture_spi_clock_domain),
     .resolution_out(resolution),
+    .roi_enable_out(roi_enable),
+    .roi_x_start_out(roi_x_start),
+    .roi_y_start_out(roi_y_start),
+    .roi_width_out(roi_width),
+    .roi_height_out(roi_height),
+    .binning_out(binning_factor),
+    .grayscale_out(grayscale),
     .compression_factor_out(compression_factor),
     .power_save_enable_out(power_save_enable),
     .gamma_bypass_out(gamma_bypass),
+    .continuous_capture_out(continuous_capture),
+    .release_frame_out(release_frame_spi_clock_domain),
 
     .image_ready_in(image_buffer_ready),
-    .final_image_address(final_image_address),
+    .final_image_address(ready_image_address),
     .image_data_in(image_buffer_data),
     .image_address_out(image_buffer_address),
     .image_address_valid(image_buffer_address_valid),
+    .frame_counter_in(frame_counter),
+    .frame_dropped_in(frame_dropped),
 
     .red_center_metering_in(red_center_metering),
     .green_center_metering_in(green_center_metering),
     .blue_center_metering_in(blue_center_metering),
     .red_average_metering_in(red_average_metering),
     .green_average_metering_in(green_average_metering),
-    .blue_average_metering_in(blue_average_metering)
+    .blue_average_metering_in(blue_average_metering),
+
+    .statistics_address_out(statistics_address),
+    .statistics_data_in(statistics_data)
 );
 
 // SPI to display pulse sync
@@ -121,6 +156,15 @@ psync1 psync1_operand_valid_in (
         .out_reset_n    (pixel_reset_n_in)
 );
 
+psync1 psync1_release_frame (
+        .in             (release_frame_spi_clock_domain),
+        .in_clk         (~spi_clock_in),
+        .in_reset_n     (spi_reset_n_in),
+        .out            (release_frame_pixel_clock_domain),
+        .out_clk        (pixel_clock_in),
+        .out_reset_n    (pixel_reset_n_in)
+);
+
 `ifndef NO_MIPI_IP_SIM
 logic [9:0] byte_to_pixel_data;
 logic byte_to_pixel_line_valid;
@@ -209,18 +253,34 @@ logic [9:0] cropped_pixel_data;
 logic cropped_line_valid;
 logic cropped_frame_valid;
 
-logic [9:0] resolution_crop_start;
-logic [9:0] resolution_crop_end;
+logic [9:0] image_x_size;
+logic [9:0] image_y_size;
+logic [10:0] crop_x_size;
+logic [10:0] crop_y_size;
+logic [9:0] x_crop_start;
+logic [9:0] y_crop_start;
+logic [9:0] x_crop_end;
+logic [9:0] y_crop_end;
 
 `ifndef SENSOR_X_SIZE
 `define SENSOR_X_SIZE 722
 `endif
 
-always_comb resolution_crop_start = (`SENSOR_X_SIZE - resolution - 2) >> 1;
-always_comb resolution_crop_end = resolution_crop_start + resolution + 2;
-
-always @(negedge spi_clock_in) if (start_capture_spi_clock_domain) 
-    assert (resolution <= `SENSOR_X_SIZE - 2) else $fatal(1, "Incorrect sensor vs. image dimensions!");
+// Either a centered square, or any rectangle within the sensor. Binning widens
+// the crop, including the extra pixel around the edge needed by the debayer
+always_comb image_x_size = roi_enable ? roi_width : resolution;
+always_comb image_y_size = roi_enable ? roi_height : resolution;
+always_comb crop_x_size = (image_x_size + 2) << binning_factor;
+always_comb crop_y_size = (image_y_size + 2) << binning_factor;
+always_comb x_crop_start = roi_enable ? roi_x_start : (`SENSOR_X_SIZE - crop_x_size) >> 1;
+always_comb y_crop_start = roi_enable ? roi_y_start : (`SENSOR_X_SIZE - crop_y_size) >> 1;
+always_comb x_crop_end = x_crop_start + crop_x_size;
+always_comb y_crop_end = y_crop_start + crop_y_size;
+
+always @(negedge spi_clock_in) if (start_capture_spi_clock_domain) begin
+    assert (x_crop_start + crop_x_size <= `SENSOR_X_SIZE) else $fatal(1, "Incorrect sensor vs. image dimensions!");
+    assert (y_crop_start + crop_y_size <= `SENSOR_X_SIZE) else $fatal(1, "Incorrect sensor vs. image dimensions!");
+end
 
 crop crop (
     .clock_in(pixel_clock_in),
@@ -230,16 +290,35 @@ crop crop (
     .line_valid_in(byte_to_pixel_line_valid),
     .frame_valid_in(byte_to_pixel_frame_valid),
 
-    .x_crop_start(resolution_crop_start),
-    .x_crop_end(resolution_crop_end),
-    .y_crop_start(resolution_crop_start),
-    .y_crop_end(resolution_crop_end),
+    .x_crop_start(x_crop_start),
+    .x_crop_end(x_crop_end),
+    .y_crop_start(y_crop_start),
+    .y_crop_end(y_crop_end),
 
     .pixel_data_out(cropped_pixel_data),
     .line_valid_out(cropped_line_valid),
     .frame_valid_out(cropped_frame_valid)
 );
 
+logic [9:0] binned_pixel_data;
+logic binned_line_valid;
+logic binned_frame_valid;
+
+binning binning (
+    .clock_in(pixel_clock_in),
+    .reset_n_in(pixel_reset_n_in),
+
+    .factor_in(binning_factor),
+
+    .pixel_data_in(cropped_pixel_data),
+    .line_valid_in(cropped_line_valid),
+    .frame_valid_in(cropped_frame_valid),
+
+    .pixel_data_out(binned_pixel_data),
+    .line_valid_out(binned_line_valid),
+    .frame_valid_out(binned_frame_valid)
+);
+
 logic [9:0] debayered_red_data;
 logic [9:0] debayered_green_data;
 logic [9:0] debayered_blue_data;
@@ -250,12 +329,12 @@ debayer debayer (
     .pixel_clock_in(pixel_clock_in),
     .pixel_reset_n_in(pixel_reset_n_in),
 
-    .x_crop_start_lsb(resolution_crop_start[0]),
-    .y_crop_start_lsb(resolution_crop_start[0]),
+    .x_crop_start_lsb(x_crop_start[0]),
+    .y_crop_start_lsb(y_crop_start[0]),
 
-    .bayer_data_in(cropped_pixel_data),
-    .line_valid_in(cropped_line_valid),
-    .frame_valid_in(cropped_frame_valid),
+    .bayer_data_in(binned_pixel_data),
+    .line_valid_in(binned_line_valid),
+    .frame_valid_in(binned_frame_valid),
 
     .red_data_out(debayered_red_data),
     .green_data_out(debayered_green_data),
@@ -303,6 +382,23 @@ metering #(.SIZE(512)) average_metering (
     .metering_ready_out(average_metering_ready_pixel_clock_domain)
 );
 
+histogram histogram (
+    .clock_in(pixel_clock_in),
+    .reset_n_in(pixel_reset_n_in),
+
+    .red_data_in(debayered_red_data),
+    .green_data_in(debayered_green_data),
+    .blue_data_in(debayered_blue_data),
+    .line_valid_in(debayered_line_valid),
+    .frame_valid_in(debayered_frame_valid),
+
+    .x_size_in(image_x_size),
+    .y_size_in(image_y_size),
+
+    .statistics_address_in(statistics_address),
+    .statistics_data_out(statistics_data)
+);
+
 always @(posedge spi_clock_in) begin : metering_cdc
     center_metering_ready_metastable <= center_metering_ready_pixel_clock_domain;
     center_metering_ready_spi_clock_domain <= center_metering_ready_metastable;
@@ -353,10 +449,11 @@ jpeg_encoder jpeg_encoder (
     .line_valid_in(gamma_bypass ? debayered_line_valid : gamma_corrected_line_valid),
     .frame_valid_in(gamma_bypass ? debayered_frame_valid : gamma_corrected_frame_valid),
 
-    .start_capture_in(start_capture_pixel_clock_domain),
-    .x_size_in(resolution),
-    .y_size_in(resolution),
+    .start_capture_in(jpeg_start_capture),
+    .x_size_in(image_x_size),
+    .y_size_in(image_y_size),
     .qf_select_in(compression_factor),
+    .luma_only_in(grayscale),
 
     .data_out(final_image_data),
     .data_valid_out(final_image_data_valid),
@@ -364,7 +461,29 @@ jpeg_encoder jpeg_encoder (
     .image_valid_out(final_image_ready)
 );
 
-always_comb image_buffer_ready = final_image_ready;
+image_buffer_controller image_buffer_controller (
+    .clock_in(pixel_clock_in),
+    .reset_n_in(pixel_reset_n_in),
+
+    .continuous_capture_in(continuous_capture),
+    .start_capture_in(start_capture_pixel_clock_domain),
+    .release_frame_in(release_frame_pixel_clock_domain),
+    .frame_valid_in(byte_to_pixel_frame_valid),
+
+    .image_valid_in(final_image_ready),
+    .image_size_in(final_image_address),
+
+    .start_capture_out(jpeg_start_capture),
+    .image_ready_out(image_buffer_ready),
+    .image_size_out(ready_image_address),
+
+    .split_out(image_buffer_split),
+    .write_half_out(image_buffer_write_half),
+    .read_half_out(image_buffer_read_half),
+
+    .frame_counter_out(frame_counter),
+    .frame_dropped_out(frame_dropped)
+);
 
 image_buffer image_buffer (
     .clock_in(jpeg_slow_clock_in),
@@ -375,7 +494,11 @@ image_buffer image_buffer (
 
     .write_data_in(final_image_data),
     .read_data_out(image_buffer_data),
-    .write_read_n_in(final_image_data_valid)
+    .write_read_n_in(final_image_data_valid),
+
+    .split_in(image_buffer_split),
+    .write_half_in(image_buffer_write_half),
+    .read_half_in(image_buffer_read_half)
 );
 
 endmodule
@@ -0,0 +1,250 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Raj Nakarja / Brilliant Labs Limited (raj@brilliant.xyz)
+ *
+ * CERN Open Hardware Licence Version 2 - Permissive
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ */
+
+/*
+ * Luminance statistics of the whole image, used for auto exposure.
+ *
+ * Each pixel's luma is approximated as (R + 2G + B) / 4, and the top 8 bits are
+ * used. A 64 bin histogram counts the top 6 bits of the luma. The histogram is
+ * kept in a RAM, and each bin is read, incremented and written back over two
+ * cycles. Back to back pixels of the same bin are forwarded from the previous
+ * write.
+ *
+ * The image is also divided into a 4x4 grid of zones, and the luma of each zone
+ * is summed. Pixels beyond a multiple of 4 fall into the last row or column.
+ * Each line is summed per zone, and only added to the zone once its segment of
+ * the line ends.
+ *
+ * Once the frame ends, the results are copied into the statistics RAM, clearing
+ * the working bins and zones as they go:
+ *
+ *    0 .. 63 = Histogram bin counts, in units of 8 pixels
+ *   64 .. 79 = Zone sums in units of 256, ordered left to right, top to bottom
+ */
+
+module histogram (
+    input logic clock_in,
+    input logic reset_n_in,
+
+    input logic [9:0] red_data_in,
+    input logic [9:0] green_data_in,
+    input logic [9:0] blue_data_in,
+    input logic line_valid_in,
+    input logic frame_valid_in,
+
+    input logic [9:0] x_size_in,
+    input logic [9:0] y_size_in,
+
+    input logic [6:0] statistics_address_in,
+    output logic [15:0] statistics_data_out
+);
+
+parameter BINS = 64;
+parameter ZONES = 16;
+
+logic [11:0] luma_sum;
+logic [7:0] luma;
+logic luma_valid;
+logic luma_frame_valid;
+logic previous_luma_valid;
+logic [2:0] frame_end_history;
+
+always_comb luma_sum = red_data_in + (green_data_in << 1) + blue_data_in;
+
+always_ff @(posedge clock_in) begin
+    if (reset_n_in == 0) begin
+        luma <= 0;
+        luma_valid <= 0;
+        luma_frame_valid <= 0;
+        previous_luma_valid <= 0;
+        frame_end_history <= 0;
+    end
+
+    else begin
+        luma <= luma_sum[11:4];
+        luma_valid <= line_valid_in & frame_valid_in;
+        luma_frame_valid <= frame_valid_in;
+        previous_luma_valid <= luma_valid;
+        frame_end_history <= {frame_end_history[1:0], luma_frame_valid};
+    end
+end
+
+// Histogram RAM
+logic [18:0] bins [0:BINS - 1];
+logic [5:0] bin_read_address;
+logic [18:0] bin_read_data;
+logic bin_write_enable;
+logic [5:0] bin_write_address;
+logic [18:0] bin_write_data;
+
+always_ff @(posedge clock_in) begin
+    if (bin_write_enable) begin
+        bins[bin_write_address] <= bin_write_data;
+    end
+
+    bin_read_data <= bins[bin_read_address];
+end
+
+// Statistics RAM. Read asynchronously from the SPI clock domain
+logic [15:0] statistics [0:BINS + ZONES - 1];
+
+always_comb statistics_data_out = statistics_address_in < BINS + ZONES
+                                ? statistics[statistics_address_in]
+                                : 0;
+
+// Copy control. Starts once the histogram pipeline has emptied
+logic copy_active;
+logic [6:0] copy_index;
+logic copy_active_1;
+logic [6:0] copy_index_1;
+
+always_ff @(posedge clock_in) begin
+    if (reset_n_in == 0) begin
+        // Clears the working bins and zones after reset
+        copy_active <= 1;
+        copy_index <= 0;
+        copy_active_1 <= 0;
+        copy_index_1 <= 0;
+    end
+
+    else begin
+        copy_active_1 <= copy_active;
+        copy_index_1 <= copy_index;
+
+        if (frame_end_history == 'b100) begin
+            copy_active <= 1;
+            copy_index <= 0;
+        end
+
+        else if (copy_active) begin
+            if (copy_index == BINS + ZONES - 1) begin
+                copy_active <= 0;
+            end
+
+            copy_index <= copy_index + 1;
+        end
+    end
+end
+
+// Histogram pipeline
+logic [5:0] bin_1;
+logic bin_valid_1;
+logic [5:0] bin_2;
+logic bin_valid_2;
+logic [18:0] bin_count_2;
+logic [18:0] bin_increment;
+
+always_comb bin_read_address = copy_active ? copy_index[5:0] : luma[7:2];
+
+always_comb bin_increment = bin_valid_2 && bin_2 == bin_1
+                          ? bin_count_2 + 1
+                          : bin_read_data + 1;
+
+always_comb begin
+    if (copy_active_1) begin
+        bin_write_enable = copy_index_1 < BINS;
+        bin_write_address = copy_index_1[5:0];
+        bin_write_data = 0;
+    end
+
+    else begin
+        bin_write_enable = bin_valid_1;
+        bin_write_address = bin_1;
+        bin_write_data = bin_increment;
+    end
+end
+
+always_ff @(posedge clock_in) begin
+    if (reset_n_in == 0) begin
+        bin_valid_1 <= 0;
+        bin_valid_2 <= 0;
+    end
+
+    else begin
+        bin_1 <= luma[7:2];
+        bin_valid_1 <= luma_valid;
+
+        bin_2 <= bin_1;
+        bin_valid_2 <= bin_valid_1;
+        bin_count_2 <= bin_increment;
+    end
+end
+
+// Zones
+logic [7:0] zone_width;
+logic [7:0] zone_height;
+logic [7:0] zone_x_counter;
+logic [7:0] zone_y_counter;
+logic [1:0] zone_x;
+logic [1:0] zone_y;
+logic [15:0] segment_sum;
+logic [23:0] zone_sums [0:ZONES - 1];
+
+always_comb zone_width = x_size_in[9:2];
+always_comb zone_height = y_size_in[9:2];
+
+always_ff @(posedge clock_in) begin
+    if (reset_n_in == 0 || luma_frame_valid == 0) begin
+        zone_x_counter <= 0;
+        zone_y_counter <= 0;
+        zone_x <= 0;
+        zone_y <= 0;
+        segment_sum <= 0;
+    end
+
+    else if (luma_valid) begin
+        // Move to the next zone, except after the last
+        if (zone_x != 3 && zone_x_counter == zone_width - 1) begin
+            zone_sums[{zone_y, zone_x}] <= zone_sums[{zone_y, zone_x}] +
+                                           segment_sum +
+                                           luma;
+            segment_sum <= 0;
+            zone_x_counter <= 0;
+            zone_x <= zone_x + 1;
+        end
+
+        else begin
+            segment_sum <= segment_sum + luma;
+            zone_x_counter <= zone_x_counter + 1;
+        end
+    end
+
+    // End of line. The last segment is added even if the frame just ended
+    if (reset_n_in == 1 && previous_luma_valid && !luma_valid) begin
+        zone_sums[{zone_y, zone_x}] <= zone_sums[{zone_y, zone_x}] + segment_sum;
+        segment_sum <= 0;
+        zone_x_counter <= 0;
+        zone_x <= 0;
+
+        if (zone_y != 3 && zone_y_counter == zone_height - 1) begin
+            zone_y_counter <= 0;
+            zone_y <= zone_y + 1;
+        end
+
+        else begin
+            zone_y_counter <= zone_y_counter + 1;
+        end
+    end
+
+    // Copy out the results
+    if (copy_active_1) begin
+        if (copy_index_1 < BINS) begin
+            statistics[copy_index_1] <= bin_read_data[18:3];
+        end
+
+        else begin
+            statistics[copy_index_1] <= zone_sums[copy_index_1[3:0]][23:8];
+            zone_sums[copy_index_1[3:0]] <= 0;
+        end
+    end
+end
+
+endmodule
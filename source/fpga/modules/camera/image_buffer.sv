@@ -29,6 +29,12 @@ end
 
 endmodule
 
+/*
+ * In continuous capture mode, the buffer is split into two 32KB halves. The
+ * JPEG encoder fills one half while the nRF52 reads out the other. Data beyond
+ * the end of a half is discarded, and such frames are dropped by the
+ * controller below.
+ */
 module image_buffer (
     input logic clock_in,
     input logic [15:0] write_address_in,
@@ -36,12 +42,24 @@ module image_buffer (
     input logic read_address_valid_in,
     input logic [31:0] write_data_in,
     output logic [7:0] read_data_out,
-    input logic write_read_n_in
+    input logic write_read_n_in,
+
+    input logic split_in,
+    input logic write_half_in,
+    input logic read_half_in
 );
 
 // Read/write selection
+logic [13:0] write_address;
+logic [13:0] read_address;
 logic [13:0] address;
-assign address = write_read_n_in ? write_address_in[15:2] : read_address_in[15:2];
+logic write_enable;
+
+always_comb write_address = split_in ? {write_half_in, write_address_in[14:2]} : write_address_in[15:2];
+always_comb read_address = split_in ? {read_half_in, read_address_in[14:2]} : read_address_in[15:2];
+always_comb write_enable = write_read_n_in & ~(split_in & write_address_in[15]);
+
+assign address = write_read_n_in ? write_address : read_address;
 
 // Read 8 bits of 32 based on address
 logic [31:0] read_data;
@@ -61,7 +79,163 @@ inferred_lram inferred_lram (
     .address_in(address),
     .write_data_in(write_data_in),
     .read_data_out(read_data),
-    .write_enable_in(write_read_n_in)
+    .write_enable_in(write_enable)
+);
+
+endmodule
+
+/*
+ * Controls which half of the image buffer is written and read during
+ * continuous capture. Each time the encoder completes a frame, the halves are
+ * swapped and a new capture is started, as long as the nRF52 has released the
+ * frame it was reading. Otherwise the completed frame is held, and every
+ * sensor frame that passes in the meantime is counted as dropped.
+ */
+module image_buffer_controller (
+    input logic clock_in,
+    input logic reset_n_in,
+
+    input logic continuous_capture_in,
+    input logic start_capture_in,
+    input logic release_frame_in,
+    input logic frame_valid_in,
+
+    input logic image_valid_in,
+    input logic [15:0] image_size_in,
+
+    output logic start_capture_out,
+    output logic image_ready_out,
+    output logic [15:0] image_size_out,
+
+    output logic split_out,
+    output logic write_half_out,
+    output logic read_half_out,
+
+    output logic [15:0] frame_counter_out,   // Sequence number of the frame being read
+    output logic frame_dropped_out          // Frames were dropped before this one
 );
 
+parameter HALF_SIZE = 'd32768;
+
+enum {STOPPED, CAPTURING, HOLDING} state;
+
+logic [1:0] continuous_capture_sync;
+logic image_valid_last;
+logic frame_valid_last;
+logic controller_start;
+
+logic read_valid;
+logic [15:0] read_size;
+logic [15:0] held_size;
+logic [15:0] held_frame_number;
+logic [15:0] frame_counter;
+logic dropped;
+
+logic image_completed;
+logic frame_started;
+logic read_free;
+
+always_comb image_completed = image_valid_in & ~image_valid_last;
+always_comb frame_started = frame_valid_in & ~frame_valid_last;
+always_comb read_free = ~read_valid | release_frame_in;
+
+always_ff @(posedge clock_in) begin
+
+    if (reset_n_in == 0) begin
+        state <= STOPPED;
+        continuous_capture_sync <= 0;
+        image_valid_last <= 0;
+        frame_valid_last <= 0;
+        controller_start <= 0;
+        read_valid <= 0;
+        dropped <= 0;
+        frame_counter <= 0;
+        frame_counter_out <= 0;
+        frame_dropped_out <= 0;
+        write_half_out <= 0;
+        read_half_out <= 1;
+    end
+
+    else begin
+        continuous_capture_sync <= {continuous_capture_sync[0], continuous_capture_in};
+        image_valid_last <= image_valid_in;
+        frame_valid_last <= frame_valid_in;
+        controller_start <= 0;
+
+        if (release_frame_in) begin
+            read_valid <= 0;
+        end
+
+        case (state)
+            STOPPED: if (continuous_capture_sync[1]) begin
+                read_valid <= 0;
+                dropped <= 0;
+                frame_counter <= 0;
+                frame_counter_out <= 0;
+                frame_dropped_out <= 0;
+                write_half_out <= 0;
+                read_half_out <= 1;
+                controller_start <= 1;
+                state <= CAPTURING;
+            end
+
+            CAPTURING: if (image_completed) begin
+                frame_counter <= frame_counter + 1;
+
+                // Frames too large for half the buffer are captured again
+                if (image_size_in >= HALF_SIZE) begin
+                    dropped <= 1;
+                    controller_start <= 1;
+                end
+
+                else if (read_free) begin
+                    read_valid <= 1;
+                    read_size <= image_size_in;
+                    frame_counter_out <= frame_counter + 1;
+                    read_half_out <= write_half_out;
+                    write_half_out <= ~write_half_out;
+                    frame_dropped_out <= dropped;
+                    dropped <= 0;
+                    controller_start <= 1;
+                end
+
+                else begin
+                    held_size <= image_size_in;
+                    held_frame_number <= frame_counter + 1;
+                    state <= HOLDING;
+                end
+            end
+
+            HOLDING: begin
+                if (frame_started) begin
+                    frame_counter <= frame_counter + 1;
+                    dropped <= 1;
+                end
+
+                if (release_frame_in) begin
+                    read_valid <= 1;
+                    read_size <= held_size;
+                    frame_counter_out <= held_frame_number;
+                    read_half_out <= write_half_out;
+                    write_half_out <= ~write_half_out;
+                    frame_dropped_out <= dropped;
+                    dropped <= 0;
+                    controller_start <= 1;
+                    state <= CAPTURING;
+                end
+            end
+        endcase
+
+        if (continuous_capture_sync[1] == 0) begin
+            state <= STOPPED;
+        end
+    end
+
+end
+
+always_comb split_out = state != STOPPED;
+always_comb start_capture_out = split_out ? controller_start : start_capture_in;
+always_comb image_ready_out = split_out ? read_valid : image_valid_in;
+always_comb image_size_out = split_out ? read_size : image_size_in;
+
 endmodule
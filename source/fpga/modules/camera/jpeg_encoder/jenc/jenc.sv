@@ -28,6 +28,7 @@ module jenc #(
 
     input   logic[$clog2(SENSOR_X_SIZE)-1:0] x_size_m1,
     input   logic[$clog2(SENSOR_Y_SIZE)-1:0] y_size_m1,
+    input   logic                   luma_only,          // 4:0:0, no chroma MCUs
 
     input   logic                   clk,
     input   logic                   resetn,
@@ -30,6 +30,7 @@ module quant #(
     input   logic[$clog2(SENSOR_X_SIZE)-1:0] x_size_m1,
     input   logic[$clog2(SENSOR_Y_SIZE)-1:0] y_size_m1,
     input   logic[2:0]              qf_select,          // select one of the 8 possible QF
+    input   logic                   luma_only,          // 4:0:0, every MCU is Y
 
     input   logic                   clk,
     input   logic                   resetn
@@ -48,7 +49,7 @@ if (!resetn)
     zigzag_mcu_cnt <= 0;
 else if (di_valid & ~q_hold)
     if (&di_cnt)
-        zigzag_mcu_cnt <= zigzag_mcu_cnt == 5 ? 0 : zigzag_mcu_cnt + 1;
+        zigzag_mcu_cnt <= (zigzag_mcu_cnt == 5 | luma_only) ? 0 : zigzag_mcu_cnt + 1;
 
 
 // pipline inputs
@@ -119,14 +120,22 @@ endgenerate
 //logic for finding the last block
 parameter X_SIZE_D16 = (SENSOR_X_SIZE + 15) >> 4;
 parameter Y_SIZE_D16 = (SENSOR_Y_SIZE + 15) >> 4;
+parameter X_SIZE_D8 = (SENSOR_X_SIZE + 7) >> 3;
+parameter Y_SIZE_D8 = (SENSOR_Y_SIZE + 7) >> 3;
 logic[$clog2(X_SIZE_D16)-1:0] x_mcu;
 logic[$clog2(Y_SIZE_D16)-1:0] y_mcu;
+logic[$clog2(X_SIZE_D8)-1:0] x_mcu_400;     // 4:0:0 MCUs arrive in raster order
+logic[$clog2(Y_SIZE_D8)-1:0] y_mcu_400;
 
 // pipline
 logic                   last_mcu;
 logic                   di0_last_mcu;
 
-always_comb last_mcu = zigzag_mcu_cnt == 5 & x_mcu == (x_size_m1 >> 4) & y_mcu == (y_size_m1 >> 4);
+always_comb
+    if (luma_only)
+        last_mcu = x_mcu_400 == (x_size_m1 >> 3) & y_mcu_400 == (y_size_m1 >> 3);
+    else
+        last_mcu = zigzag_mcu_cnt == 5 & x_mcu == (x_size_m1 >> 4) & y_mcu == (y_size_m1 >> 4);
 
 always @(posedge clk) 
 if (!resetn) begin
@@ -145,6 +154,23 @@ end else if (di_valid & ~q_hold) begin
     end
 end
 
+always @(posedge clk) 
+if (!resetn) begin
+    x_mcu_400 <= 0;
+    y_mcu_400 <= 0;
+end else if (di_valid & ~q_hold) begin
+    if (&di_cnt) begin
+        if (x_mcu_400 == (x_size_m1 >> 3)) begin
+            x_mcu_400 <= 0;
+            if (y_mcu_400 == (y_size_m1 >> 3))
+                y_mcu_400 <= 0;
+            else
+                y_mcu_400 <= y_mcu_400 + 1;
+        end else
+            x_mcu_400 <= x_mcu_400 + 1;
+    end
+end
+
 always @(posedge clk) 
 if (di_valid & !q_hold)
     di0_last_mcu  <= last_mcu;
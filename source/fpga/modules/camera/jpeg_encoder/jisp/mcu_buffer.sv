@@ -1,5 +1,5 @@
 /*
- * MCU buffer for 4:2:0 (4:4:4, 4:2:2, 4:0:0 can be added easily)
+ * MCU buffer for 4:2:0 and 4:0:0 (4:4:4, 4:2:2 can be added easily)
  *
  * Authored by: Robert Metchev / Chips & Scripts (rmetchev@ieee.org)
  *
@@ -27,6 +27,7 @@
 
     input   logic[$clog2(SENSOR_X_SIZE)-1:0] x_size_m1,
     input   logic[$clog2(SENSOR_Y_SIZE)-1:0] y_size_m1,
+    input   logic               luma_only,
     input   logic               slow_clock,
     input   logic               slow_reset_n,
     input   logic               clk,
@@ -50,6 +51,12 @@ localparam UV_LINE_BUF_HEIGHT = 8;
 444:    Y:  0       U:  1       V:  2
 
 400:    Y:  0       U:  -       V:  -
+
+With luma_only, the 16-line buffer is still filled as for 4:2:0, but a single
+component scan needs its 8x8 MCUs in raster order, so they are read as:
+        Y:  0 1 2 3 ...
+            N N+1 ...
+and 8x8 MCUs entirely outside the image are skipped.
 */
 logic[$clog2(SENSOR_X_SIZE/16)-1:0]    block_count; // 6 bits for 4:2:0, 4:2:2 (7 bits for 4:4:4, 4:0:0)
 logic[$clog2(SENSOR_Y_SIZE/16)-1:0]    block_v_count; // 6 bits for 4:2:0 (7 bits for 4:2:2, 4:4:4, 4:0:0)
@@ -61,6 +68,20 @@ logic[(8*DW)-1:0]           rd_y, rd_uv;
 logic[1:0] wptr, rptr;
 logic full, empty;
 
+// 4:0:0 read order
+logic has_right_mcu, has_bottom_mcu;
+logic last_mcu_in_block_row;
+
+always_comb has_right_mcu = {block_count, 1'b1} <= (x_size_m1 >> 3);
+always_comb has_bottom_mcu = {block_v_count, 1'b1} <= (y_size_m1 >> 3);
+
+always_comb
+    if (luma_only)
+        last_mcu_in_block_row = mcu_line_count == 7 & block_count == (x_size_m1 >> 4) & 
+                                (mcu_count[0] | !has_right_mcu) & (mcu_count[1] | !has_bottom_mcu);
+    else
+        last_mcu_in_block_row = mcu_line_count == 7 & mcu_count == 5 & block_count == (x_size_m1 >> 4);
+
 afifo #(.ASIZE(1)) afifo(
     .i_wclk(clk),
     .i_wrst_n(resetn), 
@@ -69,7 +90,7 @@ afifo #(.ASIZE(1)) afifo(
     .o_wfull(full),
     .i_rclk(slow_clock),
     .i_rrst_n(slow_reset_n),
-    .i_rd(!di_hold & !empty & mcu_line_count == 7 & mcu_count == 5 & block_count == (x_size_m1 >> 4)),
+    .i_rd(!di_hold & !empty & last_mcu_in_block_row),
     .o_rdata(),
     .o_rempty(empty),
     .*
@@ -88,7 +109,28 @@ end
 else if (!di_hold & !empty) begin
     mcu_line_count <= mcu_line_count + 1;           // 1. count 8 lines within MCU
     if (mcu_line_count == 7)
-        if (mcu_count == 5) begin
+        if (luma_only) begin
+            if (!mcu_count[0] & has_right_mcu)
+                mcu_count[0] <= 1;                  // 2. right luma MCU of the block
+            else if (block_count != (x_size_m1 >> 4)) begin
+                mcu_count[0] <= 0;
+                block_count <= block_count + 1;     // 3. next block along the row
+            end
+            else begin
+                mcu_count[0] <= 0;
+                block_count <= 0;
+                if (!mcu_count[1] & has_bottom_mcu)
+                    mcu_count[1] <= 1;              // 4. bottom row of luma MCUs
+                else begin
+                    mcu_count[1] <= 0;
+                    if (block_v_count == (y_size_m1 >> 4))
+                        block_v_count <= 0;
+                    else
+                        block_v_count <= block_v_count + 1; // 5. next 16-line block row
+                end
+            end
+        end
+        else if (mcu_count == 5) begin
             mcu_count <= 0;
             if (block_count == (x_size_m1 >> 4)) begin
                 block_count <= 0;
@@ -26,6 +26,7 @@
     output  logic               data_valid_out,     // Qualifier for valid data. Data is invalid if 0.
 
     input   logic[2:0]          qf_select_in,       // select one of the 8 possible QF
+    input   logic               luma_only_in,       // grayscale, Y component only
     input   logic[$clog2(SENSOR_X_SIZE)-1:0] x_size_in,
     input   logic[$clog2(SENSOR_Y_SIZE)-1:0] y_size_in,
 
@@ -114,6 +115,7 @@ jisp #(
     .frame_valid_in     (jpeg_en & frame_valid_in),
     .line_valid_in      (jpeg_en & line_valid_in),
     .rgb24_hold         ( ),
+    .luma_only          (luma_only_in),
 
     .clk                (pixel_clock_in),
     .resetn             (pixel_reset_n_in & jpeg_reset_n),
@@ -125,6 +127,7 @@ jenc #(
     .SENSOR_Y_SIZE      (SENSOR_Y_SIZE)
 ) jenc (
     .qf_select          (qf_select_in),
+    .luma_only          (luma_only_in),
 
     .clk                (slow_clock),
     .resetn             (slow_reset_n),
@@ -26,22 +26,36 @@
 
     output logic start_capture_out,
     output logic [9:0] resolution_out,
+    output logic roi_enable_out,
+    output logic [9:0] roi_x_start_out,
+    output logic [9:0] roi_y_start_out,
+    output logic [9:0] roi_width_out,
+    output logic [9:0] roi_height_out,
+    output logic [1:0] binning_out,
+    output logic grayscale_out,
     output logic [2:0] compression_factor_out,
     output logic power_save_enable_out,
     output logic gamma_bypass_out,
+    output logic continuous_capture_out,
+    output logic release_frame_out,
 
     input logic image_ready_in,
     input logic [15:0] final_image_address, // image_total_size_in - 4
     input logic [7:0] image_data_in,
     output logic [15:0] image_address_out,
     output logic image_address_valid,
+    input logic [15:0] frame_counter_in,
+    input logic frame_dropped_in,
 
     input logic [7:0] red_center_metering_in,
     input logic [7:0] green_center_metering_in,
     input logic [7:0] blue_center_metering_in,
     input logic [7:0] red_average_metering_in,
     input logic [7:0] green_average_metering_in,
-    input logic [7:0] blue_average_metering_in
+    input logic [7:0] blue_average_metering_in,
+
+    output logic [6:0] statistics_address_out,
+    input logic [15:0] statistics_data_in
 );
 
 // register addresses
@@ -56,6 +70,14 @@ parameter POWER_SAVE_ENABLE = 'h28; // WO
 parameter IMAGE_READY_FLAG  = 'h30; // RO
 parameter COMPRESSED_BYTES  = 'h31; // RO 2x
 parameter GAMMA_BYPASS      = 'h32; // WO
+parameter CONTINUOUS_CAPTURE= 'h33; // WO
+parameter FRAME_COUNTER     = 'h34; // RO 2x
+parameter FRAME_DROPPED     = 'h35; // RO
+parameter RELEASE_FRAME     = 'h36; // WO + reset
+parameter REGION_OF_INTEREST= 'h37; // WO 8x
+parameter BINNING           = 'h38; // WO
+parameter GRAYSCALE         = 'h39; // WO
+parameter STATISTICS        = 'h3A; // RO 160x
 
 logic [15:0] image_buffer_total_size;   // final address + 4, sames as bytes available
 logic [15:0] bytes_remaining;
@@ -63,6 +85,9 @@ logic [15:0] bytes_remaining;
 always_comb image_buffer_total_size = final_image_address + 4;
 assign bytes_remaining = image_buffer_total_size - image_address_out;
 
+// Histogram and zone words are read out LSB first
+always_comb statistics_address_out = rd_operand_count_in[7:1];
+
 always_comb
      case (opcode_in)
          // Bytes available
@@ -97,12 +122,31 @@ always_comb
              default: response_out = 0;
          endcase
 
+         // Continuous capture frame number
+         FRAME_COUNTER:
+         case (rd_operand_count_in)
+             0: response_out = frame_counter_in[7:0];
+             1: response_out = frame_counter_in[15:8];
+             default: response_out = 0;
+         endcase
+
+         // Continuous capture dropped frame flag
+         FRAME_DROPPED: response_out = frame_dropped_in;
+
+         // Luma histogram and zones
+         STATISTICS:
+         case (rd_operand_count_in[0])
+             0: response_out = statistics_data_in[7:0];
+             default: response_out = statistics_data_in[15:8];
+         endcase
+
          default: response_out = 0;
      endcase
 
 
 // combinatorial!
 always_comb start_capture_out = opcode_valid_in & opcode_in == START_CAPTURE;
+always_comb release_frame_out = opcode_valid_in & opcode_in == RELEASE_FRAME;
 
 // RM - Being extra careful here and putting POWER_SAVE_ENABLE on async reset
 always_ff @(negedge clock_in or negedge reset_n_in)
@@ -115,15 +159,23 @@ always_ff @(negedge clock_in) begin
     
     if (reset_n_in == 0) begin
         resolution_out <= 512;
+        roi_enable_out <= 0;
+        roi_x_start_out <= 0;
+        roi_y_start_out <= 0;
+        roi_width_out <= 512;
+        roi_height_out <= 512;
+        binning_out <= 0;
+        grayscale_out <= 0;
         compression_factor_out <= 0;
         image_address_valid <= 0;
         gamma_bypass_out <= 0;
+        continuous_capture_out <= 0;
     end
 
     else begin
         image_address_valid <= operand_read & (opcode_in==IMAGE_DATA | opcode_in==COMPRESSED_BYTES | opcode_in==BYTES_REMAINING);
 
-        if (start_capture_out) // Capture command
+        if (start_capture_out | release_frame_out) // Capture or next frame command
             image_address_out <= 0;
         else if (operand_read & opcode_in == IMAGE_DATA & image_address_out < image_buffer_total_size)
             // Read data
@@ -143,14 +195,42 @@ always_ff @(negedge clock_in) begin
 
             case (opcode_in)
 
-                // Resolution
+                // Resolution of a centered square image
                 RESOLUTION: begin
+                    roi_enable_out <= 0;
+
                     case (wr_operand_count_in)
                         0: resolution_out <= {operand_in[1:0], 8'b0};
                         default: resolution_out <= {resolution_out[9:8], operand_in};
                     endcase
                 end
 
+                // Crop start, and image size of a rectangular image
+                REGION_OF_INTEREST: begin
+                    roi_enable_out <= 1;
+
+                    case (wr_operand_count_in)
+                        0: roi_x_start_out <= {operand_in[1:0], 8'b0};
+                        1: roi_x_start_out <= {roi_x_start_out[9:8], operand_in};
+                        2: roi_y_start_out <= {operand_in[1:0], 8'b0};
+                        3: roi_y_start_out <= {roi_y_start_out[9:8], operand_in};
+                        4: roi_width_out <= {operand_in[1:0], 8'b0};
+                        5: roi_width_out <= {roi_width_out[9:8], operand_in};
+                        6: roi_height_out <= {operand_in[1:0], 8'b0};
+                        default: roi_height_out <= {roi_height_out[9:8], operand_in};
+                    endcase
+                end
+
+                // Downscaling of the raw image before debayering
+                BINNING: begin
+                    binning_out <= operand_in[1:0];
+                end
+
+                // Only encode the luma component
+                GRAYSCALE: begin
+                    grayscale_out <= operand_in[0];
+                end
+
                 // Compression factor
                 QUALITY_FACTOR: begin
                     compression_factor_out[2:0] <= operand_in[2:0];
@@ -161,6 +241,11 @@ always_ff @(negedge clock_in) begin
                     gamma_bypass_out <= operand_in[0];
                 end
 
+                // Continuous capture into alternating halves of the buffer
+                CONTINUOUS_CAPTURE: begin
+                    continuous_capture_out <= operand_in[0];
+                end
+
             endcase
 
         end
@@ -24,6 +24,15 @@
   *   1                      = Selects bottom LRAM of a buffer
   *                      xxx = Lower 3 bits selects a pixel from the 32 bit word
   *    x xxxx xxxx xxxx x    = This leaves 14 bits to address an LRAM block
+  *
+  * Writes are made a whole word at a time, along with a mask that selects
+  * which of the 8 pixels within the word are updated.
+  *
+  * After each switch, the new background buffer still holds the frame from
+  * two switches ago. By default, it's cleared entirely, one word per cycle.
+  * Alternatively, only a rectangular region of it may be cleared, or it may be
+  * left untouched, so that only the parts of a scene which change need to be
+  * cleared and redrawn.
   */
 
 module display_buffer (
@@ -33,7 +42,8 @@ module display_buffer (
     input logic [17:0] write_address,
     input logic [17:0] read_address,
 
-    input logic [3:0] write_data,
+    input logic [31:0] write_data,
+    input logic [7:0] write_mask,
     output logic [3:0] read_data,
 
     input logic write_enable
@@ -41,6 +51,12 @@ module display_buffer (
 
 `ifndef RADIANT (* ram_style="huge" *) `endif reg [31:0] mem [0:32767];
 
+logic [31:0] write_bit_mask;
+
+always_comb
+    for (int i = 0; i < 8; i++)
+        write_bit_mask[i * 4 +: 4] = {4{write_mask[i]}};
+
 always @(posedge clock) begin
 
     if (reset_n == 0) begin
@@ -48,17 +64,10 @@ always @(posedge clock) begin
     end
 
     else begin
+        // Any of the 8 pixels in a word can be written at once
         if (write_enable) begin
-            case (write_address[2:0])
-                'd0: mem[write_address[17:3]] <= {mem[write_address[17:3]][31:4],  write_data                                };
-                'd1: mem[write_address[17:3]] <= {mem[write_address[17:3]][31:8],  write_data, mem[write_address[17:3]][3:0] };
-                'd2: mem[write_address[17:3]] <= {mem[write_address[17:3]][31:12], write_data, mem[write_address[17:3]][7:0] };
-                'd3: mem[write_address[17:3]] <= {mem[write_address[17:3]][31:16], write_data, mem[write_address[17:3]][11:0]};
-                'd4: mem[write_address[17:3]] <= {mem[write_address[17:3]][31:20], write_data, mem[write_address[17:3]][15:0]};
-                'd5: mem[write_address[17:3]] <= {mem[write_address[17:3]][31:24], write_data, mem[write_address[17:3]][19:0]};
-                'd6: mem[write_address[17:3]] <= {mem[write_address[17:3]][31:28], write_data, mem[write_address[17:3]][23:0]};
-                'd7: mem[write_address[17:3]] <= {                                 write_data, mem[write_address[17:3]][27:0]};
-            endcase
+            mem[write_address[17:3]] <= (mem[write_address[17:3]] & ~write_bit_mask) |
+                                        (write_data & write_bit_mask);
         end
 
         case (read_address[2:0])
@@ -81,29 +90,50 @@ module display_buffers (
     input logic reset_n_in,
 
     input logic pixel_write_enable_in,
-    input logic [17:0] pixel_write_address_in,
-    input logic [3:0] pixel_write_data_in,
+    input logic [14:0] pixel_write_address_in,
+    input logic [31:0] pixel_write_data_in,
+    input logic [7:0] pixel_write_mask_in,
 
     input logic [17:0] pixel_read_address_in,
     output logic [3:0] pixel_read_data_out,
 
     output logic [1:0] buffer_status,
-    input logic switch_write_buffer_in
+    input logic switch_write_buffer_in,
+
+    input logic [1:0] clear_mode_in,
+    input logic [9:0] clear_x_start_in,
+    input logic [9:0] clear_y_start_in,
+    input logic [9:0] clear_x_end_in,
+    input logic [9:0] clear_y_end_in
 );
 
+parameter CLEAR_WHOLE_BUFFER = 'd0;
+parameter CLEAR_REGION = 'd1;
+parameter CLEAR_NOTHING = 'd2;
+
 logic [17:0] display_ram_address_a;
 logic [17:0] display_ram_address_b;
 
 logic [3:0] display_ram_read_data_a;
 logic [3:0] display_ram_read_data_b;
 
-logic [3:0] display_ram_write_data;
+logic [31:0] display_ram_write_data;
+logic [7:0] display_ram_write_mask;
 
 logic display_ram_write_enable_a;
 logic display_ram_write_enable_b;
 
 logic clear_flag;
-logic [18:0] clear_address_counter;
+logic [14:0] clear_row_address;
+logic [6:0] clear_column;
+logic [9:0] clear_row;
+logic [6:0] clear_first_column;
+logic [6:0] clear_last_column;
+logic [9:0] clear_last_row;
+logic [7:0] clear_first_column_mask;
+logic [7:0] clear_last_column_mask;
+logic [7:0] clear_mask;
+logic clear_region_valid;
 
 display_buffer buffer_a (
     .clock(clock_in),
@@ -111,6 +141,7 @@ display_buffer buffer_a (
     .write_address(display_ram_address_a),
     .read_address(display_ram_address_a),
     .write_data(display_ram_write_data),
+    .write_mask(display_ram_write_mask),
     .read_data(display_ram_read_data_a),
     .write_enable(display_ram_write_enable_a)
 );
@@ -121,11 +152,29 @@ display_buffer buffer_b (
     .write_address(display_ram_address_b),
     .read_address(display_ram_address_b),
     .write_data(display_ram_write_data),
+    .write_mask(display_ram_write_mask),
     .read_data(display_ram_read_data_b),
     .write_enable(display_ram_write_enable_b)
 );
 
 // Buffer switching & clearing logic
+always_comb clear_region_valid = clear_x_start_in <= clear_x_end_in &&
+                                 clear_y_start_in <= clear_y_end_in &&
+                                 clear_x_end_in < 640 &&
+                                 clear_y_end_in < 400;
+
+always_comb begin
+    clear_mask = 8'hFF;
+
+    if (clear_column == clear_first_column) begin
+        clear_mask = clear_mask & clear_first_column_mask;
+    end
+
+    if (clear_column == clear_last_column) begin
+        clear_mask = clear_mask & clear_last_column_mask;
+    end
+end
+
 enum logic {BUFFER_A, BUFFER_B} displayed_buffer;
 logic [1:0] switch_write_buffer_edge_monitor;
 logic buffer_switch_pending;
@@ -137,7 +186,6 @@ always_ff @(posedge clock_in) begin
         switch_write_buffer_edge_monitor <= 'b00;
         buffer_switch_pending <= 0;
         clear_flag <= 0;
-        clear_address_counter <= 0;
     end
 
     else begin
@@ -162,15 +210,53 @@ always_ff @(posedge clock_in) begin
 
             buffer_switch_pending <= 0;
 
-            clear_flag <= 1;
-            clear_address_counter <= 0;
+            // Either the whole new background buffer, or only a region of it
+            // is cleared. The region is latched so it may be updated early
+            case (clear_mode_in)
+                CLEAR_REGION: begin
+                    clear_flag <= clear_region_valid;
+                    clear_row_address <= (clear_y_start_in << 6) + (clear_y_start_in << 4);
+                    clear_column <= clear_x_start_in[9:3];
+                    clear_row <= clear_y_start_in;
+                    clear_first_column <= clear_x_start_in[9:3];
+                    clear_last_column <= clear_x_end_in[9:3];
+                    clear_last_row <= clear_y_end_in;
+                    clear_first_column_mask <= 8'hFF << clear_x_start_in[2:0];
+                    clear_last_column_mask <= 8'hFF >> (7 - clear_x_end_in[2:0]);
+                end
+
+                CLEAR_NOTHING: begin
+                    clear_flag <= 0;
+                end
+
+                default: begin
+                    clear_flag <= 1;
+                    clear_row_address <= 0;
+                    clear_column <= 0;
+                    clear_row <= 0;
+                    clear_first_column <= 0;
+                    clear_last_column <= 79;
+                    clear_last_row <= 399;
+                    clear_first_column_mask <= 8'hFF;
+                    clear_last_column_mask <= 8'hFF;
+                end
+            endcase
         end
 
+        // Clear a whole word of 8 pixels each cycle
         if (clear_flag == 1) begin
-            clear_address_counter <= clear_address_counter + 1;
+            if (clear_column < clear_last_column) begin
+                clear_column <= clear_column + 1;
+            end
+
+            else begin
+                clear_column <= clear_first_column;
+                clear_row <= clear_row + 1;
+                clear_row_address <= clear_row_address + 80;
 
-            if (clear_address_counter == 'd512000) begin
-                clear_flag <= 0;
+                if (clear_row == clear_last_row) begin
+                    clear_flag <= 0;
+                end
             end
         end
 
@@ -189,9 +275,9 @@ always_ff @(posedge clock_in) begin
     else begin
         if (displayed_buffer == BUFFER_A) begin
             if (clear_flag == 1) begin
-                display_ram_address_b <= clear_address_counter >> 1;
+                display_ram_address_b <= (clear_row_address + clear_column) << 3;
             end else begin
-                display_ram_address_b <= pixel_write_address_in;
+                display_ram_address_b <= pixel_write_address_in << 3;
             end
 
             display_ram_address_a <= pixel_read_address_in; 
@@ -199,9 +285,9 @@ always_ff @(posedge clock_in) begin
 
         else begin
             if (clear_flag == 1) begin 
-                display_ram_address_a <= clear_address_counter >> 1;
+                display_ram_address_a <= (clear_row_address + clear_column) << 3;
             end else begin
-               display_ram_address_a <= pixel_write_address_in; 
+               display_ram_address_a <= pixel_write_address_in << 3; 
             end
 
             display_ram_address_b <= pixel_read_address_in;
@@ -233,8 +319,10 @@ always_ff @(posedge clock_in) begin
 
     if (clear_flag == 1) begin
         display_ram_write_data <= 0;
+        display_ram_write_mask <= clear_mask;
     end else begin
         display_ram_write_data <= pixel_write_data_in;
+        display_ram_write_mask <= pixel_write_mask_in;
     end
 
     if (pixel_write_enable_in == 1 || clear_flag == 1) begin
@@ -14,7 +14,9 @@
 `include "modules/graphics/color_palette.sv"
 `include "modules/graphics/display_buffers.sv"
 `include "modules/graphics/display_driver.sv"
+`include "modules/graphics/sprite_cache.sv"
 `include "modules/graphics/sprite_engine.sv"
+`include "modules/graphics/vector_engine.sv"
 `endif
 
 module graphics (
@@ -46,7 +48,11 @@ parameter GRAPHICS_ASSIGN_COLOR = 'h11;
 parameter GRAPHICS_DRAW_SPRITE = 'h12;
 parameter GRAPHICS_DRAW_VECTOR = 'h13;
 parameter GRAPHICS_BUFFER_SHOW = 'h14;
+parameter GRAPHICS_CACHE_SPRITE = 'h15;
+parameter GRAPHICS_DRAW_CACHED = 'h16;
+parameter GRAPHICS_CLEAR_REGION = 'h17;
 parameter GRAPHICS_BUFFER_STATUS = 'h18;
+parameter GRAPHICS_CLEAR_MODE = 'h19;
 
 logic [3:0] assign_color_index_spi_domain;
 logic [9:0] assign_color_value_spi_domain;
@@ -64,6 +70,39 @@ logic sprite_enable_spi_domain;
 logic sprite_data_valid;
 logic sprite_enable;
 
+logic [1:0] vector_shape_spi_domain;         // Line or filled rectangle
+logic [9:0] vector_x_start_spi_domain;       // 0 - 639
+logic [9:0] vector_y_start_spi_domain;       // 0 - 399
+logic [9:0] vector_x_end_spi_domain;         // 0 - 639
+logic [9:0] vector_y_end_spi_domain;         // 0 - 399
+logic [3:0] vector_color_spi_domain;         // 0 - 15
+logic vector_enable_spi_domain;
+logic vector_enable;
+logic vector_engine_busy;
+
+logic [3:0] cache_handle_spi_domain;         // 0 - 15
+logic [12:0] cache_address_spi_domain;       // 0 - 8191
+logic [9:0] cache_width_spi_domain;          // 1 - 640
+logic [4:0] cache_color_count_spi_domain;    // 2, 4 or 16 colors
+logic [7:0] cache_data_spi_domain;
+logic cache_data_valid_spi_domain;
+logic cache_first_spi_domain;
+logic cache_data_valid;
+
+logic [9:0] cached_x_position_spi_domain;    // 0 - 639
+logic [9:0] cached_y_position_spi_domain;    // 0 - 399
+logic [3:0] cached_handle_spi_domain;        // 0 - 15
+logic [3:0] cached_palette_offset_spi_domain;// 0 - 15
+logic draw_cached_enable_spi_domain;
+logic draw_cached_enable;
+logic sprite_cache_busy;
+
+logic [1:0] clear_mode_spi_domain;           // Whole buffer, region or none
+logic [9:0] clear_x_start_spi_domain;        // 0 - 639
+logic [9:0] clear_y_start_spi_domain;        // 0 - 399
+logic [9:0] clear_x_end_spi_domain;          // 0 - 639
+logic [9:0] clear_y_end_spi_domain;          // 0 - 399
+
 logic switch_buffer_spi_domain;
 logic switch_buffer;
 logic [1:0] buffer_status;
@@ -76,6 +115,13 @@ always_comb assign_color_enable_spi_domain  = op_code_in == GRAPHICS_ASSIGN_COLO
 always_comb sprite_data_valid_spi_domain    = op_code_in == GRAPHICS_DRAW_SPRITE & operand_valid_in & operand_count_in > 7;
 always_comb sprite_enable_spi_domain        = operand_count_in == 8;
 always_comb sprite_enable                   = sprite_enable_spi_domain;
+// Draw vector
+always_comb vector_enable_spi_domain        = op_code_in == GRAPHICS_DRAW_VECTOR & operand_valid_in & operand_count_in == 9;
+// Cache sprite
+always_comb cache_data_valid_spi_domain     = op_code_in == GRAPHICS_CACHE_SPRITE & operand_valid_in & operand_count_in > 5;
+always_comb cache_first_spi_domain          = operand_count_in == 6;
+// Draw cached sprite
+always_comb draw_cached_enable_spi_domain   = op_code_in == GRAPHICS_DRAW_CACHED & operand_valid_in & operand_count_in == 5;
 // Switch buffer
 always_comb switch_buffer_spi_domain        = op_code_in == GRAPHICS_BUFFER_SHOW & op_code_valid_in;
 
@@ -109,12 +155,84 @@ always_ff @(negedge spi_clock_in) begin
                 endcase
             end
         end
+
+        // Draw vector
+        GRAPHICS_DRAW_VECTOR: begin
+            if (operand_valid_in) begin
+                case (operand_count_in)
+                    0: vector_shape_spi_domain <= operand_in[1:0];
+                    1: vector_x_start_spi_domain <= {operand_in[1:0], 8'b0};
+                    2: vector_x_start_spi_domain <= {vector_x_start_spi_domain[9:8], operand_in};
+                    3: vector_y_start_spi_domain <= {operand_in[1:0], 8'b0};
+                    4: vector_y_start_spi_domain <= {vector_y_start_spi_domain[9:8], operand_in};
+                    5: vector_x_end_spi_domain <= {operand_in[1:0], 8'b0};
+                    6: vector_x_end_spi_domain <= {vector_x_end_spi_domain[9:8], operand_in};
+                    7: vector_y_end_spi_domain <= {operand_in[1:0], 8'b0};
+                    8: vector_y_end_spi_domain <= {vector_y_end_spi_domain[9:8], operand_in};
+                    9: vector_color_spi_domain <= operand_in[3:0];
+                endcase
+            end
+        end
+
+        // Cache sprite
+        GRAPHICS_CACHE_SPRITE: begin
+            if (operand_valid_in) begin
+                case (operand_count_in)
+                    0: cache_handle_spi_domain <= operand_in[3:0];
+                    1: cache_address_spi_domain <= {operand_in[4:0], 8'b0};
+                    2: cache_address_spi_domain <= {cache_address_spi_domain[12:8], operand_in};
+                    3: cache_width_spi_domain <= {operand_in[1:0], 8'b0};
+                    4: cache_width_spi_domain <= {cache_width_spi_domain[9:8], operand_in};
+                    5: cache_color_count_spi_domain <= operand_in[4:0];
+                    default: cache_data_spi_domain <= operand_in;
+                endcase
+            end
+        end
+
+        // Draw cached sprite
+        GRAPHICS_DRAW_CACHED: begin
+            if (operand_valid_in) begin
+                case (operand_count_in)
+                    0: cached_x_position_spi_domain <= {operand_in[1:0], 8'b0};
+                    1: cached_x_position_spi_domain <= {cached_x_position_spi_domain[9:8], operand_in};
+                    2: cached_y_position_spi_domain <= {operand_in[1:0], 8'b0};
+                    3: cached_y_position_spi_domain <= {cached_y_position_spi_domain[9:8], operand_in};
+                    4: cached_handle_spi_domain <= operand_in[3:0];
+                    5: cached_palette_offset_spi_domain <= operand_in[3:0];
+                endcase
+            end
+        end
+
+        // Clear region
+        GRAPHICS_CLEAR_REGION: begin
+            if (operand_valid_in) begin
+                case (operand_count_in)
+                    0: clear_x_start_spi_domain <= {operand_in[1:0], 8'b0};
+                    1: clear_x_start_spi_domain <= {clear_x_start_spi_domain[9:8], operand_in};
+                    2: clear_y_start_spi_domain <= {operand_in[1:0], 8'b0};
+                    3: clear_y_start_spi_domain <= {clear_y_start_spi_domain[9:8], operand_in};
+                    4: clear_x_end_spi_domain <= {operand_in[1:0], 8'b0};
+                    5: clear_x_end_spi_domain <= {clear_x_end_spi_domain[9:8], operand_in};
+                    6: clear_y_end_spi_domain <= {operand_in[1:0], 8'b0};
+                    7: clear_y_end_spi_domain <= {clear_y_end_spi_domain[9:8], operand_in};
+                endcase
+            end
+        end
+
+        // Clear mode
+        GRAPHICS_CLEAR_MODE: begin
+            if (operand_valid_in) begin
+                case (operand_count_in)
+                    0: clear_mode_spi_domain <= operand_in[1:0];
+                endcase
+            end
+        end
     endcase
 end
 
 always_comb
     case (op_code_in)
-    GRAPHICS_BUFFER_STATUS: response_out = buffer_status;
+    GRAPHICS_BUFFER_STATUS: response_out = {vector_engine_busy, sprite_cache_busy, buffer_status};
     default: response_out = 0;
     endcase
 
@@ -139,6 +257,33 @@ psync1 psync1_sprite_data_valid (
         .out_reset_n    (display_reset_n_in)
 );
 
+psync1 psync1_vector_enable (
+        .in             (vector_enable_spi_domain),
+        .in_clk         (~spi_clock_in),
+        .in_reset_n     (spi_reset_n_in),
+        .out            (vector_enable),
+        .out_clk        (display_clock_in),
+        .out_reset_n    (display_reset_n_in)
+);
+
+psync1 psync1_cache_data_valid (
+        .in             (cache_data_valid_spi_domain),
+        .in_clk         (~spi_clock_in),
+        .in_reset_n     (spi_reset_n_in),
+        .out            (cache_data_valid),
+        .out_clk        (display_clock_in),
+        .out_reset_n    (display_reset_n_in)
+);
+
+psync1 psync1_draw_cached_enable (
+        .in             (draw_cached_enable_spi_domain),
+        .in_clk         (~spi_clock_in),
+        .in_reset_n     (spi_reset_n_in),
+        .out            (draw_cached_enable),
+        .out_clk        (display_clock_in),
+        .out_reset_n    (display_reset_n_in)
+);
+
 psync1 psync1_switch_buffer (
         .in             (switch_buffer_spi_domain),
         .in_clk         (~spi_clock_in),
@@ -151,58 +296,151 @@ psync1 psync1_switch_buffer (
 
 // Feed display buffer from either sprite or vector engine
 logic pixel_write_enable_sprite_to_mux_wire;
-logic [17:0] pixel_write_address_sprite_to_mux_wire;
-logic [3:0] pixel_write_data_sprite_to_mux_wire;
+logic [14:0] pixel_write_address_sprite_to_mux_wire;
+logic [31:0] pixel_write_data_sprite_to_mux_wire;
+logic [7:0] pixel_write_mask_sprite_to_mux_wire;
 
-logic pixel_write_enable_vector_to_mux_wire = 0; // TODO wire this up
+logic pixel_write_enable_vector_to_mux_wire;
 logic [17:0] pixel_write_address_vector_to_mux_wire;
 logic [3:0] pixel_write_data_vector_to_mux_wire;
 
 logic pixel_write_enable_mux_to_buffer_wire;
-logic [17:0] pixel_write_address_mux_to_buffer_wire;
-logic [3:0] pixel_write_data_mux_to_buffer_wire;
+logic [14:0] pixel_write_address_mux_to_buffer_wire;
+logic [31:0] pixel_write_data_mux_to_buffer_wire;
+logic [7:0] pixel_write_mask_mux_to_buffer_wire;
 
 always_comb begin
     if (pixel_write_enable_sprite_to_mux_wire) begin
         pixel_write_enable_mux_to_buffer_wire = 1'b1;
         pixel_write_address_mux_to_buffer_wire = pixel_write_address_sprite_to_mux_wire;
         pixel_write_data_mux_to_buffer_wire = pixel_write_data_sprite_to_mux_wire;
+        pixel_write_mask_mux_to_buffer_wire = pixel_write_mask_sprite_to_mux_wire;
     end
 
+    // The vector engine writes single pixels
     else if (pixel_write_enable_vector_to_mux_wire) begin
         pixel_write_enable_mux_to_buffer_wire = 1'b1;
-        pixel_write_address_mux_to_buffer_wire = pixel_write_address_vector_to_mux_wire;
-        pixel_write_data_mux_to_buffer_wire = pixel_write_data_vector_to_mux_wire;
+        pixel_write_address_mux_to_buffer_wire = pixel_write_address_vector_to_mux_wire[17:3];
+        pixel_write_data_mux_to_buffer_wire = {8{pixel_write_data_vector_to_mux_wire}};
+        pixel_write_mask_mux_to_buffer_wire = 8'b1 << pixel_write_address_vector_to_mux_wire[2:0];
     end
 
     else begin
         pixel_write_enable_mux_to_buffer_wire = 1'b0;
-        pixel_write_address_mux_to_buffer_wire = 18'b0;
-        pixel_write_data_mux_to_buffer_wire = 4'b0;
+        pixel_write_address_mux_to_buffer_wire = 15'b0;
+        pixel_write_data_mux_to_buffer_wire = 32'b0;
+        pixel_write_mask_mux_to_buffer_wire = 8'b0;
     end
 end
 
+// Feed sprite engine from either SPI or the sprite cache
+logic [9:0] cached_width_cache_to_mux_wire;
+logic [4:0] cached_total_colors_cache_to_mux_wire;
+logic cached_enable_cache_to_mux_wire;
+logic cached_data_valid_cache_to_mux_wire;
+logic [7:0] cached_data_cache_to_mux_wire;
+logic sprite_ready_engine_to_cache_wire;
+
+logic sprite_enable_mux_to_engine_wire;
+logic [9:0] sprite_x_position_mux_to_engine_wire;
+logic [9:0] sprite_y_position_mux_to_engine_wire;
+logic [9:0] sprite_width_mux_to_engine_wire;
+logic [4:0] sprite_total_colors_mux_to_engine_wire;
+logic [3:0] sprite_palette_offset_mux_to_engine_wire;
+logic sprite_data_valid_mux_to_engine_wire;
+logic [7:0] sprite_data_mux_to_engine_wire;
+
+always_comb begin
+    if (sprite_cache_busy) begin
+        sprite_enable_mux_to_engine_wire = cached_enable_cache_to_mux_wire;
+        sprite_x_position_mux_to_engine_wire = cached_x_position_spi_domain;
+        sprite_y_position_mux_to_engine_wire = cached_y_position_spi_domain;
+        sprite_width_mux_to_engine_wire = cached_width_cache_to_mux_wire;
+        sprite_total_colors_mux_to_engine_wire = cached_total_colors_cache_to_mux_wire;
+        sprite_palette_offset_mux_to_engine_wire = cached_palette_offset_spi_domain;
+        sprite_data_valid_mux_to_engine_wire = cached_data_valid_cache_to_mux_wire;
+        sprite_data_mux_to_engine_wire = cached_data_cache_to_mux_wire;
+    end
+
+    else begin
+        sprite_enable_mux_to_engine_wire = sprite_enable;
+        sprite_x_position_mux_to_engine_wire = sprite_x_position_spi_domain;
+        sprite_y_position_mux_to_engine_wire = sprite_y_position_spi_domain;
+        sprite_width_mux_to_engine_wire = sprite_width_spi_domain;
+        sprite_total_colors_mux_to_engine_wire = sprite_color_count_spi_domain;
+        sprite_palette_offset_mux_to_engine_wire = sprite_palette_offset_spi_domain;
+        sprite_data_valid_mux_to_engine_wire = sprite_data_valid;
+        sprite_data_mux_to_engine_wire = sprite_data_spi_domain;
+    end
+end
+
+sprite_cache sprite_cache (
+    .clock_in(display_clock_in),
+    .reset_n_in(display_reset_n_in),
+
+    .write_enable_in(cache_data_valid),
+    .write_first_in(cache_first_spi_domain),
+    .write_handle_in(cache_handle_spi_domain),
+    .write_address_in(cache_address_spi_domain),
+    .write_width_in(cache_width_spi_domain),
+    .write_total_colors_in(cache_color_count_spi_domain),
+    .write_data_in(cache_data_spi_domain),
+
+    .draw_enable_in(draw_cached_enable),
+    .draw_handle_in(cached_handle_spi_domain),
+
+    .width_out(cached_width_cache_to_mux_wire),
+    .total_colors_out(cached_total_colors_cache_to_mux_wire),
+
+    .sprite_ready_in(sprite_ready_engine_to_cache_wire),
+    .sprite_enable_out(cached_enable_cache_to_mux_wire),
+    .sprite_data_valid_out(cached_data_valid_cache_to_mux_wire),
+    .sprite_data_out(cached_data_cache_to_mux_wire),
+
+    .busy_out(sprite_cache_busy)
+);
+
 sprite_engine sprite_engine (
     .clock_in(display_clock_in),
     .reset_n_in(display_reset_n_in),
-    .enable_in(sprite_enable),
+    .enable_in(sprite_enable_mux_to_engine_wire),
 
-    .x_position_in(sprite_x_position_spi_domain),
-    .y_position_in(sprite_y_position_spi_domain),
-    .width_in(sprite_width_spi_domain),
-    .total_colors_in(sprite_color_count_spi_domain),
-    .color_palette_offset_in(sprite_palette_offset_spi_domain),
+    .x_position_in(sprite_x_position_mux_to_engine_wire),
+    .y_position_in(sprite_y_position_mux_to_engine_wire),
+    .width_in(sprite_width_mux_to_engine_wire),
+    .total_colors_in(sprite_total_colors_mux_to_engine_wire),
+    .color_palette_offset_in(sprite_palette_offset_mux_to_engine_wire),
 
-    .data_valid_in(sprite_data_valid),
-    .data_in(sprite_data_spi_domain),
+    .data_valid_in(sprite_data_valid_mux_to_engine_wire),
+    .data_in(sprite_data_mux_to_engine_wire),
 
     .pixel_write_enable_out(pixel_write_enable_sprite_to_mux_wire),
     .pixel_write_address_out(pixel_write_address_sprite_to_mux_wire),
-    .pixel_write_data_out(pixel_write_data_sprite_to_mux_wire)
+    .pixel_write_data_out(pixel_write_data_sprite_to_mux_wire),
+    .pixel_write_mask_out(pixel_write_mask_sprite_to_mux_wire),
+
+    .ready_out(sprite_ready_engine_to_cache_wire)
 );
 
-// Vector engine
-// TODO
+vector_engine vector_engine (
+    .clock_in(display_clock_in),
+    .reset_n_in(display_reset_n_in),
+    .enable_in(vector_enable),
+
+    .shape_in(vector_shape_spi_domain),
+    .x_start_position_in(vector_x_start_spi_domain),
+    .y_start_position_in(vector_y_start_spi_domain),
+    .x_end_position_in(vector_x_end_spi_domain),
+    .y_end_position_in(vector_y_end_spi_domain),
+    .color_in(vector_color_spi_domain),
+
+    .pixel_write_enable_out(pixel_write_enable_vector_to_mux_wire),
+    .pixel_write_address_out(pixel_write_address_vector_to_mux_wire),
+    .pixel_write_data_out(pixel_write_data_vector_to_mux_wire),
+    .pixel_write_ready_in(~pixel_write_enable_sprite_to_mux_wire),
+
+    .busy_out(vector_engine_busy)
+);
 
 logic [17:0] read_address_driver_to_buffer_wire;
 logic [3:0] color_data_buffer_to_palette_wire;
@@ -215,12 +453,19 @@ display_buffers display_buffers (
     .pixel_write_enable_in(pixel_write_enable_mux_to_buffer_wire),
     .pixel_write_address_in(pixel_write_address_mux_to_buffer_wire),
     .pixel_write_data_in(pixel_write_data_mux_to_buffer_wire),
+    .pixel_write_mask_in(pixel_write_mask_mux_to_buffer_wire),
 
     .pixel_read_address_in(read_address_driver_to_buffer_wire),
     .pixel_read_data_out(color_data_buffer_to_palette_wire),
 
     .buffer_status(buffer_status),
-    .switch_write_buffer_in(switch_buffer)
+    .switch_write_buffer_in(switch_buffer),
+
+    .clear_mode_in(clear_mode_spi_domain),
+    .clear_x_start_in(clear_x_start_spi_domain),
+    .clear_y_start_in(clear_y_start_spi_domain),
+    .clear_x_end_in(clear_x_end_spi_domain),
+    .clear_y_end_in(clear_y_end_spi_domain)
 );
 
 color_palette color_palette (
@@ -0,0 +1,147 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Raj Nakarja / Brilliant Labs Limited (raj@brilliant.xyz)
+ *
+ * CERN Open Hardware Licence Version 2 - Permissive
+ *
+ * Copyright © 2023 Brilliant Labs Limited
+ */
+
+ /*
+  * The sprite cache holds pre-rendered sprites, such as strings of text, so
+  * that they can be drawn again without resending the pixel data over SPI.
+  * Up to 16 sprites can be stored at once. Each entry records where its pixel
+  * data starts within the cache memory, how long it is, and the width and
+  * color format needed to draw it. Where in the cache each sprite is placed
+  * is managed by the nRF52.
+  *
+  * When a cached sprite is drawn, its pixel data is replayed byte by byte into
+  * the sprite engine, exactly as if it had arrived over SPI.
+  */
+
+module sprite_cache #(
+    parameter CACHE_SIZE = 8192
+)(
+    input logic clock_in,
+    input logic reset_n_in,
+
+    input logic write_enable_in,
+    input logic write_first_in,
+    input logic [3:0] write_handle_in,
+    input logic [$clog2(CACHE_SIZE)-1:0] write_address_in,
+    input logic [9:0] write_width_in,
+    input logic [4:0] write_total_colors_in,
+    input logic [7:0] write_data_in,
+
+    input logic draw_enable_in,
+    input logic [3:0] draw_handle_in,
+
+    output logic [9:0] width_out,
+    output logic [4:0] total_colors_out,
+
+    input logic sprite_ready_in,
+    output logic sprite_enable_out,
+    output logic sprite_data_valid_out,
+    output logic [7:0] sprite_data_out,
+
+    output logic busy_out
+);
+
+`ifndef RADIANT (* ram_style="block" *) `endif reg [7:0] mem [0:CACHE_SIZE-1];
+
+logic [$clog2(CACHE_SIZE)-1:0] entry_start [0:15];
+logic [$clog2(CACHE_SIZE):0] entry_length [0:15];
+logic [9:0] entry_width [0:15];
+logic [4:0] entry_total_colors [0:15];
+
+logic [$clog2(CACHE_SIZE)-1:0] write_pointer;
+logic [$clog2(CACHE_SIZE)-1:0] read_pointer;
+logic [$clog2(CACHE_SIZE):0] bytes_remaining;
+logic [7:0] read_data;
+
+// Storing sprites
+always_ff @(posedge clock_in) begin
+
+    if (write_enable_in) begin
+        if (write_first_in) begin
+            mem[write_address_in] <= write_data_in;
+            write_pointer <= write_address_in + 1;
+
+            entry_start[write_handle_in] <= write_address_in;
+            entry_length[write_handle_in] <= 1;
+            entry_width[write_handle_in] <= write_width_in;
+            entry_total_colors[write_handle_in] <= write_total_colors_in;
+        end
+
+        else begin
+            mem[write_pointer] <= write_data_in;
+            write_pointer <= write_pointer + 1;
+
+            entry_length[write_handle_in] <= entry_length[write_handle_in] + 1;
+        end
+    end
+
+end
+
+always_ff @(posedge clock_in) begin
+    read_data <= mem[read_pointer];
+end
+
+// Replaying sprites into the sprite engine
+enum {IDLE, FETCH, LATCH, PRESENT, NEXT, FINISH} state;
+
+always_ff @(posedge clock_in) begin
+
+    if (reset_n_in == 0) begin
+        state <= IDLE;
+        sprite_enable_out <= 0;
+        sprite_data_valid_out <= 0;
+    end
+
+    else begin
+
+        case (state)
+            IDLE: if (draw_enable_in && entry_length[draw_handle_in] != 0) begin
+                read_pointer <= entry_start[draw_handle_in];
+                bytes_remaining <= entry_length[draw_handle_in];
+                width_out <= entry_width[draw_handle_in];
+                total_colors_out <= entry_total_colors[draw_handle_in];
+                sprite_enable_out <= 1;
+                state <= FETCH;
+            end
+
+            // Memory reads take one cycle
+            FETCH: state <= LATCH;
+
+            LATCH: begin
+                sprite_data_out <= read_data;
+                state <= PRESENT;
+            end
+
+            // Data is held until the sprite engine has drawn every pixel
+            PRESENT: begin
+                sprite_data_valid_out <= 1;
+
+                if (sprite_data_valid_out && !sprite_ready_in) begin
+                    sprite_data_valid_out <= 0;
+                    sprite_enable_out <= 0;
+                    read_pointer <= read_pointer + 1;
+                    bytes_remaining <= bytes_remaining - 1;
+                    state <= bytes_remaining == 1 ? FINISH : NEXT;
+                end
+            end
+
+            NEXT: if (sprite_ready_in) state <= FETCH;
+
+            FINISH: if (sprite_ready_in) state <= IDLE;
+        endcase
+
+    end
+
+end
+
+always_comb busy_out = state != IDLE;
+
+endmodule
@@ -9,6 +9,15 @@
  * Copyright © 2023 Brilliant Labs Limited
  */
 
+ /*
+  * Pixels are written to the display buffer a word at a time, where each 32
+  * bit word holds 8 horizontally adjacent pixels. Each clock cycle, as many
+  * pixels as possible from the current byte are written in one go. A run of
+  * pixels stops at the end of the byte, the end of the word, or the end of the
+  * sprite's row. Aligned 2 color sprites therefore draw a whole byte in a
+  * single cycle.
+  */
+
  module sprite_engine (
     input logic clock_in,
     input logic reset_n_in,
@@ -24,14 +33,72 @@
     input logic [7:0] data_in,
 
     output logic pixel_write_enable_out,
-    output logic [17:0] pixel_write_address_out,
-    output logic [3:0] pixel_write_data_out
+    output logic [14:0] pixel_write_address_out,
+    output logic [31:0] pixel_write_data_out,
+    output logic [7:0] pixel_write_mask_out,
+
+    output logic ready_out
  );
 
-enum {NEW_PIXELS, DRAW, HOLD_OUTPUT_DATA, WAIT_FOR_NEW_PIXELS} state;
+enum {NEW_PIXELS, DRAW, WAIT_FOR_NEW_PIXELS} state;
 logic [9:0] current_x_pen_position;
-logic [9:0] current_y_pen_position;
-logic [4:0] pixels_remaining;
+logic [14:0] current_row_address;
+logic [3:0] pixels_remaining;
+
+logic [3:0] pixels_per_byte;
+logic [10:0] pixels_to_row_end;
+logic [3:0] pixels_to_word_end;
+logic [3:0] run_length;
+logic [3:0] first_pixel;
+logic [31:0] run_data;
+logic [7:0] run_mask;
+logic [3:0] lane_pixel;
+logic [3:0] lane_value;
+
+always_comb begin
+    case (total_colors_in)
+        4: pixels_per_byte = 4;
+        16: pixels_per_byte = 2;
+        default: pixels_per_byte = 8;
+    endcase
+
+    // The run of pixels that can be written this cycle
+    pixels_to_row_end = x_position_in + width_in - current_x_pen_position;
+    pixels_to_word_end = 8 - current_x_pen_position[2:0];
+
+    run_length = pixels_remaining;
+
+    if (pixels_to_word_end < run_length) begin
+        run_length = pixels_to_word_end;
+    end
+
+    if (pixels_to_row_end < run_length) begin
+        run_length = pixels_to_row_end[3:0];
+    end
+
+    first_pixel = pixels_per_byte - pixels_remaining;
+
+    // Place each pixel of the run into its lane of the word
+    run_data = 0;
+    run_mask = 0;
+
+    for (int lane = 0; lane < 8; lane++) begin
+        if (lane >= current_x_pen_position[2:0] &&
+            lane < current_x_pen_position[2:0] + run_length) begin
+
+            lane_pixel = first_pixel + lane - current_x_pen_position[2:0];
+
+            case (total_colors_in)
+                4: lane_value = data_in[6 - (lane_pixel[1:0] * 2) +: 2];
+                16: lane_value = data_in[4 - (lane_pixel[0] * 4) +: 4];
+                default: lane_value = data_in[7 - lane_pixel[2:0]];
+            endcase
+
+            run_mask[lane] = 1;
+            run_data[lane * 4 +: 4] = lane_value == 0 ? 0 : lane_value + color_palette_offset_in;
+        end
+    end
+end
 
 always_ff @(posedge clock_in) begin
 
@@ -46,13 +113,10 @@ always_ff @(posedge clock_in) begin
             NEW_PIXELS: if (data_valid_in) begin
                 if (enable_in) begin 
                     current_x_pen_position <= x_position_in;
-                    current_y_pen_position <= y_position_in;
+                    current_row_address <= (y_position_in << 6) + (y_position_in << 4);
                 end
-                case (total_colors_in)
-                    2: pixels_remaining <= 8;
-                    4: pixels_remaining <= 4;
-                    16: pixels_remaining <= 2;
-                endcase
+
+                pixels_remaining <= pixels_per_byte;
 
                 state <= DRAW;
 
@@ -60,70 +124,30 @@ always_ff @(posedge clock_in) begin
 
             DRAW: begin
 
-                pixels_remaining <= pixels_remaining - 1;
+                pixels_remaining <= pixels_remaining - run_length;
 
                 // Calculate the cursor position and width wrapping
-                if (current_x_pen_position < x_position_in + width_in - 1) begin
-                    current_x_pen_position <= current_x_pen_position + 1;
+                if (run_length < pixels_to_row_end) begin
+                    current_x_pen_position <= current_x_pen_position + run_length;
                 end
 
                 else begin
                     current_x_pen_position <= x_position_in;
-                    current_y_pen_position <= current_y_pen_position + 1;
+                    current_row_address <= current_row_address + 80;
                 end
 
-                // Output the pixel write address
-                pixel_write_address_out <= current_x_pen_position + 
-                                           (current_y_pen_position * 640);
-
-                // Draw pixel based on which color mode we are in
-                case (total_colors_in)
-                    2: begin
-                        case (pixels_remaining[2:0])
-                            'b001: pixel_write_data_out <= data_in[0] == 0 ? 0 : data_in[0] + color_palette_offset_in;
-                            'b010: pixel_write_data_out <= data_in[1] == 0 ? 0 : data_in[1] + color_palette_offset_in;
-                            'b011: pixel_write_data_out <= data_in[2] == 0 ? 0 : data_in[2] + color_palette_offset_in;
-                            'b100: pixel_write_data_out <= data_in[3] == 0 ? 0 : data_in[3] + color_palette_offset_in;
-                            'b101: pixel_write_data_out <= data_in[4] == 0 ? 0 : data_in[4] + color_palette_offset_in;
-                            'b110: pixel_write_data_out <= data_in[5] == 0 ? 0 : data_in[5] + color_palette_offset_in;
-                            'b111: pixel_write_data_out <= data_in[6] == 0 ? 0 : data_in[6] + color_palette_offset_in;
-                            'b000: pixel_write_data_out <= data_in[7] == 0 ? 0 : data_in[7] + color_palette_offset_in;
-                        endcase
-                    end
-
-                    4: begin
-                        case (pixels_remaining[1:0])
-                            'b01: pixel_write_data_out <= data_in[1:0] == 0 ? 0 : data_in[1:0] + color_palette_offset_in;
-                            'b10: pixel_write_data_out <= data_in[3:2] == 0 ? 0 : data_in[3:2] + color_palette_offset_in;
-                            'b11: pixel_write_data_out <= data_in[5:4] == 0 ? 0 : data_in[5:4] + color_palette_offset_in;
-                            'b00: pixel_write_data_out <= data_in[7:6] == 0 ? 0 : data_in[7:6] + color_palette_offset_in;
-                        endcase
-                    end
-
-                    16: begin
-                        case (pixels_remaining[0])
-                            'b1: pixel_write_data_out <= data_in[3:0] == 0 ? 0 : data_in[3:0] + color_palette_offset_in;
-                            'b0: pixel_write_data_out <= data_in[7:4] == 0 ? 0 : data_in[7:4] + color_palette_offset_in;
-                        endcase
-                    end
-                endcase
+                // Output the pixel write word address, data and mask
+                pixel_write_address_out <= current_row_address + 
+                                           current_x_pen_position[9:3];
+                pixel_write_data_out <= run_data;
+                pixel_write_mask_out <= run_mask;
 
                 pixel_write_enable_out <= 1;
 
-                state <= HOLD_OUTPUT_DATA;
-
-            end
-        
-            HOLD_OUTPUT_DATA: begin
-
-                if (pixels_remaining == 0) begin
+                if (pixels_remaining == run_length) begin
                     state <= WAIT_FOR_NEW_PIXELS;    
                 end
 
-                else begin
-                    state <= DRAW;
-                end
-
             end
 
             WAIT_FOR_NEW_PIXELS: begin
@@ -139,5 +163,7 @@ always_ff @(posedge clock_in) begin
     end
 
 end
+
+always_comb ready_out = state == NEW_PIXELS;
     
 endmodule
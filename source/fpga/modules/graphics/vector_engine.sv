@@ -0,0 +1,170 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Raj Nakarja / Brilliant Labs Limited (raj@brilliant.xyz)
+ *
+ * CERN Open Hardware Licence Version 2 - Permissive
+ *
+ * Copyright © 2023 Brilliant Labs Limited
+ */
+
+ /*
+  * The vector engine rasterizes two primitives. Lines between any two points
+  * are drawn using Bresenham's algorithm, and filled rectangles are drawn row
+  * by row between two corners. Outlined rectangles and polygons are built up
+  * from these by the nRF52. One pixel is output per clock, and each pixel is
+  * held until the display buffer accepts it, as the sprite engine always takes
+  * priority.
+  */
+
+module vector_engine (
+    input logic clock_in,
+    input logic reset_n_in,
+    input logic enable_in,
+
+    input logic [1:0] shape_in,
+    input logic [9:0] x_start_position_in,
+    input logic [9:0] y_start_position_in,
+    input logic [9:0] x_end_position_in,
+    input logic [9:0] y_end_position_in,
+    input logic [3:0] color_in,
+
+    output logic pixel_write_enable_out,
+    output logic [17:0] pixel_write_address_out,
+    output logic [3:0] pixel_write_data_out,
+    input logic pixel_write_ready_in,
+
+    output logic busy_out
+);
+
+parameter SHAPE_LINE = 'd0;
+parameter SHAPE_FILLED_RECTANGLE = 'd1;
+
+enum {IDLE, LINE, FILL} state;
+
+logic signed [11:0] x;
+logic signed [11:0] y;
+logic signed [11:0] x_end;
+logic signed [11:0] y_end;
+logic signed [11:0] x_step;
+logic signed [11:0] y_step;
+logic signed [11:0] delta_x;
+logic signed [11:0] delta_y;
+logic signed [12:0] error;
+logic signed [13:0] error_doubled;
+logic signed [11:0] x_fill_start;
+
+logic pixel_accepted;
+
+always_comb pixel_accepted = !pixel_write_enable_out || pixel_write_ready_in;
+always_comb error_doubled = error <<< 1;
+
+always_ff @(posedge clock_in) begin
+
+    if (reset_n_in == 0) begin
+        pixel_write_enable_out <= 0;
+        state <= IDLE;
+    end
+
+    else begin
+
+        if (pixel_write_ready_in) begin
+            pixel_write_enable_out <= 0;
+        end
+
+        case (state)
+            IDLE: if (enable_in) begin
+                case (shape_in)
+                    SHAPE_LINE: begin
+                        x <= x_start_position_in;
+                        y <= y_start_position_in;
+                        x_end <= x_end_position_in;
+                        y_end <= y_end_position_in;
+
+                        x_step <= x_start_position_in < x_end_position_in ? 1 : -1;
+                        y_step <= y_start_position_in < y_end_position_in ? 1 : -1;
+
+                        delta_x <= x_start_position_in < x_end_position_in
+                                 ? x_end_position_in - x_start_position_in
+                                 : x_start_position_in - x_end_position_in;
+
+                        delta_y <= y_start_position_in < y_end_position_in
+                                 ? y_start_position_in - y_end_position_in
+                                 : y_end_position_in - y_start_position_in;
+
+                        error <= (x_start_position_in < x_end_position_in
+                                  ? x_end_position_in - x_start_position_in
+                                  : x_start_position_in - x_end_position_in) -
+                                 (y_start_position_in < y_end_position_in
+                                  ? y_end_position_in - y_start_position_in
+                                  : y_start_position_in - y_end_position_in);
+
+                        state <= LINE;
+                    end
+
+                    SHAPE_FILLED_RECTANGLE: begin
+                        x <= x_start_position_in < x_end_position_in ? x_start_position_in : x_end_position_in;
+                        y <= y_start_position_in < y_end_position_in ? y_start_position_in : y_end_position_in;
+                        x_fill_start <= x_start_position_in < x_end_position_in ? x_start_position_in : x_end_position_in;
+                        x_end <= x_start_position_in < x_end_position_in ? x_end_position_in : x_start_position_in;
+                        y_end <= y_start_position_in < y_end_position_in ? y_end_position_in : y_start_position_in;
+
+                        state <= FILL;
+                    end
+                endcase
+            end
+
+            LINE: if (pixel_accepted) begin
+                pixel_write_enable_out <= x < 640 && y < 400;
+                pixel_write_address_out <= x + (y << 9) + (y << 7);
+                pixel_write_data_out <= color_in;
+
+                if (x == x_end && y == y_end) begin
+                    state <= IDLE;
+                end
+
+                else begin
+                    if (error_doubled >= delta_y) begin
+                        error <= error + delta_y +
+                                 (error_doubled <= delta_x ? delta_x : 0);
+                        x <= x + x_step;
+                    end
+
+                    else if (error_doubled <= delta_x) begin
+                        error <= error + delta_x;
+                    end
+
+                    if (error_doubled <= delta_x) begin
+                        y <= y + y_step;
+                    end
+                end
+            end
+
+            FILL: if (pixel_accepted) begin
+                pixel_write_enable_out <= x < 640 && y < 400;
+                pixel_write_address_out <= x + (y << 9) + (y << 7);
+                pixel_write_data_out <= color_in;
+
+                if (x < x_end) begin
+                    x <= x + 1;
+                end
+
+                else if (y < y_end) begin
+                    x <= x_fill_start;
+                    y <= y + 1;
+                end
+
+                else begin
+                    state <= IDLE;
+                end
+            end
+        endcase
+
+    end
+
+end
+
+always_comb busy_out = state != IDLE || pixel_write_enable_out;
+
+endmodule
@@ -21,8 +21,8 @@
  * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
  * PERFORMANCE OF THIS SOFTWARE.
  */
-
 #include <stdint.h>
+#include <string.h>
 #include "error_logging.h"
 #include "i2c.h"
 #include "main.h"
@@ -36,12 +36,14 @@ static const uint8_t CAMERA_I2C_ADDRESS = 0x36;
 static const uint8_t MAGNETOMETER_I2C_ADDRESS = 0x0C;
 static const uint8_t PMIC_I2C_ADDRESS = 0x48;
 
+static volatile bool transfer_in_progress = false;
+
 void i2c_configure(void)
 {
     nrfx_twim_config_t i2c_config = {
         .scl_pin = I2C_SCL_PIN,
         .sda_pin = I2C_SDA_PIN,
-        .frequency = NRF_TWIM_FREQ_100K,
+        .frequency = NRF_TWIM_FREQ_400K,
         .interrupt_priority = NRFX_TWIM_DEFAULT_CONFIG_IRQ_PRIORITY,
         .hold_bus_uninit = false,
     };
@@ -51,193 +53,192 @@ void i2c_configure(void)
     nrfx_twim_enable(&i2c);
 }
 
-i2c_response_t i2c_read(i2c_device_t device,
-                        uint16_t register_address,
-                        uint8_t register_mask)
+static uint8_t device_address_of(i2c_device_t device)
 {
-    if (not_real_hardware)
-    {
-        return (i2c_response_t){.fail = false, .value = 0x00};
-    }
-
-    uint8_t device_address = 0;
-
     switch (device)
     {
     case ACCELEROMETER:
-        device_address = ACCELEROMETER_I2C_ADDRESS;
-        break;
+        return ACCELEROMETER_I2C_ADDRESS;
 
     case CAMERA:
-        device_address = CAMERA_I2C_ADDRESS;
-        break;
+        return CAMERA_I2C_ADDRESS;
 
     case MAGNETOMETER:
-        device_address = MAGNETOMETER_I2C_ADDRESS;
-        break;
+        return MAGNETOMETER_I2C_ADDRESS;
 
     case PMIC:
-        device_address = PMIC_I2C_ADDRESS;
-        break;
+        return PMIC_I2C_ADDRESS;
 
     default:
         error_with_message("Invalid I2C device selected");
-        break;
+        return 0;
     }
+}
 
-    // Populate the default response in case of failure
-    i2c_response_t i2c_response = {
-        .fail = true,
-        .value = 0x00,
-    };
-
-    // Create the tx payload, bus handle and transfer descriptors
-    uint8_t tx_payload[2] = {(uint8_t)(register_address), 0};
-
-    nrfx_twim_xfer_desc_t i2c_tx = NRFX_TWIM_XFER_DESC_TX(device_address,
-                                                          tx_payload,
-                                                          1);
-
-    // Use 16 bit addressing for camera
+// Returns the length of the register address. The camera uses 16 bit addresses
+static size_t encode_register_address(uint8_t device_address,
+                                      uint16_t register_address,
+                                      uint8_t *payload)
+{
     if (device_address == CAMERA_I2C_ADDRESS)
     {
-        tx_payload[0] = (uint8_t)(register_address >> 8);
-        tx_payload[1] = (uint8_t)register_address;
-        i2c_tx.primary_length = 2;
+        payload[0] = (uint8_t)(register_address >> 8);
+        payload[1] = (uint8_t)register_address;
+        return 2;
     }
 
-    nrfx_twim_xfer_desc_t i2c_rx = NRFX_TWIM_XFER_DESC_RX(device_address,
-                                                          &i2c_response.value,
-                                                          1);
+    payload[0] = (uint8_t)register_address;
+    return 1;
+}
 
-    // Try several times
-    for (uint8_t i = 0; i < 3; i++)
-    {
-        nrfx_err_t tx_err = nrfx_twim_xfer(&i2c, &i2c_tx, 0);
+bool i2c_busy(void)
+{
+    return transfer_in_progress;
+}
 
-        if (tx_err == NRFX_ERROR_NOT_SUPPORTED ||
-            tx_err == NRFX_ERROR_INTERNAL ||
-            tx_err == NRFX_ERROR_INVALID_ADDR ||
-            tx_err == NRFX_ERROR_DRV_TWI_ERR_OVERRUN)
-        {
-            check_error(tx_err);
-        }
+static bool transfer(nrfx_twim_xfer_desc_t *i2c_xfer)
+{
+    // Interrupts can only use the bus when this isn't set
+    transfer_in_progress = true;
 
-        nrfx_err_t rx_err = nrfx_twim_xfer(&i2c, &i2c_rx, 0);
+    bool success = false;
 
-        if (rx_err == NRFX_ERROR_NOT_SUPPORTED ||
-            rx_err == NRFX_ERROR_INTERNAL ||
-            rx_err == NRFX_ERROR_INVALID_ADDR ||
-            rx_err == NRFX_ERROR_DRV_TWI_ERR_OVERRUN)
-        {
-            check_error(rx_err);
-        }
+    // Try several times
+    for (uint8_t i = 0; i < 3 && !success; i++)
+    {
+        nrfx_err_t err = nrfx_twim_xfer(&i2c, i2c_xfer, 0);
 
-        if (tx_err == NRFX_SUCCESS && rx_err == NRFX_SUCCESS)
+        if (err == NRFX_ERROR_BUSY ||
+            err == NRFX_ERROR_NOT_SUPPORTED ||
+            err == NRFX_ERROR_INTERNAL ||
+            err == NRFX_ERROR_INVALID_ADDR ||
+            err == NRFX_ERROR_DRV_TWI_ERR_OVERRUN)
         {
-            i2c_response.fail = false;
-            break;
+            check_error(err);
         }
+
+        success = err == NRFX_SUCCESS;
     }
 
-    i2c_response.value &= register_mask;
+    transfer_in_progress = false;
 
-    return i2c_response;
+    return success;
 }
 
-i2c_response_t i2c_write(i2c_device_t device,
-                         uint16_t register_address,
-                         uint8_t register_mask,
-                         uint8_t set_value)
+i2c_response_t i2c_read_burst(i2c_device_t device,
+                              uint16_t register_address,
+                              uint8_t *data,
+                              size_t length)
 {
-    i2c_response_t resp = {.fail = false, .value = 0x00};
-
     if (not_real_hardware)
     {
-        return resp;
+        memset(data, 0, length);
+        return (i2c_response_t){.fail = false, .value = 0x00};
     }
 
-    uint8_t device_address = 0;
-
-    switch (device)
+    if (length == 0 || length > I2C_MAX_BURST_LENGTH)
     {
-    case ACCELEROMETER:
-        device_address = ACCELEROMETER_I2C_ADDRESS;
-        break;
+        error_with_message("Invalid I2C burst length");
+    }
 
-    case CAMERA:
-        device_address = CAMERA_I2C_ADDRESS;
-        break;
+    uint8_t device_address = device_address_of(device);
 
-    case MAGNETOMETER:
-        device_address = MAGNETOMETER_I2C_ADDRESS;
-        break;
+    uint8_t tx_payload[2];
+    size_t address_length = encode_register_address(device_address,
+                                                    register_address,
+                                                    tx_payload);
 
-    case PMIC:
-        device_address = PMIC_I2C_ADDRESS;
-        break;
+    // The register address and data are sent together with a repeated start
+    nrfx_twim_xfer_desc_t i2c_txrx = NRFX_TWIM_XFER_DESC_TXRX(device_address,
+                                                              tx_payload,
+                                                              address_length,
+                                                              data,
+                                                              length);
 
-    default:
-        error_with_message("Invalid I2C device selected");
-        break;
+    if (!transfer(&i2c_txrx))
+    {
+        memset(data, 0, length);
+        return (i2c_response_t){.fail = true, .value = 0x00};
     }
 
-    if (register_mask != 0xFF)
+    return (i2c_response_t){.fail = false, .value = data[0]};
+}
+
+i2c_response_t i2c_write_burst(i2c_device_t device,
+                               uint16_t register_address,
+                               const uint8_t *data,
+                               size_t length)
+{
+    if (not_real_hardware)
     {
-        resp = i2c_read(device, register_address, 0xFF);
+        return (i2c_response_t){.fail = false, .value = 0x00};
+    }
 
-        if (resp.fail)
-        {
-            return resp;
-        }
+    if (length == 0 || length > I2C_MAX_BURST_LENGTH)
+    {
+        error_with_message("Invalid I2C burst length");
     }
 
-    // Create a combined value with the existing data and the new value
-    uint8_t updated_value = (resp.value & ~register_mask) |
-                            (set_value & register_mask);
+    uint8_t device_address = device_address_of(device);
 
-    // Create the tx payload, bus handle and transfer descriptor
-    uint8_t tx_payload[3] = {(uint8_t)register_address, updated_value, 0};
+    // The address and data must be contiguous in a single transfer
+    uint8_t tx_payload[2 + I2C_MAX_BURST_LENGTH];
+    size_t address_length = encode_register_address(device_address,
+                                                    register_address,
+                                                    tx_payload);
+
+    memcpy(tx_payload + address_length, data, length);
 
     nrfx_twim_xfer_desc_t i2c_tx = NRFX_TWIM_XFER_DESC_TX(device_address,
                                                           tx_payload,
-                                                          2);
+                                                          address_length + length);
 
-    // Use 16 bit addressing for camera
-    if (device_address == CAMERA_I2C_ADDRESS)
+    return (i2c_response_t){.fail = !transfer(&i2c_tx), .value = 0x00};
+}
+
+i2c_response_t i2c_read(i2c_device_t device,
+                        uint16_t register_address,
+                        uint8_t register_mask)
+{
+    uint8_t value;
+
+    i2c_response_t i2c_response = i2c_read_burst(device,
+                                                 register_address,
+                                                 &value,
+                                                 1);
+
+    i2c_response.value &= register_mask;
+
+    return i2c_response;
+}
+
+i2c_response_t i2c_write(i2c_device_t device,
+                         uint16_t register_address,
+                         uint8_t register_mask,
+                         uint8_t set_value)
+{
+    i2c_response_t resp = {.fail = false, .value = 0x00};
+
+    if (not_real_hardware)
     {
-        tx_payload[0] = (uint8_t)(register_address >> 8);
-        tx_payload[1] = (uint8_t)register_address;
-        tx_payload[2] = updated_value;
-        i2c_tx.primary_length = 3;
+        return resp;
     }
 
-    // Try several times
-    for (uint8_t i = 0; i < 3; i++)
+    if (register_mask != 0xFF)
     {
-        nrfx_err_t err = nrfx_twim_xfer(&i2c, &i2c_tx, 0);
+        resp = i2c_read(device, register_address, 0xFF);
 
-        if (err == NRFX_ERROR_BUSY ||
-            err == NRFX_ERROR_NOT_SUPPORTED ||
-            err == NRFX_ERROR_INTERNAL ||
-            err == NRFX_ERROR_INVALID_ADDR ||
-            err == NRFX_ERROR_DRV_TWI_ERR_OVERRUN)
+        if (resp.fail)
         {
-            check_error(err);
+            return resp;
         }
+    }
 
-        if (err == NRFX_SUCCESS)
-        {
-            break;
-        }
+    // Create a combined value with the existing data and the new value
+    uint8_t updated_value = (resp.value & ~register_mask) |
+                            (set_value & register_mask);
 
-        // If the last try failed. Don't continue
-        if (i == 2)
-        {
-            resp.fail = true;
-            break;
-        }
-    }
+    resp = i2c_write_burst(device, register_address, &updated_value, 1);
 
     return resp;
 }
@@ -25,8 +25,12 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+// Longest run of registers which can be read or written in one transfer
+#define I2C_MAX_BURST_LENGTH 32
+
 typedef enum i2c_device_t
 {
     ACCELEROMETER,
@@ -43,6 +47,10 @@ typedef struct i2c_response_t
 
 void i2c_configure(void);
 
+// True while a transfer is running. Interrupt handlers which use the bus must
+// check this, and defer their transfers until it's free
+bool i2c_busy(void);
+
 i2c_response_t i2c_read(i2c_device_t device,
                         uint16_t register_address,
                         uint8_t register_mask);
@@ -50,4 +58,16 @@ i2c_response_t i2c_read(i2c_device_t device,
 i2c_response_t i2c_write(i2c_device_t device,
                          uint16_t register_address,
                          uint8_t register_mask,
-                         uint8_t set_value);
\ No newline at end of file
+                         uint8_t set_value);
+
+// Accesses consecutive registers in a single transfer. All devices on the bus
+// auto increment the register address. The response value is the first byte
+i2c_response_t i2c_read_burst(i2c_device_t device,
+                              uint16_t register_address,
+                              uint8_t *data,
+                              size_t length);
+
+i2c_response_t i2c_write_burst(i2c_device_t device,
+                               uint16_t register_address,
+                               const uint8_t *data,
+                               size_t length);
\ No newline at end of file
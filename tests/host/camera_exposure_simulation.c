@@ -0,0 +1,278 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Runs the auto exposure control loop against a model of the sensor and the
+ * FPGA's luma statistics, and counts how many frames it takes to settle after
+ * each change of scene.
+ *
+ * The sensor is taken to be linear up to its 10 bit limit. Statistics are
+ * gathered exactly as histogram.sv does, including the truncation of the bins
+ * and zones. The previous proportional controller, which stepped only part of
+ * the way towards the target each frame, is run alongside for comparison.
+ *
+ * Usage: camera_exposure_simulation [-v]
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "camera_exposure.h"
+
+#define IMAGE_SIZE 240
+#define FRAMES_PER_SCENE 8
+
+#define TARGET 0.1
+#define TOLERANCE 0.1
+#define LEGACY_SPEED 0.45
+
+// Shutter from 4 to 16383 lines, and analog gain from 1 to 16
+#define MINIMUM_EXPOSURE 4.0
+#define MAXIMUM_EXPOSURE (16383.0 * 16.0)
+
+// Corrections allowed before settling, normally and when starting saturated
+#define MAX_STEPS 2
+#define MAX_STEPS_SATURATED 4
+
+typedef struct scene_t
+{
+    const char *name;
+    double (*radiance)(int x, int y);
+} scene_t;
+
+static double texture(int x, int y)
+{
+    return 1.0 + 0.5 * sin(x / 7.0) * cos(y / 11.0);
+}
+
+static double grey_card(int x, int y)
+{
+    return 0.064;
+}
+
+static double sunlit(int x, int y)
+{
+    return 2.0 * texture(x, y);
+}
+
+static double indoor(int x, int y)
+{
+    return (0.01 + 0.07 * x / IMAGE_SIZE) * texture(x, y);
+}
+
+static double backlit(int x, int y)
+{
+    // Window in the top left corner, taking up about a fifth of the frame
+    if (x < IMAGE_SIZE / 2 && y < IMAGE_SIZE * 2 / 5)
+    {
+        return 0.5;
+    }
+
+    return 0.004 * texture(x, y);
+}
+
+static double night(int x, int y)
+{
+    return 0.0002 * texture(x, y);
+}
+
+static const scene_t scenes[] = {
+    {"grey card", grey_card},
+    {"sunlit", sunlit},
+    {"indoor", indoor},
+    {"backlit", backlit},
+    {"night", night},
+    {"sunlit", sunlit},
+    {"indoor", indoor},
+    {"grey card", grey_card},
+};
+
+static void capture_statistics(const scene_t *scene,
+                               double exposure,
+                               camera_exposure_statistics_t *statistics)
+{
+    uint32_t bins[CAMERA_EXPOSURE_HISTOGRAM_BINS] = {0};
+    uint32_t zones[CAMERA_EXPOSURE_ZONES] = {0};
+    int zone_size = IMAGE_SIZE >> 2;
+
+    for (int y = 0; y < IMAGE_SIZE; y++)
+    {
+        for (int x = 0; x < IMAGE_SIZE; x++)
+        {
+            double value = scene->radiance(x, y) * exposure;
+            uint16_t pixel = value > 1023.0 ? 1023 : (uint16_t)value;
+
+            // Grey scene, so (R + 2G + B) / 4 is the pixel itself
+            uint8_t luma = (uint8_t)((4 * pixel) >> 4);
+
+            int zone_x = x / zone_size > 3 ? 3 : x / zone_size;
+            int zone_y = y / zone_size > 3 ? 3 : y / zone_size;
+
+            bins[luma >> 2]++;
+            zones[zone_y * 4 + zone_x] += luma;
+        }
+    }
+
+    for (int i = 0; i < CAMERA_EXPOSURE_HISTOGRAM_BINS; i++)
+    {
+        statistics->histogram[i] = (uint16_t)(bins[i] >> 3);
+    }
+
+    for (int i = 0; i < CAMERA_EXPOSURE_ZONES; i++)
+    {
+        statistics->zones[i] = (uint16_t)(zones[i] >> 8);
+    }
+}
+
+static double clamp_exposure(double exposure)
+{
+    if (exposure > MAXIMUM_EXPOSURE)
+    {
+        return MAXIMUM_EXPOSURE;
+    }
+
+    if (exposure < MINIMUM_EXPOSURE)
+    {
+        return MINIMUM_EXPOSURE;
+    }
+
+    return exposure;
+}
+
+static bool settled(const camera_exposure_measurement_t *measurement,
+                    double exposure)
+{
+    if (fabs(measurement->metered / TARGET - 1.0) <= TOLERANCE)
+    {
+        return true;
+    }
+
+    // Nothing more can be done once at a limit
+    return (exposure >= MAXIMUM_EXPOSURE && measurement->metered < TARGET) ||
+           (exposure <= MINIMUM_EXPOSURE && measurement->metered > TARGET);
+}
+
+static bool simulate(camera_exposure_metering_t metering,
+                     const char *metering_name,
+                     bool verbose)
+{
+    double exposure = 1600.0;
+    double legacy_exposure = 1600.0;
+    bool passed = true;
+
+    printf("%s metering\n", metering_name);
+
+    for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); i++)
+    {
+        int steps = -1;
+        int legacy_steps = -1;
+        bool saturated = false;
+
+        for (int frame = 0; frame < FRAMES_PER_SCENE; frame++)
+        {
+            camera_exposure_statistics_t statistics;
+            camera_exposure_measurement_t measurement;
+
+            capture_statistics(&scenes[i], exposure, &statistics);
+            double correction = camera_exposure_correction(&statistics,
+                                                           metering,
+                                                           TARGET,
+                                                           &measurement);
+
+            if (frame == 0)
+            {
+                saturated = measurement.clipped > 0.5;
+            }
+
+            if (steps < 0 && settled(&measurement, exposure))
+            {
+                steps = frame;
+            }
+
+            if (verbose)
+            {
+                printf("    %-10s %d: exposure %9.1f, metered %.3f, clipped %.3f\n",
+                       scenes[i].name,
+                       frame,
+                       exposure,
+                       measurement.metered,
+                       measurement.clipped);
+            }
+
+            exposure = clamp_exposure(exposure * correction);
+
+            // The previous controller, blending part way towards the target
+            camera_exposure_measurement_t legacy;
+
+            capture_statistics(&scenes[i], legacy_exposure, &statistics);
+            camera_exposure_correction(&statistics, metering, TARGET, &legacy);
+
+            if (legacy_steps < 0 && settled(&legacy, legacy_exposure))
+            {
+                legacy_steps = frame;
+            }
+
+            double metered = legacy.metered > 0.0001 ? legacy.metered : 0.0001;
+            double error = LEGACY_SPEED * (TARGET / metered - 1) + 1;
+            legacy_exposure = clamp_exposure(legacy_exposure * error);
+        }
+
+        int allowed = saturated ? MAX_STEPS_SATURATED : MAX_STEPS;
+        bool scene_passed = steps >= 0 && steps <= allowed;
+        passed &= scene_passed;
+
+        char legacy_result[16];
+        if (legacy_steps < 0)
+        {
+            snprintf(legacy_result, sizeof(legacy_result), ">%d", FRAMES_PER_SCENE - 1);
+        }
+        else
+        {
+            snprintf(legacy_result, sizeof(legacy_result), "%d", legacy_steps);
+        }
+
+        printf("    %-10s settled after %2d frames%s (previously %3s) %s\n",
+               scenes[i].name,
+               steps,
+               saturated ? ", from saturated" : "",
+               legacy_result,
+               scene_passed ? "PASS" : "FAIL");
+    }
+
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    bool passed = true;
+
+    passed &= simulate(CAMERA_EXPOSURE_AVERAGE, "Average", verbose);
+    passed &= simulate(CAMERA_EXPOSURE_CENTER_WEIGHTED, "Center weighted", verbose);
+    passed &= simulate(CAMERA_EXPOSURE_SPOT, "Spot", verbose);
+
+    return passed ? 0 : 1;
+}
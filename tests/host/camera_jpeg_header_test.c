@@ -0,0 +1,332 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Generates the color and grayscale JPEG headers at several sizes and quality
+ * factors, and parses them segment by segment as a decoder would.
+ *
+ * Checks that every segment fits within the header, that the scan is the last
+ * segment, and that the frame and scan only refer to the components and
+ * tables which the header defines.
+ *
+ * Usage: camera_jpeg_header_test [-v]
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "camera_jpeg_header.h"
+
+typedef struct parsed_header_t
+{
+    bool quantization_tables[4];
+    bool huffman_tables[2][4];
+    uint16_t width;
+    uint16_t height;
+    uint8_t components;
+    uint8_t component_ids[3];
+    uint8_t scan_components;
+} parsed_header_t;
+
+static bool fail(bool verbose, size_t position, const char *reason)
+{
+    if (verbose)
+    {
+        printf("    offset %zu: %s\n", position, reason);
+    }
+
+    return false;
+}
+
+static bool parse_quantization_tables(const uint8_t *segment,
+                                      size_t length,
+                                      parsed_header_t *parsed)
+{
+    for (size_t i = 0; i < length; i += 65)
+    {
+        // Only 8 bit tables are generated
+        if (length - i < 65 || segment[i] >> 4 != 0 || (segment[i] & 0x0F) > 3)
+        {
+            return false;
+        }
+
+        for (size_t j = 1; j <= 64; j++)
+        {
+            if (segment[i + j] == 0)
+            {
+                return false;
+            }
+        }
+
+        parsed->quantization_tables[segment[i] & 0x0F] = true;
+    }
+
+    return true;
+}
+
+static bool parse_huffman_tables(const uint8_t *segment,
+                                 size_t length,
+                                 parsed_header_t *parsed)
+{
+    size_t i = 0;
+
+    while (i < length)
+    {
+        if (length - i < 17 || segment[i] >> 4 > 1 || (segment[i] & 0x0F) > 3)
+        {
+            return false;
+        }
+
+        size_t symbols = 0;
+
+        for (size_t j = 1; j <= 16; j++)
+        {
+            symbols += segment[i + j];
+        }
+
+        if (length - i - 17 < symbols)
+        {
+            return false;
+        }
+
+        parsed->huffman_tables[segment[i] >> 4][segment[i] & 0x0F] = true;
+        i += 17 + symbols;
+    }
+
+    return true;
+}
+
+static bool parse_start_of_frame(const uint8_t *segment,
+                                 size_t length,
+                                 parsed_header_t *parsed)
+{
+    if (length < 6 || segment[0] != 8)
+    {
+        return false;
+    }
+
+    parsed->height = segment[1] << 8 | segment[2];
+    parsed->width = segment[3] << 8 | segment[4];
+    parsed->components = segment[5];
+
+    if (parsed->components > 3 || length != 6 + parsed->components * 3)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < parsed->components; i++)
+    {
+        const uint8_t *component = segment + 6 + i * 3;
+
+        if (component[2] > 3 || !parsed->quantization_tables[component[2]])
+        {
+            return false;
+        }
+
+        parsed->component_ids[i] = component[0];
+    }
+
+    return true;
+}
+
+static bool parse_start_of_scan(const uint8_t *segment,
+                                size_t length,
+                                parsed_header_t *parsed)
+{
+    if (length < 1 || length != 1 + segment[0] * 2 + 3)
+    {
+        return false;
+    }
+
+    parsed->scan_components = segment[0];
+
+    for (size_t i = 0; i < parsed->scan_components; i++)
+    {
+        const uint8_t *component = segment + 1 + i * 2;
+        bool found = false;
+
+        for (size_t j = 0; j < parsed->components; j++)
+        {
+            found |= parsed->component_ids[j] == component[0];
+        }
+
+        if (!found ||
+            (component[1] >> 4) > 3 ||
+            (component[1] & 0x0F) > 3 ||
+            !parsed->huffman_tables[0][component[1] >> 4] ||
+            !parsed->huffman_tables[1][component[1] & 0x0F])
+        {
+            return false;
+        }
+    }
+
+    // Baseline scans cover all 64 coefficients with no approximation
+    const uint8_t *spectral = segment + 1 + parsed->scan_components * 2;
+
+    return spectral[0] == 0 && spectral[1] == 63 && spectral[2] == 0;
+}
+
+static bool parse_header(const uint8_t *header,
+                         size_t length,
+                         parsed_header_t *parsed,
+                         bool verbose)
+{
+    memset(parsed, 0, sizeof(parsed_header_t));
+
+    if (length < 2 || header[0] != 0xFF || header[1] != 0xD8)
+    {
+        return fail(verbose, 0, "no start of image");
+    }
+
+    bool frame_seen = false;
+
+    for (size_t position = 2; position < length;)
+    {
+        if (length - position < 4 || header[position] != 0xFF)
+        {
+            return fail(verbose, position, "expected a marker");
+        }
+
+        uint8_t marker = header[position + 1];
+        size_t segment_length = header[position + 2] << 8 |
+                                header[position + 3];
+
+        if (segment_length < 2 || length - position - 2 < segment_length)
+        {
+            return fail(verbose, position, "segment overruns the header");
+        }
+
+        const uint8_t *segment = header + position + 4;
+        size_t body_length = segment_length - 2;
+        bool valid;
+
+        switch (marker)
+        {
+        case 0xE0:
+            valid = true;
+            break;
+
+        case 0xDB:
+            valid = parse_quantization_tables(segment, body_length, parsed);
+            break;
+
+        case 0xC4:
+            valid = parse_huffman_tables(segment, body_length, parsed);
+            break;
+
+        case 0xC0:
+            valid = parse_start_of_frame(segment, body_length, parsed);
+            frame_seen = true;
+            break;
+
+        case 0xDA:
+            // The compressed data follows straight after the scan header
+            if (!frame_seen ||
+                position + 2 + segment_length != length)
+            {
+                return fail(verbose, position, "scan isn't last");
+            }
+
+            valid = parse_start_of_scan(segment, body_length, parsed);
+            break;
+
+        default:
+            return fail(verbose, position, "unexpected marker");
+        }
+
+        if (!valid)
+        {
+            return fail(verbose, position, "invalid segment");
+        }
+
+        position += 2 + segment_length;
+    }
+
+    if (parsed->scan_components == 0)
+    {
+        return fail(verbose, length, "no start of scan");
+    }
+
+    return true;
+}
+
+static bool test_header(bool grayscale,
+                        uint16_t width,
+                        uint16_t height,
+                        uint8_t quality_factor,
+                        bool verbose)
+{
+    uint8_t header[CAMERA_JPEG_HEADER_MAX_LENGTH];
+    size_t length = camera_jpeg_header_length(grayscale);
+    parsed_header_t parsed;
+
+    camera_jpeg_header(header, width, height, quality_factor, grayscale);
+
+    uint8_t components = grayscale ? 1 : 3;
+
+    bool passed = length <= sizeof(header) &&
+                  parse_header(header, length, &parsed, verbose) &&
+                  parsed.width == width &&
+                  parsed.height == height &&
+                  parsed.components == components &&
+                  parsed.scan_components == components;
+
+    printf("%-16s %-9s %3ux%-3u quality %2u %3zu bytes %s\n",
+           "jpeg header",
+           grayscale ? "grayscale" : "color",
+           width,
+           height,
+           quality_factor,
+           length,
+           passed ? "PASS" : "FAIL");
+
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    bool passed = true;
+
+    const uint16_t sizes[][2] = {{720, 720}, {512, 512}, {640, 200}};
+    const uint8_t quality_factors[] = {10, 50, 95};
+
+    for (size_t grayscale = 0; grayscale <= 1; grayscale++)
+    {
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        {
+            for (size_t j = 0; j < sizeof(quality_factors); j++)
+            {
+                passed &= test_header(grayscale,
+                                      sizes[i][0],
+                                      sizes[i][1],
+                                      quality_factors[j],
+                                      verbose);
+            }
+        }
+    }
+
+    return passed ? 0 : 1;
+}
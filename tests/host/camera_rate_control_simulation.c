@@ -0,0 +1,256 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Replays recorded compressed sizes and metering values through the camera
+ * rate controller, and checks how well it keeps each frame within budget.
+ *
+ * Each trace is captured at a single quality level. The size the frame would
+ * have had at any other level is estimated by scaling the quantization tables
+ * the same way as the JPEG header generated in camera.c. This deliberately
+ * differs from the controller's own size table so that it has to adapt.
+ *
+ * Usage: camera_rate_control_simulation [-v] trace.csv [trace.csv ...]
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "camera_rate_control.h"
+
+#define MAX_TRACE_FRAMES 1024
+#define SETTLING_FRAMES 3
+
+// Allowed overshoot before a frame counts as over budget, and how many may be
+#define OVERSHOOT_TOLERANCE 1.1
+#define MAX_OVERSHOOT_FRACTION 0.1
+
+// Frames which fit should use at least this much of the budget on average
+#define MIN_AVERAGE_UTILISATION 0.6
+
+typedef struct trace_frame_t
+{
+    uint16_t resolution;
+    uint8_t quality_level;
+    uint32_t compressed_bytes;
+    uint8_t metering[6];
+} trace_frame_t;
+
+static trace_frame_t frames[MAX_TRACE_FRAMES];
+
+static const uint8_t quality_factors[CAMERA_RATE_CONTROL_QUALITY_LEVELS] = {
+    15, 20, 25, 30, 35, 40, 50, 60};
+
+static double size_at_level(const trace_frame_t *frame, uint8_t quality_level)
+{
+    double scale[2];
+    uint8_t quality_factor[2] = {quality_factors[frame->quality_level],
+                                 quality_factors[quality_level]};
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (quality_factor[i] < 50)
+        {
+            scale[i] = 5000.0 / quality_factor[i];
+        }
+        else
+        {
+            scale[i] = 200.0 - 2 * quality_factor[i];
+        }
+    }
+
+    double size = frame->compressed_bytes * pow(scale[0] / scale[1], 0.75);
+
+    return size > 65535 ? 65535 : size;
+}
+
+static int load_trace(const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "couldn't open %s\n", filename);
+        return -1;
+    }
+
+    char line[256];
+    int count = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL && count < MAX_TRACE_FRAMES)
+    {
+        if (line[0] == '#' || line[0] == '\n')
+        {
+            continue;
+        }
+
+        unsigned int values[9];
+
+        if (sscanf(line, "%u,%u,%u,%u,%u,%u,%u,%u,%u",
+                   &values[0], &values[1], &values[2],
+                   &values[3], &values[4], &values[5],
+                   &values[6], &values[7], &values[8]) != 9 ||
+            values[1] >= CAMERA_RATE_CONTROL_QUALITY_LEVELS)
+        {
+            fprintf(stderr, "%s: bad line: %s", filename, line);
+            fclose(file);
+            return -1;
+        }
+
+        frames[count].resolution = (uint16_t)values[0];
+        frames[count].quality_level = (uint8_t)values[1];
+        frames[count].compressed_bytes = values[2];
+
+        for (int i = 0; i < 6; i++)
+        {
+            frames[count].metering[i] = (uint8_t)values[3 + i];
+        }
+
+        count++;
+    }
+
+    fclose(file);
+    return count;
+}
+
+static bool simulate(const char *name,
+                     int frame_count,
+                     uint32_t target_bytes,
+                     bool verbose)
+{
+    camera_rate_control_t rate_control;
+    camera_rate_control_reset(&rate_control, target_bytes, 7);
+
+    int counted = 0;
+    int over_budget = 0;
+    int under_max_level = 0;
+    double utilisation = 0;
+
+    for (int i = 0; i < frame_count; i++)
+    {
+        uint32_t pixels = (uint32_t)frames[i].resolution * frames[i].resolution;
+
+        uint8_t quality_level = camera_rate_control_next_quality_level(
+            &rate_control,
+            pixels);
+
+        uint32_t size = (uint32_t)size_at_level(&frames[i], quality_level);
+
+        camera_rate_control_update(&rate_control,
+                                   pixels,
+                                   quality_level,
+                                   size,
+                                   frames[i].metering);
+
+        if (verbose)
+        {
+            printf("    %4d: level %u, %5u bytes%s\n",
+                   i,
+                   quality_level,
+                   size,
+                   size > target_bytes ? " over" : "");
+        }
+
+        if (i < SETTLING_FRAMES)
+        {
+            continue;
+        }
+
+        counted++;
+
+        // Can't do better than the lowest level, so those overshoots are fine
+        if (size > target_bytes * OVERSHOOT_TOLERANCE && quality_level > 0)
+        {
+            over_budget++;
+        }
+
+        // Nor use more of the budget than the highest level allows
+        if (size <= target_bytes && quality_level < 7)
+        {
+            under_max_level++;
+            utilisation += (double)size / target_bytes;
+        }
+    }
+
+    double over_budget_fraction = counted ? (double)over_budget / counted : 0;
+    double average_utilisation = under_max_level ? utilisation / under_max_level : 1;
+
+    bool passed = over_budget_fraction <= MAX_OVERSHOOT_FRACTION &&
+                  average_utilisation >= MIN_AVERAGE_UTILISATION;
+
+    printf("%-24s %6u bytes: %3d%% over budget, %3d%% average use %s\n",
+           name,
+           target_bytes,
+           (int)(over_budget_fraction * 100),
+           (int)(average_utilisation * 100),
+           passed ? "PASS" : "FAIL");
+
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    static const uint32_t targets[] = {6000, 12000, 20000, 32000};
+
+    bool verbose = false;
+    bool passed = true;
+    int traces = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+        {
+            verbose = true;
+            continue;
+        }
+
+        int frame_count = load_trace(argv[i]);
+
+        if (frame_count <= 0)
+        {
+            return 1;
+        }
+
+        const char *name = strrchr(argv[i], '/');
+        name = name ? name + 1 : argv[i];
+
+        for (size_t j = 0; j < sizeof(targets) / sizeof(targets[0]); j++)
+        {
+            passed &= simulate(name, frame_count, targets[j], verbose);
+        }
+
+        traces++;
+    }
+
+    if (traces == 0)
+    {
+        fprintf(stderr, "usage: %s [-v] trace.csv [trace.csv ...]\n", argv[0]);
+        return 1;
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,362 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Encodes batches of commands as a host would, splits the stream into writes of
+ * every Bluetooth payload size, and checks that the decoder hands back exactly
+ * the same commands in order.
+ *
+ * Also checks that commands which are too long, or don't fit in the queue, are
+ * dropped without disturbing the ones around them, and that commands keep the
+ * flags they were queued with.
+ *
+ * Usage: command_framing_test [-v]
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "command_framing.h"
+
+// Payloads from the smallest MTU of 23 bytes up to the preferred MTU of 247,
+// less the ATT header and command flag
+#define MIN_PAYLOAD 19
+#define MAX_PAYLOAD 243
+
+#define COMMAND_COUNT 2000
+#define MAX_UNREAD_WRITES 3
+
+static command_framing_t framing;
+
+static uint8_t commands[COMMAND_COUNT][COMMAND_FRAMING_MAX_LENGTH];
+static size_t command_lengths[COMMAND_COUNT];
+static uint8_t stream[COMMAND_COUNT * (COMMAND_FRAMING_MAX_LENGTH + 2)];
+
+static size_t random_length(void)
+{
+    // Mostly short calls, with some needing the two byte prefix
+    if (rand() % 8 == 0)
+    {
+        return 128 + (size_t)rand() % (COMMAND_FRAMING_MAX_LENGTH - 127);
+    }
+
+    return 1 + (size_t)rand() % 40;
+}
+
+static size_t generate_commands(void)
+{
+    size_t stream_length = 0;
+
+    for (size_t i = 0; i < COMMAND_COUNT; i++)
+    {
+        command_lengths[i] = random_length();
+
+        for (size_t j = 0; j < command_lengths[i]; j++)
+        {
+            commands[i][j] = (uint8_t)rand();
+        }
+
+        stream_length += command_framing_encode(commands[i],
+                                                command_lengths[i],
+                                                stream + stream_length);
+    }
+
+    return stream_length;
+}
+
+// Reads out every queued command, and checks them against those sent
+static bool read_commands(size_t *next, bool verbose)
+{
+    uint8_t command[COMMAND_FRAMING_MAX_LENGTH];
+    uint8_t flags;
+    size_t length;
+    bool matched = true;
+
+    while ((length = command_framing_read(&framing, command, &flags)) > 0)
+    {
+        if (*next >= COMMAND_COUNT ||
+            flags != 0 ||
+            length != command_lengths[*next] ||
+            memcmp(command, commands[*next], length) != 0)
+        {
+            if (verbose)
+            {
+                printf("    command %zu: %zu bytes differ\n", *next, length);
+            }
+
+            matched = false;
+        }
+
+        (*next)++;
+    }
+
+    return matched;
+}
+
+static bool test_loopback(size_t payload, bool verbose)
+{
+    size_t stream_length = generate_commands();
+
+    command_framing_reset(&framing);
+
+    size_t next = 0;
+    size_t unread_writes = 0;
+    bool matched = true;
+
+    for (size_t offset = 0; offset < stream_length; offset += payload)
+    {
+        size_t length = stream_length - offset < payload
+                            ? stream_length - offset
+                            : payload;
+
+        command_framing_receive(&framing, stream + offset, length);
+        unread_writes++;
+
+        // Lua doesn't always run between writes, but the queue holds a few
+        if (rand() % 2 == 0 || unread_writes == MAX_UNREAD_WRITES)
+        {
+            matched &= read_commands(&next, verbose);
+            unread_writes = 0;
+        }
+    }
+
+    matched &= read_commands(&next, verbose);
+
+    return matched && next == COMMAND_COUNT && framing.dropped == 0;
+}
+
+static bool test_payload_sizes(bool verbose)
+{
+    bool passed = true;
+
+    for (size_t payload = MIN_PAYLOAD; payload <= MAX_PAYLOAD; payload++)
+    {
+        bool matched = test_loopback(payload, verbose);
+
+        if (!matched)
+        {
+            printf("    %zu byte writes differ\n", payload);
+        }
+
+        passed &= matched;
+    }
+
+    // Byte at a time, splitting every prefix
+    passed &= test_loopback(1, verbose);
+
+    printf("%-16s %d to %d byte writes %s\n",
+           "loopback",
+           MIN_PAYLOAD,
+           MAX_PAYLOAD,
+           passed ? "PASS" : "FAIL");
+
+    return passed;
+}
+
+static bool test_batching(void)
+{
+    command_framing_reset(&framing);
+
+    // As many three byte calls as fit in one write
+    uint8_t write[MAX_PAYLOAD];
+    size_t length = 0;
+    size_t sent = 0;
+
+    while (length + 4 <= sizeof(write))
+    {
+        uint8_t command[3] = {(uint8_t)sent, 0x80, 0x81};
+        length += command_framing_encode(command, sizeof(command), write + length);
+        sent++;
+    }
+
+    command_framing_receive(&framing, write, length);
+
+    uint8_t command[COMMAND_FRAMING_MAX_LENGTH];
+    size_t received = 0;
+    bool matched = true;
+
+    while ((length = command_framing_read(&framing, command, NULL)) > 0)
+    {
+        matched &= length == 3 && command[0] == (uint8_t)received;
+        received++;
+    }
+
+    bool passed = matched && received == sent;
+
+    printf("%-16s %zu calls in one write %s\n",
+           "batching",
+           received,
+           passed ? "PASS" : "FAIL");
+
+    return passed;
+}
+
+static bool test_dropped(void)
+{
+    command_framing_reset(&framing);
+
+    uint8_t command[COMMAND_FRAMING_MAX_LENGTH + 1];
+    uint8_t encoded[COMMAND_FRAMING_MAX_LENGTH + 3];
+    memset(command, 0xAA, sizeof(command));
+
+    // Too long, and skipped without losing the next command
+    size_t length = command_framing_encode(command, sizeof(command), encoded);
+    command_framing_receive(&framing, encoded, length);
+
+    command[0] = 1;
+    length = command_framing_encode(command, 1, encoded);
+    command_framing_receive(&framing, encoded, length);
+
+    bool too_long_skipped =
+        framing.dropped == 1 &&
+        command_framing_read(&framing, command, NULL) == 1 &&
+        command[0] == 1;
+
+    // Fill the queue without reading, so the last one doesn't fit
+    size_t queued = 0;
+
+    while (framing.dropped == 1)
+    {
+        command[0] = (uint8_t)queued;
+        length = command_framing_encode(command, 100, encoded);
+        command_framing_receive(&framing, encoded, length);
+        queued++;
+    }
+
+    size_t kept = 0;
+    bool intact = true;
+
+    while (command_framing_read(&framing, command, NULL) == 100)
+    {
+        intact &= command[0] == (uint8_t)kept;
+        kept++;
+    }
+
+    bool full_dropped = kept == queued - 1 &&
+                        kept == (COMMAND_FRAMING_QUEUE_SIZE - 1) / 103;
+
+    // A disconnect part way through a command doesn't corrupt the next
+    length = command_framing_encode(command, 200, encoded);
+    command_framing_receive(&framing, encoded, 50);
+    command_framing_abandon(&framing);
+
+    command[0] = 2;
+    length = command_framing_encode(command, 1, encoded);
+    command_framing_receive(&framing, encoded, length);
+
+    bool abandoned = command_framing_read(&framing, command, NULL) == 1 &&
+                     command[0] == 2;
+
+    bool passed = too_long_skipped && intact && full_dropped && abandoned;
+
+    printf("%-16s %s, %zu of %zu queued, %s %s\n",
+           "dropped",
+           too_long_skipped ? "too long skipped" : "too long kept",
+           kept,
+           queued,
+           abandoned ? "abandoned" : "not abandoned",
+           passed ? "PASS" : "FAIL");
+
+    return passed;
+}
+
+static bool test_flags(void)
+{
+    command_framing_reset(&framing);
+
+    // A single call, as pushed from a data packet
+    uint8_t packet[] = {0x03, 0x80};
+    command_framing_push(&framing, packet, sizeof(packet), 0x01);
+
+    // Streamed calls starting with bytes that aren't valid IDs, including one
+    // that would look like a marked call to ID 3, and a lone byte
+    uint8_t writes[] = {0x03, 0xFF, 0x03, 0x80, 0x01, 0xFF, 0x00};
+    command_framing_receive(&framing, writes, sizeof(writes));
+
+    uint8_t command[COMMAND_FRAMING_MAX_LENGTH];
+    uint8_t flags;
+
+    bool packet_marked =
+        command_framing_read(&framing, command, &flags) == 2 &&
+        flags == 0x01 &&
+        command[0] == 0x03;
+
+    bool stream_unmarked =
+        command_framing_read(&framing, command, &flags) == 3 &&
+        flags == 0 &&
+        command[0] == 0xFF && command[1] == 0x03 &&
+        command_framing_read(&framing, command, &flags) == 1 &&
+        flags == 0 &&
+        command[0] == 0xFF;
+
+    // The zero length one is never queued
+    bool empty_skipped = command_framing_read(&framing, command, &flags) == 0;
+
+    bool passed = packet_marked && stream_unmarked && empty_skipped;
+
+    printf("%-16s packet %s, stream %s, %s %s\n",
+           "flags",
+           packet_marked ? "marked" : "not marked",
+           stream_unmarked ? "unmarked" : "marked",
+           empty_skipped ? "empty skipped" : "empty queued",
+           passed ? "PASS" : "FAIL");
+
+    return passed;
+}
+
+static bool test_prefix_lengths(void)
+{
+    static uint8_t command[0x8000];
+    static uint8_t encoded[0x8002];
+
+    bool passed = command_framing_encode(command, 127, encoded) == 128 &&
+                  encoded[0] == 127 &&
+                  command_framing_encode(command, 128, encoded) == 130 &&
+                  encoded[0] == 0x80 && encoded[1] == 128 &&
+                  command_framing_encode(command, 0x7FFF, encoded) == 0x8001 &&
+                  encoded[0] == 0xFF && encoded[1] == 0xFF &&
+                  command_framing_encode(command, 0x8000, encoded) == 0;
+
+    printf("%-16s %s\n", "prefix lengths", passed ? "PASS" : "FAIL");
+
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    bool passed = true;
+
+    srand(1);
+
+    passed &= test_payload_sizes(verbose);
+    passed &= test_batching();
+    passed &= test_dropped();
+    passed &= test_flags();
+    passed &= test_prefix_lengths();
+
+    return passed ? 0 : 1;
+}
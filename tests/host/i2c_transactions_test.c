@@ -0,0 +1,297 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Builds the I2C driver against a mock TWIM peripheral, and checks the
+ * transactions it makes on the bus for single, masked and burst accesses.
+ *
+ * The IMU and auto exposure access patterns are run both the previous way, as
+ * single register accesses, and as bursts, to show how much bus time is saved.
+ *
+ * Usage: i2c_transactions_test
+ */
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_logging.h"
+#include "i2c.h"
+#include "nrfx_twim_mock.h"
+
+// 9 bits per byte plus start and stop, in microseconds
+#define BUS_TIME_US(bytes, transactions, khz) \
+    (((bytes) * 9 + (transactions) * 2) * 1000 / (khz))
+
+bool not_real_hardware = false;
+
+static jmp_buf error_jump;
+static bool expecting_error = false;
+static bool passed = true;
+
+void _check_error(nrfx_err_t error_code, const char *file, const int line)
+{
+    if (error_code != NRFX_SUCCESS)
+    {
+        _error(" - check_error", file, line);
+    }
+}
+
+void _error(const char *message, const char *file, const int line)
+{
+    if (expecting_error)
+    {
+        longjmp(error_jump, 1);
+    }
+
+    fprintf(stderr, "unexpected error%s at %s:%d\n", message, file, line);
+    passed = false;
+}
+
+static void check(bool condition, const char *name)
+{
+    printf("%-48s %s\n", name, condition ? "PASS" : "FAIL");
+    passed &= condition;
+}
+
+static uint32_t transactions_since(uint32_t *start)
+{
+    uint32_t count = mock_twim.transactions - *start;
+    *start = mock_twim.transactions;
+    return count;
+}
+
+static void test_configuration(void)
+{
+    check(mock_twim.enabled && mock_twim.frequency == NRF_TWIM_FREQ_400K,
+          "bus enabled in fast mode");
+}
+
+static void test_single_accesses(void)
+{
+    mock_twim_device_t *pmic = mock_twim_device(0x48);
+    mock_twim_device_t *camera = mock_twim_device(0x36);
+    uint32_t start = mock_twim.transactions;
+
+    pmic->registers[0x14] = 0xA5;
+    i2c_response_t response = i2c_read(PMIC, 0x14, 0x0F);
+    check(!response.fail && response.value == 0x05 &&
+              transactions_since(&start) == 1,
+          "single read is one repeated start transaction");
+
+    check(!i2c_write(PMIC, 0x20, 0xFF, 0x3C).fail &&
+              pmic->registers[0x20] == 0x3C &&
+              transactions_since(&start) == 1,
+          "full write is one transaction");
+
+    pmic->registers[0x21] = 0xF0;
+    check(!i2c_write(PMIC, 0x21, 0x0F, 0x0A).fail &&
+              pmic->registers[0x21] == 0xFA &&
+              transactions_since(&start) == 2,
+          "masked write reads then writes");
+
+    camera->registers[0x300A] = 0x56;
+    camera->registers[0x0A] = 0xFF;
+    check(i2c_read(CAMERA, 0x300A, 0xFF).value == 0x56 &&
+              transactions_since(&start) == 1,
+          "camera uses 16 bit register addresses");
+}
+
+static void test_bursts(void)
+{
+    mock_twim_device_t *accelerometer = mock_twim_device(0x4C);
+    mock_twim_device_t *camera = mock_twim_device(0x36);
+    uint32_t start = mock_twim.transactions;
+
+    for (int i = 0; i < 6; i++)
+    {
+        accelerometer->registers[0x0D + i] = 0x10 + i;
+    }
+
+    uint8_t data[6];
+    i2c_response_t response = i2c_read_burst(ACCELEROMETER, 0x0D, data, 6);
+    check(!response.fail && response.value == 0x10 &&
+              memcmp(data, &accelerometer->registers[0x0D], 6) == 0 &&
+              transactions_since(&start) == 1,
+          "burst read is one transaction");
+
+    const uint8_t gains[6] = {0x01, 0x23, 0x02, 0x45, 0x03, 0x67};
+    check(!i2c_write_burst(CAMERA, 0x5180, gains, 6).fail &&
+              memcmp(gains, &camera->registers[0x5180], 6) == 0 &&
+              transactions_since(&start) == 1,
+          "burst write is one transaction");
+
+    uint8_t long_burst[I2C_MAX_BURST_LENGTH + 1] = {0};
+    expecting_error = true;
+    bool raised = setjmp(error_jump) != 0;
+    if (!raised)
+    {
+        i2c_write_burst(CAMERA, 0x5180, long_burst, sizeof(long_burst));
+    }
+    expecting_error = false;
+    check(raised && transactions_since(&start) == 0,
+          "over long burst is rejected");
+}
+
+static void test_retries(void)
+{
+    mock_twim_device_t *magnetometer = mock_twim_device(0x0C);
+    uint32_t start = mock_twim.transactions;
+
+    magnetometer->registers[0x10] = 0x42;
+    mock_twim.nacks_pending = 2;
+    i2c_response_t response = i2c_read(MAGNETOMETER, 0x10, 0xFF);
+    check(!response.fail && response.value == 0x42 &&
+              transactions_since(&start) == 3,
+          "NACKed read is retried");
+
+    mock_twim.nacks_pending = 3;
+    uint8_t data[2] = {0x12, 0x34};
+    response = i2c_read_burst(MAGNETOMETER, 0x10, data, 2);
+    check(response.fail && data[0] == 0 && data[1] == 0 &&
+              transactions_since(&start) == 3,
+          "read fails after three NACKs");
+
+    mock_twim.nacks_pending = 3;
+    check(i2c_write_burst(MAGNETOMETER, 0x1B, data, 1).fail &&
+              transactions_since(&start) == 3,
+          "write fails after three NACKs");
+
+    check(!i2c_busy(), "bus released after failed transfers");
+
+    not_real_hardware = true;
+    check(!i2c_read_burst(MAGNETOMETER, 0x10, data, 2).fail &&
+              transactions_since(&start) == 0,
+          "no transactions without real hardware");
+    not_real_hardware = false;
+}
+
+static void report(const char *name,
+                   uint32_t single_transactions,
+                   uint32_t single_bytes,
+                   uint32_t burst_transactions,
+                   uint32_t burst_bytes)
+{
+    printf("%-24s %2u transactions, %4u us at 100 kHz -> "
+           "%2u transactions, %4u us at 400 kHz\n",
+           name,
+           single_transactions,
+           BUS_TIME_US(single_bytes, single_transactions, 100),
+           burst_transactions,
+           BUS_TIME_US(burst_bytes, burst_transactions, 400));
+}
+
+static void compare_imu_reads(void)
+{
+    uint32_t transactions = mock_twim.transactions;
+    uint32_t bytes = mock_twim.bytes;
+
+    // Previously a separate address write and data read per register
+    for (uint16_t i = 0; i < 6; i++)
+    {
+        i2c_read(MAGNETOMETER, 0x10 + i, 0xFF);
+        i2c_read(ACCELEROMETER, 0x0D + i, 0xFF);
+    }
+
+    uint32_t single_transactions = 2 * (mock_twim.transactions - transactions);
+    uint32_t single_bytes = mock_twim.bytes - bytes;
+
+    transactions = mock_twim.transactions;
+    bytes = mock_twim.bytes;
+
+    uint8_t data[6];
+    i2c_read_burst(MAGNETOMETER, 0x10, data, 6);
+    i2c_read_burst(ACCELEROMETER, 0x0D, data, 6);
+
+    uint32_t burst_transactions = mock_twim.transactions - transactions;
+
+    report("IMU sample",
+           single_transactions,
+           single_bytes,
+           burst_transactions,
+           mock_twim.bytes - bytes);
+
+    check(burst_transactions == 2, "IMU sample is two transactions");
+}
+
+static void compare_auto_exposure_writes(void)
+{
+    uint32_t transactions = mock_twim.transactions;
+    uint32_t bytes = mock_twim.bytes;
+
+    // Previously each register, with read-modify-writes for masked fields
+    i2c_write(CAMERA, 0x380E, 0xFF, 0x03);
+    i2c_write(CAMERA, 0x380F, 0xFF, 0x22);
+    i2c_write(CAMERA, 0x3500, 0x03, 0x00);
+    i2c_write(CAMERA, 0x3501, 0xFF, 0x20);
+    i2c_write(CAMERA, 0x3502, 0xF0, 0x00);
+    i2c_write(CAMERA, 0x350B, 0xFF, 0x10);
+
+    for (uint16_t i = 0; i < 6; i += 2)
+    {
+        i2c_write(CAMERA, 0x5180 + i, 0x03, 0x01);
+        i2c_write(CAMERA, 0x5181 + i, 0xFF, 0x00);
+    }
+
+    // Reads were previously split into two transactions
+    uint32_t single_transactions = mock_twim.transactions - transactions + 5;
+    uint32_t single_bytes = mock_twim.bytes - bytes;
+
+    transactions = mock_twim.transactions;
+    bytes = mock_twim.bytes;
+
+    const uint8_t vts[2] = {0x03, 0x22};
+    const uint8_t exposure[3] = {0x00, 0x20, 0x00};
+    const uint8_t gains[6] = {0x01, 0x00, 0x01, 0x00, 0x01, 0x00};
+    i2c_write_burst(CAMERA, 0x380E, vts, 2);
+    i2c_write_burst(CAMERA, 0x3500, exposure, 3);
+    i2c_write(CAMERA, 0x350B, 0xFF, 0x10);
+    i2c_write_burst(CAMERA, 0x5180, gains, 6);
+
+    uint32_t burst_transactions = mock_twim.transactions - transactions;
+
+    report("Auto exposure update",
+           single_transactions,
+           single_bytes,
+           burst_transactions,
+           mock_twim.bytes - bytes);
+
+    check(burst_transactions == 4, "auto exposure update is four transactions");
+}
+
+int main(void)
+{
+    mock_twim_reset();
+    i2c_configure();
+
+    test_configuration();
+    test_single_accesses();
+    test_bursts();
+    test_retries();
+    compare_imu_reads();
+    compare_auto_exposure_writes();
+
+    return passed ? 0 : 1;
+}
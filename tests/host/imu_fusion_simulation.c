@@ -0,0 +1,272 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Replays accelerometer and magnetometer traces through the orientation filter
+ * and compares the angles with those recorded alongside them.
+ *
+ * Each trace is also run without filtering, as each sample was previously
+ * handled on its own, to show how much jitter the filter removes. Jitter is
+ * the part of each sample to sample change not present in the true angles.
+ *
+ * Usage: imu_fusion_simulation [-v] trace.csv [trace.csv ...]
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "imu_fusion.h"
+
+#define MAX_TRACE_SAMPLES 2048
+#define SETTLING_SAMPLES 64
+
+#define TIME_CONSTANT 0.2f
+
+// Limits on the RMS error and jitter of each angle, in degrees
+#define MAX_ERROR 3.0
+#define MAX_JITTER 0.5
+
+typedef struct trace_sample_t
+{
+    uint32_t timestamp_ms;
+    float accelerometer[3];
+    float magnetometer[3];
+    double angles[3];
+} trace_sample_t;
+
+typedef struct result_t
+{
+    double error[3];
+    double jitter[3];
+} result_t;
+
+static const char *angle_names[3] = {"pitch", "roll", "heading"};
+
+static trace_sample_t samples[MAX_TRACE_SAMPLES];
+
+static int load_trace(const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "couldn't open %s\n", filename);
+        return -1;
+    }
+
+    char line[256];
+    int count = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL && count < MAX_TRACE_SAMPLES)
+    {
+        if (line[0] == '#' || line[0] == '\n')
+        {
+            continue;
+        }
+
+        trace_sample_t *sample = &samples[count];
+
+        if (sscanf(line, "%u,%f,%f,%f,%f,%f,%f,%lf,%lf,%lf",
+                   &sample->timestamp_ms,
+                   &sample->accelerometer[0],
+                   &sample->accelerometer[1],
+                   &sample->accelerometer[2],
+                   &sample->magnetometer[0],
+                   &sample->magnetometer[1],
+                   &sample->magnetometer[2],
+                   &sample->angles[0],
+                   &sample->angles[1],
+                   &sample->angles[2]) != 10)
+        {
+            fprintf(stderr, "%s: bad line: %s", filename, line);
+            fclose(file);
+            return -1;
+        }
+
+        count++;
+    }
+
+    fclose(file);
+    return count;
+}
+
+// Difference between two angles, wrapped to within +/-180 degrees
+static double angle_difference(double a, double b)
+{
+    double difference = fmod(a - b, 360.0);
+
+    if (difference > 180.0)
+    {
+        difference -= 360.0;
+    }
+    else if (difference < -180.0)
+    {
+        difference += 360.0;
+    }
+
+    return difference;
+}
+
+static result_t replay(int sample_count, bool filtered, bool verbose)
+{
+    imu_fusion_t fusion;
+    imu_fusion_reset(&fusion, TIME_CONSTANT);
+
+    result_t result = {0};
+    double previous_error[3] = {0};
+    int counted = 0;
+
+    for (int i = 0; i < sample_count; i++)
+    {
+        trace_sample_t *sample = &samples[i];
+
+        float interval = i > 0 ? (sample->timestamp_ms -
+                                  samples[i - 1].timestamp_ms) /
+                                     1000.0f
+                               : 0.0f;
+
+        if (!filtered)
+        {
+            imu_fusion_reset(&fusion, TIME_CONSTANT);
+        }
+
+        imu_fusion_update(&fusion,
+                          sample->accelerometer,
+                          sample->magnetometer,
+                          interval);
+
+        imu_fusion_orientation_t orientation = imu_fusion_orientation(&fusion);
+        double angles[3] = {orientation.pitch,
+                            orientation.roll,
+                            orientation.heading};
+
+        if (verbose && filtered)
+        {
+            printf("    %5u ms: pitch %6.1f (%6.1f), roll %6.1f (%6.1f), "
+                   "heading %5.1f (%5.1f)\n",
+                   sample->timestamp_ms,
+                   angles[0], sample->angles[0],
+                   angles[1], sample->angles[1],
+                   angles[2], sample->angles[2]);
+        }
+
+        double error[3];
+
+        for (int j = 0; j < 3; j++)
+        {
+            error[j] = angle_difference(angles[j], sample->angles[j]);
+        }
+
+        if (i >= SETTLING_SAMPLES)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                double change = error[j] - previous_error[j];
+                result.error[j] += error[j] * error[j];
+                result.jitter[j] += change * change;
+            }
+
+            counted++;
+        }
+
+        memcpy(previous_error, error, sizeof(error));
+    }
+
+    for (int j = 0; j < 3; j++)
+    {
+        result.error[j] = sqrt(result.error[j] / counted);
+        result.jitter[j] = sqrt(result.jitter[j] / counted);
+    }
+
+    return result;
+}
+
+static bool simulate(const char *name, int sample_count, bool verbose)
+{
+    result_t filtered = replay(sample_count, true, verbose);
+    result_t unfiltered = replay(sample_count, false, false);
+
+    bool passed = true;
+
+    printf("%s\n", name);
+
+    for (int j = 0; j < 3; j++)
+    {
+        bool angle_passed = filtered.error[j] <= MAX_ERROR &&
+                            filtered.jitter[j] <= MAX_JITTER;
+
+        printf("    %-8s %5.2f error, %5.2f jitter "
+               "(unfiltered %5.2f error, %5.2f jitter) %s\n",
+               angle_names[j],
+               filtered.error[j],
+               filtered.jitter[j],
+               unfiltered.error[j],
+               unfiltered.jitter[j],
+               angle_passed ? "PASS" : "FAIL");
+
+        passed &= angle_passed;
+    }
+
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = false;
+    bool passed = true;
+    int traces = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+        {
+            verbose = true;
+            continue;
+        }
+
+        int sample_count = load_trace(argv[i]);
+
+        if (sample_count <= SETTLING_SAMPLES)
+        {
+            return 1;
+        }
+
+        const char *name = strrchr(argv[i], '/');
+        name = name ? name + 1 : argv[i];
+
+        passed &= simulate(name, sample_count, verbose);
+
+        traces++;
+    }
+
+    if (traces == 0)
+    {
+        fprintf(stderr, "usage: %s [-v] trace.csv [trace.csv ...]\n", argv[0]);
+        return 1;
+    }
+
+    return passed ? 0 : 1;
+}
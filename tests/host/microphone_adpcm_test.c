@@ -0,0 +1,371 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Encodes test signals into ADPCM packets as the microphone does, and decodes
+ * them with a separate reference decoder written from the IMA specification.
+ *
+ * Checks the quality of the round trip, that the decoder ends each packet in
+ * the state given by the next packet's header, and that packets fill each
+ * possible Bluetooth payload size.
+ *
+ * Usage: microphone_adpcm_test [-v]
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "microphone_adpcm.h"
+
+#define SAMPLE_RATE 16000
+#define SIGNAL_SAMPLES 32000
+
+// Payloads from the smallest MTU of 23 bytes up to the preferred MTU of 247,
+// less the ATT header and data flag
+#define MIN_PAYLOAD 19
+#define MAX_PAYLOAD 243
+
+static int16_t signal[SIGNAL_SAMPLES];
+static int16_t decoded[SIGNAL_SAMPLES];
+static uint8_t packets[SIGNAL_SAMPLES];
+static size_t packet_lengths[SIGNAL_SAMPLES];
+
+static const int reference_index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+static const int reference_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37,
+    41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173,
+    190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+    7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818,
+    18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+typedef struct reference_state_t
+{
+    int predictor;
+    int index;
+} reference_state_t;
+
+static int16_t reference_decode_nibble(reference_state_t *state, int nibble)
+{
+    int step = reference_step_table[state->index];
+    int difference = step >> 3;
+
+    if (nibble & 4)
+    {
+        difference += step;
+    }
+    if (nibble & 2)
+    {
+        difference += step >> 1;
+    }
+    if (nibble & 1)
+    {
+        difference += step >> 2;
+    }
+
+    state->predictor += nibble & 8 ? -difference : difference;
+    state->predictor = state->predictor > 32767 ? 32767 : state->predictor;
+    state->predictor = state->predictor < -32768 ? -32768 : state->predictor;
+
+    state->index += reference_index_table[nibble];
+    state->index = state->index < 0 ? 0 : state->index;
+    state->index = state->index > 88 ? 88 : state->index;
+
+    return (int16_t)state->predictor;
+}
+
+static reference_state_t reference_read_header(const uint8_t *packet)
+{
+    reference_state_t state = {
+        .predictor = (int16_t)(packet[0] | packet[1] << 8),
+        .index = packet[2],
+    };
+
+    return state;
+}
+
+// Returns the number of samples, and the state after the last one
+static size_t reference_decode_packet(const uint8_t *packet,
+                                      size_t length,
+                                      int16_t *output,
+                                      reference_state_t *state)
+{
+    *state = reference_read_header(packet);
+    size_t count = 0;
+
+    for (size_t i = MICROPHONE_ADPCM_HEADER_BYTES; i < length; i++)
+    {
+        output[count++] = reference_decode_nibble(state, packet[i] & 0x0F);
+        output[count++] = reference_decode_nibble(state, packet[i] >> 4);
+    }
+
+    return count;
+}
+
+// Splits the signal into packets as frame.microphone.read() would
+static size_t encode(size_t payload, size_t sample_count)
+{
+    microphone_adpcm_t adpcm;
+    microphone_adpcm_reset(&adpcm);
+
+    size_t packet_samples = microphone_adpcm_packet_samples(payload);
+    size_t position = 0;
+    size_t offset = 0;
+    size_t count = 0;
+
+    while (position + 1 < sample_count)
+    {
+        size_t samples = sample_count - position < packet_samples
+                             ? (sample_count - position) & ~1
+                             : packet_samples;
+
+        packet_lengths[count] = microphone_adpcm_encode_packet(&adpcm,
+                                                               signal + position,
+                                                               samples,
+                                                               packets + offset);
+        offset += packet_lengths[count];
+        position += samples;
+        count++;
+    }
+
+    return count;
+}
+
+static double snr(size_t sample_count)
+{
+    double signal_power = 0;
+    double noise_power = 0;
+
+    for (size_t i = 0; i < sample_count; i++)
+    {
+        double noise = (double)decoded[i] - signal[i];
+        signal_power += (double)signal[i] * signal[i];
+        noise_power += noise * noise;
+    }
+
+    return 10 * log10(signal_power / (noise_power + 1e-9));
+}
+
+static double sine(int i)
+{
+    return 8000 * sin(2 * M_PI * 440 * i / SAMPLE_RATE);
+}
+
+static double chirp(int i)
+{
+    double t = (double)i / SAMPLE_RATE;
+    return 6000 * sin(2 * M_PI * (100 * t + 1500 * t * t));
+}
+
+// Voiced speech like harmonics of a moving pitch, with syllable envelopes
+static double voice(int i)
+{
+    double t = (double)i / SAMPLE_RATE;
+    double pitch = 120 + 30 * sin(2 * M_PI * 0.7 * t);
+    double envelope = pow(fabs(sin(2 * M_PI * 2.5 * t)), 2);
+    double value = 0;
+
+    for (int harmonic = 1; harmonic <= 20; harmonic++)
+    {
+        double formant = exp(-pow(harmonic * pitch - 700, 2) / 2e5) +
+                         0.5 * exp(-pow(harmonic * pitch - 1800, 2) / 4e5);
+        value += formant * sin(2 * M_PI * harmonic * pitch * t);
+    }
+
+    return 4000 * envelope * value + (rand() % 201 - 100);
+}
+
+static double loud_square(int i)
+{
+    return (i / 40) % 2 ? 30000 : -30000;
+}
+
+// Each signal has its own minimum signal to noise ratio in dB, as ADPCM follows
+// slow tones far better than wideband or sharply changing signals
+static bool test_signal(const char *name,
+                        double (*generate)(int),
+                        double min_snr,
+                        bool verbose)
+{
+    srand(1);
+
+    for (int i = 0; i < SIGNAL_SAMPLES; i++)
+    {
+        signal[i] = (int16_t)lround(generate(i));
+    }
+
+    size_t packet_count = encode(MAX_PAYLOAD, SIGNAL_SAMPLES);
+
+    size_t offset = 0;
+    size_t count = 0;
+    bool states_match = true;
+
+    for (size_t i = 0; i < packet_count; i++)
+    {
+        reference_state_t state;
+        count += reference_decode_packet(packets + offset,
+                                         packet_lengths[i],
+                                         decoded + count,
+                                         &state);
+        offset += packet_lengths[i];
+
+        // Encoder and decoder must agree on the state at each packet boundary
+        if (i + 1 < packet_count)
+        {
+            reference_state_t next = reference_read_header(packets + offset);
+            states_match &= state.predictor == next.predictor &&
+                            state.index == next.index;
+        }
+    }
+
+    double ratio = snr(count);
+    bool passed = count == SIGNAL_SAMPLES && states_match && ratio >= min_snr;
+
+    printf("%-12s %4zu packets, %5.1f dB SNR, %s %s\n",
+           name,
+           packet_count,
+           ratio,
+           states_match ? "states match" : "states differ",
+           passed ? "PASS" : "FAIL");
+
+    if (verbose)
+    {
+        for (size_t i = 0; i < count; i += SAMPLE_RATE / 20)
+        {
+            printf("    %6zu: %6d -> %6d\n", i, signal[i], decoded[i]);
+        }
+    }
+
+    return passed;
+}
+
+static bool test_payload_sizes(void)
+{
+    bool passed = true;
+
+    for (int i = 0; i < SIGNAL_SAMPLES; i++)
+    {
+        signal[i] = (int16_t)lround(sine(i));
+    }
+
+    for (size_t payload = MIN_PAYLOAD; payload <= MAX_PAYLOAD; payload++)
+    {
+        // One sample short of the last full packet, so it's odd and partial
+        size_t packet_samples = microphone_adpcm_packet_samples(payload);
+        size_t sample_count = packet_samples * 3 - 3;
+        size_t packet_count = encode(payload, sample_count);
+
+        passed &= packet_count == 3 &&
+                  packet_lengths[0] == payload &&
+                  packet_lengths[1] == payload &&
+                  packet_lengths[2] == payload - 2;
+    }
+
+    printf("Packets fill payloads of %d to %d bytes %s\n",
+           MIN_PAYLOAD,
+           MAX_PAYLOAD,
+           passed ? "PASS" : "FAIL");
+
+    return passed;
+}
+
+static bool test_lost_packet(void)
+{
+    for (int i = 0; i < SIGNAL_SAMPLES; i++)
+    {
+        signal[i] = (int16_t)lround(chirp(i));
+    }
+
+    size_t packet_count = encode(MAX_PAYLOAD, SIGNAL_SAMPLES);
+    size_t packet_samples = microphone_adpcm_packet_samples(MAX_PAYLOAD);
+
+    // Decode everything apart from the third packet
+    size_t offset = 0;
+    reference_state_t state;
+    int16_t *output = decoded;
+    bool passed = true;
+
+    for (size_t i = 0; i < packet_count; i++)
+    {
+        if (i != 2)
+        {
+            reference_decode_packet(packets + offset,
+                                    packet_lengths[i],
+                                    output,
+                                    &state);
+        }
+        else
+        {
+            memset(output, 0, packet_samples * sizeof(int16_t));
+        }
+
+        offset += packet_lengths[i];
+        output += packet_samples;
+    }
+
+    // The packet after the loss must decode exactly as if nothing was lost
+    int16_t *after = decoded + 3 * packet_samples;
+    static int16_t expected[SIGNAL_SAMPLES];
+    offset = 0;
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        offset += packet_lengths[i];
+    }
+
+    reference_decode_packet(packets + offset, packet_lengths[3], expected, &state);
+    passed = memcmp(after, expected, packet_samples * sizeof(int16_t)) == 0;
+
+    printf("Packets decode on their own after a loss %s\n",
+           passed ? "PASS" : "FAIL");
+
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    bool passed = true;
+
+    passed &= test_signal("sine", sine, 30.0, verbose);
+    passed &= test_signal("chirp", chirp, 15.0, verbose);
+    passed &= test_signal("voice", voice, 12.0, verbose);
+
+    // Full scale edges, where the step size has to catch up without wrapping
+    passed &= test_signal("loud square", loud_square, 3.0, verbose);
+    passed &= test_payload_sizes();
+    passed &= test_lost_packet();
+
+    // 4 bits per sample, and the header
+    printf("Compression %.2f:1 at the largest payload\n",
+           2.0 * microphone_adpcm_packet_samples(MAX_PAYLOAD) / MAX_PAYLOAD);
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,253 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Measures the microphone decimator's frequency response with test tones, and
+ * checks how well tones above the new Nyquist frequency are kept from aliasing
+ * into the audio band. Simply dropping samples, as done previously, passes
+ * them through at full level.
+ *
+ * The 8 bit conversion is checked with a tone smaller than one output step,
+ * which rounding alone turns into distortion correlated with the tone.
+ *
+ * Usage: microphone_decimator_test [-v]
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "microphone_decimator.h"
+
+#define INPUT_RATE 16000
+#define TONE_SAMPLES 8192
+#define SETTLING_SAMPLES 256
+#define AMPLITUDE 16000.0
+
+// Requirements on the response, in dB
+#define MIN_ALIASING_REJECTION 60.0
+#define MAX_PASSBAND_RIPPLE 0.5
+
+// Passband and stopband edges, as fractions of the output Nyquist frequency
+#define PASSBAND_EDGE 0.8
+#define STOPBAND_EDGE 1.1
+
+static int16_t input[TONE_SAMPLES];
+static int16_t output[TONE_SAMPLES];
+
+static void generate_tone(double frequency)
+{
+    for (int i = 0; i < TONE_SAMPLES; i++)
+    {
+        input[i] = (int16_t)lround(AMPLITUDE * sin(2 * M_PI * frequency * i / INPUT_RATE));
+    }
+}
+
+static double rms(const int16_t *samples, size_t length)
+{
+    double sum = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        sum += (double)samples[i] * samples[i];
+    }
+
+    return sqrt(sum / length);
+}
+
+// Gain of a tone in dB, fed in uneven chunks as the PDM buffers might be
+static double tone_gain(uint8_t ratio, double frequency, bool drop_samples)
+{
+    generate_tone(frequency);
+
+    size_t count = 0;
+
+    if (drop_samples)
+    {
+        for (int i = 0; i < TONE_SAMPLES; i += ratio)
+        {
+            output[count++] = input[i];
+        }
+    }
+    else
+    {
+        static microphone_decimator_t decimator;
+        microphone_decimator_init(&decimator, ratio);
+
+        static const size_t chunks[] = {128, 100, 37, 200, 1, 64};
+        size_t position = 0;
+
+        for (int i = 0; position < TONE_SAMPLES; i++)
+        {
+            size_t chunk = chunks[i % 6];
+
+            if (position + chunk > TONE_SAMPLES)
+            {
+                chunk = TONE_SAMPLES - position;
+            }
+
+            count += microphone_decimator_process(&decimator,
+                                                  input + position,
+                                                  chunk,
+                                                  output + count);
+            position += chunk;
+        }
+    }
+
+    size_t settling = SETTLING_SAMPLES / ratio;
+
+    return 20 * log10(rms(output + settling, count - settling) /
+                      (AMPLITUDE / sqrt(2)));
+}
+
+static bool test_ratio(uint8_t ratio, bool verbose)
+{
+    double output_nyquist = INPUT_RATE / 2.0 / ratio;
+    double worst_ripple = 0;
+    double worst_rejection = INFINITY;
+    double worst_dropped_rejection = INFINITY;
+
+    for (double frequency = 50; frequency < INPUT_RATE / 2.0; frequency += 50)
+    {
+        double gain = tone_gain(ratio, frequency, false);
+
+        if (verbose)
+        {
+            printf("    %5.0f Hz: %7.1f dB\n", frequency, gain);
+        }
+
+        if (frequency <= PASSBAND_EDGE * output_nyquist)
+        {
+            worst_ripple = fmax(worst_ripple, fabs(gain));
+        }
+
+        else if (frequency >= STOPBAND_EDGE * output_nyquist)
+        {
+            worst_rejection = fmin(worst_rejection, -gain);
+
+            double dropped_gain = tone_gain(ratio, frequency, true);
+            worst_dropped_rejection = fmin(worst_dropped_rejection,
+                                           -dropped_gain);
+        }
+    }
+
+    bool passed = worst_ripple <= MAX_PASSBAND_RIPPLE &&
+                  worst_rejection >= MIN_ALIASING_REJECTION;
+
+    printf("%5u Hz: %.2f dB ripple to %.0f Hz, %.1f dB aliasing rejection "
+           "above %.0f Hz (previously %.1f dB) %s\n",
+           INPUT_RATE / ratio,
+           worst_ripple,
+           PASSBAND_EDGE * output_nyquist,
+           worst_rejection,
+           STOPBAND_EDGE * output_nyquist,
+           fabs(worst_dropped_rejection),
+           passed ? "PASS" : "FAIL");
+
+    return passed;
+}
+
+static void measure_speed(uint8_t ratio)
+{
+    static microphone_decimator_t decimator;
+    microphone_decimator_init(&decimator, ratio);
+    generate_tone(1000);
+
+    int repeats = 200;
+    clock_t start = clock();
+
+    for (int i = 0; i < repeats; i++)
+    {
+        microphone_decimator_process(&decimator, input, TONE_SAMPLES, output);
+    }
+
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    // Each output is one tap per input sample, taken two at a time
+    printf("%5u Hz: %u dual multiply accumulates per output sample, "
+           "%.1f ns per input sample on this host\n",
+           INPUT_RATE / ratio,
+           ratio * MICROPHONE_DECIMATOR_TAPS_PER_PHASE / 2,
+           seconds * 1e9 / ((double)repeats * TONE_SAMPLES));
+}
+
+// Correlation between the quantisation error and a tone below one 8 bit step
+static double quantisation_correlation(bool dither)
+{
+    uint32_t dither_state = 1;
+    double error_tone = 0;
+    double error_squared = 0;
+    double tone_squared = 0;
+
+    for (int i = 0; i < TONE_SAMPLES * 4; i++)
+    {
+        double tone = 100 * sin(2 * M_PI * 440 * i / INPUT_RATE);
+        int8_t quantised = microphone_decimator_to_8_bit((int16_t)lround(tone),
+                                                         dither,
+                                                         &dither_state);
+
+        double error = quantised * 256.0 - tone;
+        error_tone += error * tone;
+        error_squared += error * error;
+        tone_squared += tone * tone;
+    }
+
+    return fabs(error_tone) / sqrt(error_squared * tone_squared);
+}
+
+static bool test_dither(void)
+{
+    double rounded = quantisation_correlation(false);
+    double dithered = quantisation_correlation(true);
+
+    bool passed = dithered < 0.05 &&
+                  microphone_decimator_to_8_bit(INT16_MAX, false, NULL) == INT8_MAX &&
+                  microphone_decimator_to_8_bit(INT16_MIN, false, NULL) == INT8_MIN;
+
+    printf("8 bit: error correlated %.3f with a small tone when dithered, "
+           "%.3f when rounded %s\n",
+           dithered,
+           rounded,
+           passed ? "PASS" : "FAIL");
+
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    bool passed = true;
+
+    for (uint8_t ratio = 2; ratio <= MICROPHONE_DECIMATOR_MAX_RATIO; ratio *= 2)
+    {
+        passed &= test_ratio(ratio, verbose);
+        measure_speed(ratio);
+    }
+
+    passed &= test_dither();
+
+    return passed ? 0 : 1;
+}
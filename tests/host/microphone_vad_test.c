@@ -0,0 +1,331 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Runs recorded audio through the voice activity detector, in blocks the size
+ * the microphone produces, and compares what's detected against the labelled
+ * speech in the matching .csv file.
+ *
+ * Detection is allowed to run on past the end of speech by the hangover time.
+ * Radio time is how much of the audio would be sent with the detector gating
+ * the microphone, rather than all of it.
+ *
+ * Usage: microphone_vad_test [-v] audio.wav [audio.wav ...]
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "microphone_vad.h"
+
+#define MAX_SAMPLES (16000 * 30)
+#define MAX_SEGMENTS 32
+
+// The microphone produces 8ms blocks at every sample rate
+#define BLOCK_SECONDS 0.008
+
+// Enough speech must be found, and little else
+#define MIN_SPEECH_DETECTED 0.9
+#define MAX_FALSE_DETECTION 0.05
+
+static int16_t samples[MAX_SAMPLES];
+
+static struct segment
+{
+    double start;
+    double end;
+} segments[MAX_SEGMENTS];
+
+static uint32_t read_le(const uint8_t *bytes, int length)
+{
+    uint32_t value = 0;
+
+    for (int i = length - 1; i >= 0; i--)
+    {
+        value = value << 8 | bytes[i];
+    }
+
+    return value;
+}
+
+// Returns the number of samples in a 16 bit mono file, or -1 on error
+static int load_wav(const char *filename, uint32_t *sample_rate)
+{
+    FILE *file = fopen(filename, "rb");
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "couldn't open %s\n", filename);
+        return -1;
+    }
+
+    uint8_t header[12];
+
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 ||
+        memcmp(header + 8, "WAVE", 4) != 0)
+    {
+        fprintf(stderr, "%s: not a wav file\n", filename);
+        fclose(file);
+        return -1;
+    }
+
+    int count = -1;
+    uint8_t chunk[8];
+
+    while (fread(chunk, 1, sizeof(chunk), file) == sizeof(chunk))
+    {
+        uint32_t length = read_le(chunk + 4, 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0)
+        {
+            uint8_t format[16];
+
+            if (length < sizeof(format) ||
+                fread(format, 1, sizeof(format), file) != sizeof(format))
+            {
+                break;
+            }
+
+            if (read_le(format, 2) != 1 ||
+                read_le(format + 2, 2) != 1 ||
+                read_le(format + 14, 2) != 16)
+            {
+                fprintf(stderr, "%s: must be 16 bit mono PCM\n", filename);
+                break;
+            }
+
+            *sample_rate = read_le(format + 4, 4);
+            fseek(file, length - sizeof(format) + (length & 1), SEEK_CUR);
+        }
+
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            size_t wanted = length / 2 < MAX_SAMPLES ? length / 2 : MAX_SAMPLES;
+            uint8_t bytes[2];
+            count = 0;
+
+            while ((size_t)count < wanted && fread(bytes, 1, 2, file) == 2)
+            {
+                samples[count++] = (int16_t)read_le(bytes, 2);
+            }
+
+            break;
+        }
+
+        else
+        {
+            fseek(file, length + (length & 1), SEEK_CUR);
+        }
+    }
+
+    fclose(file);
+    return count;
+}
+
+static int load_labels(const char *wav_filename)
+{
+    char filename[512];
+    snprintf(filename, sizeof(filename), "%s", wav_filename);
+
+    char *extension = strrchr(filename, '.');
+
+    if (extension == NULL || strlen(extension) < 4)
+    {
+        fprintf(stderr, "%s: no labels\n", wav_filename);
+        return -1;
+    }
+
+    strcpy(extension, ".csv");
+    FILE *file = fopen(filename, "r");
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "couldn't open %s\n", filename);
+        return -1;
+    }
+
+    char line[256];
+    int count = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL && count < MAX_SEGMENTS)
+    {
+        if (line[0] == '#' || line[0] == '\n')
+        {
+            continue;
+        }
+
+        if (sscanf(line, "%lf,%lf", &segments[count].start,
+                   &segments[count].end) != 2)
+        {
+            fprintf(stderr, "%s: bad line: %s", filename, line);
+            fclose(file);
+            return -1;
+        }
+
+        count++;
+    }
+
+    fclose(file);
+    return count;
+}
+
+static bool in_segment(double time, int segment_count, double extra)
+{
+    for (int i = 0; i < segment_count; i++)
+    {
+        if (time >= segments[i].start && time < segments[i].end + extra)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool simulate(const char *name,
+                     int sample_count,
+                     uint32_t sample_rate,
+                     int segment_count,
+                     bool verbose)
+{
+    microphone_vad_t vad;
+    microphone_vad_init(&vad,
+                        sample_rate,
+                        MICROPHONE_VAD_DEFAULT_THRESHOLD_DB,
+                        MICROPHONE_VAD_DEFAULT_ZERO_CROSSING_LIMIT,
+                        MICROPHONE_VAD_DEFAULT_ONSET_SECONDS,
+                        MICROPHONE_VAD_DEFAULT_HANGOVER_SECONDS);
+
+    int block_size = (int)lround(sample_rate * BLOCK_SECONDS);
+    double allowance = MICROPHONE_VAD_DEFAULT_HANGOVER_SECONDS + BLOCK_SECONDS;
+
+    int speech_blocks = 0;
+    int speech_detected = 0;
+    int other_blocks = 0;
+    int other_detected = 0;
+    int detected = 0;
+    int blocks = 0;
+
+    for (int i = 0; i + block_size <= sample_count; i += block_size)
+    {
+        microphone_vad_event_t event = microphone_vad_process(&vad,
+                                                              samples + i,
+                                                              block_size);
+
+        double time = (double)(i + block_size / 2) / sample_rate;
+
+        if (verbose && event != MICROPHONE_VAD_NO_CHANGE)
+        {
+            printf("    %6.3fs: speech %s\n",
+                   time,
+                   event == MICROPHONE_VAD_SPEECH_STARTED ? "started" : "stopped");
+        }
+
+        blocks++;
+        detected += vad.active;
+
+        if (in_segment(time, segment_count, 0))
+        {
+            speech_blocks++;
+            speech_detected += vad.active;
+        }
+
+        // The hangover is expected to run on past the end of speech
+        else if (!in_segment(time, segment_count, allowance))
+        {
+            other_blocks++;
+            other_detected += vad.active;
+        }
+    }
+
+    double speech_fraction = speech_blocks
+                                 ? (double)speech_detected / speech_blocks
+                                 : 1;
+    double false_fraction = other_blocks
+                                ? (double)other_detected / other_blocks
+                                : 0;
+
+    bool passed = speech_fraction >= MIN_SPEECH_DETECTED &&
+                  false_fraction <= MAX_FALSE_DETECTION;
+
+    char found[32] = "no speech to find";
+
+    if (speech_blocks)
+    {
+        snprintf(found, sizeof(found), "%3d%% of speech found",
+                 (int)(speech_fraction * 100));
+    }
+
+    printf("%-20s %s, %3d%% false, %3d%% radio time %s\n",
+           name,
+           found,
+           (int)(false_fraction * 100),
+           (int)(100.0 * detected / blocks),
+           passed ? "PASS" : "FAIL");
+
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = false;
+    bool passed = true;
+    int files = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+        {
+            verbose = true;
+            continue;
+        }
+
+        uint32_t sample_rate = 0;
+        int sample_count = load_wav(argv[i], &sample_rate);
+        int segment_count = load_labels(argv[i]);
+
+        if (sample_count <= 0 || sample_rate == 0 || segment_count < 0)
+        {
+            return 1;
+        }
+
+        const char *name = strrchr(argv[i], '/');
+        name = name ? name + 1 : argv[i];
+
+        passed &= simulate(name, sample_count, sample_rate, segment_count, verbose);
+        files++;
+    }
+
+    if (files == 0)
+    {
+        fprintf(stderr, "usage: %s [-v] audio.wav [audio.wav ...]\n", argv[0]);
+        return 1;
+    }
+
+    return passed ? 0 : 1;
+}
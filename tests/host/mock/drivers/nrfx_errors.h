@@ -0,0 +1,45 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+typedef enum
+{
+    NRFX_SUCCESS,
+    NRFX_ERROR_INTERNAL,
+    NRFX_ERROR_NO_MEM,
+    NRFX_ERROR_NOT_SUPPORTED,
+    NRFX_ERROR_INVALID_PARAM,
+    NRFX_ERROR_INVALID_STATE,
+    NRFX_ERROR_INVALID_LENGTH,
+    NRFX_ERROR_TIMEOUT,
+    NRFX_ERROR_FORBIDDEN,
+    NRFX_ERROR_NULL,
+    NRFX_ERROR_INVALID_ADDR,
+    NRFX_ERROR_BUSY,
+    NRFX_ERROR_ALREADY_INITIALIZED,
+    NRFX_ERROR_DRV_TWI_ERR_OVERRUN,
+    NRFX_ERROR_DRV_TWI_ERR_ANACK,
+    NRFX_ERROR_DRV_TWI_ERR_DNACK,
+} nrfx_err_t;
@@ -0,0 +1,131 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Models the devices on the I2C bus as register files which auto increment
+ * their register address, and counts the transactions made on the bus.
+ */
+
+#include <string.h>
+#include "nrfx_twim_mock.h"
+
+mock_twim_t mock_twim;
+
+void mock_twim_reset(void)
+{
+    memset(&mock_twim, 0, sizeof(mock_twim));
+
+    // Accelerometer, camera, magnetometer and PMIC
+    static const uint8_t addresses[MOCK_TWIM_DEVICES] = {0x4C, 0x36, 0x0C, 0x48};
+
+    for (int i = 0; i < MOCK_TWIM_DEVICES; i++)
+    {
+        mock_twim.devices[i].address = addresses[i];
+        mock_twim.devices[i].wide_register_address = addresses[i] == 0x36;
+    }
+}
+
+mock_twim_device_t *mock_twim_device(uint8_t address)
+{
+    for (int i = 0; i < MOCK_TWIM_DEVICES; i++)
+    {
+        if (mock_twim.devices[i].address == address)
+        {
+            return &mock_twim.devices[i];
+        }
+    }
+
+    return NULL;
+}
+
+nrfx_err_t nrfx_twim_init(nrfx_twim_t const *p_instance,
+                          nrfx_twim_config_t const *p_config,
+                          nrfx_twim_evt_handler_t event_handler,
+                          void *p_context)
+{
+    mock_twim.frequency = p_config->frequency;
+    return NRFX_SUCCESS;
+}
+
+void nrfx_twim_enable(nrfx_twim_t const *p_instance)
+{
+    mock_twim.enabled = true;
+}
+
+nrfx_err_t nrfx_twim_xfer(nrfx_twim_t const *p_instance,
+                          nrfx_twim_xfer_desc_t const *p_xfer_desc,
+                          uint32_t flags)
+{
+    if (!mock_twim.enabled)
+    {
+        return NRFX_ERROR_INVALID_STATE;
+    }
+
+    mock_twim.transactions++;
+
+    mock_twim_device_t *device = mock_twim_device(p_xfer_desc->address);
+
+    if (device == NULL)
+    {
+        return NRFX_ERROR_DRV_TWI_ERR_ANACK;
+    }
+
+    if (mock_twim.nacks_pending > 0)
+    {
+        mock_twim.nacks_pending--;
+        return NRFX_ERROR_DRV_TWI_ERR_ANACK;
+    }
+
+    // Every transfer in this driver starts by writing the register address
+    size_t address_length = device->wide_register_address ? 2 : 1;
+
+    if (p_xfer_desc->type == NRFX_TWIM_XFER_RX ||
+        p_xfer_desc->primary_length < address_length)
+    {
+        return NRFX_ERROR_NOT_SUPPORTED;
+    }
+
+    uint8_t *tx = p_xfer_desc->p_primary_buf;
+    uint16_t register_address = address_length == 2 ? tx[0] << 8 | tx[1]
+                                                    : tx[0];
+
+    mock_twim.bytes += 1 + p_xfer_desc->primary_length;
+
+    for (size_t i = address_length; i < p_xfer_desc->primary_length; i++)
+    {
+        device->registers[register_address++] = tx[i];
+    }
+
+    if (p_xfer_desc->type == NRFX_TWIM_XFER_TXRX)
+    {
+        mock_twim.bytes += 1 + p_xfer_desc->secondary_length;
+
+        for (size_t i = 0; i < p_xfer_desc->secondary_length; i++)
+        {
+            p_xfer_desc->p_secondary_buf[i] = device->registers[register_address++];
+        }
+    }
+
+    return NRFX_SUCCESS;
+}
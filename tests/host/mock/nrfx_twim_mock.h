@@ -0,0 +1,58 @@
+/*
+ * This file is a part of: https://github.com/brilliantlabsAR/frame-codebase
+ *
+ * Authored by: Raj Nakarja / Brilliant Labs Ltd. (raj@brilliant.xyz)
+ *              Rohit Rathnam / Silicon Witchery AB (rohit@siliconwitchery.com)
+ *              Uma S. Gupta / Techno Exponent (umasankar@technoexponent.com)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "nrfx_twim.h"
+
+#define MOCK_TWIM_DEVICES 4
+
+typedef struct mock_twim_device_t
+{
+    uint8_t address;
+    bool wide_register_address;
+    uint8_t registers[0x10000];
+} mock_twim_device_t;
+
+typedef struct mock_twim_t
+{
+    nrf_twim_frequency_t frequency;
+    bool enabled;
+
+    // Each call to nrfx_twim_xfer() is one transaction on the bus
+    uint32_t transactions;
+    uint32_t bytes;
+
+    // The next transfers are NACKed by the device, and then this counts down
+    uint32_t nacks_pending;
+
+    mock_twim_device_t devices[MOCK_TWIM_DEVICES];
+} mock_twim_t;
+
+extern mock_twim_t mock_twim;
+
+void mock_twim_reset(void);
+
+mock_twim_device_t *mock_twim_device(uint8_t address);
@@ -99,6 +99,45 @@ async def main():
     await test.data_equal(b"test", b"test")
     await test.lua_send("frame.bluetooth.receive_callback(nil)")
 
+    ## Calling registered functions with binary arguments
+    await test.lua_equals(
+        "frame.rpc.register('echo', function(...) frame.bluetooth.send(string.format(string.rep('%s ', select('#', ...)), ...)) end)",
+        "0",
+    )
+    await test.lua_equals("frame.rpc.register('echo', print)", "0")
+    await test.lua_equals("frame.rpc.register('other', print)", "1")
+    await test.lua_send("frame.rpc.register('other', nil)")
+    await test.lua_send(
+        "frame.rpc.register('echo', function(...) frame.bluetooth.send(string.format(string.rep('%s ', select('#', ...)), ...)) end)"
+    )
+    await test.data_equal(
+        b"\x02\x00\x00\x01\x02\x85\x03\xfe\x04\x00\x01\x07\x00\x00\xc0\x3f\x09\x02hi",
+        b"nil false true 5 -2 256 1.5 hi ",
+    )
+    await test.lua_send("frame.rpc.register('echo', nil)")
+
+    ## Streams of calls, many to a write and spanning writes
+    await test.lua_send("r={} frame.rpc.register('append', function(s) table.insert(r, s) end)")
+    await test._transmit(b"\x02\x04\x00\x09\x01a\x04\x00\x09\x01b\x04\x00")
+    await test._transmit(b"\x02\x09\x01c")
+    await asyncio.sleep(0.1)
+    await test.lua_equals("table.concat(r)", "abc")
+    await test.lua_equals("frame.rpc.stats()['dropped']", "0")
+
+    ## Calls too long to queue are dropped and counted
+    await test._transmit(b"\x02\x82\x01" + b"\x00" * 200)
+    await test._transmit(b"\x02" + b"\x00" * 200)
+    await test._transmit(b"\x02" + b"\x00" * 113)
+    await test.lua_equals("frame.rpc.stats()['dropped']", "1")
+    await test.lua_send("frame.rpc.register('append', nil)")
+
+    ## Unregistered functions are passed to the receive callback as data
+    await test.lua_send(
+        "frame.bluetooth.receive_callback((function(d)frame.bluetooth.send(d)end))"
+    )
+    await test.data_equal(b"\x02\x00\x85", b"\x02\x00\x85")
+    await test.lua_send("frame.bluetooth.receive_callback(nil)")
+
     ## MTU size
     max_length = test.max_data_payload()
     await test.lua_equals("frame.bluetooth.max_length()", max_length)
@@ -222,7 +261,20 @@ async def main():
     # TODO
 
     ## Auto exposure & gain
-    # TODO
+    await test.lua_is_type("frame.camera.auto{}", "table")
+    await test.lua_is_type("frame.camera.auto{}['brightness']['zones']", "table")
+    await test.lua_send("frame.camera.auto{ metering = 'SPOT', exposure = 0.2 }")
+    await test.lua_error("frame.camera.auto{ metering = 'BAD' }")
+
+    ## Background auto exposure loop
+    await test.lua_equals("frame.camera.auto_loop()", "false")
+    await test.lua_send("frame.camera.auto_loop(true, { interval = 0.05 })")
+    await test.lua_equals("frame.camera.auto_loop()", "true")
+    await test.lua_send("for i = 1, 200000 do end")
+    await test.lua_send("frame.camera.auto_loop(false)")
+    await test.lua_equals("frame.camera.auto_loop()", "false")
+    await test.lua_error("frame.camera.auto_loop(true, { interval = 0.001 })")
+    await test.lua_error("frame.camera.auto_loop('on')")
 
     # Microphone
 
@@ -239,9 +291,17 @@ async def main():
     await test.lua_send("frame.microphone.start{sample_rate=16000, bit_depth=16}")
     await test.lua_send("frame.microphone.stop()")
 
+    await test.lua_send("frame.microphone.start{sample_rate=4000, dither=true}")
+    await test.lua_send("frame.microphone.stop()")
+
+    await test.lua_send("frame.microphone.start{codec='adpcm'}")
+    await test.lua_send("frame.microphone.stop()")
+
     ## Unexpected parameters
     await test.lua_error("frame.microphone.start{sample_rate=24000}")
     await test.lua_error("frame.microphone.start{bit_depth=32}")
+    await test.lua_error("frame.microphone.start{codec='mp3'}")
+    await test.lua_error("frame.microphone.start{codec='adpcm', bit_depth=8}")
 
     ## Read some data
     await test.lua_send("frame.microphone.start{}")
@@ -249,8 +309,45 @@ async def main():
     await test.lua_equals("#frame.microphone.read(10)", "10")
     await test.lua_equals("#frame.microphone.read(256)", "256")
     await test.lua_error("frame.microphone.read(11)")
+    await test.lua_error("frame.microphone.read(-2)")
+    await test.lua_is_type("select(2, frame.microphone.read(10))", "number")
+    await test.lua_equals("frame.microphone.stats()['overruns']", "0")
     await test.lua_send("frame.microphone.stop()")
 
+    ## Overruns are counted once the FIFO fills up
+    await test.lua_send("frame.microphone.start{sample_rate=16000}")
+    await asyncio.sleep(2.5)
+    await test.lua_equals("frame.microphone.stats()['overruns'] > 0", "true")
+    await test.lua_send("frame.microphone.stop()")
+
+    ## Native streaming
+    await test.lua_send("frame.microphone.start{stream=true}")
+    await asyncio.sleep(0.25)
+    await test.lua_error("frame.microphone.read(10)")
+    await test.lua_is_type("frame.microphone.stats()['sent']", "number")
+    await test.lua_is_type("frame.microphone.stats()['busy']", "number")
+    await test.lua_is_type("frame.microphone.stats()['dropped']", "number")
+    await test.lua_send("frame.microphone.stop()")
+    await test.lua_error("frame.microphone.start{stream='yes'}")
+
+    ## Voice activity detection
+    await test.lua_equals("frame.microphone.speaking()", "false")
+    await test.lua_send("frame.microphone.start{vad=true}")
+    await test.lua_is_type("frame.microphone.speaking()", "boolean")
+    await test.lua_send("frame.microphone.stop()")
+    await test.lua_send(
+        "frame.microphone.start{vad={threshold=6, zero_crossings=0.4, onset=0.05, hangover=0.5, gate=false}}"
+    )
+    await asyncio.sleep(0.25)
+    await test.lua_equals("#frame.microphone.read(10)", "10")
+    await test.lua_send("frame.microphone.stop()")
+    await test.lua_send("frame.microphone.speech_callback(function(s) end)")
+    await test.lua_send("frame.microphone.speech_callback(nil)")
+    await test.lua_error("frame.microphone.speech_callback(1)")
+    await test.lua_error("frame.microphone.start{vad={threshold=100}}")
+    await test.lua_error("frame.microphone.start{vad={gate='no'}}")
+    await test.lua_error("frame.microphone.start{vad=1}")
+
     # IMU
 
     ## Direction
@@ -262,6 +359,27 @@ async def main():
     await test.lua_send("frame.imu.tap_callback((function()print('tap')end))")
     await test.lua_send("frame.imu.tap_callback(nil)")
 
+    ## Buffered sampling
+    await test.lua_error("frame.imu.read_batch()")
+    await test.lua_error("frame.imu.start{rate=100}")
+    await test.lua_error("frame.imu.start{smoothing=-1}")
+    await test.lua_send("frame.imu.start{rate=64}")
+    await test.lua_error("frame.imu.start{}")
+    await asyncio.sleep(0.5)
+    await test.lua_send("samples, dropped = frame.imu.read_batch(10)")
+    await test.lua_equals("#samples", "10")
+    await test.lua_is_type("samples[1]['timestamp']", "number")
+    await test.lua_is_type("samples[1]['accelerometer']['x']", "number")
+    await test.lua_is_type("samples[1]['compass']['x']", "number")
+    await test.lua_equals("samples[10]['timestamp'] > samples[1]['timestamp']", "true")
+    await test.lua_is_type("frame.imu.raw()['accelerometer']['x']", "number")
+    await test.lua_is_type("frame.imu.direction()['heading']", "number")
+    await test.lua_send("frame.imu.stop()")
+    await test.lua_send("frame.imu.start{rate=256, compass=false}")
+    await asyncio.sleep(0.5)
+    await test.lua_equals("#frame.imu.read_batch() > 100", "true")
+    await test.lua_send("frame.imu.stop()")
+
     # Time functions
 
     ## Delays
@@ -269,6 +387,18 @@ async def main():
     await test.lua_send("frame.sleep(2.0)")
     await test.lua_equals("math.floor(frame.time.utc()+0.5)", "1698756586")
 
+    ## Sub millisecond resolution, from the RTC counter rather than a tick
+    await test.lua_equals(
+        "(function() local t=frame.time.utc() local n=t repeat n=frame.time.utc() until n~=t return n-t < 0.0005 end)()",
+        "true",
+    )
+    await test.lua_send("t=frame.time.utc() frame.sleep(0.25)")
+    await test.lua_equals("math.abs(frame.time.utc()-t-0.25) < 0.005", "true")
+
+    ## Sleeping for longer than the watchdog timeout
+    await test.lua_send("t=frame.time.utc() frame.sleep(7)")
+    await test.lua_equals("math.abs(frame.time.utc()-t-7) < 0.005", "true")
+
     ## Date now under different timezones
     await test.lua_send("frame.time.zone('0:00')")
     await test.lua_equals("frame.time.zone()", "+00:00")
@@ -309,6 +439,26 @@ async def main():
     await test.lua_equals("frame.time.date(1698943733)['day of year']", "305")
     await test.lua_equals("frame.time.date(1698943733)['is daylight saving']", "false")
 
+    # Tasks
+
+    ## Interleaved sleeps finish in order of their deadlines
+    await test.lua_send("r='' for i,d in ipairs{0.3,0.1,0.2} do frame.task.spawn(function(n) frame.task.sleep(d) r=r..n end, i) end")
+    await test.lua_send("t=frame.time.utc() frame.task.run()")
+    await test.lua_equals("r", "231")
+    await test.lua_equals("math.abs(frame.time.utc()-t-0.3) < 0.005", "true")
+
+    ## Tasks give way with coroutine.yield()
+    await test.lua_send("r='' for i=1,2 do frame.task.spawn(function() for j=1,2 do r=r..i coroutine.yield() end end) end frame.task.run()")
+    await test.lua_equals("r", "1212")
+
+    ## Waiting for bluetooth to finish sending
+    await test.lua_send("frame.task.spawn(function() frame.bluetooth.send('abc') frame.task.bluetooth_drain() end) frame.task.run()")
+
+    ## Errors from tasks are raised by run()
+    await test.lua_error("frame.task.spawn(function() error('failed') end) frame.task.run()")
+    await test.lua_error("frame.task.sleep(1)")
+    await test.lua_error("frame.task.spawn(1)")
+
     # System functions
 
     ## Resets
@@ -87,6 +87,16 @@ async def main():
     frame.camera.capture { resolution = 720, pan = 75 }; transfer()
     frame.camera.capture { resolution = 720, pan = 140 }; transfer()
 
+    frame.camera.capture { resolution = 256, binning = 2 }; transfer()
+    frame.camera.capture { resolution = 176, binning = 4 }; transfer()
+    frame.camera.capture { roi = { 0, 0, 720, 240 } }; transfer()
+    frame.camera.capture { roi = { 160, 400, 400, 160 }, binning = 2 }; transfer()
+    frame.camera.capture { roi = { 0, 0, 712, 712 }, binning = 4 }; transfer()
+
+    frame.camera.capture { resolution = 512, grayscale = true }; transfer()
+    frame.camera.capture { roi = { 0, 300, 720, 120 }, grayscale = true }; transfer()
+    frame.camera.capture { resolution = 200, quality = 'VERY_HIGH', grayscale = true }; transfer()
+
     frame.camera.capture { }; transfer()
 
     print("Done - Press enter to finish")
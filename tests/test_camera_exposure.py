@@ -19,7 +19,7 @@ async def main():
         metrics = metrics..e['brightness']['matrix']['r']..':'
         metrics = metrics..e['brightness']['matrix']['g']..':'
         metrics = metrics..e['brightness']['matrix']['b']..':'
-        metrics = metrics..e['brightness']['center_weighted_average']..':'
+        metrics = metrics..e['brightness']['metered']..':'
         metrics = metrics..e['shutter']..':'
         metrics = metrics..e['analog_gain']..':'
         metrics = metrics..e['error']
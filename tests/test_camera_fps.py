@@ -671,7 +671,9 @@ async def main():
 
     while true do
         if state == 'CAPTURE' then
-            frame.camera.capture { }
+            -- Compression of the next image overlaps with reading out this
+            -- one. Each image must fit within half of the 64KB image buffer
+            frame.camera.capture { continuous = true, quality = 'LOW' }
             -- frame.camera.capture { resolution = 512, quality = 'HIGH' }
             state_time = frame.time.utc()
             state = 'WAIT'
@@ -698,7 +700,7 @@ async def main():
                     break
                 end
             end
-            state = 'CAPTURE'
+            state = 'WAIT'
         end
 
         if frame.time.utc() - last_autoexp_time > 0.1 then
@@ -0,0 +1,103 @@
+"""
+Records a trace of compressed image sizes and metering values which can be
+replayed through the rate controller using `make host-tests`, and then checks
+the image sizes when capturing with a target size
+"""
+
+import asyncio
+from frameutils import Bluetooth
+
+# Size of the header and footer added by frame.camera.read()
+JPEG_HEADER_AND_FOOTER_BYTES = 625
+
+trace = []
+sizes = []
+
+
+def receive_print(response):
+    if response.startswith("Trace:"):
+        values = [float(v) for v in response[6:].split(":")]
+        size = int(values[0]) - JPEG_HEADER_AND_FOOTER_BYTES
+        metering = [int(v * 255) for v in values[1:]]
+        trace.append([512, 4, size] + metering)
+        print(f"Frame {len(trace)}: {size} bytes")
+
+    elif response.startswith("Size:"):
+        size = int(response[5:]) - JPEG_HEADER_AND_FOOTER_BYTES
+        sizes.append(size)
+        print(f"Frame {len(sizes)}: {size} bytes with a target of 12000")
+
+    else:
+        print(response)
+
+
+async def main():
+
+    lua_script = """
+    function capture_size(options)
+        frame.camera.capture(options)
+
+        while frame.camera.image_ready() == false do
+            frame.sleep(0.01)
+        end
+
+        local size = 0
+
+        while true do
+            local data = frame.camera.read(256)
+            if data == nil then
+                break
+            end
+            size = size + #data
+        end
+
+        return size
+    end
+
+    frame.display.power_save(true)
+    frame.camera.power_save(false)
+
+    for i = 1, 100 do
+        local size = capture_size { resolution = 512, quality = 'MEDIUM' }
+        local b = frame.camera.auto { }['brightness']
+        print('Trace:'..size..':'..
+              b['spot']['r']..':'..b['spot']['g']..':'..b['spot']['b']..':'..
+              b['matrix']['r']..':'..b['matrix']['g']..':'..b['matrix']['b'])
+    end
+
+    for i = 1, 50 do
+        local size = capture_size { resolution = 512, target_size = 12000 }
+        frame.camera.auto { }
+        print('Size:'..size)
+    end
+
+    print('Done')
+    """
+
+    b = Bluetooth()
+
+    await b.connect(print_response_handler=receive_print)
+
+    await b.upload_file(lua_script, "main.lua")
+    await b.send_reset_signal()
+
+    while len(sizes) < 50:
+        await asyncio.sleep(1)
+
+    await b.send_break_signal()
+    await b.disconnect()
+
+    with open("test_camera_rate_control_trace.csv", "w") as f:
+        f.write("# Recorded with tests/test_camera_rate_control.py\n")
+        f.write(
+            "# resolution,quality_level,compressed_bytes,"
+            "spot_r,spot_g,spot_b,matrix_r,matrix_g,matrix_b\n"
+        )
+        for row in trace:
+            f.write(",".join(str(v) for v in row) + "\n")
+
+    over_budget = len([s for s in sizes[3:] if s > 12000 * 1.1])
+    print(f"{over_budget} of {len(sizes) - 3} frames more than 10% over budget")
+
+
+asyncio.run(main())
@@ -0,0 +1,66 @@
+import asyncio
+import struct
+import time
+from aioconsole import ainput
+from frameutils import Bluetooth
+
+VIDEO_FRAME_START = 0x10
+VIDEO_FRAME_DATA = 0x11
+
+frame_data = b""
+frame_length = 0
+last_frame_time = time.time()
+
+
+def receive_data(data):
+    global frame_data
+    global frame_length
+    global last_frame_time
+
+    if data[0] == VIDEO_FRAME_START:
+        sequence, timestamp, resolution, quality, frame_length = struct.unpack(
+            "<HQHBI", data[1:18]
+        )
+        fps = 1 / (time.time() - last_frame_time)
+        last_frame_time = time.time()
+        print(
+            f"\rFrame {sequence} at {timestamp}ms: {resolution}x{resolution}, "
+            f"quality {quality}, {frame_length} bytes, {fps:.1f} FPS. "
+            "Press enter to finish      ",
+            end="",
+        )
+        frame_data = b""
+
+    elif data[0] == VIDEO_FRAME_DATA:
+        frame_data += data[1:]
+
+        # Save each complete frame, so the latest is always viewable
+        if len(frame_data) == frame_length:
+            with open("test_camera_video_frame.jpg", "wb") as f:
+                f.write(frame_data)
+
+
+async def main():
+
+    lua_script = """
+    frame.display.power_save(true)
+    frame.camera.power_save(false)
+
+    frame.camera.video { fps = 10, resolution = 256, quality = 'HIGH' }
+    """
+
+    b = Bluetooth()
+
+    await b.connect(data_response_handler=receive_data)
+
+    await b.upload_file(lua_script, "main.lua")
+    await b.send_reset_signal()
+
+    # Wait until a keypress
+    await ainput("")
+
+    await b.send_break_signal()
+    await b.disconnect()
+
+
+asyncio.run(main())
@@ -14,6 +14,9 @@ async def main():
     # Load the I2C bus
     await b.send_lua("frame.camera.auto(true, 'average')")
 
+    # Filter the orientation from continuous samples
+    await b.send_lua("frame.imu.start{rate=64}")
+
     # Enable taps
     await b.send_lua("frame.imu.tap_callback((function()print('Tap!')end))")
 
@@ -8,41 +8,116 @@ import sounddevice as sd
 import numpy as np
 
 audio_buffer = b""
+adpcm_packets = []
+
+STREAM_DATA = 0x12
+
+ADPCM_INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8] * 2
+
+ADPCM_STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41,
+    45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209,
+    230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876,
+    963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+    3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493,
+    10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086,
+    29794, 32767,
+]  # fmt: skip
+
+
+def decode_adpcm_packet(packet):
+    """Decodes one packet, which starts with the predictor and step index"""
+    predictor = int.from_bytes(packet[0:2], "little", signed=True)
+    index = packet[2]
+    samples = []
+
+    for byte in packet[4:]:
+        for code in (byte & 0x0F, byte >> 4):
+            step = ADPCM_STEP_TABLE[index]
+            difference = step >> 3
+            if code & 4:
+                difference += step
+            if code & 2:
+                difference += step >> 1
+            if code & 1:
+                difference += step >> 2
+            predictor += -difference if code & 8 else difference
+            predictor = max(-32768, min(32767, predictor))
+            index = max(0, min(88, index + ADPCM_INDEX_TABLE[code]))
+            samples.append(predictor)
+
+    return samples
 
 
 def receive_data(data):
     global audio_buffer
     audio_buffer += data
+    adpcm_packets.append(data)
     print(f"Received {str(len(audio_buffer))} bytes", end="\r")
 
 
-async def record_and_play(b: Bluetooth, sample_rate, bit_depth):
+def unpack_stream():
+    """Strips the stream headers, and reports any packets the Frame dropped"""
+    global audio_buffer
+
+    packets = [p for p in adpcm_packets if p[0] == STREAM_DATA]
+    sequences = [int.from_bytes(p[1:3], "little") for p in packets]
+    missing = sum((b - a - 1) % 65536 for a, b in zip(sequences, sequences[1:]))
+    print(f"\n{len(packets)} packets streamed, {missing} dropped")
+
+    adpcm_packets[:] = [p[3:] for p in packets]
+    audio_buffer = b"".join(adpcm_packets)
+
+
+async def record_and_play(
+    b: Bluetooth, sample_rate, bit_depth, codec="pcm", stream=False
+):
     global audio_buffer
 
     audio_buffer = b""
+    adpcm_packets.clear()
 
-    print(f"Streaming at {sample_rate/1000}kHz {bit_depth}bit")
+    print(
+        f"Streaming at {sample_rate/1000}kHz {bit_depth}bit {codec}"
+        f"{' natively' if stream else ''}"
+    )
     await b.send_lua(
-        f"frame.microphone.start{{sample_rate={sample_rate}, bit_depth={bit_depth}}}"
+        f"frame.microphone.start{{sample_rate={sample_rate}, bit_depth={bit_depth}, codec='{codec}', stream={str(stream).lower()}}}"
     )
 
     # await asyncio.sleep(1)
 
-    await b.send_lua(
-        f"while true do s=frame.microphone.read({b.max_data_payload()}); if s==nil then break end if s~='' then while true do if (pcall(frame.bluetooth.send,s)) then break end end end end"
-    )
+    if stream:
+        await asyncio.sleep(5)
+        await b.send_lua(f"frame.microphone.stop()")
+        stats = await b.send_lua(
+            "s=frame.microphone.stats() print(s.sent..' sent, '..s.busy..' busy, '..s.dropped..' dropped')",
+            await_print=True,
+        )
+        print(f"\nFrame reports {stats}")
+        unpack_stream()
+
+    else:
+        await b.send_lua(
+            f"while true do s=frame.microphone.read({b.max_data_payload()}); if s==nil then break end if s~='' then while true do if (pcall(frame.bluetooth.send,s)) then break end end end end"
+        )
 
-    await asyncio.sleep(5)
+        await asyncio.sleep(5)
 
-    await b.send_break_signal()
-    await b.send_lua(f"frame.microphone.stop()")
+        await b.send_break_signal()
+        await b.send_lua(f"frame.microphone.stop()")
 
     print("\nConverting to audio")
 
     # Convert audio bytes to a NumPy array of type int8
-    if bit_depth == 16:
+    if codec == "adpcm":
+        audio_data = np.array(
+            [s for p in adpcm_packets for s in decode_adpcm_packet(p)],
+            dtype=np.int16,
+        )
+    elif bit_depth == 16:
         audio_data = np.frombuffer(audio_buffer, dtype=np.int16)
-    if bit_depth == 8:
+    elif bit_depth == 8:
         audio_data = np.frombuffer(audio_buffer, dtype=np.int8)
 
     # Convert it to float32 which is what sounddevice expects for playback
@@ -67,6 +142,9 @@ async def main():
     await record_and_play(b, 8000, 8)
     await record_and_play(b, 8000, 16)
     await record_and_play(b, 16000, 8)
+    await record_and_play(b, 16000, 16, "adpcm")
+    await record_and_play(b, 16000, 16, stream=True)
+    await record_and_play(b, 16000, 16, "adpcm", stream=True)
 
     await b.disconnect()
 
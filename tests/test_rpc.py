@@ -0,0 +1,121 @@
+import asyncio
+import struct
+import time
+from frameutils import Bluetooth
+
+RPC_CALL = 0x02
+RPC_STREAM = 0x02
+
+
+def encode_rpc_arguments(function_id, *arguments):
+    """Encodes a call to a function registered with frame.rpc.register()"""
+    data = bytes([function_id])
+
+    for argument in arguments:
+        if argument is None:
+            data += b"\x00"
+        elif argument is False:
+            data += b"\x01"
+        elif argument is True:
+            data += b"\x02"
+        elif isinstance(argument, int):
+            if 0 <= argument <= 127:
+                data += bytes([0x80 | argument])
+            elif -(2**7) <= argument < 2**7:
+                data += b"\x03" + struct.pack("<b", argument)
+            elif -(2**15) <= argument < 2**15:
+                data += b"\x04" + struct.pack("<h", argument)
+            elif -(2**31) <= argument < 2**31:
+                data += b"\x05" + struct.pack("<i", argument)
+            else:
+                data += b"\x06" + struct.pack("<q", argument)
+        elif isinstance(argument, float):
+            data += b"\x08" + struct.pack("<d", argument)
+        else:
+            if isinstance(argument, str):
+                argument = argument.encode()
+            if len(argument) < 256:
+                data += b"\x09" + bytes([len(argument)]) + argument
+            else:
+                data += b"\x0a" + struct.pack("<H", len(argument)) + argument
+
+    return data
+
+
+def encode_rpc_call(function_id, *arguments):
+    """A single call, sent with send_data()"""
+    return bytes([RPC_CALL]) + encode_rpc_arguments(function_id, *arguments)
+
+
+def encode_rpc_stream(calls, max_payload):
+    """Packs (function_id, arguments...) calls into as few writes as possible"""
+    stream = b""
+
+    for call in calls:
+        command = encode_rpc_arguments(*call)
+        if len(command) < 0x80:
+            stream += bytes([len(command)]) + command
+        else:
+            stream += bytes([0x80 | len(command) >> 8, len(command) & 0xFF])
+            stream += command
+
+    # Less one for the stream flag
+    chunk = max_payload - 1
+    return [
+        bytes([RPC_STREAM]) + stream[i : i + chunk]
+        for i in range(0, len(stream), chunk)
+    ]
+
+
+responses = asyncio.Queue()
+
+
+async def main():
+    b = Bluetooth()
+
+    await b.connect(data_response_handler=lambda data: responses.put_nowait(data))
+
+    # Draws a heads up display, and acknowledges each update
+    hud_id = int(
+        await b.send_lua(
+            "print(frame.rpc.register('hud', function(text, x, y) "
+            "frame.display.text(text, x, y) frame.display.show() "
+            "frame.bluetooth.send('') end))",
+            await_print=True,
+        )
+    )
+
+    updates = 50
+
+    start = time.time()
+    for i in range(updates):
+        await b.send_lua(
+            f"frame.display.text('Update {i}', 50, 100) frame.display.show() "
+            "frame.bluetooth.send('')"
+        )
+        await responses.get()
+    repl_time = (time.time() - start) / updates
+
+    start = time.time()
+    for i in range(updates):
+        await b.send_data(encode_rpc_call(hud_id, f"Update {i}", 50, 100))
+        await responses.get()
+    rpc_time = (time.time() - start) / updates
+
+    # Many updates batched into each write
+    start = time.time()
+    calls = [(hud_id, f"Update {i}", 50, 100) for i in range(updates)]
+    for write in encode_rpc_stream(calls, b.max_lua_payload()):
+        await b._transmit(write)
+    for i in range(updates):
+        await responses.get()
+    batched_time = (time.time() - start) / updates
+
+    print(f"REPL:    {repl_time * 1000:.1f}ms per update")
+    print(f"RPC:     {rpc_time * 1000:.1f}ms per update")
+    print(f"Batched: {batched_time * 1000:.1f}ms per update")
+
+    await b.disconnect()
+
+
+asyncio.run(main())
@@ -0,0 +1,103 @@
+import asyncio
+import time
+from aioconsole import ainput
+from frameutils import Bluetooth
+
+image_data = b""
+last_frame_time = time.time()
+
+
+def receive_data(data):
+    global image_data
+    global last_frame_time
+
+    if data[0] == 0:
+        image_data += data[1:]
+
+    elif data[0] == 1:
+        fps = 1 / (time.time() - last_frame_time)
+        last_frame_time = time.time()
+        print(
+            f"\r{len(image_data)} byte image at {fps:.1f} FPS. "
+            "Press enter to finish      ",
+            end="",
+        )
+
+        with open("test_tasks_frame.jpg", "wb") as f:
+            f.write(image_data)
+
+        image_data = b""
+
+
+async def main():
+
+    # Captures the next image while the previous one is still being sent, and
+    # keeps the display updated alongside both
+    lua_script = """
+    frame.camera.power_save(false)
+
+    local chunks = {}
+    local captured = 0
+
+    local function send(data)
+        while pcall(frame.bluetooth.send, data) == false do
+            frame.task.bluetooth_drain()
+        end
+    end
+
+    frame.task.spawn(function()
+        while true do
+            frame.camera.capture { quality = 'HIGH' }
+            frame.task.camera_ready()
+
+            while true do
+                local chunk = frame.camera.read(frame.bluetooth.max_length() - 1)
+                if chunk == nil then break end
+                table.insert(chunks, chunk)
+                coroutine.yield()
+            end
+
+            table.insert(chunks, false)
+            captured = captured + 1
+        end
+    end)
+
+    frame.task.spawn(function()
+        while true do
+            local chunk = table.remove(chunks, 1)
+            if chunk == nil then
+                frame.task.sleep(0.005)
+            elseif chunk == false then
+                send('\\x01')
+            else
+                send('\\x00' .. chunk)
+            end
+        end
+    end)
+
+    frame.task.spawn(function()
+        while true do
+            frame.display.text(captured .. ' images', 50, 100)
+            frame.display.show()
+            frame.task.sleep(0.5)
+        end
+    end)
+
+    frame.task.run()
+    """
+
+    b = Bluetooth()
+
+    await b.connect(data_response_handler=receive_data)
+
+    await b.upload_file(lua_script, "main.lua")
+    await b.send_reset_signal()
+
+    # Wait until a keypress
+    await ainput("")
+
+    await b.send_break_signal()
+    await b.disconnect()
+
+
+asyncio.run(main())
@@ -31,6 +31,32 @@ async def main():
     await b.send_lua("frame.display.show()")
     await asyncio.sleep(2.00)
 
+    # Test justification
+    await b.send_lua("frame.display.text('Left', 1, 1, { align = 'LEFT' })")
+    await b.send_lua("frame.display.text('Center', 1, 50, { align = 'CENTER' })")
+    await b.send_lua("frame.display.text('Right', 1, 100, { align = 'RIGHT' })")
+    await b.send_lua(
+        "frame.display.text('Centered in a box', 200, 150, { width = 240, align = 'CENTER' })"
+    )
+    await b.send_lua("frame.display.show()")
+    await asyncio.sleep(2.00)
+
+    # Test wrapping
+    await b.send_lua(
+        "frame.display.text('This sentence should wrap over a few lines', 50, 50, { width = 300 })"
+    )
+    await b.send_lua(
+        "frame.display.text('Line one\\nLine two', 400, 50, { line_spacing = 10 })"
+    )
+    await b.send_lua("frame.display.show()")
+    await asyncio.sleep(2.00)
+
+    # Test measuring
+    await b.send_lua(
+        "m=frame.display.measure_text('Hello world', { width = 150 });print(m.width..' '..m.height..' '..#m.lines)",
+        await_print=True,
+    )
+
     # Print all colors
     await b.send_lua("frame.display.text('WHITE', 1, 1, { color = 'WHITE' })")
     await b.send_lua("frame.display.text('GREY', 1, 50, { color = 'GREY' })")
@@ -0,0 +1,60 @@
+import asyncio
+from frameutils import Bluetooth
+
+
+async def main():
+    b = Bluetooth()
+
+    await b.connect(print_response_handler=lambda s: print(s))
+
+    await b.send_lua("frame.display.power_save(false)")
+
+    # Lines in every direction
+    await b.send_lua("frame.display.line(320, 200, 1, 1)")
+    await b.send_lua("frame.display.line(320, 200, 640, 1, { color = 'RED' })")
+    await b.send_lua("frame.display.line(320, 200, 1, 400, { color = 'GREEN' })")
+    await b.send_lua("frame.display.line(320, 200, 640, 400, { color = 'SKYBLUE' })")
+    await b.send_lua("frame.display.line(1, 200, 640, 200, { color = 'YELLOW' })")
+    await b.send_lua("frame.display.line(320, 1, 320, 400, { color = 'PINK' })")
+    await b.send_lua("frame.display.show()")
+    await asyncio.sleep(2.00)
+
+    # Rectangles
+    await b.send_lua("frame.display.rect(1, 1, 640, 400)")
+    await b.send_lua("frame.display.rect(50, 50, 200, 100, { color = 'RED' })")
+    await b.send_lua(
+        "frame.display.rect(300, 50, 200, 100, { color = 'ORANGE', fill = true })"
+    )
+    await b.send_lua("frame.display.show()")
+    await asyncio.sleep(2.00)
+
+    # Polygons
+    await b.send_lua(
+        "frame.display.polygon({ 100, 350, 200, 200, 300, 350 }, { color = 'GREEN' })"
+    )
+    await b.send_lua(
+        "frame.display.polygon({ 350, 350, 450, 200, 550, 350, 450, 300 }, { color = 'SEABLUE', fill = true })"
+    )
+    await b.send_lua("frame.display.show()")
+    await asyncio.sleep(2.00)
+
+    # Retained mode where only the moving bar is cleared and redrawn
+    await b.send_lua("frame.display.retain(true)")
+    for _ in range(2):
+        await b.send_lua("frame.display.rect(1, 1, 640, 200, { color = 'GREY' })")
+        await b.send_lua("frame.display.show()")
+    for x in range(1, 600, 10):
+        await b.send_lua(
+            f"frame.display.rect({x}, 300, 40, 50, {{ color = 'RED', fill = true }})"
+        )
+        await b.send_lua(f"frame.display.mark_dirty({x}, 300, 40, 50)")
+        await b.send_lua("frame.display.show()")
+    await b.send_lua("frame.display.retain(false)")
+    await b.send_lua("frame.display.show()")
+
+    await b.send_lua("frame.display.power_save(true)")
+
+    await b.disconnect()
+
+
+asyncio.run(main())